@@ -0,0 +1,164 @@
+/*
+ * docstats.c - CS50 TSE docstats module
+ *
+ * see docstats.h for more information.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "docstats.h"
+#include "safefile.h"
+
+/**************** global types ****************/
+typedef struct docstats {
+    int* lengths;               // by docID; -1 if not recorded
+    int size;                   // slots in lengths
+    int count;                  // documents recorded
+    long long total;            // sum of their lengths
+} docstats_t;
+
+/**************** local functions ****************/
+static char* statsPath(const char* indexFilename);
+
+static const char* SUFFIX = ".docs";
+
+/**************** docstats_new() ****************/
+/* see docstats.h for description */
+docstats_t* docstats_new(void)
+{
+    return calloc(1, sizeof(docstats_t));
+}
+
+/**************** docstats_set() ****************/
+/* see docstats.h for description */
+bool docstats_set(docstats_t* stats, const int docID, const int length)
+{
+    if (stats == NULL || docID <= 0 || length < 0) {
+        return false;
+    }
+    if (docID >= stats->size) {
+        int size = (stats->size > 0) ? stats->size : 64;
+        while (size <= docID) {
+            size *= 2;
+        }
+        int* bigger = realloc(stats->lengths, size * sizeof(int));
+        if (bigger == NULL) {
+            return false;
+        }
+        for (int i = stats->size; i < size; i++) {
+            bigger[i] = -1;
+        }
+        stats->lengths = bigger;
+        stats->size = size;
+    }
+    if (stats->lengths[docID] < 0) {
+        stats->count++;
+    } else {
+        stats->total -= stats->lengths[docID];
+    }
+    stats->lengths[docID] = length;
+    stats->total += length;
+    return true;
+}
+
+/**************** docstats_length() ****************/
+/* see docstats.h for description */
+int docstats_length(docstats_t* stats, const int docID)
+{
+    if (stats == NULL || docID <= 0 || docID >= stats->size) {
+        return -1;
+    }
+    return stats->lengths[docID];
+}
+
+/**************** docstats_count() ****************/
+/* see docstats.h for description */
+int docstats_count(docstats_t* stats)
+{
+    return (stats == NULL) ? 0 : stats->count;
+}
+
+/**************** docstats_average() ****************/
+/* see docstats.h for description */
+double docstats_average(docstats_t* stats)
+{
+    if (stats == NULL || stats->count == 0) {
+        return 0;
+    }
+    return (double) stats->total / stats->count;
+}
+
+/**************** docstats_save() ****************/
+/* see docstats.h for description */
+bool docstats_save(docstats_t* stats, const char* indexFilename)
+{
+    char* pathname = statsPath(indexFilename);
+    FILE* fp = (pathname == NULL || stats == NULL) ? NULL : safefile_open(pathname, "w");
+    if (fp == NULL) {
+        free(pathname);
+        return false;
+    }
+    for (int docID = 1; docID < stats->size; docID++) {
+        if (stats->lengths[docID] >= 0) {
+            fprintf(fp, "%d %d\n", docID, stats->lengths[docID]);
+        }
+    }
+    bool ok = safefile_close(fp, pathname, true);
+    free(pathname);
+    return ok;
+}
+
+/**************** docstats_load() ****************/
+/* see docstats.h for description */
+docstats_t* docstats_load(const char* indexFilename)
+{
+    char* pathname = statsPath(indexFilename);
+    FILE* fp = (pathname == NULL) ? NULL : fopen(pathname, "r");
+    free(pathname);
+    if (fp == NULL) {
+        return NULL;
+    }
+    docstats_t* stats = docstats_new();
+    int docID, length, fields;
+    while (stats != NULL && (fields = fscanf(fp, "%d %d", &docID, &length)) == 2) {
+        if (!docstats_set(stats, docID, length)) {
+            docstats_delete(stats);
+            stats = NULL;
+        }
+    }
+    if (stats != NULL && fields != EOF) {
+        docstats_delete(stats);       // a malformed line
+        stats = NULL;
+    }
+    fclose(fp);
+    return stats;
+}
+
+/**************** docstats_delete() ****************/
+/* see docstats.h for description */
+void docstats_delete(docstats_t* stats)
+{
+    if (stats != NULL) {
+        free(stats->lengths);
+        free(stats);
+    }
+}
+
+/**************** statsPath() ****************/
+/* Return the malloc'd pathname of an index's statistics file */
+static char* statsPath(const char* indexFilename)
+{
+    if (indexFilename == NULL) {
+        return NULL;
+    }
+    char* pathname = malloc(strlen(indexFilename) + strlen(SUFFIX) + 1);
+    if (pathname != NULL) {
+        strcpy(pathname, indexFilename);
+        strcat(pathname, SUFFIX);
+    }
+    return pathname;
+}
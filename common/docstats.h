@@ -0,0 +1,72 @@
+/*
+ * docstats.h - header file for CS50 TSE docstats module
+ *
+ * The docstats module records how long each indexed document is (the
+ * number of words the indexer counted in it: words of three or more
+ * letters), which the querier needs to normalize scores by document
+ * length (BM25). The indexer saves them beside the index, in a file
+ * named for the index with ".docs" appended, one line per document:
+ *
+ *     docID length
+ *
+ * in increasing docID order. The document frequency of each word needs
+ * no file of its own: it is the number of (docID, count) pairs on the
+ * word's line of the index.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#ifndef __DOCSTATS_H
+#define __DOCSTATS_H
+
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct docstats docstats_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** docstats_new ****************/
+/* Create an empty set of document statistics; NULL on error.
+ * Caller is responsible for docstats_delete.
+ */
+docstats_t* docstats_new(void);
+
+/**************** docstats_set ****************/
+/* Record a document's length (which may be 0); return false on error. */
+bool docstats_set(docstats_t* stats, const int docID, const int length);
+
+/**************** docstats_length ****************/
+/* Return a document's length, or -1 if it was never recorded. */
+int docstats_length(docstats_t* stats, const int docID);
+
+/**************** docstats_count ****************/
+/* Return the number of documents recorded. */
+int docstats_count(docstats_t* stats);
+
+/**************** docstats_average ****************/
+/* Return the documents' mean length (0 if there are none). */
+double docstats_average(docstats_t* stats);
+
+/**************** docstats_save ****************/
+/* Write the statistics beside the index file indexFilename.
+ *
+ * We return:
+ *   false if the file could not be written.
+ */
+bool docstats_save(docstats_t* stats, const char* indexFilename);
+
+/**************** docstats_load ****************/
+/* Read the statistics saved beside the index file indexFilename.
+ *
+ * We return:
+ *   the statistics, or NULL if the file is missing or malformed.
+ *   Caller is responsible for docstats_delete.
+ */
+docstats_t* docstats_load(const char* indexFilename);
+
+/**************** docstats_delete ****************/
+/* Delete the statistics. */
+void docstats_delete(docstats_t* stats);
+
+#endif // __DOCSTATS_H
@@ -0,0 +1,791 @@
+/*
+ * fetcher.c - CS50 TSE fetcher module
+ *
+ * see fetcher.h for more information.
+ *
+ * Each connection moves through three states: CONNECTING (a non-blocking
+ * connect is in progress; we wait for the socket to become writable),
+ * SENDING (the request is being written) and RECEIVING (the response is
+ * being read). After a complete keep-alive response the connection is
+ * taken out of epoll and parked on its host's idle list.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include "fetcher.h"
+
+/**************** local types ****************/
+/* one request, queued on its host until it can start */
+typedef struct request {
+    char* url;                  // as given to fetcher_add
+    char* path;                 // the path to ask the server for
+    void* item;                 // handed back to the callback
+    bool retried;               // already retried after a stale connection?
+    struct request* next;       // next in the host's queue
+} request_t;
+
+typedef struct conn conn_t;
+
+/* a server, with its queue of waiting requests and idle connections */
+typedef struct host {
+    char* name;                 // host name, as in the URLs
+    int port;                   // port number
+    bool resolved;              // have we looked up its address yet?
+    struct sockaddr_storage addr;  // its address, once resolved
+    socklen_t addrlen;          // length of addr
+    int busy;                   // connections with a request in flight
+    long nextStart;             // earliest time (ms) to start another request
+    request_t* head;            // requests waiting for this host
+    request_t* tail;            // ... and the last of them
+    conn_t* idle;               // idle keep-alive connections
+    struct host* next;          // next host
+} host_t;
+
+typedef enum { CONNECTING, SENDING, RECEIVING } connstate_t;
+
+/* a connection, and the request it is working on */
+struct conn {
+    int sock;                   // the non-blocking socket
+    host_t* host;               // server it is connected to
+    request_t* req;             // request in flight (NULL when idle)
+    connstate_t state;          // see top of file
+    bool reused;                // was it idle before this request?
+    char* out;                  // the request text
+    size_t outLen, outSent;     // its length, and how much is sent
+    char* in;                   // response bytes so far, null-terminated
+    size_t inLen, inSize;       // bytes in `in`, and its capacity
+    size_t headerLen;           // length of the response header, 0 until read
+    int status;                 // HTTP status code
+    long contentLength;         // body length, -1 if not given
+    bool chunked;               // chunked transfer coding?
+    bool keepAlive;             // may the connection be reused?
+    long deadline;              // time (ms) by which the request must finish
+    conn_t* next;               // next busy connection, or next idle one
+};
+
+/**************** global types ****************/
+typedef struct fetcher {
+    int epfd;                   // the epoll instance
+    int maxInFlight;            // limit on requests in flight
+    int perHost;                // limit on requests in flight to one host
+    int hostDelay;              // ms between request starts on one host
+    int timeout;                // ms a request may take
+    fetcher_done_t done;        // completion callback
+    void* arg;                  // ... and its arg
+    host_t* hosts;              // every host seen
+    conn_t* busy;               // connections with a request in flight
+    int inFlight;               // number of busy connections
+    int queued;                 // requests waiting on some host
+} fetcher_t;
+
+/**************** local functions ****************/
+static long nowMs(void);
+static bool splitURL(const char* url, char** hostname, int* port, char** path);
+static host_t* findHost(fetcher_t* f, const char* name, const int port);
+static int startRequests(fetcher_t* f, const long now);
+static conn_t* openConn(fetcher_t* f, host_t* host);
+static bool watch(fetcher_t* f, conn_t* conn, const int op, const unsigned events);
+static int connEvent(fetcher_t* f, conn_t* conn, const unsigned events);
+static bool connSend(conn_t* conn);
+static int connReceive(conn_t* conn);
+static bool parseHeader(conn_t* conn);
+static int responseBody(conn_t* conn, const bool atEOF, char** body, size_t* len);
+static int dechunk(const char* in, const size_t avail, char* out, size_t* len);
+static int finish(fetcher_t* f, conn_t* conn, const bool ok, char* body, const size_t len);
+static void connClose(conn_t* conn);
+
+static const int MAX_EVENTS = 64;        // epoll events taken per wait
+static const size_t INITIAL_IN = 16384;  // first size of a response buffer
+static const size_t MAX_BODY = 64 << 20;  // largest response we will hold
+
+/**************** fetcher_new() ****************/
+/* see fetcher.h for description */
+fetcher_t* fetcher_new(const int maxInFlight, const int perHost,
+                       const int hostDelay, const int timeout,
+                       fetcher_done_t done, void* arg)
+{
+    if (maxInFlight <= 0 || perHost <= 0 || hostDelay < 0 || timeout <= 0
+        || done == NULL) {
+        return NULL;
+    }
+    fetcher_t* f = calloc(1, sizeof(fetcher_t));
+    if (f == NULL) {
+        return NULL;
+    }
+    f->epfd = epoll_create1(0);
+    if (f->epfd < 0) {
+        free(f);
+        return NULL;
+    }
+    f->maxInFlight = maxInFlight;
+    f->perHost = perHost;
+    f->hostDelay = hostDelay;
+    f->timeout = timeout;
+    f->done = done;
+    f->arg = arg;
+    return f;
+}
+
+/**************** fetcher_add() ****************/
+/* see fetcher.h for description */
+bool fetcher_add(fetcher_t* f, const char* url, void* item)
+{
+    if (f == NULL || url == NULL) {
+        return false;
+    }
+    char* hostname;
+    int port;
+    request_t* req = calloc(1, sizeof(request_t));
+    if (req == NULL) {
+        return false;
+    }
+    if (!splitURL(url, &hostname, &port, &req->path)) {
+        free(req);
+        return false;
+    }
+    host_t* host = findHost(f, hostname, port);
+    free(hostname);
+    req->url = malloc(strlen(url) + 1);
+    if (host == NULL || req->url == NULL) {
+        free(req->url);
+        free(req->path);
+        free(req);
+        return false;
+    }
+    strcpy(req->url, url);
+    req->item = item;
+
+    if (host->tail == NULL) {
+        host->head = req;
+    } else {
+        host->tail->next = req;
+    }
+    host->tail = req;
+    f->queued++;
+    return true;
+}
+
+/**************** fetcher_outstanding() ****************/
+/* see fetcher.h for description */
+int fetcher_outstanding(fetcher_t* f)
+{
+    return (f == NULL) ? 0 : f->queued + f->inFlight;
+}
+
+/**************** fetcher_poll() ****************/
+/* see fetcher.h for description */
+int fetcher_poll(fetcher_t* f, const int maxWait)
+{
+    if (f == NULL) {
+        return 0;
+    }
+    long now = nowMs();
+    int completed = startRequests(f, now);
+
+    // sleep no longer than the nearest deadline or host delay
+    long wait = (completed > 0) ? 0 : maxWait;
+    for (conn_t* conn = f->busy; conn != NULL; conn = conn->next) {
+        if (conn->deadline - now < wait) {
+            wait = conn->deadline - now;
+        }
+    }
+    if (f->inFlight < f->maxInFlight) {
+        for (host_t* host = f->hosts; host != NULL; host = host->next) {
+            if (host->head != NULL && host->busy < f->perHost
+                && host->nextStart - now < wait) {
+                wait = host->nextStart - now;
+            }
+        }
+    }
+    if (wait < 0) {
+        wait = 0;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(f->epfd, events, MAX_EVENTS, (int) wait);
+    for (int i = 0; i < n; i++) {
+        completed += connEvent(f, events[i].data.ptr, events[i].events);
+    }
+
+    // fail whatever has run out of time
+    now = nowMs();
+    conn_t* conn = f->busy;
+    while (conn != NULL) {
+        conn_t* next = conn->next;
+        if (conn->deadline <= now) {
+            completed += finish(f, conn, false, NULL, 0);
+        }
+        conn = next;
+    }
+    return completed;
+}
+
+/**************** fetcher_delete() ****************/
+/* see fetcher.h for description */
+void fetcher_delete(fetcher_t* f, void (*itemdelete)(void* item))
+{
+    if (f == NULL) {
+        return;
+    }
+    while (f->busy != NULL) {
+        conn_t* conn = f->busy;
+        f->busy = conn->next;
+        if (itemdelete != NULL) {
+            (*itemdelete)(conn->req->item);
+        }
+        free(conn->req->url);
+        free(conn->req->path);
+        free(conn->req);
+        connClose(conn);
+    }
+    while (f->hosts != NULL) {
+        host_t* host = f->hosts;
+        f->hosts = host->next;
+        while (host->head != NULL) {
+            request_t* req = host->head;
+            host->head = req->next;
+            if (itemdelete != NULL) {
+                (*itemdelete)(req->item);
+            }
+            free(req->url);
+            free(req->path);
+            free(req);
+        }
+        while (host->idle != NULL) {
+            conn_t* conn = host->idle;
+            host->idle = conn->next;
+            connClose(conn);
+        }
+        free(host->name);
+        free(host);
+    }
+    close(f->epfd);
+    free(f);
+}
+
+/**************** nowMs() ****************/
+/* Return a monotonic clock reading in milliseconds */
+static long nowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+/**************** splitURL() ****************/
+/* Split http://host[:port][/path] into malloc'd hostname and path
+ * (path starts with '/') and the port; false if the URL is not of that form.
+ */
+static bool splitURL(const char* url, char** hostname, int* port, char** path)
+{
+    if (strncmp(url, "http://", 7) != 0) {
+        return false;
+    }
+    const char* start = url + 7;
+    const char* slash = strchr(start, '/');
+    const char* end = (slash == NULL) ? start + strlen(start) : slash;
+    const char* colon = memchr(start, ':', end - start);
+    const char* nameEnd = (colon == NULL) ? end : colon;
+    if (nameEnd == start) {
+        return false;
+    }
+
+    *port = 80;
+    if (colon != NULL && sscanf(colon + 1, "%d", port) != 1) {
+        return false;
+    }
+    *hostname = malloc(nameEnd - start + 1);
+    *path = malloc((slash == NULL) ? 2 : strlen(slash) + 1);
+    if (*hostname == NULL || *path == NULL) {
+        free(*hostname);
+        free(*path);
+        return false;
+    }
+    memcpy(*hostname, start, nameEnd - start);
+    (*hostname)[nameEnd - start] = '\0';
+    strcpy(*path, (slash == NULL) ? "/" : slash);
+    return true;
+}
+
+/**************** findHost() ****************/
+/* Return the host record for name:port, creating it if new; NULL on error */
+static host_t* findHost(fetcher_t* f, const char* name, const int port)
+{
+    for (host_t* host = f->hosts; host != NULL; host = host->next) {
+        if (host->port == port && strcmp(host->name, name) == 0) {
+            return host;
+        }
+    }
+    host_t* host = calloc(1, sizeof(host_t));
+    if (host == NULL || (host->name = malloc(strlen(name) + 1)) == NULL) {
+        free(host);
+        return NULL;
+    }
+    strcpy(host->name, name);
+    host->port = port;
+    host->next = f->hosts;
+    f->hosts = host;
+    return host;
+}
+
+/**************** startRequests() ****************/
+/* Start every queued request the limits allow; requests that fail to
+ * start are completed (as failures) right away. Return how many were.
+ */
+static int startRequests(fetcher_t* f, const long now)
+{
+    int completed = 0;
+    for (host_t* host = f->hosts; host != NULL; host = host->next) {
+        while (host->head != NULL && f->inFlight < f->maxInFlight
+               && host->busy < f->perHost && now >= host->nextStart) {
+            request_t* req = host->head;
+            host->head = req->next;
+            if (host->head == NULL) {
+                host->tail = NULL;
+            }
+            req->next = NULL;
+            f->queued--;
+            host->nextStart = now + f->hostDelay;
+
+            // prefer an idle connection to a new one
+            conn_t* conn = host->idle;
+            bool reused = (conn != NULL);
+            if (reused) {
+                host->idle = conn->next;
+            } else {
+                conn = openConn(f, host);
+            }
+            char* out = NULL;
+            const char* format = "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n\r\n";
+            int outLen = (conn == NULL) ? -1
+                : snprintf(NULL, 0, format, req->path, host->name);
+            if (outLen >= 0 && (out = malloc(outLen + 1)) != NULL) {
+                snprintf(out, outLen + 1, format, req->path, host->name);
+            }
+            if (out == NULL || !watch(f, conn, EPOLL_CTL_ADD, EPOLLOUT)) {
+                // could not even start: report the failure
+                free(out);
+                if (conn != NULL) {
+                    connClose(conn);
+                }
+                f->done(f->arg, req->item, 0, NULL, 0);
+                free(req->url);
+                free(req->path);
+                free(req);
+                completed++;
+                continue;
+            }
+
+            conn->req = req;
+            conn->reused = reused;
+            if (reused) {
+                conn->state = SENDING;
+            }
+            conn->out = out;
+            conn->outLen = outLen;
+            conn->outSent = 0;
+            conn->inLen = 0;
+            conn->headerLen = 0;
+            conn->deadline = now + f->timeout;
+            conn->next = f->busy;
+            f->busy = conn;
+            f->inFlight++;
+            host->busy++;
+        }
+    }
+    return completed;
+}
+
+/**************** openConn() ****************/
+/* Start a non-blocking connect to the host; NULL on failure */
+static conn_t* openConn(fetcher_t* f, host_t* host)
+{
+    if (!host->resolved) {
+        // the one blocking step, taken once per host
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        char service[16];
+        snprintf(service, sizeof(service), "%d", host->port);
+        struct addrinfo* server;
+        if (getaddrinfo(host->name, service, &hints, &server) != 0) {
+            return NULL;
+        }
+        memcpy(&host->addr, server->ai_addr, server->ai_addrlen);
+        host->addrlen = server->ai_addrlen;
+        host->resolved = true;
+        freeaddrinfo(server);
+    }
+
+    int sock = socket(host->addr.ss_family, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return NULL;
+    }
+    if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) < 0
+        || (connect(sock, (struct sockaddr*) &host->addr, host->addrlen) < 0
+            && errno != EINPROGRESS)) {
+        close(sock);
+        return NULL;
+    }
+    conn_t* conn = calloc(1, sizeof(conn_t));
+    if (conn == NULL || (conn->in = malloc(INITIAL_IN)) == NULL) {
+        free(conn);
+        close(sock);
+        return NULL;
+    }
+    conn->sock = sock;
+    conn->host = host;
+    conn->state = CONNECTING;
+    conn->inSize = INITIAL_IN;
+    return conn;
+}
+
+/**************** watch() ****************/
+/* Add (or modify) the connection in the epoll set for the given events */
+static bool watch(fetcher_t* f, conn_t* conn, const int op, const unsigned events)
+{
+    if (conn == NULL) {
+        return false;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = conn;
+    return epoll_ctl(f->epfd, op, conn->sock, &ev) == 0;
+}
+
+/**************** connEvent() ****************/
+/* Handle epoll events on a busy connection; return 1 if its request
+ * completed (successfully or not), else 0.
+ */
+static int connEvent(fetcher_t* f, conn_t* conn, const unsigned events)
+{
+    if (conn->state == CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(conn->sock, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            return finish(f, conn, false, NULL, 0);
+        }
+        conn->state = SENDING;
+    }
+    if (conn->state == SENDING) {
+        if (!connSend(conn)) {
+            return finish(f, conn, false, NULL, 0);
+        }
+        if (conn->outSent == conn->outLen) {
+            conn->state = RECEIVING;
+            if (!watch(f, conn, EPOLL_CTL_MOD, EPOLLIN)) {
+                return finish(f, conn, false, NULL, 0);
+            }
+        }
+        return 0;
+    }
+
+    // RECEIVING
+    int got = connReceive(conn);
+    if (got < 0) {
+        return finish(f, conn, false, NULL, 0);
+    }
+    if (conn->headerLen == 0 && !parseHeader(conn)) {
+        // no full header yet; fine unless the server has hung up
+        return (got == 0) ? finish(f, conn, false, NULL, 0) : 0;
+    }
+    if (conn->status == 0) {
+        return finish(f, conn, false, NULL, 0);   // not an HTTP response
+    }
+    char* body = NULL;
+    size_t len = 0;
+    int state = responseBody(conn, got == 0, &body, &len);
+    if (state < 0 || (state == 0 && got == 0)) {
+        return finish(f, conn, false, NULL, 0);
+    }
+    if (state == 0) {
+        return 0;
+    }
+    if (got == 0) {
+        conn->keepAlive = false;
+    }
+    return finish(f, conn, true, body, len);
+}
+
+/**************** connSend() ****************/
+/* Send as much of the request as the socket takes; false on error */
+static bool connSend(conn_t* conn)
+{
+    while (conn->outSent < conn->outLen) {
+        ssize_t n = send(conn->sock, conn->out + conn->outSent,
+                         conn->outLen - conn->outSent, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        conn->outSent += n;
+    }
+    return true;
+}
+
+/**************** connReceive() ****************/
+/* Read everything available into conn->in.
+ * Return 1 if the connection is still open, 0 if the server closed it,
+ * or -1 on error.
+ */
+static int connReceive(conn_t* conn)
+{
+    while (true) {
+        if (conn->inSize - conn->inLen < 4096) {
+            if (conn->inSize > MAX_BODY) {
+                return -1;                // too big to be a page
+            }
+            char* bigger = realloc(conn->in, conn->inSize * 2);
+            if (bigger == NULL) {
+                return -1;
+            }
+            conn->in = bigger;
+            conn->inSize *= 2;
+        }
+        ssize_t n = recv(conn->sock, conn->in + conn->inLen,
+                         conn->inSize - conn->inLen - 1, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 1;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        conn->in[conn->inLen + n] = '\0';
+        if (n == 0) {
+            return 0;
+        }
+        conn->inLen += n;
+    }
+}
+
+/**************** parseHeader() ****************/
+/* Look for the end of the response header in conn->in; if it is there,
+ * parse the status line and the headers we care about and return true.
+ */
+static bool parseHeader(conn_t* conn)
+{
+    char* in = conn->in;
+    char* end = NULL;
+    for (size_t i = 0; i + 1 < conn->inLen && end == NULL; i++) {
+        if (in[i] == '\n' && in[i+1] == '\n') {
+            end = in + i + 2;
+        } else if (in[i] == '\n' && in[i+1] == '\r' && i + 2 < conn->inLen
+                   && in[i+2] == '\n') {
+            end = in + i + 3;
+        }
+    }
+    if (end == NULL) {
+        return false;
+    }
+    conn->headerLen = end - in;
+
+    int minor = 0;
+    conn->status = 0;
+    if (sscanf(in, "HTTP/1.%d %d", &minor, &conn->status) != 2) {
+        conn->status = 0;
+    }
+    // HTTP/1.1 connections persist unless the server says otherwise
+    conn->keepAlive = (minor >= 1);
+    conn->contentLength = -1;
+    conn->chunked = false;
+
+    for (char* line = strchr(in, '\n') + 1; line < end; line = strchr(line, '\n') + 1) {
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            conn->contentLength = atol(line + 15);
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            conn->chunked = (strncasecmp(line + 18 + strspn(line + 18, " \t"), "chunked", 7) == 0);
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            const char* value = line + 11 + strspn(line + 11, " \t");
+            if (strncasecmp(value, "close", 5) == 0) {
+                conn->keepAlive = false;
+            } else if (strncasecmp(value, "keep-alive", 10) == 0) {
+                conn->keepAlive = true;
+            }
+        }
+    }
+    return true;
+}
+
+/**************** responseBody() ****************/
+/* Decide whether the whole body has arrived; if so, return 1 with a
+ * malloc'd, null-terminated copy in *body. Return 0 if more is needed,
+ * -1 if the response is malformed or memory runs out.
+ */
+static int responseBody(conn_t* conn, const bool atEOF, char** body, size_t* len)
+{
+    const char* in = conn->in + conn->headerLen;
+    size_t avail = conn->inLen - conn->headerLen;
+
+    if ((conn->status >= 100 && conn->status < 200) || conn->status == 204
+        || conn->status == 304) {
+        avail = 0;                        // these never have a body
+    } else if (conn->chunked) {
+        int state = dechunk(in, avail, NULL, len);
+        if (state <= 0) {
+            return state;
+        }
+        if ((*body = malloc(*len + 1)) == NULL) {
+            return -1;
+        }
+        dechunk(in, avail, *body, len);
+        (*body)[*len] = '\0';
+        return 1;
+    } else if (conn->contentLength >= 0) {
+        if ((size_t) conn->contentLength > MAX_BODY) {
+            return -1;
+        }
+        if (avail < (size_t) conn->contentLength) {
+            return 0;
+        }
+        avail = conn->contentLength;
+    } else if (!atEOF) {
+        return 0;                         // body runs until the server closes
+    }
+
+    if ((*body = malloc(avail + 1)) == NULL) {
+        return -1;
+    }
+    memcpy(*body, in, avail);
+    (*body)[avail] = '\0';
+    *len = avail;
+    return 1;
+}
+
+/**************** dechunk() ****************/
+/* Walk a chunked body of `avail` bytes: each chunk is a hex size line,
+ * the data and CRLF; a zero size, any trailers and a blank line end it.
+ * If out is not NULL, copy the data there. Sets *len to the data length.
+ * Return 1 if the body is complete, 0 if more is needed, -1 if malformed
+ * or larger than MAX_BODY.
+ */
+static int dechunk(const char* in, const size_t avail, char* out, size_t* len)
+{
+    size_t pos = 0;
+    *len = 0;
+    while (true) {
+        const char* eol = memchr(in + pos, '\n', avail - pos);
+        if (eol == NULL) {
+            return 0;
+        }
+        char* endSize;
+        unsigned long size = strtoul(in + pos, &endSize, 16);
+        if (endSize == in + pos) {
+            return -1;
+        }
+        pos = eol - in + 1;
+        if (size == 0) {
+            break;
+        }
+        // compared without adding to size, which a server may make overflow
+        if (size > MAX_BODY - *len) {
+            return -1;
+        }
+        if (size > avail - pos || avail - pos - size < 2) {
+            return 0;
+        }
+        if (out != NULL) {
+            memcpy(out + *len, in + pos, size);
+        }
+        *len += size;
+        pos += size;
+        pos += (in[pos] == '\r') ? 2 : 1;
+    }
+    // trailers, up to a blank line
+    while (true) {
+        const char* eol = memchr(in + pos, '\n', avail - pos);
+        if (eol == NULL) {
+            return 0;
+        }
+        bool blank = (eol == in + pos) || (eol == in + pos + 1 && in[pos] == '\r');
+        pos = eol - in + 1;
+        if (blank) {
+            return 1;
+        }
+    }
+}
+
+/**************** finish() ****************/
+/* Retire a busy connection's request and report it to the callback.
+ * A request that failed before any reply on a reused connection (which
+ * the server had probably closed while idle) is queued once more instead.
+ * Return 1 if the callback was called, else 0.
+ */
+static int finish(fetcher_t* f, conn_t* conn, const bool ok, char* body, const size_t len)
+{
+    // unlink from the busy list
+    for (conn_t** prev = &f->busy; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == conn) {
+            *prev = conn->next;
+            break;
+        }
+    }
+    f->inFlight--;
+    host_t* host = conn->host;
+    host->busy--;
+    epoll_ctl(f->epfd, EPOLL_CTL_DEL, conn->sock, NULL);
+
+    request_t* req = conn->req;
+    conn->req = NULL;
+    free(conn->out);
+    conn->out = NULL;
+    int status = ok ? conn->status : 0;
+    bool stale = (!ok && conn->reused && conn->inLen == 0 && !req->retried);
+
+    if (ok && conn->keepAlive) {
+        conn->next = host->idle;
+        host->idle = conn;
+    } else {
+        connClose(conn);
+    }
+
+    if (stale) {
+        req->retried = true;
+        req->next = host->head;
+        host->head = req;
+        if (host->tail == NULL) {
+            host->tail = req;
+        }
+        host->nextStart = 0;
+        f->queued++;
+        return 0;
+    }
+
+    f->done(f->arg, req->item, status, body, len);
+    free(req->url);
+    free(req->path);
+    free(req);
+    return 1;
+}
+
+/**************** connClose() ****************/
+/* Close the socket and free the connection */
+static void connClose(conn_t* conn)
+{
+    close(conn->sock);
+    free(conn->out);
+    free(conn->in);
+    free(conn);
+}
@@ -0,0 +1,95 @@
+/*
+ * fetcher.h - header file for CS50 TSE fetcher module
+ *
+ * The fetcher downloads many pages at once from a single thread. Every
+ * connection is a non-blocking socket watched by one epoll instance, so
+ * hundreds of requests can be in flight without a thread (or a blocked
+ * read) per connection. Requests are queued per host and started subject
+ * to politeness limits: at most perHost connections busy on one host, and
+ * at least hostDelay milliseconds between the starts of two requests to
+ * that host. Each request has a deadline; one that has not completed by
+ * then fails with status 0, as does one whose body would exceed 64MB.
+ * Connections are kept alive and reused for later requests to the same
+ * host.
+ *
+ * Only http://host[:port][/path] URLs are supported, like webpage_fetch.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#ifndef __FETCHER_H
+#define __FETCHER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**************** global types ****************/
+typedef struct fetcher fetcher_t;  // opaque to users of the module
+
+/* called once for every request added, when it completes or fails:
+ *   arg    the arg given to fetcher_new;
+ *   item   the item given to fetcher_add;
+ *   status the HTTP status code, or 0 if the request failed or timed out;
+ *   body   the null-terminated response body (malloc'd; the callback must
+ *          free it or hand it on), or NULL if the request failed;
+ *   len    the length of the body.
+ * The callback may call fetcher_add.
+ */
+typedef void (*fetcher_done_t)(void* arg, void* item, const int status,
+                               char* body, const size_t len);
+
+/**************** functions ****************/
+
+/**************** fetcher_new ****************/
+/* Create a new fetcher with nothing queued.
+ *
+ * Caller provides:
+ *   the most requests to have in flight at once (> 0),
+ *   the most of those that may go to any one host (> 0),
+ *   the least time between starting two requests to one host, in ms (>= 0),
+ *   the time a request may take before it fails, in ms (> 0),
+ *   and the completion callback with its arg.
+ * We return:
+ *   pointer to a new fetcher, or NULL if error.
+ * Caller is responsible for:
+ *   later calling fetcher_delete.
+ */
+fetcher_t* fetcher_new(const int maxInFlight, const int perHost,
+                       const int hostDelay, const int timeout,
+                       fetcher_done_t done, void* arg);
+
+/**************** fetcher_add ****************/
+/* Queue a request for url; the callback later receives item with the result.
+ *
+ * We return:
+ *   true if the request was queued; false on a bad parameter, an
+ *   unsupported URL, or out of memory (the callback is not called).
+ * Notes:
+ *   The url string is copied. Nothing is sent until fetcher_poll.
+ */
+bool fetcher_add(fetcher_t* f, const char* url, void* item);
+
+/**************** fetcher_outstanding ****************/
+/* Return the number of requests queued or in flight; 0 when all are done. */
+int fetcher_outstanding(fetcher_t* f);
+
+/**************** fetcher_poll ****************/
+/* Make progress on the queued requests.
+ *
+ * We do:
+ *   start every queued request the limits allow, wait up to maxWait ms
+ *   for network events (less if a deadline or host delay expires sooner),
+ *   send and receive what we can without blocking, and call the callback
+ *   for every request that completed, failed or timed out.
+ * We return:
+ *   the number of requests completed by this call.
+ */
+int fetcher_poll(fetcher_t* f, const int maxWait);
+
+/**************** fetcher_delete ****************/
+/* Close every connection and delete the fetcher. Requests still queued
+ * or in flight are dropped, calling itemdelete (if not NULL) on each item.
+ */
+void fetcher_delete(fetcher_t* f, void (*itemdelete)(void* item));
+
+#endif // __FETCHER_H
@@ -0,0 +1,351 @@
+/*
+ * frontier.c - CS50 TSE frontier module
+ *
+ * see frontier.h for more information.
+ *
+ * Each deque is a Chase-Lev work-stealing deque (Le, Pop, Cohen and
+ * Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak Memory
+ * Models", PPoPP 2013) written with C11 atomics.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "frontier.h"
+
+/**************** local types ****************/
+/* circular buffer behind one deque; replaced (never resized) when full */
+typedef struct dqbuf {
+    long size;                  // number of slots, a power of two
+    struct dqbuf* retired;      // older buffer, freed when the deque is
+    _Atomic(void*) slot[];      // the items
+} dqbuf_t;
+
+/* one work-stealing deque; top and bottom live on separate cache lines */
+typedef struct deque {
+    _Alignas(64) atomic_long top;         // next item to steal
+    _Alignas(64) atomic_long bottom;      // next free slot for the owner
+    _Atomic(dqbuf_t*) buf;                // current buffer
+} deque_t;
+
+/**************** global types ****************/
+typedef struct frontier {
+    int numWorkers;             // number of worker threads
+    int numDepths;              // maxDepth + 1
+    bool bfs;                   // hand out work shallowest-first?
+    deque_t* deques;            // deques[worker * numDepths + depth]
+    _Alignas(64) atomic_long pending;  // pushed but not yet done
+} frontier_t;
+
+/**************** local functions ****************/
+static dqbuf_t* dqbuf_new(long size);
+static bool deque_init(deque_t* dq);
+static bool deque_push(deque_t* dq, void* item);
+static void* deque_take(deque_t* dq);
+static void* deque_steal(deque_t* dq);
+static void* frontier_find(frontier_t* fr, const int worker, int* depth);
+
+static const long INITIAL_SLOTS = 64;  // initial slots in each deque
+static const long MAX_BACKOFF_NS = 1000000;  // longest idle wait: 1ms
+
+/**************** frontier_new() ****************/
+/* see frontier.h for description */
+frontier_t* frontier_new(const int numWorkers, const int maxDepth, const bool bfs)
+{
+    if (numWorkers <= 0 || maxDepth < 0) {
+        return NULL;
+    }
+    frontier_t* fr = aligned_alloc(64, sizeof(frontier_t));
+    if (fr == NULL) {
+        return NULL;
+    }
+    fr->numWorkers = numWorkers;
+    fr->numDepths = maxDepth + 1;
+    fr->bfs = bfs;
+    atomic_init(&fr->pending, 0);
+
+    int count = numWorkers * fr->numDepths;
+    fr->deques = aligned_alloc(64, count * sizeof(deque_t));
+    if (fr->deques == NULL) {
+        free(fr);
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!deque_init(&fr->deques[i])) {
+            // unwind the deques built so far
+            while (--i >= 0) {
+                free(atomic_load(&fr->deques[i].buf));
+            }
+            free(fr->deques);
+            free(fr);
+            return NULL;
+        }
+    }
+    return fr;
+}
+
+/**************** frontier_push() ****************/
+/* see frontier.h for description */
+bool frontier_push(frontier_t* fr, const int worker, void* item, const int depth)
+{
+    if (fr == NULL || item == NULL || worker < 0 || worker >= fr->numWorkers
+        || depth < 0 || depth >= fr->numDepths) {
+        return false;
+    }
+    // count the item before it becomes visible, so a concurrent pop
+    // never sees an empty frontier with nothing pending while it exists
+    atomic_fetch_add(&fr->pending, 1);
+    if (!deque_push(&fr->deques[worker * fr->numDepths + depth], item)) {
+        atomic_fetch_sub(&fr->pending, 1);
+        return false;
+    }
+    return true;
+}
+
+/**************** frontier_pop() ****************/
+/* see frontier.h for description */
+void* frontier_pop(frontier_t* fr, const int worker, int* depth)
+{
+    if (fr == NULL || worker < 0 || worker >= fr->numWorkers) {
+        return NULL;
+    }
+    long backoff = 1000;  // ns
+    while (true) {
+        void* item = frontier_find(fr, worker, depth);
+        if (item != NULL) {
+            return item;
+        }
+        if (atomic_load(&fr->pending) == 0) {
+            return NULL;  // nothing queued and nothing in progress
+        }
+        // someone is still working and may push more; wait a little
+        struct timespec ts = {0, backoff};
+        nanosleep(&ts, NULL);
+        if (backoff < MAX_BACKOFF_NS) {
+            backoff *= 2;
+        }
+    }
+}
+
+/**************** frontier_take() ****************/
+/* see frontier.h for description */
+void* frontier_take(frontier_t* fr, const int worker, int* depth)
+{
+    if (fr == NULL || worker < 0 || worker >= fr->numWorkers) {
+        return NULL;
+    }
+    return frontier_find(fr, worker, depth);
+}
+
+/**************** frontier_done() ****************/
+/* see frontier.h for description */
+void frontier_done(frontier_t* fr)
+{
+    if (fr != NULL) {
+        atomic_fetch_sub(&fr->pending, 1);
+    }
+}
+
+/**************** frontier_iterate() ****************/
+/* see frontier.h for description */
+void frontier_iterate(frontier_t* fr, void* arg,
+                      void (*itemfunc)(void* arg, void* item, const int depth))
+{
+    if (fr == NULL || itemfunc == NULL) {
+        return;
+    }
+    for (int w = 0; w < fr->numWorkers; w++) {
+        for (int d = 0; d < fr->numDepths; d++) {
+            deque_t* dq = &fr->deques[w * fr->numDepths + d];
+            dqbuf_t* buf = atomic_load(&dq->buf);
+            long b = atomic_load(&dq->bottom);
+            for (long t = atomic_load(&dq->top); t < b; t++) {
+                (*itemfunc)(arg, atomic_load(&buf->slot[t & (buf->size - 1)]), d);
+            }
+        }
+    }
+}
+
+/**************** frontier_delete() ****************/
+/* see frontier.h for description */
+void frontier_delete(frontier_t* fr, void (*itemdelete)(void* item))
+{
+    if (fr == NULL) {
+        return;
+    }
+    int count = fr->numWorkers * fr->numDepths;
+    for (int i = 0; i < count; i++) {
+        deque_t* dq = &fr->deques[i];
+        void* item;
+        while ((item = deque_take(dq)) != NULL) {
+            if (itemdelete != NULL) {
+                (*itemdelete)(item);
+            }
+        }
+        dqbuf_t* buf = atomic_load(&dq->buf);
+        while (buf != NULL) {
+            dqbuf_t* older = buf->retired;
+            free(buf);
+            buf = older;
+        }
+    }
+    free(fr->deques);
+    free(fr);
+}
+
+/**************** frontier_find() ****************/
+/* Look once through the deques for work, in the order described in
+ * frontier.h; returns NULL if nothing was found on this pass.
+ */
+static void* frontier_find(frontier_t* fr, const int worker, int* depth)
+{
+    int n = fr->numDepths;
+    for (int i = 0; i < n; i++) {
+        // breadth-first: shallowest first everywhere;
+        // otherwise: own work deepest first, stolen work shallowest first
+        int own = fr->bfs ? i : n - 1 - i;
+        void* item = deque_take(&fr->deques[worker * n + own]);
+        if (item != NULL) {
+            if (depth != NULL) *depth = own;
+            return item;
+        }
+        if (!fr->bfs) {
+            continue;  // finish our own deques before stealing
+        }
+        for (int v = 1; v < fr->numWorkers; v++) {
+            int victim = (worker + v) % fr->numWorkers;
+            item = deque_steal(&fr->deques[victim * n + i]);
+            if (item != NULL) {
+                if (depth != NULL) *depth = i;
+                return item;
+            }
+        }
+    }
+    if (!fr->bfs) {
+        for (int d = 0; d < n; d++) {
+            for (int v = 1; v < fr->numWorkers; v++) {
+                int victim = (worker + v) % fr->numWorkers;
+                void* item = deque_steal(&fr->deques[victim * n + d]);
+                if (item != NULL) {
+                    if (depth != NULL) *depth = d;
+                    return item;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+/**************** dqbuf_new() ****************/
+/* Allocate an empty deque buffer with `size` slots */
+static dqbuf_t* dqbuf_new(long size)
+{
+    dqbuf_t* buf = malloc(sizeof(dqbuf_t) + size * sizeof(_Atomic(void*)));
+    if (buf == NULL) {
+        return NULL;
+    }
+    buf->size = size;
+    buf->retired = NULL;
+    return buf;
+}
+
+/**************** deque_init() ****************/
+/* Initialize an empty deque; return false if out of memory */
+static bool deque_init(deque_t* dq)
+{
+    dqbuf_t* buf = dqbuf_new(INITIAL_SLOTS);
+    if (buf == NULL) {
+        return false;
+    }
+    atomic_init(&dq->top, 0);
+    atomic_init(&dq->bottom, 0);
+    atomic_init(&dq->buf, buf);
+    return true;
+}
+
+/**************** deque_push() ****************/
+/* Owner only: push an item on the bottom, doubling the buffer when full.
+ * The old buffer is kept (thieves may still be reading it) and freed
+ * along with the deque.
+ */
+static bool deque_push(deque_t* dq, void* item)
+{
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    dqbuf_t* buf = atomic_load_explicit(&dq->buf, memory_order_relaxed);
+
+    if (b - t > buf->size - 1) {
+        dqbuf_t* bigger = dqbuf_new(buf->size * 2);
+        if (bigger == NULL) {
+            return false;
+        }
+        for (long i = t; i < b; i++) {
+            void* x = atomic_load_explicit(&buf->slot[i & (buf->size - 1)],
+                                           memory_order_relaxed);
+            atomic_store_explicit(&bigger->slot[i & (bigger->size - 1)], x,
+                                  memory_order_relaxed);
+        }
+        bigger->retired = buf;
+        atomic_store_explicit(&dq->buf, bigger, memory_order_release);
+        buf = bigger;
+    }
+    atomic_store_explicit(&buf->slot[b & (buf->size - 1)], item, memory_order_relaxed);
+    // publish the item to thieves, who load bottom with acquire
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+/**************** deque_take() ****************/
+/* Owner only: pop an item from the bottom; NULL if empty */
+static void* deque_take(deque_t* dq)
+{
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    dqbuf_t* buf = atomic_load_explicit(&dq->buf, memory_order_relaxed);
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+    void* item = NULL;
+    if (t <= b) {
+        item = atomic_load_explicit(&buf->slot[b & (buf->size - 1)],
+                                    memory_order_relaxed);
+        if (t == b) {
+            // last item: race any thief for it
+            if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                         memory_order_seq_cst,
+                                                         memory_order_relaxed)) {
+                item = NULL;
+            }
+            atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    }
+    return item;
+}
+
+/**************** deque_steal() ****************/
+/* Any thread: pop an item from the top; NULL if empty or we lost a race */
+static void* deque_steal(deque_t* dq)
+{
+    long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    if (t < b) {
+        dqbuf_t* buf = atomic_load_explicit(&dq->buf, memory_order_acquire);
+        void* item = atomic_load_explicit(&buf->slot[t & (buf->size - 1)],
+                                          memory_order_relaxed);
+        if (atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                    memory_order_seq_cst,
+                                                    memory_order_relaxed)) {
+            return item;
+        }
+    }
+    return NULL;
+}
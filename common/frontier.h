@@ -0,0 +1,109 @@
+/*
+ * frontier.h - header file for CS50 TSE frontier module
+ *
+ * The frontier holds the pages a multi-threaded crawler has yet to fetch.
+ * Each worker thread owns one lock-free work-stealing deque per crawl depth;
+ * a worker pushes and pops at the bottom of its own deques and, when those
+ * run dry, steals from the top of another worker's deques. No lock is taken
+ * on any push or pop, so handing out the next URL never serializes workers.
+ *
+ * In breadth-first mode a worker always takes the shallowest depth that has
+ * any queued work, from its own deques or another worker's, so pages at
+ * depth d+1 are not started while pages at depth d are still waiting.
+ * Otherwise a worker takes its own deepest work first (like the old bag)
+ * and steals the shallowest work from others.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#ifndef __FRONTIER_H
+#define __FRONTIER_H
+
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct frontier frontier_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** frontier_new ****************/
+/* Create a new (empty) frontier.
+ *
+ * Caller provides:
+ *   the number of worker threads that will use the frontier (> 0),
+ *   the largest depth any item will have (>= 0),
+ *   and whether items must be handed out in breadth-first order.
+ * We return:
+ *   pointer to a new frontier, or NULL if error.
+ * Caller is responsible for:
+ *   later calling frontier_delete.
+ */
+frontier_t* frontier_new(const int numWorkers, const int maxDepth, const bool bfs);
+
+/**************** frontier_push ****************/
+/* Add an item at the given depth to the frontier.
+ *
+ * Caller provides:
+ *   a valid frontier, the caller's worker number (0 <= worker < numWorkers),
+ *   a non-NULL item, and its depth (0 <= depth <= maxDepth).
+ * We return:
+ *   true if the item was added, false on bad parameter or out of memory.
+ * Notes:
+ *   Only the thread acting as `worker` may push with that worker number;
+ *   before the workers start, the main thread may push as worker 0.
+ */
+bool frontier_push(frontier_t* fr, const int worker, void* item, const int depth);
+
+/**************** frontier_pop ****************/
+/* Take the next item to work on.
+ *
+ * Caller provides:
+ *   a valid frontier and the caller's worker number.
+ * We return:
+ *   the next item, with its depth in *depth (if depth is not NULL);
+ *   NULL once the frontier is empty and no popped item is still in progress,
+ *   which means the crawl is finished.
+ * We do:
+ *   wait (without holding any lock) while the frontier is empty but other
+ *   workers are still processing items that may push more work.
+ * Caller is responsible for:
+ *   calling frontier_done once it has finished with each returned item,
+ *   after pushing any items discovered while processing it.
+ */
+void* frontier_pop(frontier_t* fr, const int worker, int* depth);
+
+/**************** frontier_take ****************/
+/* Like frontier_pop, but never waits.
+ *
+ * We return:
+ *   the next item (and its depth, as for frontier_pop), or NULL if no
+ *   item is queued right now, whether or not others are still in progress.
+ * Caller is responsible for:
+ *   calling frontier_done once it has finished with each returned item.
+ * Notes:
+ *   For a caller that does other work while the frontier is empty, such
+ *   as a single thread with many fetches in flight.
+ */
+void* frontier_take(frontier_t* fr, const int worker, int* depth);
+
+/**************** frontier_done ****************/
+/* Mark one item returned by frontier_pop as finished. */
+void frontier_done(frontier_t* fr);
+
+/**************** frontier_iterate ****************/
+/* Call itemfunc(arg, item, depth) on every item still queued.
+ *
+ * Notes:
+ *   Not safe against concurrent pushes or pops; the caller must make sure
+ *   every worker is paused (or not yet started) while iterating.
+ */
+void frontier_iterate(frontier_t* fr, void* arg,
+                      void (*itemfunc)(void* arg, void* item, const int depth));
+
+/**************** frontier_delete ****************/
+/* Delete the frontier, calling itemdelete (if not NULL) on each queued item.
+ * Only call once every worker has stopped using the frontier.
+ */
+void frontier_delete(frontier_t* fr, void (*itemdelete)(void* item));
+
+#endif // __FRONTIER_H
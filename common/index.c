@@ -7,19 +7,63 @@
 #include <stdio.h>   
 #include <stdlib.h>   
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "../libcs50/hashtable.h"
 #include "../libcs50/counters.h"
 #include "index.h"
-#include "../libcs50/file.h"
+#include "indexfile.h"
+#include "safefile.h"
 
 
 
+// memory a word and a posting take: malloc'd hashtable node, key and
+// counters for a word, one counters node for a posting
+static const size_t WORD_BYTES = 112;
+static const size_t POSTING_BYTES = 32;
+
+// how index_save splits up the formatting: at most SAVE_THREADS
+// threads, each given at least SAVE_MIN_WORDS words and at most
+// SAVE_BATCH before the text so far is written
+#define SAVE_THREADS 8
+static const size_t SAVE_MIN_WORDS = 4096;
+static const size_t SAVE_BATCH = 16384;
+
+// a word of the index, for sorting
+typedef struct saveword {
+    const char* word;
+    counters_t* counts;
+} saveword_t;
+
+typedef struct gathered {
+    saveword_t* words;
+    size_t num;
+} gathered_t;
+
+// the words one thread formats, and the buffers it formats them in
+typedef struct saveslice {
+    saveword_t* words;
+    size_t num;
+    char* text;             // the formatted lines
+    size_t len;             // bytes of text in use
+    size_t size;            // bytes of text allocated
+    int* pairs;             // a word's docID, count, docID, count...
+    int num_pairs;
+    int pairs_size;         // pairs allocated
+    bool sorted;            // the pairs came in increasing docID order
+    bool failed;            // out of memory
+} saveslice_t;
+
 // Function prototypes for helper functions
-static void index_save_helper(void *arg, const char *key, void* item);
-static void counters_iterate_helper(void* file, const int id, const int count);
-void index_load_helper(FILE* fp, index_t* index);
-index_t* index_load(char* file);
+static void count_words(void* arg, const char* key, void* item);
+static void gather_word(void* arg, const char* key, void* item);
+static int compare_words(const void* a, const void* b);
+static int compare_pairs(const void* a, const void* b);
+static void* format_slice(void* arg);
+static void gather_pair(void* arg, const int id, const int count);
+static char* put_int(char* p, int value);
+static void load_word(void* arg, const char* word, const indexposting_t* postings, const int num);
 
 /**************** index_new() ****************/
 /* Creates a new index (hashtable) */
@@ -34,6 +78,9 @@ index_t* index_new(const int num_slots) {
         free(index);  // Free index if hashtable allocation fails
         return NULL;
     }
+    index->num_slots = num_slots;
+    index->num_words = 0;
+    index->num_postings = 0;
 
     return index;
 }
@@ -46,120 +93,271 @@ void index_delete(index_t* index) {
     free(index);
 }
 
+/**************** index_bytes() ****************/
+/* see index.h for description */
+size_t index_bytes(const index_t* index) {
+    return index->num_words * WORD_BYTES + index->num_postings * POSTING_BYTES;
+}
+
+/**************** index_clear() ****************/
+/* see index.h for description */
+bool index_clear(index_t* index) {
+    hashtable_delete(index->ht, (void (*)(void *)) counters_delete);
+    index->ht = hashtable_new(index->num_slots);
+    index->num_words = 0;
+    index->num_postings = 0;
+    return index->ht != NULL;
+}
+
 /**************** index_save() ****************/
-/* Saves the index to a file */
-void index_save(const char *fname, index_t* index){
-    FILE* fp= fopen(fname, "w");
+/* Saves the index to a file, one line per word in sorted order, each
+ * word's docIDs increasing. The words are sorted, then formatted
+ * SAVE_BATCH at a time by up to SAVE_THREADS threads, each into its own
+ * buffer, and the buffers written in order with one fwrite each. The
+ * file is replaced whole (see safefile.h), so a querier reading it never
+ * sees it half written. */
+bool index_save(const char *fname, index_t* index){
+    FILE* fp = safefile_open(fname, "w");
     if (fp == NULL){
         fprintf(stderr, "Failed to open the file '%s' for writing\n", fname);
-        return;
+        return false;
     }
-    hashtable_iterate(index->ht, fp, index_save_helper);
-    fclose(fp);
-}
 
-/**************** index_save_helper() ****************/
-/* Helper function for hashtable_iterate to save each word and its counts */
-static void index_save_helper(void *arg, const char *key, void* item){
-    FILE *fp = (FILE*) arg;
-    counters_t* ctrs = (counters_t*) item;
-    fprintf(fp, "%s", key);
-    counters_iterate(ctrs, fp, counters_iterate_helper);
-    fprintf(fp, "\n");
-}
+    // the words, sorted
+    size_t num_words = 0;
+    hashtable_iterate(index->ht, &num_words, count_words);
+    saveword_t* words = malloc((num_words > 0 ? num_words : 1) * sizeof(saveword_t));
+    gathered_t gathered = {words, 0};
+    if (words != NULL) {
+        hashtable_iterate(index->ht, &gathered, gather_word);
+        qsort(words, num_words, sizeof(saveword_t), compare_words);
+    }
 
-/**************** counters_iterate_helper() ****************/
-/* Helper function for counters_iterate to save each docID and count */
-static void counters_iterate_helper(void* file, const int id, const int count){
-    fprintf((FILE*)file, " %d %d", id, count);
+    // as many threads as there are processors, and enough words for
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_threads = (cpus < 1) ? 1 : (cpus > SAVE_THREADS) ? SAVE_THREADS : cpus;
+    if ((size_t) num_threads > num_words / SAVE_MIN_WORDS) {
+        num_threads = (num_words / SAVE_MIN_WORDS > 0) ? num_words / SAVE_MIN_WORDS : 1;
+    }
+    saveslice_t slices[SAVE_THREADS] = {{0}};
+    pthread_t threads[SAVE_THREADS];
+    bool ok = (words != NULL);
+    for (size_t first = 0; ok && first < num_words; ) {
+        size_t left = num_words - first;
+        size_t batch = (left < (size_t) num_threads * SAVE_BATCH) ? left : (size_t) num_threads * SAVE_BATCH;
+        size_t per = (batch + num_threads - 1) / num_threads;
+        int started = 0;
+        for (int t = 0; t < num_threads; t++) {
+            size_t from = (t * per < batch) ? t * per : batch;
+            size_t to = (from + per < batch) ? from + per : batch;
+            slices[t].words = words + first + from;
+            slices[t].num = to - from;
+            slices[t].len = 0;
+            // slice 0 is formatted by this thread, once the others start
+            if (t > 0 && slices[t].num > 0
+                && pthread_create(&threads[t], NULL, format_slice, &slices[t]) == 0) {
+                started |= 1 << t;
+            } else if (t > 0) {
+                format_slice(&slices[t]);
+            }
+        }
+        format_slice(&slices[0]);
+        for (int t = 1; t < num_threads; t++) {
+            if (started & (1 << t)) {
+                pthread_join(threads[t], NULL);
+            }
+        }
+        for (int t = 0; t < num_threads; t++) {
+            ok = ok && !slices[t].failed
+                 && fwrite(slices[t].text, 1, slices[t].len, fp) == slices[t].len;
+        }
+        first += batch;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        free(slices[t].text);
+        free(slices[t].pairs);
+    }
+    free(words);
+    ok = safefile_close(fp, fname, ok);
+    if (!ok) {
+        fprintf(stderr, "Failed to write the index to '%s'\n", fname);
+    }
+    return ok;
 }
 
+/**************** count_words() ****************/
+/* Helper function for hashtable_iterate to count the words */
+static void count_words(void* arg, const char* key, void* item){
+    (*(size_t*) arg)++;
+}
 
+/**************** gather_word() ****************/
+/* Helper function for hashtable_iterate to collect each word and its counts */
+static void gather_word(void* arg, const char* key, void* item){
+    gathered_t* gathered = arg;
+    gathered->words[gathered->num].word = key;
+    gathered->words[gathered->num].counts = item;
+    gathered->num++;
+}
 
-void index_load_helper(FILE* fp, index_t* index) {
-    char* line;
-    while ((line = file_readLine(fp)) != NULL) {
-        char* saveptr;
-        char* token = strtok_r(line, " ", &saveptr);
-        if (token == NULL) {
-            free(line);
-            continue;
-        }
+/**************** compare_words() ****************/
+/* qsort comparator for saveword_t, by word */
+static int compare_words(const void* a, const void* b){
+    return strcmp(((const saveword_t*) a)->word, ((const saveword_t*) b)->word);
+}
 
-        char* word = token;
+/**************** compare_pairs() ****************/
+/* qsort comparator for (docID, count) pairs, by docID */
+static int compare_pairs(const void* a, const void* b){
+    int x = *(const int*) a;
+    int y = *(const int*) b;
+    return (x > y) - (x < y);
+}
 
-        counters_t* ctrs = counters_new();
-        if (ctrs == NULL) {
-            fprintf(stderr, "Error: Memory allocation for counters failed.\n");
-            free(line);
-            continue;
+/**************** format_slice() ****************/
+/* Formats a slice's words into its text, each line "word docID count
+ * ..." with the docIDs increasing; sets failed if memory runs out.
+ * Runs as a thread, so returns NULL. */
+static void* format_slice(void* arg){
+    saveslice_t* slice = arg;
+    for (size_t i = 0; i < slice->num && !slice->failed; i++) {
+        slice->num_pairs = 0;
+        slice->sorted = true;
+        counters_iterate(slice->words[i].counts, slice, gather_pair);
+        if (!slice->sorted) {
+            qsort(slice->pairs, slice->num_pairs, 2 * sizeof(int), compare_pairs);
         }
-
-        // Parse docID-count pairs
-        int docID = 0, count = 0;
-        int token_index = 0;
-        bool valid_line = true;
-
-        // Process each token (docID and count pairs)
-        while ((token = strtok_r(NULL, " ", &saveptr)) != NULL) {
-            if (token_index % 2 == 0) {  // docID expected
-                docID = atoi(token);
-            } else {  // count expected
-                count = atoi(token);
-                if (count <= 0 || docID <= 0) {  // Invalid data check
-                    valid_line = false;
-                    break;
-                }
-                counters_set(ctrs, docID, count);
+        // a word, and two numbers of at most 11 characters and two
+        // spaces a pair, and a newline
+        size_t length = strlen(slice->words[i].word);
+        size_t need = slice->len + length + 24 * (size_t) slice->num_pairs + 1;
+        if (need > slice->size) {
+            size_t size = (2 * slice->size > need) ? 2 * slice->size : need;
+            char* text = realloc(slice->text, size);
+            if (text == NULL) {
+                slice->failed = true;
+                break;
             }
-            token_index++;
+            slice->text = text;
+            slice->size = size;
         }
-
-        // Ensure even number of tokens and valid pairs
-        if (token_index % 2 != 0 || !valid_line) {
-            fprintf(stderr, "Error: Malformed line in index file.\n");
-            counters_delete(ctrs);  // Free counters if line is malformed
-            free(line);             // Free line before moving to the next iteration
-            continue;
+        char* p = slice->text + slice->len;
+        memcpy(p, slice->words[i].word, length);
+        p += length;
+        for (int j = 0; j < slice->num_pairs; j++) {
+            *p++ = ' ';
+            p = put_int(p, slice->pairs[2 * j]);
+            *p++ = ' ';
+            p = put_int(p, slice->pairs[2 * j + 1]);
         }
+        *p++ = '\n';
+        slice->len = p - slice->text;
+    }
+    return NULL;
+}
 
-        // Insert word and counters into the hashtable
-        if (!hashtable_insert(index->ht, word, ctrs)) {  // Check for insertion failure
-            fprintf(stderr, "Error: Failed to insert into hashtable.\n");
-            counters_delete(ctrs);  // Free counters if insertion fails
+/**************** gather_pair() ****************/
+/* Helper function for counters_iterate to collect each docID and count */
+static void gather_pair(void* arg, const int id, const int count){
+    saveslice_t* slice = arg;
+    if (slice->failed) {
+        return;
+    }
+    if (slice->num_pairs == slice->pairs_size) {
+        int size = (slice->pairs_size == 0) ? 64 : 2 * slice->pairs_size;
+        int* pairs = realloc(slice->pairs, 2 * (size_t) size * sizeof(int));
+        if (pairs == NULL) {
+            slice->failed = true;
+            return;
         }
+        slice->pairs = pairs;
+        slice->pairs_size = size;
+    }
+    if (slice->num_pairs > 0 && slice->pairs[2 * (slice->num_pairs - 1)] > id) {
+        slice->sorted = false;
+    }
+    slice->pairs[2 * slice->num_pairs] = id;
+    slice->pairs[2 * slice->num_pairs + 1] = count;
+    slice->num_pairs++;
+}
 
-        free(line);  // Free line at the end of each iteration
+/**************** put_int() ****************/
+/* Writes a number in decimal at p, as "%d" would, two digits at a time,
+ * and returns the end of it. */
+static char* put_int(char* p, int value){
+    static const char pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+    unsigned int n = value;
+    if (value < 0) {
+        *p++ = '-';
+        n = 0u - n;
+    }
+    char digits[10];
+    int len = 0;
+    while (n >= 100) {
+        unsigned int two = n % 100;
+        n /= 100;
+        digits[len++] = pairs[2 * two + 1];
+        digits[len++] = pairs[2 * two];
     }
+    if (n >= 10) {
+        digits[len++] = pairs[2 * n + 1];
+        digits[len++] = pairs[2 * n];
+    } else {
+        digits[len++] = '0' + n;
+    }
+    while (len > 0) {
+        *p++ = digits[--len];
+    }
+    return p;
 }
 
 
+
+/**************** index_load() ****************/
+/* Loads an index file into a new index. The file is parsed by the
+ * indexfile module, then each word's postings set in its counters. */
 index_t* index_load(char* file) {
-    index_t* index = index_new(100);  
-    if (index == NULL) {
-        fprintf(stderr, "Error: Unable to allocate memory for index.\n");
+    indexfile_t* parsed = indexfile_load(file);
+    if (parsed == NULL) {
+        fprintf(stderr, "failed to read the indexer's file '%s'\n", file);
         return NULL;
     }
-
-    FILE* fp = fopen(file, "r");
-    if (fp == NULL) {
-        fprintf(stderr, "failed to open the indexer's file for reading");
-        index_delete(index);  // Clean up index if file open fails
-        return NULL;
+    if (indexfile_skipped(parsed) > 0) {
+        fprintf(stderr, "Error: %d malformed lines in index file.\n", indexfile_skipped(parsed));
     }
 
-    char* line = file_readLine(fp);
-    if (line == NULL) {
-        fprintf(stderr, "Empty file");
-        free(line);
-        index_delete(index);  // Clean up index if file is empty
-        fclose(fp);
+    size_t num_words = indexfile_count(parsed);
+    index_t* index = index_new(num_words > 0 ? (int) num_words : 1);
+    if (index == NULL) {
+        fprintf(stderr, "Error: Unable to allocate memory for index.\n");
+        indexfile_delete(parsed);
         return NULL;
     }
-    free(line);  // Free the first line after reading
-
-    index_load_helper(fp, index);  // Populate index
-    fclose(fp);  // Close file after reading
+    indexfile_iterate(parsed, index, load_word);
+    indexfile_delete(parsed);
     return index;
 }
 
+/**************** load_word() ****************/
+/* Helper function for indexfile_iterate to add a word and its postings */
+static void load_word(void* arg, const char* word, const indexposting_t* postings, const int num){
+    index_t* index = arg;
+    counters_t* ctrs = counters_new();
+    if (ctrs == NULL) {
+        fprintf(stderr, "Error: Memory allocation for counters failed.\n");
+        return;
+    }
+    for (int i = 0; i < num; i++) {
+        counters_set(ctrs, postings[i].docID, postings[i].count);
+    }
+    if (!hashtable_insert(index->ht, word, ctrs)) {  // Check for insertion failure
+        fprintf(stderr, "Error: Failed to insert into hashtable.\n");
+        counters_delete(ctrs);  // Free counters if insertion fails
+    }
+}
+
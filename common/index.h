@@ -2,28 +2,56 @@
 #define __INDEXER_H
 
 #include "../libcs50/hashtable.h"
+#include "../libcs50/counters.h"
 #include "../libcs50/webpage.h"
+#include "docstats.h"
+#include "positions.h"
+#include "simhash.h"
+#include "word.h"
+#include <stdbool.h>
+#include <stddef.h>
 
 typedef struct index {
     hashtable_t *ht;  // Pointer to the hashtable
-    // Other fields if needed
+    int num_slots;          // slots ht was made with
+    size_t num_words;       // words indexPage has added
+    size_t num_postings;    // (word, docID) pairs indexPage has added
 } index_t;
 
+typedef struct indexruns indexruns_t;  // see indexruns.h
+
 
 /**************** functions ****************/
 
-void index_build(char* pageDirectory, index_t* index);
+int index_build(char* pageDirectory, index_t* index, counters_t* duplicates,
+                fpindex_t* fingerprints, docstats_t* stats,
+                positions_t* positions, wordnorm_t* norm, indexruns_t* runs,
+                const int firstDoc, const int lastDoc);
 
-void indexPage(webpage_t* page, int docID, index_t* index);
+int indexPage(webpage_t* page, int docID, index_t* index, positions_t* positions,
+              wordnorm_t* norm);
 
-/* Add semicolon at the end of the function prototype */
-index_t* index_load(char* file); // Add semicolon
+/* Load an index file, as index_save writes it, into a new index, every
+ * line a word; NULL, after printing an error, if it cannot be read.
+ * The file is parsed on several threads (see indexfile.h). */
+index_t* index_load(char* file);
 
 void index_delete(index_t* index); // Ensure this is declared if not already
 
 index_t* index_new(int size);
 
-void index_save(const char* filename, index_t* index);
+/* Estimate the bytes of memory the words and postings indexPage has
+ * added take, counting the hashtable's and counters' nodes. */
+size_t index_bytes(const index_t* index);
+
+/* Empty the index, as if just made by index_new; false on error. */
+bool index_clear(index_t* index);
+
+/* Save the index to filename, a line "word docID count ..." per word,
+ * the words in strcmp order and each word's docIDs increasing; the
+ * lines are formatted on several threads. Returns false, after
+ * printing an error, if the file cannot be written. */
+bool index_save(const char* filename, index_t* index);
 
 
 
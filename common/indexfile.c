@@ -0,0 +1,416 @@
+/*
+ * indexfile.c - CS50 TSE indexfile module
+ *
+ * see indexfile.h for more information.
+ *
+ * Each chunk ends just after a newline, and a last line with none is
+ * copied out with one added, so every line is known to end in '\n' and
+ * the scans for words and digits stop there without checking for the
+ * end of the text. Numbers are read digit by digit with a single
+ * unsigned comparison each, and the postings of all of a chunk's words
+ * go into one array, grown rarely, instead of a list per word.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "indexfile.h"
+
+/**************** local types ****************/
+// a word of a chunk: where its text and postings are
+typedef struct fileword {
+    size_t text;                // offset of the word in the chunk's text
+    size_t first;               // its first posting
+    int num;                    // its number of postings
+} fileword_t;
+
+// the lines one thread parses, and what it makes of them
+typedef struct chunk {
+    const char* start;          // the first line
+    const char* end;            // just past the last line's newline
+    char* text;                 // the words, each ending in a 0 byte
+    size_t text_len;
+    size_t text_size;
+    fileword_t* words;
+    size_t num_words;
+    size_t words_size;
+    indexposting_t* postings;   // the words' postings, one word after another
+    size_t num_postings;
+    size_t postings_size;
+    int skipped;                // malformed lines
+    bool failed;                // out of memory
+} chunk_t;
+
+/**************** global types ****************/
+typedef struct indexfile {
+    chunk_t* chunks;            // in the order of their lines
+    int num_chunks;
+    size_t num_words;
+    int skipped;
+} indexfile_t;
+
+/**************** local functions ****************/
+static void splitChunks(chunk_t* chunks, const int num, const char* text, const size_t whole);
+static void* parseChunk(void* arg);
+static bool addWord(chunk_t* chunk, const char* word, const size_t length, const size_t first);
+static void sortPostings(chunk_t* chunk, const size_t first);
+static const char* parseNumber(const char* p, int* number);
+static bool isBlank(const char ch);
+static void* reserve(void* array, size_t* size, const size_t need, const size_t each);
+static int comparePostings(const void* a, const void* b);
+
+/**************** indexfile_load() ****************/
+/* see indexfile.h for description */
+indexfile_t* indexfile_load(const char* filename)
+{
+    int fd = (filename == NULL) ? -1 : open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat status;
+    indexfile_t* file = calloc(1, sizeof(indexfile_t));
+    if (file == NULL || fstat(fd, &status) != 0) {
+        free(file);
+        close(fd);
+        return NULL;
+    }
+    size_t size = status.st_size;
+    const char* text = "";
+    if (size > 0) {
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            free(file);
+            close(fd);
+            return NULL;
+        }
+        text = mapped;
+        posix_madvise(mapped, size, POSIX_MADV_SEQUENTIAL);
+    }
+    close(fd);   // the mapping stays
+
+    // the whole lines, then a last line with no newline, copied with one
+    size_t whole = size;
+    while (whole > 0 && text[whole - 1] != '\n') {
+        whole--;
+    }
+    char* tail = NULL;
+    if (whole < size && (tail = malloc(size - whole + 1)) != NULL) {
+        memcpy(tail, text + whole, size - whole);
+        tail[size - whole] = '\n';
+    }
+
+    // as many threads as there are processors, and big enough chunks for
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_threads = (cpus < 1) ? 1 : (cpus > INDEXFILE_THREADS) ? INDEXFILE_THREADS : cpus;
+    if ((size_t) num_threads > whole / INDEXFILE_MIN_CHUNK) {
+        num_threads = (whole / INDEXFILE_MIN_CHUNK > 0) ? whole / INDEXFILE_MIN_CHUNK : 1;
+    }
+    file->num_chunks = num_threads + ((whole < size) ? 1 : 0);
+    file->chunks = calloc(file->num_chunks, sizeof(chunk_t));
+    bool ok = (file->chunks != NULL && (whole == size || tail != NULL));
+    if (ok) {
+        splitChunks(file->chunks, num_threads, text, whole);
+        if (tail != NULL) {
+            file->chunks[num_threads].start = tail;
+            file->chunks[num_threads].end = tail + (size - whole) + 1;
+        }
+
+        // chunk 0, and the last line, are parsed by this thread
+        pthread_t threads[INDEXFILE_THREADS];
+        bool started[INDEXFILE_THREADS] = {false};
+        for (int t = 1; t < num_threads; t++) {
+            started[t] = (pthread_create(&threads[t], NULL, parseChunk, &file->chunks[t]) == 0);
+            if (!started[t]) {
+                parseChunk(&file->chunks[t]);
+            }
+        }
+        parseChunk(&file->chunks[0]);
+        if (tail != NULL) {
+            parseChunk(&file->chunks[num_threads]);
+        }
+        for (int t = 1; t < num_threads; t++) {
+            if (started[t]) {
+                pthread_join(threads[t], NULL);
+            }
+        }
+        for (int c = 0; c < file->num_chunks; c++) {
+            ok = ok && !file->chunks[c].failed;
+            file->num_words += file->chunks[c].num_words;
+            file->skipped += file->chunks[c].skipped;
+        }
+    }
+    free(tail);
+    if (size > 0) {
+        munmap((void*) text, size);
+    }
+    if (!ok) {
+        indexfile_delete(file);
+        return NULL;
+    }
+    return file;
+}
+
+/**************** indexfile_count() ****************/
+/* see indexfile.h for description */
+size_t indexfile_count(const indexfile_t* file)
+{
+    return (file == NULL) ? 0 : file->num_words;
+}
+
+/**************** indexfile_skipped() ****************/
+/* see indexfile.h for description */
+int indexfile_skipped(const indexfile_t* file)
+{
+    return (file == NULL) ? 0 : file->skipped;
+}
+
+/**************** indexfile_iterate() ****************/
+/* see indexfile.h for description */
+void indexfile_iterate(const indexfile_t* file, void* arg,
+                       void (*itemfunc)(void* arg, const char* word,
+                                        const indexposting_t* postings, const int num))
+{
+    if (file == NULL || itemfunc == NULL) {
+        return;
+    }
+    for (int c = 0; c < file->num_chunks; c++) {
+        const chunk_t* chunk = &file->chunks[c];
+        for (size_t i = 0; i < chunk->num_words; i++) {
+            const fileword_t* word = &chunk->words[i];
+            (*itemfunc)(arg, chunk->text + word->text, chunk->postings + word->first, word->num);
+        }
+    }
+}
+
+/**************** indexfile_delete() ****************/
+/* see indexfile.h for description */
+void indexfile_delete(indexfile_t* file)
+{
+    if (file != NULL) {
+        for (int c = 0; c < file->num_chunks && file->chunks != NULL; c++) {
+            free(file->chunks[c].text);
+            free(file->chunks[c].words);
+            free(file->chunks[c].postings);
+        }
+        free(file->chunks);
+        free(file);
+    }
+}
+
+/**************** splitChunks() ****************/
+/* Split the whole lines text[0 .. whole - 1], which end in a newline,
+ * into num chunks of about equal size, each ending at a line's end.
+ * A line longer than a chunk leaves the chunks after it empty.
+ */
+static void splitChunks(chunk_t* chunks, const int num, const char* text, const size_t whole)
+{
+    const char* from = text;
+    for (int c = 0; c < num; c++) {
+        const char* to = text + whole * (c + 1) / num;
+        if (to <= from) {
+            to = from;
+        } else {
+            to = (const char*) memchr(to - 1, '\n', text + whole - (to - 1)) + 1;
+        }
+        chunks[c].start = from;
+        chunks[c].end = to;
+        from = to;
+    }
+}
+
+/**************** parseChunk() ****************/
+/* Parse a chunk's lines into its words and postings; sets failed if
+ * memory runs out. Runs as a thread, so returns NULL.
+ */
+static void* parseChunk(void* arg)
+{
+    chunk_t* chunk = arg;
+
+    // room for about what the lines hold, grown if they hold more
+    size_t bytes = chunk->end - chunk->start;
+    chunk->postings = reserve(NULL, &chunk->postings_size, bytes / 8 + 1, sizeof(indexposting_t));
+    chunk->words = reserve(NULL, &chunk->words_size, bytes / 64 + 1, sizeof(fileword_t));
+    chunk->text = reserve(NULL, &chunk->text_size, bytes / 8 + 1, 1);
+    chunk->failed = (chunk->postings == NULL || chunk->words == NULL || chunk->text == NULL);
+
+    const char* p = chunk->start;
+    while (p < chunk->end && !chunk->failed) {
+        // the word, up to a blank
+        const char* word = p;
+        while (!isBlank(*p) && *p != '\n') {
+            p++;
+        }
+        size_t length = p - word;
+        size_t first = chunk->num_postings;
+        bool sorted = true;
+        bool ok = (length > 0);
+
+        // then docID count pairs, separated by blanks
+        while (ok && *p != '\n') {
+            while (isBlank(*p)) {
+                p++;
+            }
+            if (*p == '\n') {
+                break;
+            }
+            indexposting_t posting;
+            p = parseNumber(p, &posting.docID);
+            ok = (p != NULL && isBlank(*p));
+            while (ok && isBlank(*p)) {
+                p++;
+            }
+            p = ok ? parseNumber(p, &posting.count) : NULL;
+            ok = (p != NULL && (isBlank(*p) || *p == '\n') && posting.docID > 0 && posting.count > 0);
+            if (ok && chunk->num_postings == chunk->postings_size) {
+                indexposting_t* grown = reserve(chunk->postings, &chunk->postings_size,
+                                                chunk->num_postings + 1, sizeof(indexposting_t));
+                if (grown == NULL) {
+                    chunk->failed = true;
+                    return NULL;
+                }
+                chunk->postings = grown;
+            }
+            if (ok) {
+                sorted = sorted && (chunk->num_postings == first
+                                    || chunk->postings[chunk->num_postings - 1].docID < posting.docID);
+                chunk->postings[chunk->num_postings++] = posting;
+            }
+        }
+
+        if (!ok) {
+            // skip the rest of the line; a blank line is not malformed
+            chunk->num_postings = first;
+            const char* newline = memchr(word, '\n', chunk->end - word);
+            if (newline > word) {
+                chunk->skipped++;
+            }
+            p = newline + 1;
+            continue;
+        }
+        p++;
+        if (!sorted) {
+            sortPostings(chunk, first);
+        }
+        if (!addWord(chunk, word, length, first)) {
+            chunk->failed = true;
+        }
+    }
+    return NULL;
+}
+
+/**************** addWord() ****************/
+/* Append a word of length letters, whose postings start at first, to
+ * the chunk; false if memory runs out.
+ */
+static bool addWord(chunk_t* chunk, const char* word, const size_t length, const size_t first)
+{
+    if (chunk->num_words == chunk->words_size) {
+        fileword_t* grown = reserve(chunk->words, &chunk->words_size,
+                                    chunk->num_words + 1, sizeof(fileword_t));
+        if (grown == NULL) {
+            return false;
+        }
+        chunk->words = grown;
+    }
+    if (chunk->text_len + length + 1 > chunk->text_size) {
+        char* grown = reserve(chunk->text, &chunk->text_size, chunk->text_len + length + 1, 1);
+        if (grown == NULL) {
+            return false;
+        }
+        chunk->text = grown;
+    }
+    fileword_t* entry = &chunk->words[chunk->num_words++];
+    entry->text = chunk->text_len;
+    entry->first = first;
+    entry->num = chunk->num_postings - first;
+    memcpy(chunk->text + chunk->text_len, word, length);
+    chunk->text[chunk->text_len + length] = '\0';
+    chunk->text_len += length + 1;
+    return true;
+}
+
+/**************** sortPostings() ****************/
+/* Sort a word's postings, those from first on, by docID, keeping the
+ * larger count of a repeated docID.
+ */
+static void sortPostings(chunk_t* chunk, const size_t first)
+{
+    indexposting_t* postings = chunk->postings;
+    qsort(postings + first, chunk->num_postings - first, sizeof(indexposting_t), comparePostings);
+    size_t kept = first;
+    for (size_t i = first; i < chunk->num_postings; i++) {
+        if (kept > first && postings[kept - 1].docID == postings[i].docID) {
+            postings[kept - 1] = postings[i];   // sorted after, so larger
+        } else {
+            postings[kept++] = postings[i];
+        }
+    }
+    chunk->num_postings = kept;
+}
+
+/**************** parseNumber() ****************/
+/* Read the decimal number at p, of one to nine digits.
+ * Returns the character after it, or NULL if there is no such number.
+ */
+static const char* parseNumber(const char* p, int* number)
+{
+    const char* start = p;
+    unsigned int value = 0;
+    unsigned int digit;
+    // a non-digit wraps around to more than 9, so one test a character
+    while ((digit = (unsigned char) *p - '0') <= 9) {
+        value = value * 10 + digit;
+        p++;
+    }
+    if (p == start || p - start > 9) {
+        return NULL;
+    }
+    *number = value;
+    return p;
+}
+
+/**************** isBlank() ****************/
+/* Does ch separate the words and numbers of a line? */
+static bool isBlank(const char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+/**************** reserve() ****************/
+/* Grow an array of *size items of each bytes to hold need items, at
+ * least doubling it. Returns the array, perhaps moved, with *size
+ * updated, or NULL if memory ran out (the array is then unchanged).
+ */
+static void* reserve(void* array, size_t* size, const size_t need, const size_t each)
+{
+    if (need <= *size && array != NULL) {
+        return array;
+    }
+    size_t grown = (2 * *size > need) ? 2 * *size : need;
+    void* bigger = realloc(array, grown * each);
+    if (bigger != NULL) {
+        *size = grown;
+    }
+    return bigger;
+}
+
+/**************** comparePostings() ****************/
+/* qsort comparator for postings, by docID and then count. */
+static int comparePostings(const void* a, const void* b)
+{
+    const indexposting_t* x = a;
+    const indexposting_t* y = b;
+    if (x->docID != y->docID) {
+        return (x->docID > y->docID) - (x->docID < y->docID);
+    }
+    return (x->count > y->count) - (x->count < y->count);
+}
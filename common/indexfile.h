@@ -0,0 +1,75 @@
+/*
+ * indexfile.h - header file for CS50 TSE indexfile module
+ *
+ * The indexfile module reads an index file, as index_save writes it,
+ * one line per word,
+ *
+ *     word docID count [docID count]...
+ *
+ * straight into arrays: each word's postings are (docID, count) pairs
+ * in increasing docID order, so the querier can take them as they are
+ * and index_load can fill counters from them. The file is mapped into
+ * memory, not read line by line, and split at line boundaries into
+ * chunks that up to INDEXFILE_THREADS threads parse at once.
+ *
+ * A line whose postings are not pairs of positive numbers is skipped
+ * and counted (see indexfile_skipped); a line with a docID repeated
+ * keeps it once, with the larger count.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#ifndef __INDEXFILE_H
+#define __INDEXFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define INDEXFILE_THREADS 8          // most threads parsing one file
+#define INDEXFILE_MIN_CHUNK 262144   // fewest bytes worth a thread of their own
+
+/**************** global types ****************/
+typedef struct indexfile indexfile_t;  // opaque to users of the module
+
+// one document a word occurs in
+typedef struct indexposting {
+    int docID;
+    int count;
+} indexposting_t;
+
+/**************** functions ****************/
+
+/**************** indexfile_load ****************/
+/* Read and parse the index file filename.
+ *
+ * We return:
+ *   the parsed file, or NULL if it cannot be read or memory runs out.
+ *   An empty file is an index with no words.
+ * Caller is responsible for indexfile_delete.
+ */
+indexfile_t* indexfile_load(const char* filename);
+
+/**************** indexfile_count ****************/
+/* Return the number of words read (words repeated on later lines
+ * count each time).
+ */
+size_t indexfile_count(const indexfile_t* file);
+
+/**************** indexfile_skipped ****************/
+/* Return the number of malformed lines skipped. */
+int indexfile_skipped(const indexfile_t* file);
+
+/**************** indexfile_iterate ****************/
+/* Call itemfunc with each word in the order of the file's lines, with
+ * its num postings, by increasing docID (num may be 0). The word and
+ * postings belong to the file, and stay good until indexfile_delete.
+ */
+void indexfile_iterate(const indexfile_t* file, void* arg,
+                       void (*itemfunc)(void* arg, const char* word,
+                                        const indexposting_t* postings, const int num));
+
+/**************** indexfile_delete ****************/
+/* Free the parsed file. */
+void indexfile_delete(indexfile_t* file);
+
+#endif // __INDEXFILE_H
@@ -0,0 +1,336 @@
+/*
+ * indexruns.c - CS50 TSE indexruns module
+ *
+ * see indexruns.h for more information.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "indexruns.h"
+#include "safefile.h"
+
+/**************** local types ****************/
+// the next line of a run being merged
+typedef struct cursor {
+    FILE* fp;
+    int run;                    // the run's place in docID order
+    char* line;                 // the word, then a 0 byte, then its postings
+    size_t size;                // bytes allocated for line
+    char* rest;                 // the postings, "docID count ...", within line
+} cursor_t;
+
+/**************** global types ****************/
+typedef struct indexruns {
+    char* prefix;               // the index file, which run names extend
+    size_t budget;              // bytes an index may reach before a run
+    char** names;               // the runs' files, in docID order
+    int num_runs;
+    int size;                   // slots allocated in names
+    int next_id;                // number for the next run's name
+} indexruns_t;
+
+/**************** local functions ****************/
+static char* newRunName(indexruns_t* runs);
+static bool addRun(indexruns_t* runs, char* name);
+static bool mergeRuns(char** names, const int num, const char* pathname);
+static bool readLine(cursor_t* cursor);
+static bool cursorLess(const cursor_t* a, const cursor_t* b);
+static void siftDown(cursor_t** heap, const int num, int i);
+
+/**************** indexruns_new() ****************/
+/* see indexruns.h for description */
+indexruns_t* indexruns_new(const char* indexFilename, const size_t budget)
+{
+    indexruns_t* runs = (indexFilename == NULL) ? NULL : calloc(1, sizeof(indexruns_t));
+    if (runs == NULL) {
+        return NULL;
+    }
+    runs->prefix = malloc(strlen(indexFilename) + 1);
+    if (runs->prefix == NULL) {
+        free(runs);
+        return NULL;
+    }
+    strcpy(runs->prefix, indexFilename);
+    runs->budget = budget;
+    return runs;
+}
+
+/**************** indexruns_check() ****************/
+/* see indexruns.h for description */
+bool indexruns_check(indexruns_t* runs, index_t* index)
+{
+    if (runs == NULL || index == NULL) {
+        return false;
+    }
+    return index_bytes(index) < runs->budget || indexruns_flush(runs, index);
+}
+
+/**************** indexruns_flush() ****************/
+/* see indexruns.h for description */
+bool indexruns_flush(indexruns_t* runs, index_t* index)
+{
+    if (runs == NULL || index == NULL) {
+        return false;
+    }
+    if (index->num_words == 0) {
+        return true;
+    }
+
+    char* name = newRunName(runs);
+    if (name == NULL || !index_save(name, index) || !addRun(runs, name)) {
+        if (name != NULL) {
+            unlink(name);
+        }
+        free(name);
+        return false;
+    }
+    return index_clear(index);
+}
+
+/**************** indexruns_count() ****************/
+/* see indexruns.h for description */
+int indexruns_count(const indexruns_t* runs)
+{
+    return (runs == NULL) ? 0 : runs->num_runs;
+}
+
+/**************** indexruns_merge() ****************/
+/* see indexruns.h for description */
+bool indexruns_merge(indexruns_t* runs, const char* indexFilename)
+{
+    if (runs == NULL || indexFilename == NULL) {
+        return false;
+    }
+
+    // too many to merge at once: merge neighbours into longer runs,
+    // keeping them in docID order
+    while (runs->num_runs > INDEXRUNS_FANIN) {
+        int merged = 0;
+        for (int first = 0; first < runs->num_runs; first += INDEXRUNS_FANIN) {
+            int num = runs->num_runs - first;
+            num = (num > INDEXRUNS_FANIN) ? INDEXRUNS_FANIN : num;
+            char* name = (num == 1) ? runs->names[first] : newRunName(runs);
+            if (name == NULL || (num > 1 && !mergeRuns(runs->names + first, num, name))) {
+                // keep the runs not yet merged after the merged ones
+                if (num > 1) {
+                    free(name);
+                }
+                while (first < runs->num_runs) {
+                    runs->names[merged++] = runs->names[first++];
+                }
+                runs->num_runs = merged;
+                return false;
+            }
+            if (num > 1) {
+                for (int i = first; i < first + num; i++) {
+                    unlink(runs->names[i]);
+                    free(runs->names[i]);
+                }
+            }
+            runs->names[merged++] = name;
+        }
+        runs->num_runs = merged;
+    }
+
+    if (!mergeRuns(runs->names, runs->num_runs, indexFilename)) {
+        return false;
+    }
+    for (int i = 0; i < runs->num_runs; i++) {
+        unlink(runs->names[i]);
+        free(runs->names[i]);
+    }
+    runs->num_runs = 0;
+    return true;
+}
+
+/**************** indexruns_delete() ****************/
+/* see indexruns.h for description */
+void indexruns_delete(indexruns_t* runs, const bool keep)
+{
+    if (runs != NULL) {
+        for (int i = 0; i < runs->num_runs; i++) {
+            if (!keep) {
+                unlink(runs->names[i]);
+            }
+            free(runs->names[i]);
+        }
+        free(runs->names);
+        free(runs->prefix);
+        free(runs);
+    }
+}
+
+/**************** newRunName() ****************/
+/* Return the pathname for the next run, malloc'd; NULL on error. */
+static char* newRunName(indexruns_t* runs)
+{
+    size_t length = strlen(runs->prefix) + 16;
+    char* name = malloc(length);
+    if (name != NULL) {
+        snprintf(name, length, "%s.run%d", runs->prefix, runs->next_id++);
+    }
+    return name;
+}
+
+/**************** addRun() ****************/
+/* Append a run's name, which runs then owns; false on error. */
+static bool addRun(indexruns_t* runs, char* name)
+{
+    if (runs->num_runs == runs->size) {
+        int size = (runs->size == 0) ? 16 : 2 * runs->size;
+        char** names = realloc(runs->names, size * sizeof(char*));
+        if (names == NULL) {
+            return false;
+        }
+        runs->names = names;
+        runs->size = size;
+    }
+    runs->names[runs->num_runs++] = name;
+    return true;
+}
+
+/**************** mergeRuns() ****************/
+/* Merge num runs, named in docID order, into the file pathname, which is
+ * replaced whole (see safefile.h).
+ * Returns false if a run cannot be read or the file written; the runs
+ * and the file are left as they were.
+ */
+static bool mergeRuns(char** names, const int num, const char* pathname)
+{
+    FILE* out = safefile_open(pathname, "w");
+    cursor_t* cursors = calloc(num > 0 ? num : 1, sizeof(cursor_t));
+    cursor_t** heap = malloc((num > 0 ? num : 1) * sizeof(cursor_t*));
+    bool ok = (out != NULL && cursors != NULL && heap != NULL);
+
+    // the heap holds each run's next line, least word first, and of
+    // equal words the earlier run's first
+    int heap_size = 0;
+    for (int i = 0; ok && i < num; i++) {
+        cursors[i].run = i;
+        cursors[i].fp = fopen(names[i], "r");
+        if (cursors[i].fp == NULL) {
+            ok = false;
+        } else if (readLine(&cursors[i])) {
+            int child = heap_size++;
+            heap[child] = &cursors[i];
+            while (child > 0 && cursorLess(heap[child], heap[(child - 1) / 2])) {
+                cursor_t* parent = heap[(child - 1) / 2];
+                heap[(child - 1) / 2] = heap[child];
+                heap[child] = parent;
+                child = (child - 1) / 2;
+            }
+        }
+    }
+
+    // write each word once, followed by its postings from every run
+    char* last = NULL;          // the word being written
+    size_t last_size = 0;
+    while (ok && heap_size > 0) {
+        cursor_t* top = heap[0];
+        if (last == NULL || strcmp(last, top->line) != 0) {
+            size_t length = strlen(top->line) + 1;
+            if (length > last_size) {
+                char* grown = realloc(last, length);
+                if (grown == NULL) {
+                    ok = false;
+                    break;
+                }
+                if (last != NULL) {
+                    fputc('\n', out);
+                }
+                last = grown;
+                last_size = length;
+            } else {
+                fputc('\n', out);
+            }
+            memcpy(last, top->line, length);
+            fputs(top->line, out);
+        }
+        if (top->rest[0] != '\0') {
+            fputc(' ', out);
+            fputs(top->rest, out);
+        }
+        if (!readLine(top)) {
+            heap[0] = heap[--heap_size];
+        }
+        siftDown(heap, heap_size, 0);
+    }
+    if (ok && last != NULL) {
+        fputc('\n', out);
+    }
+    for (int i = 0; i < num && cursors != NULL; i++) {
+        if (cursors[i].fp != NULL) {
+            ok = ok && !ferror(cursors[i].fp);
+            fclose(cursors[i].fp);
+        }
+        free(cursors[i].line);
+    }
+    free(last);
+    free(heap);
+    free(cursors);
+    if (out != NULL) {
+        ok = safefile_close(out, pathname, ok);
+    }
+    return ok;
+}
+
+/**************** readLine() ****************/
+/* Read a cursor's next line, splitting it into word and postings.
+ * Returns false at the end of the run.
+ */
+static bool readLine(cursor_t* cursor)
+{
+    ssize_t length = getline(&cursor->line, &cursor->size, cursor->fp);
+    if (length <= 0) {
+        return false;
+    }
+    if (cursor->line[length - 1] == '\n') {
+        cursor->line[length - 1] = '\0';
+    }
+    char* space = strchr(cursor->line, ' ');
+    if (space == NULL) {
+        cursor->rest = cursor->line + strlen(cursor->line);
+    } else {
+        *space = '\0';
+        cursor->rest = space + 1;
+    }
+    return true;
+}
+
+/**************** cursorLess() ****************/
+/* Does a's line come before b's: a smaller word, or the same word from an earlier run? */
+static bool cursorLess(const cursor_t* a, const cursor_t* b)
+{
+    int order = strcmp(a->line, b->line);
+    return order < 0 || (order == 0 && a->run < b->run);
+}
+
+/**************** siftDown() ****************/
+/* Move heap[i] down until neither child comes before it. */
+static void siftDown(cursor_t** heap, const int num, int i)
+{
+    while (true) {
+        int least = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < num && cursorLess(heap[left], heap[least])) {
+            least = left;
+        }
+        if (right < num && cursorLess(heap[right], heap[least])) {
+            least = right;
+        }
+        if (least == i) {
+            return;
+        }
+        cursor_t* swap = heap[i];
+        heap[i] = heap[least];
+        heap[least] = swap;
+        i = least;
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * indexruns.h - header file for CS50 TSE indexruns module
+ *
+ * The indexruns module lets the indexer build an index bigger than its
+ * memory. The indexer fills an index_t as usual; whenever the index
+ * grows past a memory budget (by index_bytes), it is written out as a
+ * sorted run, a temporary file, and emptied. At the end the runs are
+ * merged into the index file.
+ *
+ * A run is an index file, written by index_save, so it has one line
+ * per word,
+ *
+ *     word docID count [docID count]...
+ *
+ * with the words in strcmp order and each word's docIDs increasing.
+ * The indexer reads pages in docID order and only starts a run between
+ * pages, so every docID of a run is smaller than every docID of the
+ * runs after it. Merging is then a k-way merge by word, in which a word
+ * found in several runs gets their postings one run after another, and
+ * its docIDs stay increasing with no sorting. At most INDEXRUNS_FANIN
+ * runs are merged at once, to bound the open files and line buffers;
+ * with more, neighbouring runs are first merged into longer ones.
+ *
+ * Runs are named for the index file, with ".run" and a number appended,
+ * so they land on the same filesystem; they are removed once merged.
+ * The merged index is sorted as index_save would have written it.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#ifndef __INDEXRUNS_H
+#define __INDEXRUNS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "index.h"
+
+#define INDEXRUNS_FANIN 64   // most runs merged at once
+
+/**************** global types ****************/
+typedef struct indexruns indexruns_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** indexruns_new ****************/
+/* Create an empty set of runs for the index file indexFilename, to be
+ * written whenever an index reaches budget bytes; NULL on error.
+ * Caller is responsible for indexruns_delete.
+ */
+indexruns_t* indexruns_new(const char* indexFilename, const size_t budget);
+
+/**************** indexruns_check ****************/
+/* Write the index as a run and empty it, if it has reached the budget.
+ *
+ * Caller provides:
+ *   an index holding only pages after those of earlier runs, and
+ *   whole pages (call this between pages).
+ * We return:
+ *   false if the run could not be written (the index is then kept).
+ */
+bool indexruns_check(indexruns_t* runs, index_t* index);
+
+/**************** indexruns_flush ****************/
+/* Write the index as a run and empty it, whatever its size (an empty
+ * index writes nothing); as indexruns_check otherwise.
+ */
+bool indexruns_flush(indexruns_t* runs, index_t* index);
+
+/**************** indexruns_count ****************/
+/* Return the number of runs written and not yet merged. */
+int indexruns_count(const indexruns_t* runs);
+
+/**************** indexruns_merge ****************/
+/* Merge the runs into the index file indexFilename, removing them.
+ *
+ * We return:
+ *   false if a run could not be read or the index written.
+ */
+bool indexruns_merge(indexruns_t* runs, const char* indexFilename);
+
+/**************** indexruns_delete ****************/
+/* Delete the runs, removing any run files still on disk unless keep
+ * is true (say, because a flush or merge failed and the runs are all
+ * there is of the index).
+ */
+void indexruns_delete(indexruns_t* runs, const bool keep);
+
+#endif // __INDEXRUNS_H
@@ -0,0 +1,99 @@
+/*
+ * indexshards.c - CS50 TSE indexshards module
+ *
+ * see indexshards.h for more information.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "indexshards.h"
+#include "safefile.h"
+
+static const char* SHARD_SUFFIX = ".shard";
+static const char* LIST_SUFFIX = ".shards";
+
+/**************** indexshards_name() ****************/
+/* see indexshards.h for description */
+char* indexshards_name(const char* indexFilename, const int shard)
+{
+    if (indexFilename == NULL || shard < 0) {
+        return NULL;
+    }
+    size_t length = strlen(indexFilename) + strlen(SHARD_SUFFIX) + 12;
+    char* pathname = malloc(length);
+    if (pathname != NULL) {
+        snprintf(pathname, length, "%s%s%d", indexFilename, SHARD_SUFFIX, shard);
+    }
+    return pathname;
+}
+
+/**************** indexshards_list() ****************/
+/* see indexshards.h for description */
+char* indexshards_list(const char* indexFilename)
+{
+    if (indexFilename == NULL) {
+        return NULL;
+    }
+    char* pathname = malloc(strlen(indexFilename) + strlen(LIST_SUFFIX) + 1);
+    if (pathname != NULL) {
+        strcpy(pathname, indexFilename);
+        strcat(pathname, LIST_SUFFIX);
+    }
+    return pathname;
+}
+
+/**************** indexshards_save() ****************/
+/* see indexshards.h for description */
+bool indexshards_save(const char* indexFilename, const int* first, const int* last,
+                      const int num)
+{
+    char* pathname = indexshards_list(indexFilename);
+    FILE* fp = (pathname == NULL) ? NULL : safefile_open(pathname, "w");
+    if (fp == NULL) {
+        free(pathname);
+        return false;
+    }
+    for (int i = 0; i < num; i++) {
+        fprintf(fp, "%d %d\n", first[i], last[i]);
+    }
+    bool ok = safefile_close(fp, pathname, true);
+    free(pathname);
+    return ok;
+}
+
+/**************** indexshards_load() ****************/
+/* see indexshards.h for description */
+int indexshards_load(const char* indexFilename)
+{
+    char* pathname = indexshards_list(indexFilename);
+    FILE* fp = (pathname == NULL) ? NULL : fopen(pathname, "r");
+    free(pathname);
+    if (fp == NULL) {
+        return 0;
+    }
+    int num = 0;
+    int first, last, fields;
+    while ((fields = fscanf(fp, "%d %d", &first, &last)) == 2) {
+        num++;
+    }
+    fclose(fp);
+    if (fields != EOF || num == 0 || num > INDEXSHARDS_MAX) {
+        return -1;      // a malformed line, or no shards
+    }
+    return num;
+}
+
+/**************** indexshards_remove() ****************/
+/* see indexshards.h for description */
+void indexshards_remove(const char* indexFilename)
+{
+    char* pathname = indexshards_list(indexFilename);
+    if (pathname != NULL) {
+        remove(pathname);
+        free(pathname);
+    }
+}
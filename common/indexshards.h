@@ -0,0 +1,63 @@
+/*
+ * indexshards.h - header file for CS50 TSE indexshards module
+ *
+ * An index may be split into shards by docID range, so that no one
+ * index need hold every page: the indexer, given --shards=N, divides
+ * the pages into N ranges of about equal size and writes each as an
+ * index of its own, with its own page lengths, positions and word
+ * normalization beside it, in files named for the index with ".shard"
+ * and the shard's number appended (indexFilename.shard0, ...). It then
+ * lists the shards in a file named for the index with ".shards"
+ * appended, one line per shard, in order,
+ *
+ *     firstDoc lastDoc
+ *
+ * (an empty range, firstDoc past lastDoc, if there were fewer pages
+ * than shards). The querier takes an index with such a list to be the
+ * union of its shards.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#ifndef __INDEXSHARDS_H
+#define __INDEXSHARDS_H
+
+#include <stdbool.h>
+
+#define INDEXSHARDS_MAX 64   // most shards an index may have
+
+/**************** functions ****************/
+
+/**************** indexshards_name ****************/
+/* Return the name of an index's shard file, malloc'd; NULL on error.
+ * Caller is responsible for freeing it.
+ */
+char* indexshards_name(const char* indexFilename, const int shard);
+
+/**************** indexshards_list ****************/
+/* Return the name of an index's list of shards, malloc'd; NULL on error.
+ * Caller is responsible for freeing it.
+ */
+char* indexshards_list(const char* indexFilename);
+
+/**************** indexshards_save ****************/
+/* Write the list of an index's num shards, shard i holding docIDs
+ * first[i] through last[i]; false on error.
+ */
+bool indexshards_save(const char* indexFilename, const int* first, const int* last,
+                      const int num);
+
+/**************** indexshards_load ****************/
+/* Return the number of shards an index's list names: 0 if it has no
+ * list (it is one index file), or -1 if the list cannot be read or
+ * names no shards or more than INDEXSHARDS_MAX.
+ */
+int indexshards_load(const char* indexFilename);
+
+/**************** indexshards_remove ****************/
+/* Remove an index's list of shards, if any, so the index is again one
+ * file; the shard files themselves are left.
+ */
+void indexshards_remove(const char* indexFilename);
+
+#endif // __INDEXSHARDS_H
@@ -0,0 +1,189 @@
+/*
+ * lzblock.c - CS50 TSE lzblock module
+ *
+ * see lzblock.h for more information.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "lzblock.h"
+
+/**************** local functions ****************/
+static uint32_t read32(const unsigned char* p);
+static unsigned char* putLength(unsigned char* op, size_t n);
+
+static const int HASH_BITS = 13;          // 8192 entries in the match table
+static const size_t MIN_MATCH = 4;        // shortest match worth encoding
+static const size_t MAX_OFFSET = 65535;   // furthest back a match may start
+static const size_t LAST_LITERALS = 5;    // a block always ends in literals
+static const size_t MATCH_LIMIT = 12;     // no match starts this near the end
+
+/**************** lzblock_bound() ****************/
+/* see lzblock.h for description */
+size_t lzblock_bound(const size_t len)
+{
+    return len + len / 255 + 16;
+}
+
+/**************** lzblock_compress() ****************/
+/* see lzblock.h for description */
+size_t lzblock_compress(const char* src, const size_t len, char* dst, const size_t cap)
+{
+    const unsigned char* in = (const unsigned char*) src;
+    unsigned char* op = (unsigned char*) dst;
+    unsigned char* const oend = op + cap;
+    uint32_t table[1 << HASH_BITS];       // position + 1 of a recent prefix
+    memset(table, 0, sizeof(table));
+
+    size_t anchor = 0;      // first literal not yet written
+    size_t ip = 0;
+    while (len >= MATCH_LIMIT && ip + MATCH_LIMIT <= len) {
+        uint32_t seq = read32(in + ip);
+        uint32_t h = (seq * 2654435761U) >> (32 - HASH_BITS);
+        size_t ref = table[h];
+        table[h] = ip + 1;
+        if (ref == 0 || ip - (ref - 1) > MAX_OFFSET || read32(in + ref - 1) != seq) {
+            ip++;
+            continue;
+        }
+        ref--;
+
+        // extend the match, stopping short of the final literals
+        size_t matchLen = MIN_MATCH;
+        while (ip + matchLen < len - LAST_LITERALS && in[ref + matchLen] == in[ip + matchLen]) {
+            matchLen++;
+        }
+
+        // token, literals, offset, match length
+        size_t litLen = ip - anchor;
+        if ((size_t) (oend - op) < 1 + litLen + litLen / 255 + 1 + 2 + matchLen / 255 + 1) {
+            return 0;
+        }
+        unsigned char* token = op++;
+        *token = (litLen >= 15 ? 15 : litLen) << 4;
+        if (litLen >= 15) {
+            op = putLength(op, litLen - 15);
+        }
+        memcpy(op, in + anchor, litLen);
+        op += litLen;
+        size_t offset = ip - ref;
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        size_t code = matchLen - MIN_MATCH;
+        *token |= (code >= 15 ? 15 : code);
+        if (code >= 15) {
+            op = putLength(op, code - 15);
+        }
+
+        ip += matchLen;
+        anchor = ip;
+    }
+
+    // the last sequence: literals only
+    size_t litLen = len - anchor;
+    if ((size_t) (oend - op) < 1 + litLen + litLen / 255 + 1) {
+        return 0;
+    }
+    unsigned char* token = op++;
+    *token = (litLen >= 15 ? 15 : litLen) << 4;
+    if (litLen >= 15) {
+        op = putLength(op, litLen - 15);
+    }
+    memcpy(op, in + anchor, litLen);
+    op += litLen;
+    return op - (unsigned char*) dst;
+}
+
+/**************** lzblock_decompress() ****************/
+/* see lzblock.h for description */
+long lzblock_decompress(const char* src, const size_t len, char* dst, const size_t cap)
+{
+    const unsigned char* ip = (const unsigned char*) src;
+    const unsigned char* const iend = ip + len;
+    unsigned char* op = (unsigned char*) dst;
+    unsigned char* const ostart = op;
+    unsigned char* const oend = op + cap;
+
+    while (ip < iend) {
+        unsigned token = *ip++;
+
+        // literals
+        size_t litLen = token >> 4;
+        if (litLen == 15) {
+            unsigned char b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                litLen += b;
+            } while (b == 255);
+        }
+        if ((size_t) (iend - ip) < litLen || (size_t) (oend - op) < litLen) {
+            return -1;
+        }
+        memcpy(op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+        if (ip == iend) {
+            break;          // the last sequence has no match
+        }
+
+        // match
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t matchLen = token & 15;
+        if (matchLen == 15) {
+            unsigned char b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                matchLen += b;
+            } while (b == 255);
+        }
+        matchLen += MIN_MATCH;
+        if (offset == 0 || offset > (size_t) (op - ostart)
+            || (size_t) (oend - op) < matchLen) {
+            return -1;
+        }
+        const unsigned char* ref = op - offset;
+        if (offset >= matchLen) {
+            memcpy(op, ref, matchLen);
+            op += matchLen;
+        } else {
+            // overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < matchLen; i++) {
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op - ostart;
+}
+
+/**************** read32() ****************/
+/* Read four bytes, whatever their alignment */
+static uint32_t read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**************** putLength() ****************/
+/* Write the rest of a length as 255s and a final byte below 255 */
+static unsigned char* putLength(unsigned char* op, size_t n)
+{
+    while (n >= 255) {
+        *op++ = 255;
+        n -= 255;
+    }
+    *op++ = n;
+    return op;
+}
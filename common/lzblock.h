@@ -0,0 +1,52 @@
+/*
+ * lzblock.h - header file for CS50 TSE lzblock module
+ *
+ * lzblock is a small LZ77 block codec in the style of LZ4: a block is a
+ * run of sequences, each a token byte (literal count in the high four
+ * bits, match length - 4 in the low four, 15 meaning "more bytes
+ * follow"), the literals, and a two-byte little-endian offset back into
+ * the output (at most 65535). The last sequence has literals only.
+ * Compression hashes every four-byte prefix into a small table and takes
+ * the first match it finds, trading ratio for speed; decompression is a
+ * tight copy loop. HTML typically shrinks to a third of its size or less.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#ifndef __LZBLOCK_H
+#define __LZBLOCK_H
+
+#include <stddef.h>
+
+/**************** functions ****************/
+
+/**************** lzblock_bound ****************/
+/* Return the most bytes lzblock_compress can produce from len bytes. */
+size_t lzblock_bound(const size_t len);
+
+/**************** lzblock_compress ****************/
+/* Compress a block.
+ *
+ * Caller provides:
+ *   len bytes at src, and a buffer dst of cap bytes.
+ * We return:
+ *   the number of bytes written to dst, or 0 if they did not fit
+ *   (cap >= lzblock_bound(len) always suffices).
+ */
+size_t lzblock_compress(const char* src, const size_t len, char* dst, const size_t cap);
+
+/**************** lzblock_decompress ****************/
+/* Decompress a block made by lzblock_compress.
+ *
+ * Caller provides:
+ *   len bytes of compressed data at src, and a buffer dst of cap bytes.
+ * We return:
+ *   the number of bytes written to dst, or -1 if the data is malformed
+ *   or would overflow dst.
+ * Notes:
+ *   Every read and write is bounds-checked, so a corrupt block cannot
+ *   crash the caller.
+ */
+long lzblock_decompress(const char* src, const size_t len, char* dst, const size_t cap);
+
+#endif // __LZBLOCK_H
@@ -4,21 +4,47 @@
  * Manzi Fabrice Niyigaba October 20 2024
  */
 
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "../libcs50/webpage.h"
 #include "../libcs50/file.h"
+#include "../libcs50/counters.h"
+#include "lzblock.h"
 #include "pagedir.h"
 
+/**************** local types ****************/
+typedef struct pagewriter {
+    char* pageDirectory;        // where the page goes
+    char* tmpname;              // the temporary file, until commit
+    FILE* fp;                   // open on tmpname
+    bool failed;                // has a write failed?
+    char* block;                // HTML not yet compressed (NULL if raw)
+    size_t blockLen;            // bytes in block
+    char* packed;               // room for one compressed block
+} pagewriter_t;
+
 /**************** function prototypes ****************/
 bool pagedir_init(const char* pageDirectory);
 bool save_webpage_dir(const webpage_t* page, const char* pageDirectory, const int docID);
 char* get_pathname(const char* pageDirectory, const char* filename);
 int pagedir_verify(const char* pageDirectory);
 webpage_t* pagedir_load(const char* pathname);
+bool pagedir_duplicates(const char* pageDirectory, counters_t** duplicates);
+static bool block_flush(pagewriter_t* writer);
+static char* blocks_read(FILE* fp);
+static void put32(char* p, size_t v);
+static size_t get32(const unsigned char* p);
+
+/* a compressed page has this line after its depth, then its HTML in blocks */
+static const char LZ_MAGIC[] = "\001lzblock\n";
+static const size_t LZ_BLOCK = 1 << 16;     // HTML bytes per block
 
 /**************** pagedir_init() ****************/
 /* see pagedir.h for description */
@@ -81,6 +107,129 @@ bool save_webpage_dir(const webpage_t* page, const char* pageDirectory, const in
     return true;
 }
 
+/**************** pagedir_begin() ****************/
+/* see pagedir.h for description */
+pagewriter_t* pagedir_begin(const char* pageDirectory, const char* url, const int depth,
+                            const bool compress)
+{
+    pagewriter_t* writer = calloc(1, sizeof(pagewriter_t));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer->pageDirectory = malloc(strlen(pageDirectory) + 1);
+    writer->tmpname = get_pathname(pageDirectory, ".partial-XXXXXX");
+    if (compress) {
+        writer->block = malloc(LZ_BLOCK);
+        writer->packed = malloc(lzblock_bound(LZ_BLOCK));
+    }
+    int fd = -1;
+    if (writer->pageDirectory == NULL
+        || (compress && (writer->block == NULL || writer->packed == NULL))
+        || (fd = mkstemp(writer->tmpname)) < 0
+        || (writer->fp = fdopen(fd, "w")) == NULL) {
+        fprintf(stderr, "Failed to create a page file in directory: %s\n", pageDirectory);
+        if (fd >= 0) {
+            close(fd);
+            unlink(writer->tmpname);
+        }
+        free(writer->pageDirectory);
+        free(writer->tmpname);
+        free(writer->block);
+        free(writer->packed);
+        free(writer);
+        return NULL;
+    }
+    strcpy(writer->pageDirectory, pageDirectory);
+    fchmod(fd, 0644);       // mkstemp makes it private; pages are not
+
+    fprintf(writer->fp, "%s\n", url);     // Save the URL
+    fprintf(writer->fp, "%d\n", depth);   // Save the depth
+    if (compress) {
+        fputs(LZ_MAGIC, writer->fp);
+    }
+    return writer;
+}
+
+/**************** pagedir_write() ****************/
+/* see pagedir.h for description */
+bool pagedir_write(pagewriter_t* writer, const char* data, const size_t len)
+{
+    if (writer == NULL || data == NULL) {
+        return false;
+    }
+    if (writer->block == NULL) {
+        if (fwrite(data, 1, len, writer->fp) != len) {
+            writer->failed = true;
+        }
+        return !writer->failed;
+    }
+
+    // fill and compress whole blocks; the last, partial one waits for commit
+    size_t done = 0;
+    while (done < len && !writer->failed) {
+        size_t n = LZ_BLOCK - writer->blockLen;
+        if (n > len - done) {
+            n = len - done;
+        }
+        memcpy(writer->block + writer->blockLen, data + done, n);
+        writer->blockLen += n;
+        done += n;
+        if (writer->blockLen == LZ_BLOCK) {
+            block_flush(writer);
+        }
+    }
+    return !writer->failed;
+}
+
+/**************** pagedir_commit() ****************/
+/* see pagedir.h for description */
+bool pagedir_commit(pagewriter_t* writer, const int docID)
+{
+    if (writer == NULL) {
+        return false;
+    }
+    pagedir_write(writer, "\n", 1);     // as save_webpage_dir ends the HTML
+    if (writer->block != NULL) {
+        if (writer->blockLen > 0) {
+            block_flush(writer);
+        }
+        block_flush(writer);        // an empty block ends the page
+    }
+    bool ok = !writer->failed && !ferror(writer->fp);
+    ok = (fclose(writer->fp) == 0) && ok;
+
+    char filename[16];
+    snprintf(filename, sizeof(filename), "%d", docID);
+    char* pathname = get_pathname(writer->pageDirectory, filename);
+    if (!ok || rename(writer->tmpname, pathname) != 0) {
+        fprintf(stderr, "Failed to save page file: %s\n", pathname);
+        unlink(writer->tmpname);
+        ok = false;
+    }
+    free(pathname);
+    free(writer->pageDirectory);
+    free(writer->tmpname);
+    free(writer->block);
+    free(writer->packed);
+    free(writer);
+    return ok;
+}
+
+/**************** pagedir_abort() ****************/
+/* see pagedir.h for description */
+void pagedir_abort(pagewriter_t* writer)
+{
+    if (writer != NULL) {
+        fclose(writer->fp);
+        unlink(writer->tmpname);
+        free(writer->pageDirectory);
+        free(writer->tmpname);
+        free(writer->block);
+        free(writer->packed);
+        free(writer);
+    }
+}
+
 /**************** get_pathname() ****************/
 /* see pagedir.h for description */
 char* get_pathname(const char* pageDirectory, const char* filename) {
@@ -107,6 +256,42 @@ int pagedir_verify(const char* pageDirectory) {
     return 0; 
 }
 
+/**************** pagedir_duplicates() ****************/
+/* see pagedir.h for description */
+bool pagedir_duplicates(const char* pageDirectory, counters_t** duplicates)
+{
+    *duplicates = NULL;
+    char* pathname = get_pathname(pageDirectory, ".duplicates");
+    if (pathname == NULL) {
+        return false;
+    }
+    FILE* fp = fopen(pathname, "r");
+    free(pathname);
+    if (fp == NULL) {
+        return errno == ENOENT;     // no file: the crawl was not deduplicated
+    }
+
+    counters_t* list = counters_new();
+    bool ok = (list != NULL);
+    char* line;
+    while (ok && (line = file_readLine(fp)) != NULL) {
+        int docID, originalID, urlStart = 0;
+        ok = sscanf(line, "%d %d %n", &docID, &originalID, &urlStart) == 2
+             && urlStart > 0 && line[urlStart] != '\0'
+             && docID > originalID && originalID > 0
+             && counters_set(list, docID, originalID);
+        free(line);
+    }
+    ok = ok && !ferror(fp);
+    fclose(fp);
+    if (!ok) {
+        counters_delete(list);
+        return false;
+    }
+    *duplicates = list;
+    return true;
+}
+
 /**************** pagedir_load() ****************/
 /* see pagedir.h for description */
 webpage_t* pagedir_load(const char* pathname) {
@@ -136,8 +321,20 @@ webpage_t* pagedir_load(const char* pathname) {
     int depth = atoi(depth_str);
     free(depth_str);
 
-    // Read the HTML content using file_readFile
-    char* html = file_readFile(fp);
+    // Read the HTML content, decompressing it if need be
+    char* html;
+    int c = getc(fp);
+    if (c == LZ_MAGIC[0]) {
+        char magic[sizeof(LZ_MAGIC)];
+        html = NULL;
+        if (fgets(magic, sizeof(magic) - 1, fp) != NULL
+            && strcmp(magic, LZ_MAGIC + 1) == 0) {
+            html = blocks_read(fp);
+        }
+    } else {
+        ungetc(c, fp);
+        html = file_readFile(fp);
+    }
     fclose(fp);  
     if (html == NULL) {
         fprintf(stderr, "Failed to read HTML content from file: %s\n", pathname);
@@ -154,4 +351,92 @@ webpage_t* pagedir_load(const char* pathname) {
         return NULL;
     }
     return page;
-}
\ No newline at end of file
+}
+
+/**************** block_flush() ****************/
+/* Compress the writer's block and append it to the page file as
+ * rawLength, storedLength (four bytes each, little-endian) and the
+ * stored bytes; a block that does not shrink is stored as it is.
+ * An empty block, with both lengths 0, marks the end of the page.
+ */
+static bool block_flush(pagewriter_t* writer)
+{
+    size_t stored = lzblock_compress(writer->block, writer->blockLen,
+                                     writer->packed, writer->blockLen);
+    const char* data = writer->packed;
+    if (stored == 0 || stored >= writer->blockLen) {
+        stored = writer->blockLen;
+        data = writer->block;
+    }
+    char header[8];
+    put32(header, writer->blockLen);
+    put32(header + 4, stored);
+    if (fwrite(header, 1, sizeof(header), writer->fp) != sizeof(header)
+        || fwrite(data, 1, stored, writer->fp) != stored) {
+        writer->failed = true;
+    }
+    writer->blockLen = 0;
+    return !writer->failed;
+}
+
+/**************** blocks_read() ****************/
+/* Read the blocks of a compressed page (see block_flush) up to the empty
+ * one; return the HTML as a malloc'd string, or NULL if the file is
+ * truncated or corrupt.
+ */
+static char* blocks_read(FILE* fp)
+{
+    char* html = NULL;
+    size_t len = 0;
+    char* packed = malloc(LZ_BLOCK);
+    unsigned char header[8];
+
+    while (packed != NULL && fread(header, 1, sizeof(header), fp) == sizeof(header)) {
+        size_t raw = get32(header);
+        size_t stored = get32(header + 4);
+        if (raw == 0 && stored == 0) {
+            free(packed);
+            if (html == NULL) {
+                html = calloc(1, 1);        // an empty page
+            }
+            return html;
+        }
+        if (raw > LZ_BLOCK || stored > raw) {
+            break;
+        }
+        char* grown = realloc(html, len + raw + 1);
+        if (grown == NULL) {
+            break;
+        }
+        html = grown;
+        if (stored == raw) {
+            if (fread(html + len, 1, raw, fp) != raw) {
+                break;
+            }
+        } else if (fread(packed, 1, stored, fp) != stored
+                   || lzblock_decompress(packed, stored, html + len, raw) != (long) raw) {
+            break;
+        }
+        len += raw;
+        html[len] = '\0';
+    }
+    free(packed);
+    free(html);
+    return NULL;
+}
+
+/**************** put32() ****************/
+/* Store v in four bytes, little-endian */
+static void put32(char* p, size_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (v >> (8 * i)) & 0xff;
+    }
+}
+
+/**************** get32() ****************/
+/* Load four little-endian bytes */
+static size_t get32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((size_t) p[3] << 24);
+}
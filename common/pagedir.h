@@ -14,6 +14,7 @@
 
 #include <stdbool.h>
 #include "../libcs50/webpage.h"
+#include "../libcs50/counters.h"
 
 /**************** functions ****************/
 
@@ -52,6 +53,52 @@ bool pagedir_init(const char* pageDirectory);
  */
 bool save_webpage_dir(const webpage_t* page, const char* pageDirectory, const int docID);
 
+/**************** pagedir_begin ****************/
+/* Start saving a page whose HTML is still arriving.
+ *
+ * Caller provides:
+ *   a valid directory path, the page's URL and depth, and whether to
+ *   compress the HTML.
+ * We do:
+ *   create a temporary file in the directory (named ".partial-XXXXXX")
+ *   and write the URL and depth lines to it.
+ * We return:
+ *   a pagewriter for the page, or NULL on error.
+ * Caller is responsible for:
+ *   passing the writer to exactly one of pagedir_commit or pagedir_abort.
+ * Notes:
+ *   The page gets its docID only at pagedir_commit, so pages that fail
+ *   partway leave no gap in the numbering.
+ *   A compressed page keeps its URL and depth lines as plain text, so
+ *   anything reading just the URL still works. They are followed by a
+ *   line holding "\001lzblock" and the HTML in blocks of up to 64KB,
+ *   each compressed with lzblock (or stored, if it does not shrink) and
+ *   preceded by its raw and stored lengths; an empty block ends the page.
+ *   Blocks are compressed as the HTML arrives, so memory use stays fixed.
+ */
+typedef struct pagewriter pagewriter_t;
+pagewriter_t* pagedir_begin(const char* pageDirectory, const char* url, const int depth,
+                            const bool compress);
+
+/**************** pagedir_write ****************/
+/* Append len bytes of the page's HTML; return false on a write error. */
+bool pagedir_write(pagewriter_t* writer, const char* data, const size_t len);
+
+/**************** pagedir_commit ****************/
+/* Finish the page and give it its docID.
+ *
+ * We do:
+ *   end the file as save_webpage_dir would, flush it, and rename it to
+ *   "pageDirectory/docID"; then free the writer.
+ * We return:
+ *   true if the page was saved, false otherwise (the file is removed).
+ */
+bool pagedir_commit(pagewriter_t* writer, const int docID);
+
+/**************** pagedir_abort ****************/
+/* Throw away a partly written page and free the writer. */
+void pagedir_abort(pagewriter_t* writer);
+
 /**************** get_pathname ****************/
 /* Constructs a full pathname for a given file in the specified directory.
  *
@@ -101,7 +148,30 @@ int pagedir_verify(const char* pageDirectory);
  * Notes:
  *   If the file cannot be opened or the page content cannot be read, 
  *   an error message is printed and NULL is returned.
+ *   Compressed pages (see pagedir_begin) are decompressed transparently;
+ *   a page directory may hold both kinds.
  */
 webpage_t* pagedir_load(const char* pathname);
 
+/**************** pagedir_duplicates ****************/
+/* Reads the near-duplicate pages that crawler --dedup listed.
+ *
+ * Caller provides:
+ *   a valid page directory, and where to put the list (duplicates).
+ * We do:
+ *   read pageDirectory/.duplicates, one "docID originalID URL" line per
+ *   near-duplicate page, into a counters set mapping each duplicate's
+ *   docID to its original's.
+ * We return:
+ *   true with *duplicates set; *duplicates is NULL if the directory has
+ *   no .duplicates, as for a crawl made without --dedup. false if the
+ *   file cannot be read or a line is malformed.
+ * Caller is responsible for:
+ *   calling counters_delete on *duplicates.
+ * Notes:
+ *   crawler --dedup creates the file when it starts, so a crawl that
+ *   found no near-duplicates has an empty one.
+ */
+bool pagedir_duplicates(const char* pageDirectory, counters_t** duplicates);
+
 #endif // __PAGEDIR_H
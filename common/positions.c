@@ -0,0 +1,378 @@
+/*
+ * positions.c - CS50 TSE positions module
+ *
+ * see positions.h for more information.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "positions.h"
+#include "safefile.h"
+#include "../libcs50/hashtable.h"
+
+/**************** local types ****************/
+typedef struct posentry {
+    posword_t word;             // what positions_find returns
+    int docs_size;              // slots in word.docs and word.ends
+    size_t len;                 // bytes of word.bytes in use
+    size_t size;                // bytes of word.bytes allocated
+    int last;                   // last position added to the last document
+} posentry_t;
+
+/**************** global types ****************/
+typedef struct positions {
+    hashtable_t* ht;            // word -> posentry_t
+} positions_t;
+
+/**************** local functions ****************/
+static posentry_t* entryFor(positions_t* positions, const char* word);
+static bool entryDoc(posentry_t* entry, const int docID);
+static bool entryBytes(posentry_t* entry, const size_t need);
+static void entryPut(posentry_t* entry, unsigned int value);
+static void entryDelete(void* item);
+static void saveWord(void* arg, const char* key, void* item);
+static void putVarint(FILE* fp, unsigned int value);
+static bool getVarint(const unsigned char** p, const unsigned char* end, unsigned int* value);
+static char* positionsPath(const char* indexFilename);
+
+static const char* SUFFIX = ".pos";
+static const char* HEADER = "positions 1\n";
+static const int MAX_VARINT = 5;      // bytes in the longest 32-bit varint
+
+/**************** positions_new() ****************/
+/* see positions.h for description */
+positions_t* positions_new(const int num_slots)
+{
+    positions_t* positions = malloc(sizeof(positions_t));
+    if (positions == NULL) {
+        return NULL;
+    }
+    positions->ht = hashtable_new(num_slots);
+    if (positions->ht == NULL) {
+        free(positions);
+        return NULL;
+    }
+    return positions;
+}
+
+/**************** positions_add() ****************/
+/* see positions.h for description */
+bool positions_add(positions_t* positions, const char* word,
+                   const int docID, const int position)
+{
+    if (positions == NULL || word == NULL || docID <= 0 || position < 0) {
+        return false;
+    }
+    posentry_t* entry = entryFor(positions, word);
+    if (entry == NULL) {
+        return false;
+    }
+    posword_t* pw = &entry->word;
+    unsigned int gap;
+    if (pw->num_docs > 0 && pw->docs[pw->num_docs - 1] == docID) {
+        if (position <= entry->last) {
+            return false;
+        }
+        gap = position - entry->last;
+    } else {
+        if ((pw->num_docs > 0 && pw->docs[pw->num_docs - 1] > docID)
+            || !entryDoc(entry, docID)) {
+            return false;
+        }
+        gap = position;
+    }
+    if (!entryBytes(entry, entry->len + MAX_VARINT)) {
+        return false;
+    }
+    entryPut(entry, gap);
+    entry->last = position;
+    pw->ends[pw->num_docs - 1] = entry->len;
+    return true;
+}
+
+/**************** positions_find() ****************/
+/* see positions.h for description */
+const posword_t* positions_find(positions_t* positions, const char* word)
+{
+    if (positions == NULL || word == NULL) {
+        return NULL;
+    }
+    posentry_t* entry = hashtable_find(positions->ht, word);
+    return (entry == NULL) ? NULL : &entry->word;
+}
+
+/**************** positions_decode() ****************/
+/* see positions.h for description */
+int positions_decode(const posword_t* word, const int i, int* out)
+{
+    if (word == NULL || i < 0 || i >= word->num_docs || out == NULL) {
+        return 0;
+    }
+    const unsigned char* p = word->bytes + ((i == 0) ? 0 : word->ends[i - 1]);
+    const unsigned char* end = word->bytes + word->ends[i];
+    unsigned int position = 0;
+    unsigned int gap;
+    int n = 0;
+    while (p < end && getVarint(&p, end, &gap)) {
+        position += gap;
+        out[n++] = position;
+    }
+    return n;
+}
+
+/**************** positions_save() ****************/
+/* see positions.h for description */
+bool positions_save(positions_t* positions, const char* indexFilename)
+{
+    char* pathname = positionsPath(indexFilename);
+    FILE* fp = (pathname == NULL || positions == NULL) ? NULL : safefile_open(pathname, "wb");
+    if (fp == NULL) {
+        free(pathname);
+        return false;
+    }
+    fputs(HEADER, fp);
+    hashtable_iterate(positions->ht, fp, saveWord);
+    bool ok = safefile_close(fp, pathname, true);
+    free(pathname);
+    return ok;
+}
+
+/**************** positions_load() ****************/
+/* see positions.h for description */
+positions_t* positions_load(const char* indexFilename)
+{
+    char* pathname = positionsPath(indexFilename);
+    FILE* fp = (pathname == NULL) ? NULL : fopen(pathname, "rb");
+    free(pathname);
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    // read the whole file
+    unsigned char* data = NULL;
+    size_t len = 0;
+    size_t size = 0;
+    bool ok = true;
+    while (ok) {
+        if (len == size) {
+            size = (size > 0) ? size * 2 : 1 << 16;
+            unsigned char* bigger = realloc(data, size);
+            if (bigger == NULL) {
+                ok = false;
+                break;
+            }
+            data = bigger;
+        }
+        size_t got = fread(data + len, 1, size - len, fp);
+        len += got;
+        if (got == 0) {
+            ok = !ferror(fp);
+            break;
+        }
+    }
+    fclose(fp);
+
+    size_t header = strlen(HEADER);
+    ok = ok && len >= header && memcmp(data, HEADER, header) == 0;
+    // about one word in every 64 bytes; the table only needs to be near
+    int slots = (len / 64 < 800) ? 800 : (len / 64 > (1 << 20)) ? (1 << 20) : len / 64;
+    positions_t* positions = ok ? positions_new(slots) : NULL;
+    const unsigned char* p = ok ? data + header : NULL;
+    const unsigned char* end = data + len;
+    while (positions != NULL && p < end) {
+        const unsigned char* nul = memchr(p, '\0', end - p);
+        posentry_t* entry = NULL;
+        unsigned int num_docs;
+        if (nul == NULL || nul == p || hashtable_find(positions->ht, (const char*) p) != NULL
+            || (entry = entryFor(positions, (const char*) p)) == NULL) {
+            ok = false;
+        }
+        p = (nul == NULL) ? end : nul + 1;
+        if (ok && !getVarint(&p, end, &num_docs)) {
+            ok = false;
+        }
+        int docID = 0;
+        for (unsigned int d = 0; ok && d < num_docs; d++) {
+            unsigned int gap, num_bytes;
+            if (!getVarint(&p, end, &gap) || !getVarint(&p, end, &num_bytes)
+                || (size_t) (end - p) < num_bytes || !entryDoc(entry, docID += gap)
+                || !entryBytes(entry, entry->len + num_bytes)) {
+                ok = false;
+                break;
+            }
+            memcpy(entry->word.bytes + entry->len, p, num_bytes);
+            p += num_bytes;
+            entry->len += num_bytes;
+            entry->word.ends[entry->word.num_docs - 1] = entry->len;
+        }
+        if (!ok) {
+            positions_delete(positions);
+            positions = NULL;
+        }
+    }
+    free(data);
+    return positions;
+}
+
+/**************** positions_delete() ****************/
+/* see positions.h for description */
+void positions_delete(positions_t* positions)
+{
+    if (positions != NULL) {
+        hashtable_delete(positions->ht, entryDelete);
+        free(positions);
+    }
+}
+
+/**************** entryFor() ****************/
+/* Return the word's entry, made empty if it has none; NULL on error */
+static posentry_t* entryFor(positions_t* positions, const char* word)
+{
+    posentry_t* entry = hashtable_find(positions->ht, word);
+    if (entry == NULL) {
+        entry = calloc(1, sizeof(posentry_t));
+        if (entry == NULL || !hashtable_insert(positions->ht, word, entry)) {
+            free(entry);
+            return NULL;
+        }
+    }
+    return entry;
+}
+
+/**************** entryDoc() ****************/
+/* Start a new document in the entry, with no positions yet */
+static bool entryDoc(posentry_t* entry, const int docID)
+{
+    posword_t* pw = &entry->word;
+    if (pw->num_docs == entry->docs_size) {
+        int size = (entry->docs_size > 0) ? entry->docs_size * 2 : 4;
+        int* docs = realloc(pw->docs, size * sizeof(int));
+        if (docs == NULL) {
+            return false;
+        }
+        pw->docs = docs;
+        size_t* ends = realloc(pw->ends, size * sizeof(size_t));
+        if (ends == NULL) {
+            return false;
+        }
+        pw->ends = ends;
+        entry->docs_size = size;
+    }
+    pw->docs[pw->num_docs] = docID;
+    pw->ends[pw->num_docs] = entry->len;
+    pw->num_docs++;
+    entry->last = 0;
+    return true;
+}
+
+/**************** entryBytes() ****************/
+/* Make room for need bytes of positions in the entry */
+static bool entryBytes(posentry_t* entry, const size_t need)
+{
+    if (need <= entry->size) {
+        return true;
+    }
+    size_t size = (entry->size > 0) ? entry->size : 16;
+    while (size < need) {
+        size *= 2;
+    }
+    unsigned char* bytes = realloc(entry->word.bytes, size);
+    if (bytes == NULL) {
+        return false;
+    }
+    entry->word.bytes = bytes;
+    entry->size = size;
+    return true;
+}
+
+/**************** entryPut() ****************/
+/* Append a varint to the entry's bytes, which have room for it */
+static void entryPut(posentry_t* entry, unsigned int value)
+{
+    while (value >= 0x80) {
+        entry->word.bytes[entry->len++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    entry->word.bytes[entry->len++] = value;
+}
+
+/**************** entryDelete() ****************/
+/* Free one word's entry, for hashtable_delete */
+static void entryDelete(void* item)
+{
+    posentry_t* entry = item;
+    if (entry != NULL) {
+        free(entry->word.docs);
+        free(entry->word.ends);
+        free(entry->word.bytes);
+        free(entry);
+    }
+}
+
+/**************** saveWord() ****************/
+/* Write one word's positions to the file, for hashtable_iterate */
+static void saveWord(void* arg, const char* key, void* item)
+{
+    FILE* fp = arg;
+    posword_t* pw = &((posentry_t*) item)->word;
+    fputs(key, fp);
+    fputc('\0', fp);
+    putVarint(fp, pw->num_docs);
+    int docID = 0;
+    size_t start = 0;
+    for (int i = 0; i < pw->num_docs; i++) {
+        putVarint(fp, pw->docs[i] - docID);
+        putVarint(fp, pw->ends[i] - start);
+        fwrite(pw->bytes + start, 1, pw->ends[i] - start, fp);
+        docID = pw->docs[i];
+        start = pw->ends[i];
+    }
+}
+
+/**************** putVarint() ****************/
+/* Write a varint to the file */
+static void putVarint(FILE* fp, unsigned int value)
+{
+    while (value >= 0x80) {
+        fputc((value & 0x7f) | 0x80, fp);
+        value >>= 7;
+    }
+    fputc(value, fp);
+}
+
+/**************** getVarint() ****************/
+/* Read a varint at *p, not past end, and move *p past it.
+ * Return false if it runs past end or is too long.
+ */
+static bool getVarint(const unsigned char** p, const unsigned char* end, unsigned int* value)
+{
+    unsigned int result = 0;
+    for (int shift = 0; *p < end && shift < 7 * MAX_VARINT; shift += 7) {
+        unsigned char byte = *(*p)++;
+        result |= (unsigned int) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**************** positionsPath() ****************/
+/* Return the malloc'd pathname of an index's positions file */
+static char* positionsPath(const char* indexFilename)
+{
+    if (indexFilename == NULL) {
+        return NULL;
+    }
+    char* pathname = malloc(strlen(indexFilename) + strlen(SUFFIX) + 1);
+    if (pathname != NULL) {
+        strcpy(pathname, indexFilename);
+        strcat(pathname, SUFFIX);
+    }
+    return pathname;
+}
@@ -0,0 +1,103 @@
+/*
+ * positions.h - header file for CS50 TSE positions module
+ *
+ * The positions module records where in each document every word
+ * occurs, so the querier can answer phrase queries. A word's position
+ * is its place among the words the indexer counted in the document
+ * (words of three or more letters, as for docstats), so the shorter
+ * words between two counted words do not separate them.
+ *
+ * Positions are kept compressed. For each word there are the documents
+ * holding it, in increasing docID order, and for each document the gaps
+ * between the word's successive positions there (the first gap counted
+ * from 0), each gap a variable-length integer: seven bits a byte, low
+ * bits first, the high bit set on every byte but the last.
+ *
+ * The indexer saves them, with --positions, beside the index in a file
+ * named for the index with ".pos" appended. After a first line
+ * "positions 1", the file holds, for each word, its letters and a 0
+ * byte, then its number of documents, then for each document the gap
+ * from the previous docID (from 0 for the first), the number of bytes
+ * of its positions, and those bytes; every number is a variable-length
+ * integer as above.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#ifndef __POSITIONS_H
+#define __POSITIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**************** global types ****************/
+typedef struct positions positions_t;  // opaque to users of the module
+
+/* One word's positions.
+ * Document i holds the word at the positions encoded in
+ * bytes[start .. ends[i] - 1], where start is ends[i - 1] (0 for i = 0).
+ */
+typedef struct posword {
+    int num_docs;               // documents holding the word
+    int* docs;                  // their docIDs, increasing
+    size_t* ends;               // where each document's positions end
+    unsigned char* bytes;       // the positions, gap-encoded
+} posword_t;
+
+/**************** functions ****************/
+
+/**************** positions_new ****************/
+/* Create an empty set of positions, hashed into num_slots slots;
+ * NULL on error. Caller is responsible for positions_delete.
+ */
+positions_t* positions_new(const int num_slots);
+
+/**************** positions_add ****************/
+/* Record that word occurs in document docID at position.
+ *
+ * Caller provides:
+ *   documents in increasing docID order, and each document's
+ *   positions in increasing order, as the indexer reads them.
+ * We return:
+ *   false on error, or if the order is not kept.
+ */
+bool positions_add(positions_t* positions, const char* word,
+                   const int docID, const int position);
+
+/**************** positions_find ****************/
+/* Return the word's positions, or NULL if no document holds it. */
+const posword_t* positions_find(positions_t* positions, const char* word);
+
+/**************** positions_decode ****************/
+/* Decode the positions of a word in its i'th document (see posword_t).
+ *
+ * Caller provides:
+ *   room in out for as many positions as the document has bytes of
+ *   them (each takes at least one byte).
+ * We return:
+ *   the number of positions decoded, in increasing order.
+ */
+int positions_decode(const posword_t* word, const int i, int* out);
+
+/**************** positions_save ****************/
+/* Write the positions beside the index file indexFilename.
+ *
+ * We return:
+ *   false if the file could not be written.
+ */
+bool positions_save(positions_t* positions, const char* indexFilename);
+
+/**************** positions_load ****************/
+/* Read the positions saved beside the index file indexFilename.
+ *
+ * We return:
+ *   the positions, or NULL if the file is missing or malformed.
+ *   Caller is responsible for positions_delete.
+ */
+positions_t* positions_load(const char* indexFilename);
+
+/**************** positions_delete ****************/
+/* Delete the positions. */
+void positions_delete(positions_t* positions);
+
+#endif // __POSITIONS_H
@@ -0,0 +1,68 @@
+/*
+ * safefile.c - CS50 TSE safefile module
+ *
+ * see safefile.h for more information.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "safefile.h"
+
+/**************** local functions ****************/
+static char* tempPath(const char* pathname);
+
+static const char* TEMP_SUFFIX = ".tmp";
+
+/**************** safefile_open() ****************/
+/* see safefile.h for description */
+FILE* safefile_open(const char* pathname, const char* mode)
+{
+    char* tmpname = tempPath(pathname);
+    FILE* fp = (tmpname == NULL) ? NULL : fopen(tmpname, mode);
+    free(tmpname);
+    return fp;
+}
+
+/**************** safefile_close() ****************/
+/* see safefile.h for description */
+bool safefile_close(FILE* fp, const char* pathname, const bool ok)
+{
+    char* tmpname = tempPath(pathname);
+    if (fp == NULL || tmpname == NULL) {
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        free(tmpname);
+        return false;
+    }
+    // the new file must be on disk before it replaces the old one
+    bool done = ok && !ferror(fp) && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    done = (fclose(fp) == 0) && done;
+    done = done && rename(tmpname, pathname) == 0;
+    if (!done) {
+        unlink(tmpname);
+    }
+    free(tmpname);
+    return done;
+}
+
+/**************** tempPath() ****************/
+/* Return pathname with TEMP_SUFFIX appended, malloc'd; NULL on error */
+static char* tempPath(const char* pathname)
+{
+    if (pathname == NULL) {
+        return NULL;
+    }
+    char* tmpname = malloc(strlen(pathname) + strlen(TEMP_SUFFIX) + 1);
+    if (tmpname != NULL) {
+        strcpy(tmpname, pathname);
+        strcat(tmpname, TEMP_SUFFIX);
+    }
+    return tmpname;
+}
@@ -0,0 +1,41 @@
+/*
+ * safefile.h - header file for CS50 TSE safefile module
+ *
+ * A safefile replaces a file all at once. It is written under the
+ * file's name with ".tmp" appended, synced to disk, and only then
+ * renamed over the file. A reader that has the old file open or mapped
+ * (the querier maps its index) keeps reading the old file whole, and
+ * one that opens the name afterwards gets the new file whole; neither
+ * ever sees a file half written or cut short. A crash leaves the old
+ * file, and at worst a stray ".tmp" beside it.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#ifndef __SAFEFILE_H
+#define __SAFEFILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/**************** functions ****************/
+
+/**************** safefile_open ****************/
+/* Open pathname's temporary file for writing, with the fopen mode
+ * given ("w" or "wb"); NULL on error.
+ * Caller is responsible for:
+ *   later calling safefile_close with the same pathname.
+ */
+FILE* safefile_open(const char* pathname, const char* mode);
+
+/**************** safefile_close ****************/
+/* Close a file from safefile_open and, if ok (the caller wrote all of
+ * it) and it reached the disk, rename it over pathname. Otherwise the
+ * temporary file is removed and pathname left as it was.
+ *
+ * We return:
+ *   true if pathname now holds the new file.
+ */
+bool safefile_close(FILE* fp, const char* pathname, const bool ok);
+
+#endif // __SAFEFILE_H
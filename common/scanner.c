@@ -0,0 +1,199 @@
+/*
+ * scanner.c - CS50 TSE scanner module
+ *
+ * see scanner.h for more information.
+ *
+ * The scanner is a two-state machine: outside a tag it collects letters
+ * into the current word; from '<' to the next '>' it collects the tag,
+ * minus white space, and on '>' looks in it for a link.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "../libcs50/webpage.h"
+#include "scanner.h"
+
+/**************** global types ****************/
+typedef struct scanner {
+    char* pageURL;              // base for relative links
+    void (*linkfunc)(void* arg, const char* url, const urlparts_t* parts);
+                                // NULL to skip links
+    void (*wordfunc)(void* arg, char* word);   // NULL to skip words
+    void* arg;                  // for linkfunc and wordfunc
+    char* link;                 // canonical form of the latest link
+    size_t linkSize;            // characters allocated in link
+    bool inTag;                 // between '<' and '>'?
+    char* tag;                  // the tag so far, without white space
+    size_t tagLen;              // characters in tag
+    bool tagTooLong;            // tag overflowed; ignore it
+    char* word;                 // the word so far
+    size_t wordLen;             // characters in word
+    bool wordTooLong;           // word overflowed; drop it
+} scanner_t;
+
+/**************** local functions ****************/
+static void tagDone(scanner_t* sc);
+static void wordDone(scanner_t* sc);
+
+static const size_t MAX_TAG = 8192;    // longest tag we look for a link in
+static const size_t MAX_WORD = 1024;   // longest word we report
+
+/**************** scanner_new() ****************/
+/* see scanner.h for description */
+scanner_t* scanner_new(const char* pageURL,
+                       void (*linkfunc)(void* arg, const char* url,
+                                        const urlparts_t* parts),
+                       void (*wordfunc)(void* arg, char* word),
+                       void* arg)
+{
+    if (pageURL == NULL) {
+        return NULL;
+    }
+    scanner_t* sc = calloc(1, sizeof(scanner_t));
+    if (sc == NULL) {
+        return NULL;
+    }
+    sc->pageURL = malloc(strlen(pageURL) + 1);
+    sc->tag = malloc(MAX_TAG + 1);
+    sc->word = malloc(MAX_WORD + 1);
+    sc->linkSize = strlen(pageURL) + MAX_TAG + 2;   // enough for any link
+    sc->link = malloc(sc->linkSize);
+    if (sc->pageURL == NULL || sc->tag == NULL || sc->word == NULL || sc->link == NULL) {
+        scanner_delete(sc);
+        return NULL;
+    }
+    strcpy(sc->pageURL, pageURL);
+    sc->linkfunc = linkfunc;
+    sc->wordfunc = wordfunc;
+    sc->arg = arg;
+    return sc;
+}
+
+/**************** scanner_feed() ****************/
+/* see scanner.h for description */
+void scanner_feed(scanner_t* sc, const char* data, const size_t len)
+{
+    if (sc == NULL || data == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (sc->inTag) {
+            if (c == '>') {
+                sc->inTag = false;
+                tagDone(sc);
+            } else if (!isspace((unsigned char) c)) {
+                if (sc->tagLen < MAX_TAG) {
+                    sc->tag[sc->tagLen++] = c;
+                } else {
+                    sc->tagTooLong = true;
+                }
+            }
+        } else if (isalpha((unsigned char) c)) {
+            if (sc->wordLen < MAX_WORD) {
+                sc->word[sc->wordLen++] = c;
+            } else {
+                sc->wordTooLong = true;
+            }
+        } else {
+            wordDone(sc);
+            if (c == '<') {
+                sc->inTag = true;
+                sc->tagLen = 0;
+                sc->tagTooLong = false;
+            }
+        }
+    }
+}
+
+/**************** scanner_finish() ****************/
+/* see scanner.h for description */
+void scanner_finish(scanner_t* sc)
+{
+    if (sc != NULL && !sc->inTag) {
+        wordDone(sc);
+    }
+}
+
+/**************** scanner_delete() ****************/
+/* see scanner.h for description */
+void scanner_delete(scanner_t* sc)
+{
+    if (sc != NULL) {
+        free(sc->pageURL);
+        free(sc->tag);
+        free(sc->word);
+        free(sc->link);
+        free(sc);
+    }
+}
+
+/**************** tagDone() ****************/
+/* A tag has ended: if it is "<a ...>" with an href, report the link */
+static void tagDone(scanner_t* sc)
+{
+    if (sc->linkfunc == NULL || sc->tagTooLong || sc->tagLen == 0
+        || tolower((unsigned char) sc->tag[0]) != 'a') {
+        return;
+    }
+    char* tag = sc->tag;
+    char* tagEnd = tag + sc->tagLen;
+    *tagEnd = '\0';
+
+    // the first href in the tag
+    char* href = NULL;
+    for (char* p = tag; p + 5 <= tagEnd && href == NULL; p++) {
+        if (strncasecmp(p, "href=", 5) == 0) {
+            href = p + 5;
+        }
+    }
+    if (href == NULL) {
+        return;
+    }
+
+    // quoted or unquoted value
+    char* end = tagEnd;
+    if (*href == '\'' || *href == '"') {
+        char delim = *href++;
+        end = strchr(href, delim);
+        if (end == NULL) {
+            return;
+        }
+    }
+    // skip internal references, and drop any #fragment
+    if (*href == '#') {
+        return;
+    }
+    char* hash = memchr(href, '#', end - href);
+    if (hash != NULL) {
+        end = hash;
+    }
+
+    urlparts_t parts;
+    if (webpage_canonicalURL(sc->pageURL, href, end - href,
+                             sc->link, sc->linkSize, &parts) > 0) {
+        (*sc->linkfunc)(sc->arg, sc->link, &parts);
+    }
+}
+
+/**************** wordDone() ****************/
+/* A non-letter has ended the current word, if any: report it */
+static void wordDone(scanner_t* sc)
+{
+    if (sc->wordLen > 0 && sc->wordfunc != NULL && !sc->wordTooLong) {
+        char* word = malloc(sc->wordLen + 1);
+        if (word != NULL) {
+            memcpy(word, sc->word, sc->wordLen);
+            word[sc->wordLen] = '\0';
+            (*sc->wordfunc)(sc->arg, word);
+        }
+    }
+    sc->wordLen = 0;
+    sc->wordTooLong = false;
+}
@@ -0,0 +1,70 @@
+/*
+ * scanner.h - header file for CS50 TSE scanner module
+ *
+ * A scanner finds the links and words in a page's HTML while the page is
+ * still arriving. The HTML is fed in pieces of any size; links and words
+ * are reported through callbacks as soon as they are complete, and only
+ * an unfinished tag or word is carried from one piece to the next, so
+ * memory use does not depend on the size of the page.
+ *
+ * Links are found as webpage_getNextURL finds them: an href attribute in
+ * a tag starting "<a" (ignoring white space), without its #fragment,
+ * made absolute against the page's URL and normalized, all without
+ * allocating. Words are found as
+ * webpage_getNextWord finds them: runs of letters outside of tags.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#ifndef __SCANNER_H
+#define __SCANNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../libcs50/webpage.h"
+
+/**************** global types ****************/
+typedef struct scanner scanner_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** scanner_new ****************/
+/* Create a new scanner for one page.
+ *
+ * Caller provides:
+ *   the URL of the page (copied), against which relative links resolve;
+ *   linkfunc(arg, url, parts), called with each link found, in canonical
+ *   form (webpage_canonicalURL), or NULL to skip links;
+ *   wordfunc(arg, word), called with each word found, or NULL to skip words;
+ *   and arg, passed to both.
+ * We return:
+ *   pointer to a new scanner, or NULL if error.
+ * Caller is responsible for:
+ *   later calling scanner_delete.
+ * Notes:
+ *   linkfunc's url lies in the scanner's own buffer and is good only
+ *   until linkfunc returns, so links that are dropped (external, say)
+ *   cost no malloc; it must copy any url it keeps. wordfunc receives a
+ *   malloc'd string, which it must free (or keep).
+ */
+scanner_t* scanner_new(const char* pageURL,
+                       void (*linkfunc)(void* arg, const char* url,
+                                        const urlparts_t* parts),
+                       void (*wordfunc)(void* arg, char* word),
+                       void* arg);
+
+/**************** scanner_feed ****************/
+/* Scan the next len bytes of the page. */
+void scanner_feed(scanner_t* sc, const char* data, const size_t len);
+
+/**************** scanner_finish ****************/
+/* Report the word, if any, that the page ended in the middle of.
+ * Call once after the last scanner_feed.
+ */
+void scanner_finish(scanner_t* sc);
+
+/**************** scanner_delete ****************/
+/* Delete the scanner. */
+void scanner_delete(scanner_t* sc);
+
+#endif // __SCANNER_H
@@ -0,0 +1,589 @@
+/*
+ * seenset.c - CS50 TSE seenset module
+ *
+ * see seenset.h for more information.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../libcs50/hashtable.h"
+#include "../libcs50/file.h"
+#include "pagedir.h"
+#include "seenset.h"
+
+/**************** local types ****************/
+/* What a bounded set keeps in memory for one bucket file: the URLs
+ * added but not yet written, one per line, and the URLs most recently
+ * looked up or added, so a link that keeps coming back (a site's
+ * navigation, say) is answered without reading the file.
+ */
+typedef struct bucket {
+    char* pending;                  // URLs not yet appended to the file
+    size_t pendingLen;
+    size_t pendingSize;
+    char* recent[8];                // RECENT_URLS of them, or NULL
+    uint64_t recentHash[8];         // their hash1
+    int nextRecent;                 // the slot to replace next
+} bucket_t;
+
+/**************** global types ****************/
+typedef struct seenset {
+    // exact flavor
+    hashtable_t* table;             // URL -> "" (NULL if bounded)
+    FILE* log;                      // each URL inserted, for checkpoints; or NULL
+    // bounded flavor
+    size_t budget;                  // bytes in the Bloom filter
+    _Atomic(uint64_t)* bits;        // the Bloom filter
+    uint64_t numBits;               // size of the filter in bits
+    bucket_t* buckets;              // NUM_BUCKETS of them, each under its stripe
+    atomic_bool writeFailed;        // a bucket could not be written
+    // both flavors
+    char* directory;                // holds the log or the bucket files, or NULL
+    pthread_mutex_t locks[64];      // bounded: stripes chosen by bucket;
+                                    // exact: locks[0] guards the table
+} seenset_t;
+
+/**************** local functions ****************/
+static seenset_t* seenset_alloc_exact(const char* directory);
+static seenset_t* seenset_alloc_bounded(const char* directory, const size_t budget);
+static bool make_directory(const char* directory);
+static char* log_path(seenset_t* set);
+static uint64_t hash1(const char* url);
+static uint64_t hash2(uint64_t h);
+static bool bloom_testAndSet(seenset_t* set, uint64_t h);
+static char* bucket_path(seenset_t* set, int bucket);
+static bool bucket_contains(const char* pathname, const char* url);
+static bool bucket_append(bucket_t* bk, const char* url);
+static bool bucket_flush(seenset_t* set, int bucket);
+static bool lines_contain(const char* text, size_t len, const char* url, size_t urlLen);
+static bool recent_find(bucket_t* bk, uint64_t h, const char* url);
+static void recent_add(bucket_t* bk, uint64_t h, const char* url);
+
+static const int NUM_LOCKS = 64;        // must match the size of locks[]
+static const int NUM_BUCKETS = 1024;    // bucket files on disk
+static const int NUM_HASHES = 7;        // Bloom filter probes per URL
+static const int EXACT_SLOTS = 10000;   // hashtable slots for exact sets
+static const int RECENT_URLS = 8;       // must match the size of bucket_t's recent[]
+static const size_t PENDING_BYTES = 4096;   // URLs a bucket holds before writing them
+enum { SCAN_BYTES = 65536 };            // read at a time when scanning a bucket file
+
+/**************** seenset_new() ****************/
+/* see seenset.h for description */
+seenset_t* seenset_new(const char* directory)
+{
+    seenset_t* set = seenset_alloc_exact(directory);
+    if (set == NULL || directory == NULL) {
+        return set;
+    }
+
+    // start from an empty log
+    char* pathname = log_path(set);
+    set->log = (pathname == NULL) ? NULL : fopen(pathname, "w");
+    free(pathname);
+    if (set->log == NULL) {
+        fprintf(stderr, "Failed to create seen-set log in %s\n", directory);
+        seenset_delete(set);
+        return NULL;
+    }
+    return set;
+}
+
+/**************** seenset_new_bounded() ****************/
+/* see seenset.h for description */
+seenset_t* seenset_new_bounded(const char* directory, const size_t budget)
+{
+    seenset_t* set = seenset_alloc_bounded(directory, budget);
+    if (set == NULL) {
+        return NULL;
+    }
+
+    // start from empty buckets
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        char* pathname = bucket_path(set, b);
+        FILE* fp = fopen(pathname, "w");
+        free(pathname);
+        if (fp == NULL) {
+            fprintf(stderr, "Failed to create seen-set bucket in %s\n", directory);
+            seenset_delete(set);
+            return NULL;
+        }
+        fclose(fp);
+    }
+    return set;
+}
+
+/**************** seenset_insert() ****************/
+/* see seenset.h for description */
+bool seenset_insert(seenset_t* set, const char* url)
+{
+    if (set == NULL || url == NULL) {
+        return false;
+    }
+    uint64_t h = hash1(url);
+    int bucket = h % NUM_BUCKETS;
+    // the hashtable picks its slot by a hash of its own, so any two URLs
+    // may share one and the table takes a single lock; a bucket file is
+    // only ever touched under its own stripe
+    pthread_mutex_t* lock = (set->table != NULL) ? &set->locks[0]
+                                                 : &set->locks[bucket % NUM_LOCKS];
+    bool inserted = false;
+
+    pthread_mutex_lock(lock);
+    if (set->table != NULL) {
+        inserted = hashtable_insert(set->table, url, "");
+        if (inserted && set->log != NULL) {
+            fprintf(set->log, "%s\n", url);    // write errors show at the next save
+        }
+    } else if (!recent_find(&set->buckets[bucket], h, url)) {
+        // a URL the filter had not seen is certainly new; otherwise
+        // ask the bucket, which knows for sure, writes pending first
+        bucket_t* bk = &set->buckets[bucket];
+        bool maybeSeen = bloom_testAndSet(set, h);
+        bool seen = maybeSeen && lines_contain(bk->pending, bk->pendingLen, url, strlen(url));
+        if (maybeSeen && !seen) {
+            char* pathname = bucket_path(set, bucket);
+            seen = (pathname == NULL || bucket_contains(pathname, url));
+            free(pathname);
+        }
+        if (!seen) {
+            inserted = bucket_append(bk, url);
+            if (inserted && bk->pendingLen >= PENDING_BYTES) {
+                bucket_flush(set, bucket);
+            }
+        }
+        recent_add(bk, h, url);
+    }
+    pthread_mutex_unlock(lock);
+    return inserted;
+}
+
+/**************** seenset_save() ****************/
+/* see seenset.h for description */
+bool seenset_save(seenset_t* set, FILE* fp)
+{
+    if (set == NULL || fp == NULL) {
+        return false;
+    }
+    if (set->table != NULL) {
+        // the URLs are already in the log; it need only reach the disk
+        if (set->log == NULL || fflush(set->log) != 0 || ferror(set->log)
+            || fsync(fileno(set->log)) != 0) {
+            return false;
+        }
+        fprintf(fp, "exact %lld\n", (long long) ftello(set->log));
+    } else {
+        // the URLs still in memory join those on disk first
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            bucket_flush(set, b);
+        }
+        if (atomic_load(&set->writeFailed)) {
+            return false;
+        }
+        fprintf(fp, "bounded %zu %d\n", set->budget, NUM_BUCKETS);
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            char* pathname = bucket_path(set, b);
+            struct stat st;
+            bool ok = (pathname != NULL && stat(pathname, &st) == 0);
+            free(pathname);
+            if (!ok) {
+                return false;
+            }
+            fprintf(fp, "%lld%c", (long long) st.st_size,
+                    b == NUM_BUCKETS - 1 ? '\n' : ' ');
+        }
+    }
+    return !ferror(fp);
+}
+
+/**************** seenset_load() ****************/
+/* see seenset.h for description */
+seenset_t* seenset_load(FILE* fp, const char* directory)
+{
+    char kind[16];
+    if (fp == NULL || fscanf(fp, "%15s", kind) != 1) {
+        return NULL;
+    }
+
+    if (strcmp(kind, "exact") == 0) {
+        long long size;
+        if (fscanf(fp, "%lld\n", &size) != 1) {
+            return NULL;
+        }
+        seenset_t* set = seenset_alloc_exact(directory);
+        char* pathname = (set == NULL) ? NULL : log_path(set);
+        if (pathname == NULL || truncate(pathname, size) != 0) {
+            fprintf(stderr, "Failed to restore the seen-set log in %s\n", directory);
+            free(pathname);
+            seenset_delete(set);
+            return NULL;
+        }
+
+        // read back the URLs logged by the checkpoint, then log on after them
+        FILE* log = fopen(pathname, "r");
+        char* url;
+        while (log != NULL && (url = file_readLine(log)) != NULL) {
+            hashtable_insert(set->table, url, "");
+            free(url);
+        }
+        if (log != NULL) {
+            fclose(log);
+        }
+        set->log = fopen(pathname, "a");
+        free(pathname);
+        if (set->log == NULL || fseeko(set->log, 0, SEEK_END) != 0) {
+            seenset_delete(set);
+            return NULL;
+        }
+        return set;
+    }
+
+    size_t budget;
+    int buckets;
+    if (strcmp(kind, "bounded") != 0
+        || fscanf(fp, "%zu %d", &budget, &buckets) != 2 || buckets != NUM_BUCKETS) {
+        return NULL;
+    }
+    seenset_t* set = seenset_alloc_bounded(directory, budget);
+    if (set == NULL) {
+        return NULL;
+    }
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        long long size;
+        char* pathname = bucket_path(set, b);
+        if (pathname == NULL || fscanf(fp, "%lld", &size) != 1
+            || truncate(pathname, size) != 0) {
+            fprintf(stderr, "Failed to restore seen-set bucket %d in %s\n", b, directory);
+            free(pathname);
+            seenset_delete(set);
+            return NULL;
+        }
+
+        // refill the filter with the URLs that survived
+        FILE* bucket = fopen(pathname, "r");
+        free(pathname);
+        char* url;
+        while (bucket != NULL && (url = file_readLine(bucket)) != NULL) {
+            bloom_testAndSet(set, hash1(url));
+            free(url);
+        }
+        if (bucket != NULL) {
+            fclose(bucket);
+        }
+    }
+    fscanf(fp, "\n");
+    return set;
+}
+
+/**************** seenset_delete() ****************/
+/* see seenset.h for description */
+void seenset_delete(seenset_t* set)
+{
+    if (set == NULL) {
+        return;
+    }
+    hashtable_delete(set->table, NULL);
+    if (set->log != NULL) {
+        fclose(set->log);
+    }
+    for (int b = 0; set->buckets != NULL && b < NUM_BUCKETS; b++) {
+        bucket_flush(set, b);
+        free(set->buckets[b].pending);
+        for (int i = 0; i < RECENT_URLS; i++) {
+            free(set->buckets[b].recent[i]);
+        }
+    }
+    free(set->buckets);
+    for (int i = 0; i < NUM_LOCKS; i++) {
+        pthread_mutex_destroy(&set->locks[i]);
+    }
+    free(set->directory);
+    free(set->bits);
+    free(set);
+}
+
+/**************** seenset_alloc_exact() ****************/
+/* Allocate an empty exact set, without its log, making the directory
+ * the log goes in (if one is given) but leaving any log in it as is.
+ */
+static seenset_t* seenset_alloc_exact(const char* directory)
+{
+    if (directory != NULL && !make_directory(directory)) {
+        return NULL;
+    }
+    seenset_t* set = calloc(1, sizeof(seenset_t));
+    if (set == NULL) {
+        return NULL;
+    }
+    set->table = hashtable_new(EXACT_SLOTS);
+    set->directory = (directory == NULL) ? NULL : malloc(strlen(directory) + 1);
+    if (set->table == NULL || (directory != NULL && set->directory == NULL)) {
+        hashtable_delete(set->table, NULL);
+        free(set->directory);
+        free(set);
+        return NULL;
+    }
+    if (directory != NULL) {
+        strcpy(set->directory, directory);
+    }
+    for (int i = 0; i < NUM_LOCKS; i++) {
+        pthread_mutex_init(&set->locks[i], NULL);
+    }
+    return set;
+}
+
+/**************** seenset_alloc_bounded() ****************/
+/* Allocate a bounded set with an empty filter, leaving the bucket files
+ * in the directory as they are.
+ */
+static seenset_t* seenset_alloc_bounded(const char* directory, const size_t budget)
+{
+    if (directory == NULL || budget < 1024 || !make_directory(directory)) {
+        return NULL;
+    }
+
+    seenset_t* set = calloc(1, sizeof(seenset_t));
+    if (set == NULL) {
+        return NULL;
+    }
+    set->directory = malloc(strlen(directory) + 1);
+    size_t words = budget / sizeof(uint64_t);
+    set->bits = calloc(words, sizeof(uint64_t));
+    set->buckets = calloc(NUM_BUCKETS, sizeof(bucket_t));
+    if (set->directory == NULL || set->bits == NULL || set->buckets == NULL) {
+        free(set->directory);
+        free(set->bits);
+        free(set->buckets);
+        free(set);
+        return NULL;
+    }
+    atomic_init(&set->writeFailed, false);
+    strcpy(set->directory, directory);
+    set->budget = budget;
+    set->numBits = words * 64;
+    for (int i = 0; i < NUM_LOCKS; i++) {
+        pthread_mutex_init(&set->locks[i], NULL);
+    }
+    return set;
+}
+
+/**************** make_directory() ****************/
+/* Create the directory unless it exists; return false if it cannot be */
+static bool make_directory(const char* directory)
+{
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create seen-set directory: %s\n", directory);
+        return false;
+    }
+    return true;
+}
+
+/**************** log_path() ****************/
+/* Return the malloc'd pathname of an exact set's log */
+static char* log_path(seenset_t* set)
+{
+    return get_pathname(set->directory, "urls");
+}
+
+/**************** hash1() ****************/
+/* 64-bit FNV-1a hash of the URL */
+static uint64_t hash1(const char* url)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*) url; *p != '\0'; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**************** hash2() ****************/
+/* Derive a second, independent hash from the first (splitmix64 finalizer);
+ * forced odd so the probe sequence visits distinct bits.
+ */
+static uint64_t hash2(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h | 1;
+}
+
+/**************** bloom_testAndSet() ****************/
+/* Set the URL's bits in the filter; return true if all were already set,
+ * that is, if the URL may have been inserted before.
+ * Uses double hashing (Kirsch and Mitzenmacher): probe i is h1 + i*h2.
+ */
+static bool bloom_testAndSet(seenset_t* set, uint64_t h)
+{
+    uint64_t step = hash2(h);
+    bool allSet = true;
+    for (int i = 0; i < NUM_HASHES; i++) {
+        uint64_t bit = (h + i * step) % set->numBits;
+        uint64_t mask = 1ULL << (bit % 64);
+        uint64_t old = atomic_fetch_or(&set->bits[bit / 64], mask);
+        if ((old & mask) == 0) {
+            allSet = false;
+        }
+    }
+    return allSet;
+}
+
+/**************** bucket_path() ****************/
+/* Return the malloc'd pathname of a bucket file */
+static char* bucket_path(seenset_t* set, int bucket)
+{
+    char filename[16];
+    snprintf(filename, sizeof(filename), "%d", bucket);
+    return get_pathname(set->directory, filename);
+}
+
+/**************** bucket_contains() ****************/
+/* Scan a bucket file, one URL per line, for the given URL, reading it
+ * SCAN_BYTES at a time; a line longer than that is passed over.
+ */
+static bool bucket_contains(const char* pathname, const char* url)
+{
+    int fd = open(pathname, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char buf[SCAN_BYTES];
+    size_t urlLen = strlen(url);
+    size_t have = 0;                // bytes in buf, a partial line first
+    bool found = false;
+    bool skipping = false;          // in a line longer than buf
+    ssize_t got;
+    while (!found && (got = read(fd, buf + have, sizeof(buf) - have)) > 0) {
+        have += got;
+        char* line = buf;
+        char* end;
+        while (!found && (end = memchr(line, '\n', buf + have - line)) != NULL) {
+            found = !skipping && (size_t) (end - line) == urlLen
+                    && memcmp(line, url, urlLen) == 0;
+            skipping = false;
+            line = end + 1;
+        }
+        have = buf + have - line;
+        if (have == sizeof(buf)) {
+            skipping = true;
+            have = 0;
+        }
+        memmove(buf, line, have);
+    }
+    close(fd);
+    return found;
+}
+
+/**************** bucket_append() ****************/
+/* Add a URL to a bucket's pending lines; return false if out of memory */
+static bool bucket_append(bucket_t* bk, const char* url)
+{
+    size_t len = strlen(url);
+    if (bk->pendingLen + len + 1 > bk->pendingSize) {
+        size_t size = (bk->pendingSize > 0) ? bk->pendingSize : PENDING_BYTES;
+        while (size < bk->pendingLen + len + 1) {
+            size *= 2;
+        }
+        char* bigger = realloc(bk->pending, size);
+        if (bigger == NULL) {
+            return false;
+        }
+        bk->pending = bigger;
+        bk->pendingSize = size;
+    }
+    memcpy(bk->pending + bk->pendingLen, url, len);
+    bk->pending[bk->pendingLen + len] = '\n';
+    bk->pendingLen += len + 1;
+    return true;
+}
+
+/**************** bucket_flush() ****************/
+/* Append a bucket's pending lines to its file, in one write. If that
+ * fails the lines are dropped (their pages may then be crawled twice)
+ * and the next seenset_save fails. Return false on error.
+ */
+static bool bucket_flush(seenset_t* set, int bucket)
+{
+    bucket_t* bk = &set->buckets[bucket];
+    if (bk->pendingLen == 0) {
+        return true;
+    }
+    char* pathname = bucket_path(set, bucket);
+    int fd = (pathname == NULL) ? -1 : open(pathname, O_WRONLY | O_APPEND);
+    size_t done = 0;
+    ssize_t put = 0;
+    while (fd >= 0 && done < bk->pendingLen
+           && (put = write(fd, bk->pending + done, bk->pendingLen - done)) > 0) {
+        done += put;
+    }
+    if (fd >= 0 && close(fd) != 0) {
+        done = 0;
+    }
+    bool ok = (done == bk->pendingLen);
+    if (!ok) {
+        fprintf(stderr, "Failed to write seen-set bucket: %s\n",
+                pathname != NULL ? pathname : set->directory);
+        atomic_store(&set->writeFailed, true);
+    }
+    free(pathname);
+    bk->pendingLen = 0;
+    return ok;
+}
+
+/**************** lines_contain() ****************/
+/* Return true if one of the lines of text is the given URL */
+static bool lines_contain(const char* text, size_t len, const char* url, size_t urlLen)
+{
+    const char* line = text;
+    const char* end;
+    while (line < text + len && (end = memchr(line, '\n', text + len - line)) != NULL) {
+        if ((size_t) (end - line) == urlLen && memcmp(line, url, urlLen) == 0) {
+            return true;
+        }
+        line = end + 1;
+    }
+    return false;
+}
+
+/**************** recent_find() ****************/
+/* Return true if the URL is one of the bucket's recent URLs */
+static bool recent_find(bucket_t* bk, uint64_t h, const char* url)
+{
+    for (int i = 0; i < RECENT_URLS; i++) {
+        if (bk->recentHash[i] == h && bk->recent[i] != NULL
+            && strcmp(bk->recent[i], url) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**************** recent_add() ****************/
+/* Remember a URL known to be in the set, in place of the bucket's
+ * oldest recent URL; if it cannot be copied, the slot is left empty.
+ */
+static void recent_add(bucket_t* bk, uint64_t h, const char* url)
+{
+    int i = bk->nextRecent;
+    free(bk->recent[i]);
+    bk->recent[i] = malloc(strlen(url) + 1);
+    if (bk->recent[i] != NULL) {
+        strcpy(bk->recent[i], url);
+    }
+    bk->recentHash[i] = h;
+    bk->nextRecent = (i + 1) % RECENT_URLS;
+}
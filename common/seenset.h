@@ -0,0 +1,132 @@
+/*
+ * seenset.h - header file for CS50 TSE seenset module
+ *
+ * A seenset records the normalized URLs a crawler has already queued.
+ * It comes in two flavors:
+ *
+ *   exact:   every URL is kept as a string in an in-memory hashtable;
+ *            fast, but memory grows with the crawl. For checkpoints,
+ *            each URL is also appended to a log file as it is inserted.
+ *   bounded: a Bloom filter over URL hashes, sized to a fixed RAM budget,
+ *            in front of an exact set kept on disk as hashed bucket files.
+ *            A URL the filter has never seen is new for certain; a URL
+ *            the filter may have seen is resolved against its bucket file,
+ *            so false positives never drop a page from the crawl.
+ *            Each bucket also keeps in memory the URLs added to it but
+ *            not yet written (up to 4KB, then written at once) and the
+ *            8 URLs it was last asked about, so a link that recurs on
+ *            page after page costs no file access; that is about 5MB
+ *            beyond the budget at most.
+ *
+ * Both flavors are safe to use from several crawler threads at once.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#ifndef __SEENSET_H
+#define __SEENSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**************** global types ****************/
+typedef struct seenset seenset_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** seenset_new ****************/
+/* Create a new (empty) exact seenset held in memory.
+ *
+ * Caller provides:
+ *   a writable directory to hold the set's log, named "urls" (the
+ *   directory is created if missing, and any log already in it is
+ *   emptied); or NULL for a set that is never saved.
+ * We return:
+ *   pointer to a new seenset, or NULL if error.
+ * Caller is responsible for:
+ *   later calling seenset_delete.
+ */
+seenset_t* seenset_new(const char* directory);
+
+/**************** seenset_new_bounded ****************/
+/* Create a new (empty) bounded seenset.
+ *
+ * Caller provides:
+ *   a writable directory to hold the on-disk exact set (it is created
+ *   if missing, and any bucket files already in it are emptied), and
+ *   the number of bytes of RAM the Bloom filter may use (>= 1024).
+ * We return:
+ *   pointer to a new seenset, or NULL if error.
+ * Caller is responsible for:
+ *   later calling seenset_delete.
+ * Notes:
+ *   With 7 hash functions, the false-positive rate per MB of budget is
+ *   about 0.05% at 500,000 URLs, 0.65% at 800,000, 1.9% at 1,000,000
+ *   and 9.5% at 1,500,000 (it scales with the budget): near 1% until
+ *   about budget*8/10 URLs. Each false positive, like each URL really
+ *   seen before but not among its bucket's recent ones, costs one scan
+ *   of a bucket file, which holds about 1/1024 of the URLs.
+ */
+seenset_t* seenset_new_bounded(const char* directory, const size_t budget);
+
+/**************** seenset_insert ****************/
+/* Add a URL to the set unless it is already there.
+ *
+ * Caller provides:
+ *   a valid seenset and a non-NULL url.
+ * We return:
+ *   true if the url was not in the set and has now been added;
+ *   false if it was already in the set, or on error.
+ * Notes:
+ *   The test and the insert happen atomically with respect to other
+ *   threads inserting the same url. The url string is copied.
+ */
+bool seenset_insert(seenset_t* set, const char* url);
+
+/**************** seenset_save ****************/
+/* Write a checkpoint of the set to an open file.
+ *
+ * Caller provides:
+ *   a valid seenset and a FILE open for writing.
+ * We do:
+ *   exact sets: sync the log to disk and write "exact size", the size
+ *   of the log.
+ *   bounded sets: write "bounded budget buckets" and then the current
+ *   size of every bucket file on one line.
+ *   Either way the URLs themselves are already on disk, so a checkpoint
+ *   costs the same however many URLs the set holds.
+ * We return:
+ *   true on success, false on a write error or for an exact set made
+ *   without a directory.
+ * Caller is responsible for:
+ *   making sure no thread inserts while the checkpoint is written.
+ */
+bool seenset_save(seenset_t* set, FILE* fp);
+
+/**************** seenset_load ****************/
+/* Rebuild a set from a checkpoint written by seenset_save.
+ *
+ * Caller provides:
+ *   a FILE positioned at the checkpoint, and the same directory that
+ *   held the log or buckets when the checkpoint was taken.
+ * We do:
+ *   cut the log, or every bucket file, back to its checkpointed size
+ *   (dropping URLs queued after the checkpoint, whose pages were lost
+ *   with the frontier), then for exact sets read the log's URLs back
+ *   into memory, and for bounded sets refill the Bloom filter from the
+ *   buckets.
+ * We return:
+ *   the rebuilt set, or NULL if the checkpoint is malformed or on error.
+ * Caller is responsible for:
+ *   later calling seenset_delete.
+ */
+seenset_t* seenset_load(FILE* fp, const char* directory);
+
+/**************** seenset_delete ****************/
+/* Delete the seenset and free its memory; the log of an exact seenset
+ * and the buckets of a bounded one are left in place.
+ */
+void seenset_delete(seenset_t* set);
+
+#endif // __SEENSET_H
@@ -0,0 +1,242 @@
+/*
+ * simhash.c - CS50 TSE simhash module
+ *
+ * see simhash.h for more information.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include "../libcs50/webpage.h"
+#include "simhash.h"
+
+/**************** global types ****************/
+typedef struct simhash {
+    int32_t votes[64];          // per bit: pairs with it set minus clear
+    uint64_t previous;          // hash of the last word, for the next pair
+    long words;                 // words added
+} simhash_t;
+
+/* one fingerprint in one band's chain */
+typedef struct fpentry {
+    uint64_t fingerprint;
+    int docID;
+    struct fpentry* next;
+} fpentry_t;
+
+#define NUM_BANDS (SIMHASH_DISTANCE + 1)
+#define NUM_CHAINS (1 << 16)        // per band; band values share chains
+typedef struct fpindex {
+    fpentry_t** bands[NUM_BANDS];   // per band: chains by band value
+} fpindex_t;
+
+/**************** local functions ****************/
+static uint64_t wordHash(const char* word);
+static uint64_t mix(uint64_t h);
+static int bandValue(const uint64_t fingerprint, const int band);
+
+static const long MIN_WORDS = 32;       // fewer words cannot be fingerprinted
+static const int BAND_BITS = 64 / NUM_BANDS;  // any leftover bits are in no band
+
+/**************** simhash_new() ****************/
+/* see simhash.h for description */
+simhash_t* simhash_new(void)
+{
+    return calloc(1, sizeof(simhash_t));
+}
+
+/**************** simhash_add() ****************/
+/* see simhash.h for description */
+void simhash_add(simhash_t* sh, const char* word)
+{
+    if (sh == NULL || word == NULL || strlen(word) < 3) {
+        return;
+    }
+    uint64_t h = wordHash(word);
+    if (sh->words++ > 0) {
+        // the pair (previous, this): order matters, so no plain xor
+        uint64_t pair = mix(sh->previous * 31 + h);
+        for (int i = 0; i < 64; i++) {
+            sh->votes[i] += ((pair >> i) & 1) ? 1 : -1;
+        }
+    }
+    sh->previous = h;
+}
+
+/**************** simhash_value() ****************/
+/* see simhash.h for description */
+bool simhash_value(simhash_t* sh, uint64_t* fingerprint)
+{
+    if (sh == NULL || fingerprint == NULL || sh->words < MIN_WORDS) {
+        return false;
+    }
+    uint64_t fp = 0;
+    for (int i = 0; i < 64; i++) {
+        if (sh->votes[i] > 0) {
+            fp |= 1ULL << i;
+        }
+    }
+    *fingerprint = fp;
+    return true;
+}
+
+/**************** simhash_delete() ****************/
+/* see simhash.h for description */
+void simhash_delete(simhash_t* sh)
+{
+    free(sh);
+}
+
+/**************** simhash_page() ****************/
+/* see simhash.h for description */
+bool simhash_page(webpage_t* page, uint64_t* fingerprint)
+{
+    simhash_t* sh = simhash_new();
+    if (sh == NULL || page == NULL) {
+        simhash_delete(sh);
+        return false;
+    }
+    int pos = 0;
+    char* word;
+    while ((word = webpage_getNextWord(page, &pos)) != NULL) {
+        simhash_add(sh, word);
+        free(word);
+    }
+    bool ok = simhash_value(sh, fingerprint);
+    simhash_delete(sh);
+    return ok;
+}
+
+/**************** simhash_distance() ****************/
+/* see simhash.h for description */
+int simhash_distance(const uint64_t a, const uint64_t b)
+{
+    uint64_t x = a ^ b;
+    int bits = 0;
+    while (x != 0) {
+        x &= x - 1;
+        bits++;
+    }
+    return bits;
+}
+
+/**************** fpindex_new() ****************/
+/* see simhash.h for description */
+fpindex_t* fpindex_new(void)
+{
+    fpindex_t* index = calloc(1, sizeof(fpindex_t));
+    if (index == NULL) {
+        return NULL;
+    }
+    for (int b = 0; b < NUM_BANDS; b++) {
+        index->bands[b] = calloc(NUM_CHAINS, sizeof(fpentry_t*));
+        if (index->bands[b] == NULL) {
+            fpindex_delete(index);
+            return NULL;
+        }
+    }
+    return index;
+}
+
+/**************** fpindex_find() ****************/
+/* see simhash.h for description */
+int fpindex_find(fpindex_t* index, const uint64_t fingerprint)
+{
+    if (index == NULL) {
+        return 0;
+    }
+    int found = 0;
+    for (int b = 0; b < NUM_BANDS; b++) {
+        for (fpentry_t* e = index->bands[b][bandValue(fingerprint, b)]; e != NULL; e = e->next) {
+            if ((found == 0 || e->docID < found)
+                && simhash_distance(e->fingerprint, fingerprint) <= SIMHASH_DISTANCE) {
+                found = e->docID;
+            }
+        }
+    }
+    return found;
+}
+
+/**************** fpindex_insert() ****************/
+/* see simhash.h for description */
+bool fpindex_insert(fpindex_t* index, const uint64_t fingerprint, const int docID)
+{
+    if (index == NULL || docID <= 0) {
+        return false;
+    }
+    for (int b = 0; b < NUM_BANDS; b++) {
+        fpentry_t* e = malloc(sizeof(fpentry_t));
+        if (e == NULL) {
+            return false;
+        }
+        fpentry_t** chain = &index->bands[b][bandValue(fingerprint, b)];
+        e->fingerprint = fingerprint;
+        e->docID = docID;
+        e->next = *chain;
+        *chain = e;
+    }
+    return true;
+}
+
+/**************** fpindex_delete() ****************/
+/* see simhash.h for description */
+void fpindex_delete(fpindex_t* index)
+{
+    if (index == NULL) {
+        return;
+    }
+    for (int b = 0; b < NUM_BANDS; b++) {
+        if (index->bands[b] == NULL) {
+            continue;
+        }
+        for (int v = 0; v < NUM_CHAINS; v++) {
+            fpentry_t* e = index->bands[b][v];
+            while (e != NULL) {
+                fpentry_t* next = e->next;
+                free(e);
+                e = next;
+            }
+        }
+        free(index->bands[b]);
+    }
+    free(index);
+}
+
+/**************** wordHash() ****************/
+/* 64-bit FNV-1a hash of the lowercased word */
+static uint64_t wordHash(const char* word)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*) word; *p != '\0'; p++) {
+        h ^= tolower(*p);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**************** mix() ****************/
+/* Spread a hash's entropy over all 64 bits (splitmix64 finalizer), so
+ * every bit of the fingerprint gets an unbiased vote.
+ */
+static uint64_t mix(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+/**************** bandValue() ****************/
+/* Return the chain for the given band (BAND_BITS bits) of a fingerprint */
+static int bandValue(const uint64_t fingerprint, const int band)
+{
+    uint64_t value = (fingerprint >> (band * BAND_BITS)) & ((1ULL << BAND_BITS) - 1);
+    return mix(value) % NUM_CHAINS;
+}
@@ -0,0 +1,97 @@
+/*
+ * simhash.h - header file for CS50 TSE simhash module
+ *
+ * The simhash module finds pages whose text is nearly the same, such as
+ * one page mirrored under several URLs. A page's fingerprint is a 64-bit
+ * SimHash (Charikar) of its words, taken as overlapping pairs so word
+ * order counts: each pair is hashed, and bit i of the fingerprint is set
+ * if more pairs have bit i set than clear. Pages that differ in a few
+ * words get fingerprints that differ in a few bits, so two pages are
+ * near-duplicates if their fingerprints are at most SIMHASH_DISTANCE
+ * bits apart.
+ *
+ * Words are found as the indexer finds them: webpage_getNextWord (or
+ * the scanner module) splits the text, words under three letters are
+ * skipped, and the rest are lowercased.
+ *
+ * A fingerprint index holds the fingerprints of pages seen so far and
+ * finds any within SIMHASH_DISTANCE bits of a new one without comparing
+ * against them all: it splits each fingerprint into SIMHASH_DISTANCE + 1
+ * bands, and two fingerprints that close must agree exactly on at least
+ * one band (Manku, Jain and Das Sarma), so only pages sharing a band
+ * with the new one are compared. Nothing here locks; threads sharing an
+ * index must hold their own lock across fpindex_find and fpindex_insert.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#ifndef __SIMHASH_H
+#define __SIMHASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../libcs50/webpage.h"
+
+/* most bits two near-duplicate fingerprints may differ in */
+#define SIMHASH_DISTANCE 2
+
+/**************** global types ****************/
+typedef struct simhash simhash_t;  // opaque to users of the module
+typedef struct fpindex fpindex_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** simhash_new ****************/
+/* Create a fingerprint accumulator for one page, with no words yet.
+ * We return NULL on error. Caller is responsible for simhash_delete.
+ */
+simhash_t* simhash_new(void);
+
+/**************** simhash_add ****************/
+/* Add the page's next word (as split from the text, in any case). */
+void simhash_add(simhash_t* sh, const char* word);
+
+/**************** simhash_value ****************/
+/* Compute the page's fingerprint.
+ *
+ * We return:
+ *   true and set *fingerprint if the page had enough words to fingerprint
+ *   reliably; false if it had too few (say, an error page or a frame),
+ *   in which case it should not be treated as anyone's duplicate.
+ */
+bool simhash_value(simhash_t* sh, uint64_t* fingerprint);
+
+/**************** simhash_delete ****************/
+/* Delete the accumulator. */
+void simhash_delete(simhash_t* sh);
+
+/**************** simhash_page ****************/
+/* Fingerprint a loaded page's HTML; return as for simhash_value. */
+bool simhash_page(webpage_t* page, uint64_t* fingerprint);
+
+/**************** simhash_distance ****************/
+/* Return the number of bits in which two fingerprints differ. */
+int simhash_distance(const uint64_t a, const uint64_t b);
+
+/**************** fpindex_new ****************/
+/* Create an empty fingerprint index; NULL on error.
+ * Caller is responsible for fpindex_delete.
+ */
+fpindex_t* fpindex_new(void);
+
+/**************** fpindex_find ****************/
+/* Return the docID of a page in the index whose fingerprint is within
+ * SIMHASH_DISTANCE bits of the given one (the earliest added, if
+ * several), or 0 if there is none.
+ */
+int fpindex_find(fpindex_t* index, const uint64_t fingerprint);
+
+/**************** fpindex_insert ****************/
+/* Add a page's fingerprint; return false on error. */
+bool fpindex_insert(fpindex_t* index, const uint64_t fingerprint, const int docID);
+
+/**************** fpindex_delete ****************/
+/* Delete the index. */
+void fpindex_delete(fpindex_t* index);
+
+#endif // __SIMHASH_H
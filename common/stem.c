@@ -0,0 +1,285 @@
+/*
+ * stem.c - CS50 TSE stem module
+ *
+ * see stem.h for more information.
+ *
+ * Porter describes a word as [C](VC)^m[V], where C is a run of
+ * consonants and V a run of vowels; its "measure" m counts the VC
+ * pairs. Each step below strips or rewrites a suffix, most only when
+ * what is left has a large enough measure. The steps follow the
+ * published algorithm, with none of the later departures.
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "stem.h"
+
+/**************** local types ****************/
+typedef struct stemmer {
+    char* b;       // the word being stemmed
+    int k;         // index of its last letter
+    int j;         // index of the last letter before a suffix found by ends()
+} stemmer_t;
+
+/**************** local functions ****************/
+static bool isConsonant(const stemmer_t* z, const int i);
+static int measure(const stemmer_t* z);
+static bool vowelInStem(const stemmer_t* z);
+static bool doubleConsonant(const stemmer_t* z, const int i);
+static bool cvc(const stemmer_t* z, const int i);
+static bool ends(stemmer_t* z, const char* suffix);
+static void setTo(stemmer_t* z, const char* s);
+static void replace(stemmer_t* z, const char* s);
+static void step1ab(stemmer_t* z);
+static void step1c(stemmer_t* z);
+static void step2(stemmer_t* z);
+static void step3(stemmer_t* z);
+static void step4(stemmer_t* z);
+static void step5(stemmer_t* z);
+
+/**************** stem() ****************/
+/* see stem.h for description */
+int stem(char* word, const int len)
+{
+    if (len <= 2) {
+        return len;   // nothing to strip
+    }
+    stemmer_t z = {word, len - 1, 0};
+    step1ab(&z);
+    if (z.k > 0) {
+        step1c(&z);
+        step2(&z);
+        step3(&z);
+        step4(&z);
+        step5(&z);
+    }
+    return z.k + 1;
+}
+
+/**************** isConsonant() ****************/
+/* Is b[i] a consonant? 'y' is one unless it follows a consonant. */
+static bool isConsonant(const stemmer_t* z, const int i)
+{
+    switch (z->b[i]) {
+        case 'a': case 'e': case 'i': case 'o': case 'u':
+            return false;
+        case 'y':
+            return (i == 0) ? true : !isConsonant(z, i - 1);
+        default:
+            return true;
+    }
+}
+
+/**************** measure() ****************/
+/* The measure of b[0 .. j]: its number of vowel-consonant pairs. */
+static int measure(const stemmer_t* z)
+{
+    int m = 0;
+    bool vowel = false;   // was the letter before a vowel?
+    for (int i = 0; i <= z->j; i++) {
+        bool consonant = isConsonant(z, i);
+        if (consonant && vowel) {
+            m++;
+        }
+        vowel = !consonant;
+    }
+    return m;
+}
+
+/**************** vowelInStem() ****************/
+/* Does b[0 .. j] hold a vowel? */
+static bool vowelInStem(const stemmer_t* z)
+{
+    for (int i = 0; i <= z->j; i++) {
+        if (!isConsonant(z, i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**************** doubleConsonant() ****************/
+/* Are b[i - 1] and b[i] the same consonant? */
+static bool doubleConsonant(const stemmer_t* z, const int i)
+{
+    return i >= 1 && z->b[i] == z->b[i - 1] && isConsonant(z, i);
+}
+
+/**************** cvc() ****************/
+/* Do b[i - 2 .. i] run consonant, vowel, consonant, the last not w, x
+ * or y? Such stems, like "hop" or "fil", get back the 'e' they lost.
+ */
+static bool cvc(const stemmer_t* z, const int i)
+{
+    if (i < 2 || !isConsonant(z, i) || isConsonant(z, i - 1) || !isConsonant(z, i - 2)) {
+        return false;
+    }
+    char ch = z->b[i];
+    return ch != 'w' && ch != 'x' && ch != 'y';
+}
+
+/**************** ends() ****************/
+/* Does b[0 .. k] end with suffix? If so, j is set to the letter before it. */
+static bool ends(stemmer_t* z, const char* suffix)
+{
+    int length = strlen(suffix);
+    if (length > z->k + 1 || memcmp(z->b + z->k - length + 1, suffix, length) != 0) {
+        return false;
+    }
+    z->j = z->k - length;
+    return true;
+}
+
+/**************** setTo() ****************/
+/* Replace b[j + 1 .. k] with s. */
+static void setTo(stemmer_t* z, const char* s)
+{
+    int length = strlen(s);
+    memcpy(z->b + z->j + 1, s, length);
+    z->k = z->j + length;
+}
+
+/**************** replace() ****************/
+/* Replace the suffix found by ends() with s if the stem's measure is positive. */
+static void replace(stemmer_t* z, const char* s)
+{
+    if (measure(z) > 0) {
+        setTo(z, s);
+    }
+}
+
+/**************** step1ab() ****************/
+/* Remove plurals and -ed or -ing:
+ *   caresses -> caress, ponies -> poni, cats -> cat, feed -> feed,
+ *   agreed -> agree, plastered -> plaster, motoring -> motor,
+ *   hopping -> hop, filing -> file, sizing -> size.
+ */
+static void step1ab(stemmer_t* z)
+{
+    if (z->b[z->k] == 's') {
+        if (ends(z, "sses")) {
+            z->k -= 2;
+        } else if (ends(z, "ies")) {
+            setTo(z, "i");
+        } else if (z->b[z->k - 1] != 's') {
+            z->k--;
+        }
+    }
+    if (ends(z, "eed")) {
+        if (measure(z) > 0) {
+            z->k--;
+        }
+    } else if ((ends(z, "ed") || ends(z, "ing")) && vowelInStem(z)) {
+        z->k = z->j;
+        if (ends(z, "at")) {
+            setTo(z, "ate");
+        } else if (ends(z, "bl")) {
+            setTo(z, "ble");
+        } else if (ends(z, "iz")) {
+            setTo(z, "ize");
+        } else if (doubleConsonant(z, z->k)) {
+            char ch = z->b[z->k];
+            if (ch != 'l' && ch != 's' && ch != 'z') {
+                z->k--;
+            }
+        } else if (measure(z) == 1 && cvc(z, z->k)) {
+            z->j = z->k;
+            setTo(z, "e");
+        }
+    }
+}
+
+/**************** step1c() ****************/
+/* Turn a final 'y' into 'i' when there is a vowel before it: happy -> happi. */
+static void step1c(stemmer_t* z)
+{
+    if (ends(z, "y") && vowelInStem(z)) {
+        z->b[z->k] = 'i';
+    }
+}
+
+/**************** step2() ****************/
+/* Map double suffixes to single ones: -ization (-ize plus -ation) to
+ * -ize, and so on, when the stem's measure is positive. The cases are
+ * picked by the second last letter.
+ */
+static void step2(stemmer_t* z)
+{
+    static const char* const rules[][2] = {
+        {"ational", "ate"}, {"tional", "tion"}, {"enci", "ence"}, {"anci", "ance"},
+        {"izer", "ize"}, {"abli", "able"}, {"alli", "al"}, {"entli", "ent"},
+        {"eli", "e"}, {"ousli", "ous"}, {"ization", "ize"}, {"ation", "ate"},
+        {"ator", "ate"}, {"alism", "al"}, {"iveness", "ive"}, {"fulness", "ful"},
+        {"ousness", "ous"}, {"aliti", "al"}, {"iviti", "ive"}, {"biliti", "ble"},
+    };
+    char penultimate = z->b[z->k - 1];
+    for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); i++) {
+        const char* suffix = rules[i][0];
+        if (suffix[strlen(suffix) - 2] == penultimate && ends(z, suffix)) {
+            replace(z, rules[i][1]);
+            return;
+        }
+    }
+}
+
+/**************** step3() ****************/
+/* Deal with -ic-, -full, -ness and the like, as step2 does. */
+static void step3(stemmer_t* z)
+{
+    static const char* const rules[][2] = {
+        {"icate", "ic"}, {"ative", ""}, {"alize", "al"}, {"iciti", "ic"},
+        {"ical", "ic"}, {"ful", ""}, {"ness", ""},
+    };
+    for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); i++) {
+        if (ends(z, rules[i][0])) {
+            replace(z, rules[i][1]);
+            return;
+        }
+    }
+}
+
+/**************** step4() ****************/
+/* Take off -ant, -ence and the like from a stem of measure above one. */
+static void step4(stemmer_t* z)
+{
+    static const char* const suffixes[] = {
+        "al", "ance", "ence", "er", "ic", "able", "ible", "ant", "ement",
+        "ment", "ent", "ion", "ou", "ism", "ate", "iti", "ous", "ive", "ize",
+    };
+    char penultimate = z->b[z->k - 1];
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        const char* suffix = suffixes[i];
+        if (suffix[strlen(suffix) - 2] != penultimate || !ends(z, suffix)) {
+            continue;
+        }
+        // -ion only goes after s or t
+        if (strcmp(suffix, "ion") == 0
+            && (z->j < 0 || (z->b[z->j] != 's' && z->b[z->j] != 't'))) {
+            continue;
+        }
+        if (measure(z) > 1) {
+            z->k = z->j;
+        }
+        return;
+    }
+}
+
+/**************** step5() ****************/
+/* Remove a final -e from a stem of measure above one (or of one, if it
+ * does not end consonant-vowel-consonant), and -ll to -l likewise.
+ */
+static void step5(stemmer_t* z)
+{
+    z->j = z->k;
+    if (z->b[z->k] == 'e') {
+        int m = measure(z);
+        if (m > 1 || (m == 1 && !cvc(z, z->k - 1))) {
+            z->k--;
+        }
+    }
+    if (z->b[z->k] == 'l' && doubleConsonant(z, z->k) && measure(z) > 1) {
+        z->k--;
+    }
+}
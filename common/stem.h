@@ -0,0 +1,30 @@
+/*
+ * stem.h - header file for CS50 TSE stem module
+ *
+ * The stem module reduces an English word to its stem with Porter's
+ * algorithm (M.F. Porter, "An algorithm for suffix stripping", 1980),
+ * so that "searching", "searched" and "searches" are all indexed and
+ * queried as "search". A stem need not be a word itself: "computer"
+ * and "computing" both become "comput".
+ *
+ * Manzi Fabrice Niyigaba, November 2024
+ */
+
+#ifndef __STEM_H
+#define __STEM_H
+
+/**************** functions ****************/
+
+/**************** stem ****************/
+/* Stem a word in place.
+ *
+ * Caller provides:
+ *   a word of len lowercase letters (a-z); it need not end in '\0'.
+ * We return:
+ *   the length of its stem, which is word[0 .. length - 1]; the stem
+ *   is never longer than the word. Nothing is written past it, so a
+ *   caller that wants a string sets word[length] = '\0' itself.
+ */
+int stem(char* word, const int len);
+
+#endif // __STEM_H
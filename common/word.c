@@ -5,13 +5,29 @@
  */
 #include <ctype.h>
 #include "word.h"
+#include "stem.h"
+#include "safefile.h"
+#include "../libcs50/hashtable.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <pthread.h>
+
+/**************** local types ****************/
+struct wordnorm {
+    int stages;              // stages after lowercasing
+    hashtable_t* memo;       // lowercased word -> its stem
+    int num_memo;            // stems in memo, at most WORD_MEMO
+    pthread_mutex_t lock;    // guards memo and num_memo
+};
 
 // Function prototype
 char* normalize(const char* word);
+static char* normPath(const char* indexFilename);
+
+static const char* SUFFIX = ".norm";
+static const int MEMO_SLOTS = 16384;   // hashtable slots for remembered stems
 
 
 
@@ -30,3 +46,143 @@ char* normalize(const char* word){
     normalized[length] = '\0';
     return normalized;
 }
+
+/**************** wordnorm_new() ****************/
+/* see word.h for description */
+wordnorm_t* wordnorm_new(const int stages)
+{
+    if ((stages & ~WORD_STEM) != 0) {
+        return NULL;
+    }
+    wordnorm_t* norm = calloc(1, sizeof(wordnorm_t));
+    if (norm == NULL) {
+        return NULL;
+    }
+    norm->stages = stages;
+    if ((stages & WORD_STEM) != 0 && (norm->memo = hashtable_new(MEMO_SLOTS)) == NULL) {
+        free(norm);
+        return NULL;
+    }
+    pthread_mutex_init(&norm->lock, NULL);
+    return norm;
+}
+
+/**************** wordnorm_stages() ****************/
+/* see word.h for description */
+int wordnorm_stages(const wordnorm_t* norm)
+{
+    return (norm == NULL) ? 0 : norm->stages;
+}
+
+/**************** wordnorm_apply() ****************/
+/* see word.h for description */
+char* wordnorm_apply(wordnorm_t* norm, const char* word)
+{
+    char* lower = normalize(word);
+    if (lower == NULL || norm == NULL || (norm->stages & WORD_STEM) == 0) {
+        return lower;
+    }
+
+    // a stem is never longer than its word, so it fits in lower
+    pthread_mutex_lock(&norm->lock);
+    const char* known = hashtable_find(norm->memo, lower);
+    if (known != NULL) {
+        strcpy(lower, known);
+    }
+    pthread_mutex_unlock(&norm->lock);
+    if (known != NULL) {
+        return lower;
+    }
+
+    // first time: stem a copy, and remember it while there is room
+    int length = strlen(lower);
+    char* stemmed = malloc(length + 1);
+    if (stemmed == NULL) {
+        free(lower);
+        return NULL;
+    }
+    memcpy(stemmed, lower, length);
+    stemmed[stem(stemmed, length)] = '\0';
+    pthread_mutex_lock(&norm->lock);
+    bool kept = norm->num_memo < WORD_MEMO && hashtable_insert(norm->memo, lower, stemmed);
+    if (kept) {
+        norm->num_memo++;
+    }
+    pthread_mutex_unlock(&norm->lock);
+    strcpy(lower, stemmed);   // remembered stems are never changed or freed
+    if (!kept) {
+        free(stemmed);
+    }
+    return lower;
+}
+
+/**************** wordnorm_save() ****************/
+/* see word.h for description */
+bool wordnorm_save(const wordnorm_t* norm, const char* indexFilename)
+{
+    char* pathname = normPath(indexFilename);
+    FILE* fp = (pathname == NULL) ? NULL : safefile_open(pathname, "w");
+    if (fp == NULL) {
+        free(pathname);
+        return false;
+    }
+    fprintf(fp, "lower%s\n", (wordnorm_stages(norm) & WORD_STEM) ? " stem" : "");
+    bool ok = safefile_close(fp, pathname, true);
+    free(pathname);
+    return ok;
+}
+
+/**************** wordnorm_load() ****************/
+/* see word.h for description */
+wordnorm_t* wordnorm_load(const char* indexFilename)
+{
+    char* pathname = normPath(indexFilename);
+    if (pathname == NULL) {
+        return NULL;
+    }
+    FILE* fp = fopen(pathname, "r");
+    free(pathname);
+    if (fp == NULL) {
+        return wordnorm_new(0);       // an index from before pipelines
+    }
+    char stage[16];
+    int stages = 0;
+    bool ok = (fscanf(fp, "%15s", stage) == 1 && strcmp(stage, "lower") == 0);
+    while (ok && fscanf(fp, "%15s", stage) == 1) {
+        if (strcmp(stage, "stem") == 0) {
+            stages |= WORD_STEM;
+        } else {
+            ok = false;
+        }
+    }
+    fclose(fp);
+    return ok ? wordnorm_new(stages) : NULL;
+}
+
+/**************** wordnorm_delete() ****************/
+/* see word.h for description */
+void wordnorm_delete(wordnorm_t* norm)
+{
+    if (norm != NULL) {
+        hashtable_delete(norm->memo, free);
+        pthread_mutex_destroy(&norm->lock);
+        free(norm);
+    }
+}
+
+/**************** normPath() ****************/
+/* Return the pathname of the pipeline file for indexFilename, malloc'd;
+ * NULL on error.
+ */
+static char* normPath(const char* indexFilename)
+{
+    if (indexFilename == NULL) {
+        return NULL;
+    }
+    char* pathname = malloc(strlen(indexFilename) + strlen(SUFFIX) + 1);
+    if (pathname != NULL) {
+        strcpy(pathname, indexFilename);
+        strcat(pathname, SUFFIX);
+    }
+    return pathname;
+}
@@ -4,6 +4,20 @@
  * The word module provides a function to normalize words by converting
  * them to lowercase, making word comparisons case-insensitive.
  *
+ * It also provides a normalization pipeline, wordnorm_t, which the
+ * indexer and the querier both run every word through so they agree on
+ * what a word is: always lowercasing, then, if the pipeline has the
+ * WORD_STEM stage, Porter stemming (see stem.h). Stemming a word costs
+ * far more than lowercasing it, and the same few thousand words make
+ * up most of any text, so a pipeline remembers the stem of each
+ * lowercased word it has seen (up to WORD_MEMO of them) and only
+ * stems a word the first time.
+ *
+ * The indexer saves its pipeline beside the index, in a file named for
+ * the index with ".norm" appended, holding one line: the names of the
+ * stages, "lower" and then "stem" if it stems, separated by spaces.
+ * An index with no such file was only lowercased.
+ *
  * Manzi Fabrice Niyigaba, October 2024
  */
 
@@ -11,6 +25,13 @@
 #define __WORD_H
 
 #include <stddef.h>
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct wordnorm wordnorm_t;  // opaque to users of the module
+
+#define WORD_STEM 1          // stage: Porter stemming after lowercasing
+#define WORD_MEMO 65536      // most stems a pipeline remembers
 
 /**************** functions ****************/
 
@@ -30,4 +51,53 @@
  */
 char* normalize(const char* word);
 
+/**************** wordnorm_new ****************/
+/* Create a pipeline that lowercases words and runs the given stages
+ * (0, or WORD_STEM) after; NULL on error.
+ * Caller is responsible for wordnorm_delete.
+ */
+wordnorm_t* wordnorm_new(const int stages);
+
+/**************** wordnorm_stages ****************/
+/* Return the stages the pipeline runs after lowercasing (0 if norm is NULL). */
+int wordnorm_stages(const wordnorm_t* norm);
+
+/**************** wordnorm_apply ****************/
+/* Normalizes a word through the pipeline.
+ *
+ * Caller provides:
+ *   a valid word of letters; a NULL norm just lowercases, as normalize.
+ * We return:
+ *   a newly allocated string holding the normalized word, or NULL if
+ *   memory allocation fails.
+ * Caller is responsible for:
+ *   freeing the returned string when done.
+ * Notes:
+ *   Any number of threads may apply one pipeline at once; the
+ *   remembered stems are shared under a lock.
+ */
+char* wordnorm_apply(wordnorm_t* norm, const char* word);
+
+/**************** wordnorm_save ****************/
+/* Write the pipeline's stages beside the index file indexFilename.
+ *
+ * We return:
+ *   false if the file could not be written.
+ */
+bool wordnorm_save(const wordnorm_t* norm, const char* indexFilename);
+
+/**************** wordnorm_load ****************/
+/* Read the pipeline saved beside the index file indexFilename.
+ *
+ * We return:
+ *   the pipeline (one that only lowercases if there is no file), or
+ *   NULL if the file is malformed or names a stage we do not know.
+ *   Caller is responsible for wordnorm_delete.
+ */
+wordnorm_t* wordnorm_load(const char* indexFilename);
+
+/**************** wordnorm_delete ****************/
+/* Delete the pipeline and the stems it remembers. */
+void wordnorm_delete(wordnorm_t* norm);
+
 #endif // __WORD_H
@@ -0,0 +1,1005 @@
+/*
+ * crawler.c - CS50 crawler module
+ *
+ * Manzi Fabrice Niyigaba October 20 2024
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../libcs50/webpage.h"
+#include "../libcs50/file.h"
+#include "../common/pagedir.h"
+#include "../common/frontier.h"
+#include "../common/seenset.h"
+#include "../common/fetcher.h"
+#include "../common/scanner.h"
+#include "../common/simhash.h"
+# include "crawler.h"
+
+/**************** local types ****************/
+/* state shared by all crawl workers */
+typedef struct crawlstate {
+    char* pageDirectory;          // where to save pages
+    int maxDepth;                 // do not scan pages at this depth
+    frontier_t* pagesToCrawl;     // pages not yet fetched
+    seenset_t* pagesSeen;         // normalized URLs already queued
+    atomic_int id;                // last docID handed out
+    int checkpointEvery;          // pages between checkpoints, 0 for never
+    atomic_int lastCheckpoint;    // value of id at the last checkpoint
+    pthread_mutex_t gateLock;     // guards active and pausing
+    pthread_cond_t gateCond;      // signalled when either changes
+    int active;                   // workers holding a page
+    bool pausing;                 // a checkpoint is waiting for quiet
+    bool compress;                // save pages compressed
+    fpindex_t* fingerprints;      // of the pages saved (NULL without --dedup)
+    pthread_mutex_t dupLock;      // guards fingerprints and .duplicates
+} crawlstate_t;
+
+/* one crawl worker thread */
+typedef struct worker {
+    crawlstate_t* state;          // shared crawl state
+    int num;                      // worker number, for the frontier
+    pthread_t thread;             // the thread running crawlWorker
+} worker_t;
+
+/* one page being fetched: where its body goes, and what scanning it
+ * found, held until the page is saved */
+typedef struct pagework {
+    crawlstate_t* state;          // shared crawl state
+    webpage_t* page;              // the page's URL and depth
+    int worker;                   // frontier part to push links to
+    pagewriter_t* writer;         // the page file being written
+    scanner_t* scanner;           // NULL if neither links nor words are wanted
+    simhash_t* simhash;           // the page's fingerprint (NULL without --dedup)
+    char* links;                  // internal URLs found, each ending in '\0'
+    size_t linksLen;              // characters used in links
+    size_t linksSize;             // characters allocated in links
+} pagework_t;
+
+/**************** local functions ****************/
+// not visible outside this file
+
+/**************** parseArgs ****************/
+/* Parse the command-line arguments for the crawler.
+ *
+ * Usage:
+ *   ./crawler seedURL pageDirectory maxDepth [--threads=N] [--bfs]
+ *             [--seen-budget=MB] [--checkpoint=N] [--resume]
+ *             [--async=N] [--host-delay=MS] [--per-host=N] [--compress]
+ *             [--dedup]
+ * 
+ * Caller provides:
+ *   the number of command-line arguments (argc),
+ *   the array of argument strings (argv),
+ *   pointers to store the seed URL, page directory, and max depth,
+ *   and an options struct already filled with the defaults.
+ * We do:
+ *   validate the number of arguments and the validity of the seed URL
+ *   (ensuring it is an internal URL and properly normalized),
+ *   ensure the page directory can be written to,
+ *   verify that the max depth is within allowed limits,
+ *   and record any optional flags in the options struct.
+ * We guarantee:
+ *   The seed URL is valid, and max depth is a valid integer between 0 and 10.
+ * Caller is responsible for:
+ *   passing valid pointers and managing memory for the URL and directory.
+ * Notes:
+ *   If any argument is invalid, the function will exit with an error message.
+ */
+static void parseArgs(const int argc, char* argv[],
+                      char** seedURL, char** pageDirectory, int* maxDepth,
+                      crawlopts_t* opts);
+
+/**************** crawlWorker ****************/
+/* Body of one crawler thread.
+ *
+ * We do:
+ *   repeatedly pop a page from the frontier, set it up with pageBegin,
+ *   and fetch it with webpage_fetchStream, passing each piece of the
+ *   body to pageSink; once the whole page is in, pageFinish saves it
+ *   under the next docID and queues its new links. Stop when
+ *   frontier_pop reports the crawl is finished.
+ * Notes:
+ *   The body is never held in memory whole, however large the page.
+ *   docIDs are handed out atomically after a successful fetch, so the
+ *   saved pages are numbered 1..n without gaps whatever the thread count.
+ */
+static void* crawlWorker(void* arg);
+
+/**************** crawlAsync ****************/
+/* Crawl on the calling thread with an event-driven fetcher.
+ *
+ * We do:
+ *   keep up to opts->asyncFetches pages from the frontier in flight in a
+ *   fetcher (non-blocking sockets and epoll), with at most opts->perHost
+ *   connections busy on one host and its fetches started at least
+ *   opts->hostDelay ms apart, and handle each page in
+ *   asyncDone as its fetch completes; stop when the frontier is empty
+ *   and nothing is in flight.
+ * Notes:
+ *   A due checkpoint stops new fetches until those in flight are done,
+ *   so the checkpoint sees every page either queued or finished.
+ */
+static void crawlAsync(crawlstate_t* state, const crawlopts_t* opts);
+
+/**************** asyncDone ****************/
+/* Fetcher callback: handle one completed fetch.
+ *
+ * We do:
+ *   on HTTP 200, pass the whole body through pageBegin, pageSink and
+ *   pageFinish, as crawlWorker does a piece at a time; otherwise report
+ *   the failure. Either way mark the page done in the frontier, and ask
+ *   for a checkpoint when one is due.
+ */
+static void asyncDone(void* arg, void* item, const int status,
+                      char* body, const size_t len);
+
+/**************** checkpointDue ****************/
+/* Return true if checkpointEvery pages were saved since the last
+ * checkpoint; only one caller sees true for each checkpoint.
+ */
+static bool checkpointDue(crawlstate_t* state);
+
+/**************** gateEnter, gateLeave ****************/
+/* Bracket the work on one page, so a checkpoint can wait for quiet.
+ *
+ * We do:
+ *   gateEnter waits while a checkpoint is pending, then counts the
+ *   worker as active; gateLeave counts it out again and wakes a waiting
+ *   checkpoint when no worker is active.
+ * Notes:
+ *   A worker waiting inside frontier_pop counts as active, but it only
+ *   waits on pages other active workers hold, so a checkpoint never
+ *   waits forever.
+ */
+static void gateEnter(crawlstate_t* state);
+static void gateLeave(crawlstate_t* state);
+
+/**************** checkpointMaybe ****************/
+/* Take a checkpoint if checkpointEvery pages were saved since the last.
+ *
+ * We do:
+ *   let one worker claim the checkpoint, stop the others from starting
+ *   new pages, wait for the pages in flight to finish, then write the
+ *   checkpoint and let the workers go again.
+ */
+static void checkpointMaybe(crawlstate_t* state);
+
+/**************** checkpointWrite ****************/
+/* Write the crawl state to pageDirectory/.checkpoint.
+ *
+ * We do:
+ *   write the next docID, every queued page as "depth url", and the
+ *   seenset (see seenset_save) to .checkpoint.tmp, sync it to disk and
+ *   rename it over .checkpoint, so a crash never leaves half a checkpoint.
+ * We return:
+ *   true on success, false on error.
+ * Caller is responsible for:
+ *   making sure no worker is processing a page.
+ */
+static bool checkpointWrite(crawlstate_t* state);
+
+/**************** checkpointLoad ****************/
+/* Restore the crawl state from pageDirectory/.checkpoint.
+ *
+ * We do:
+ *   refill the frontier (as worker 0) and rebuild the seenset, set the
+ *   docID counter, and delete any pages saved after the checkpoint was
+ *   taken, since they are fetched again under the same docIDs. With
+ *   --dedup, also cut .duplicates back to its size at the checkpoint
+ *   and refill the fingerprint index (see fingerprintsLoad).
+ * We return:
+ *   true on success, false if the checkpoint is missing or malformed,
+ *   or if the seen set or .duplicates cannot be cut back.
+ */
+static bool checkpointLoad(crawlstate_t* state);
+
+/**************** duplicatesCreate ****************/
+/* Create pageDirectory/.duplicates empty for a new --dedup crawl, so
+ * that indexer --dedup finds the crawl's list even if it stays empty;
+ * return false, after reporting it, if it cannot be created.
+ */
+static bool duplicatesCreate(crawlstate_t* state);
+
+/**************** fingerprintsLoad ****************/
+/* With --dedup, fingerprint saved pages 1..nextID-1 (as pagedir_load
+ * and webpage_getNextWord see them) into the fingerprint index, but
+ * for those listed in pageDirectory/.duplicates; return false if a
+ * page or the list cannot be loaded.
+ */
+static bool fingerprintsLoad(crawlstate_t* state, const int nextID);
+
+/**************** pageBegin ****************/
+/* Set up the work for fetching one page.
+ *
+ * Caller provides:
+ *   the work to fill in, the shared state, the page, and the frontier
+ *   part (worker) its links go to.
+ * We do:
+ *   start its page file (pagedir_begin); create a scanner if the page is
+ *   below the max depth (for links) or the crawl has --dedup (for words,
+ *   which build the page's SimHash).
+ * We return:
+ *   true if all is ready, false on error.
+ * Caller is responsible for:
+ *   calling pageFinish on the work, whatever we return.
+ */
+static bool pageBegin(pagework_t* work, crawlstate_t* state, webpage_t* page,
+                      const int worker);
+
+/**************** pageSink ****************/
+/* webpage_fetchStream sink: write a piece of the body to the page file
+ * and feed it to the scanner (if any); return false on a write error.
+ */
+static bool pageSink(void* arg, const char* data, const size_t len);
+
+/**************** pageLink ****************/
+/* Scanner link callback: if the (canonical) URL is internal, append it
+ * to the page's links for linksPush. The links share one growing
+ * buffer, so external links cost nothing and internal ones no malloc.
+ */
+static void pageLink(void* arg, const char* url, const urlparts_t* parts);
+
+/**************** pageWord ****************/
+/* Scanner word callback: add the word to the page's SimHash. */
+static void pageWord(void* arg, char* word);
+
+/**************** pageFinish ****************/
+/* Finish the work on one page and free it.
+ *
+ * We do:
+ *   if the page was fetched, claim a docID for it (pageClaim), save the
+ *   page under it and queue its links, near-duplicate or not. If the
+ *   fetch failed, report it and discard the page.
+ * Notes:
+ *   Links are queued only after the page is saved: queuing them while a
+ *   slow page arrives would let other workers reach them first by longer
+ *   paths, at too great a depth to be scanned.
+ */
+static void pageFinish(pagework_t* work, const bool fetched);
+
+/**************** pageClaim ****************/
+/* Return the next docID for a fetched page.
+ *
+ * We do:
+ *   take the next docID. With --dedup, for a page with enough words to
+ *   fingerprint, also look the page's SimHash up in the fingerprint
+ *   index; if a saved page is within SIMHASH_DISTANCE bits, append
+ *   "docID originalID url" to pageDirectory/.duplicates, else add the
+ *   fingerprint under the new docID.
+ * Notes:
+ *   The lookup and insert happen under one lock, so of two copies
+ *   fetched at once exactly one is the original.
+ */
+static int pageClaim(pagework_t* work);
+
+/**************** linksPush ****************/
+/* Add each of the page's links not seen before to the frontier, one
+ * deeper than the page.
+ *
+ * We guarantee:
+ *   No duplicate pages are added to the frontier or seen set, even
+ *   when several workers find the same URL at once.
+ * Notes:
+ *   Only links the seen set has not had are copied, for the frontier;
+ *   a duplicate costs one seen-set lookup.
+ */
+static void linksPush(pagework_t* work);
+
+/* frontier_iterate helpers for checkpoints */
+static void countItem(void* arg, void* item, const int depth);
+static void writeItem(void* arg, void* item, const int depth);
+
+/**************** other functions ****************/
+void crawl(char *seedURL, char* pageDirectory, int maxDepth, const crawlopts_t* opts);
+
+static const int MAX_THREADS = 64;    // most worker threads we allow
+static const int MAX_SEEN_MB = 1 << 16;  // largest seen-set budget, in MB
+static const int MAX_CHECKPOINT = 1000000;  // largest checkpoint interval
+static const int DEFAULT_CHECKPOINT = 100;  // interval with --resume alone
+static const int MAX_ASYNC = 1024;    // most fetches in flight with --async
+static const int MAX_HOST_DELAY = 60000;  // longest --host-delay, in ms
+static const int MAX_PER_HOST = 16;   // most async connections to one host
+static const int FETCH_TIMEOUT_MS = 30000;  // time allowed for one async fetch
+static const int POLL_MS = 1000;      // longest wait for network events
+
+
+/**************** main() ****************/
+int main(const int argc, char* argv[])
+{
+    char* seedURL = NULL;
+    char* pageDirectory = NULL;
+    int maxDepth = 0;
+    crawlopts_t opts = {.numThreads = 1, .hostDelay = 1000, .perHost = 2};
+
+    // Parse command-line arguments
+    parseArgs(argc, argv, &seedURL, &pageDirectory, &maxDepth, &opts);
+
+    // Start crawling
+    crawl(seedURL, pageDirectory, maxDepth, &opts);
+
+    return 0;
+}
+
+/**************** parseArgs() ****************/
+/* see the prototype above for description */
+static void parseArgs(const int argc, char* argv[],
+                      char** seedURL, char** pageDirectory, int* maxDepth,
+                      crawlopts_t* opts)
+{
+    if (argc < 4) {
+        fprintf(stderr, "invalid numnber of inputs\n");
+        exit(1);
+    }
+    // Everything after the three required arguments must be an option
+    bool checkpointGiven = false;
+    for (int i = 4; i < argc; i++) {
+        if (strncmp(argv[i], "--threads=", 10) == 0) {
+            opts->numThreads = atoi(argv[i] + 10);
+            if (opts->numThreads < 1 || opts->numThreads > MAX_THREADS) {
+                fprintf(stderr, "invalid number of threads: %s\n", argv[i] + 10);
+                exit(5);
+            }
+        } else if (strcmp(argv[i], "--bfs") == 0) {
+            opts->bfs = true;
+        } else if (strncmp(argv[i], "--seen-budget=", 14) == 0) {
+            opts->seenBudgetMB = atoi(argv[i] + 14);
+            if (opts->seenBudgetMB < 1 || opts->seenBudgetMB > MAX_SEEN_MB) {
+                fprintf(stderr, "invalid seen-set budget: %s\n", argv[i] + 14);
+                exit(5);
+            }
+        } else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+            opts->checkpointEvery = atoi(argv[i] + 13);
+            checkpointGiven = true;
+            if (opts->checkpointEvery < 0 || opts->checkpointEvery > MAX_CHECKPOINT
+                || argv[i][13] == '\0') {
+                fprintf(stderr, "invalid checkpoint interval: %s\n", argv[i] + 13);
+                exit(5);
+            }
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            opts->resume = true;
+        } else if (strncmp(argv[i], "--async=", 8) == 0) {
+            opts->asyncFetches = atoi(argv[i] + 8);
+            if (opts->asyncFetches < 1 || opts->asyncFetches > MAX_ASYNC) {
+                fprintf(stderr, "invalid number of async fetches: %s\n", argv[i] + 8);
+                exit(5);
+            }
+        } else if (strncmp(argv[i], "--host-delay=", 13) == 0) {
+            opts->hostDelay = atoi(argv[i] + 13);
+            if (opts->hostDelay < 0 || opts->hostDelay > MAX_HOST_DELAY
+                || argv[i][13] == '\0') {
+                fprintf(stderr, "invalid host delay: %s\n", argv[i] + 13);
+                exit(5);
+            }
+        } else if (strncmp(argv[i], "--per-host=", 11) == 0) {
+            opts->perHost = atoi(argv[i] + 11);
+            if (opts->perHost < 1 || opts->perHost > MAX_PER_HOST) {
+                fprintf(stderr, "invalid number of connections per host: %s\n", argv[i] + 11);
+                exit(5);
+            }
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            opts->compress = true;
+        } else if (strcmp(argv[i], "--dedup") == 0) {
+            opts->dedup = true;
+        } else {
+            fprintf(stderr, "invalid numnber of inputs\n");
+            exit(1);
+        }
+    }
+    // a resumed crawl keeps checkpointing, unless told otherwise
+    if (opts->resume && !checkpointGiven) {
+        opts->checkpointEvery = DEFAULT_CHECKPOINT;
+    }
+    if (opts->asyncFetches > 0 && opts->numThreads > 1) {
+        fprintf(stderr, "--async runs on one thread; it cannot be used with --threads\n");
+        exit(5);
+    }
+
+    // Validate pageDirectory by initializing it
+    if (!pagedir_init(argv[2])) {
+        fprintf(stderr, "Invalid pageDirectory: %s\n", argv[2]);
+        exit(2);
+    }
+
+    if ((atoi(argv[3]))<0 || (atoi(argv[3]))>10){
+        fprintf(stderr, "invalid depth");
+        exit(3);
+    }
+
+
+    if (!isInternalURL(argv[1])) {
+        fprintf(stderr, "Invalid seedURL: %s\n", argv[1]);
+        exit(4);
+    }
+
+
+    *seedURL = argv[1];
+    *pageDirectory = argv[2];
+    *maxDepth = atoi(argv[3]);
+}
+
+
+
+/**************** crawl() ****************/
+/* see crawler.h for description */
+void crawl(char *seedURL, char *pageDirectory, int maxDepth, const crawlopts_t* opts)
+{
+    crawlstate_t state;
+    state.pageDirectory = pageDirectory;
+    state.maxDepth = maxDepth;
+    state.pagesToCrawl = frontier_new(opts->numThreads, maxDepth, opts->bfs);
+    state.pagesSeen = NULL;
+    atomic_init(&state.id, 0);
+    state.checkpointEvery = opts->checkpointEvery;
+    atomic_init(&state.lastCheckpoint, 0);
+    pthread_mutex_init(&state.gateLock, NULL);
+    pthread_cond_init(&state.gateCond, NULL);
+    state.active = 0;
+    state.pausing = false;
+    state.compress = opts->compress;
+    state.fingerprints = opts->dedup ? fpindex_new() : NULL;
+    pthread_mutex_init(&state.dupLock, NULL);
+    if (state.pagesToCrawl == NULL || (opts->dedup && state.fingerprints == NULL)) {
+        fprintf(stderr, "Memory allocation failed for crawler state\n");
+        exit(1);
+    }
+
+    if (opts->resume) {
+        // pick up the frontier, seen set and docIDs where the last run left off
+        if (!checkpointLoad(&state)) {
+            fprintf(stderr, "Cannot resume: no usable checkpoint in %s\n", pageDirectory);
+            exit(6);
+        }
+    } else {
+        if (opts->seenBudgetMB > 0) {
+            // keep the exact set on disk, next to the pages
+            char* seenDirectory = get_pathname(pageDirectory, ".seen");
+            state.pagesSeen = seenset_new_bounded(seenDirectory,
+                                                  (size_t) opts->seenBudgetMB << 20);
+            free(seenDirectory);
+        } else {
+            // checkpoints need the set's log, next to the pages
+            char* seenDirectory = (opts->checkpointEvery > 0)
+                ? get_pathname(pageDirectory, ".seen") : NULL;
+            state.pagesSeen = seenset_new(seenDirectory);
+            free(seenDirectory);
+        }
+        if (state.pagesSeen == NULL) {
+            fprintf(stderr, "Memory allocation failed for crawler state\n");
+            exit(1);
+        }
+        if (opts->dedup && !duplicatesCreate(&state)) {
+            exit(1);
+        }
+
+        // Dynamically allocate memory for seedURL
+        char* seedURLCopy = malloc(strlen(seedURL) + 1);
+        if (seedURLCopy == NULL) {
+            fprintf(stderr, "Memory allocation failed for seedURL\n");
+            exit(1);
+        }
+        strcpy(seedURLCopy, seedURL);
+
+        // Add the seed URL to the seen set and the frontier
+        seenset_insert(state.pagesSeen, seedURLCopy);
+        webpage_t *seed_page = webpage_new(seedURLCopy, 0, NULL);
+        frontier_push(state.pagesToCrawl, 0, seed_page, 0);
+    }
+
+    if (opts->asyncFetches > 0) {
+        // one thread, many fetches in flight
+        crawlAsync(&state, opts);
+    } else {
+        // Start the workers and wait for the frontier to drain
+        worker_t* workers = calloc(opts->numThreads, sizeof(worker_t));
+        if (workers == NULL) {
+            fprintf(stderr, "Memory allocation failed for workers\n");
+            exit(1);
+        }
+        for (int i = 0; i < opts->numThreads; i++) {
+            workers[i].state = &state;
+            workers[i].num = i;
+            if (pthread_create(&workers[i].thread, NULL, crawlWorker, &workers[i]) != 0) {
+                fprintf(stderr, "Failed to start crawler thread %d\n", i);
+                exit(1);
+            }
+        }
+        for (int i = 0; i < opts->numThreads; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        free(workers);
+    }
+
+    // a final (empty) checkpoint makes resuming a finished crawl a no-op
+    if (state.checkpointEvery > 0) {
+        checkpointWrite(&state);
+    }
+
+    // Clean up
+    webpage_closeConnections();
+    seenset_delete(state.pagesSeen);
+    frontier_delete(state.pagesToCrawl, webpage_delete);
+    fpindex_delete(state.fingerprints);
+    pthread_mutex_destroy(&state.dupLock);
+    pthread_mutex_destroy(&state.gateLock);
+    pthread_cond_destroy(&state.gateCond);
+}
+
+/**************** crawlWorker() ****************/
+/* see the prototype above for description */
+static void* crawlWorker(void* arg)
+{
+    worker_t* self = arg;
+    crawlstate_t* state = self->state;
+    webpage_t *current_page;
+
+    while (true) {
+        gateEnter(state);
+        current_page = frontier_pop(state->pagesToCrawl, self->num, NULL);
+        if (current_page == NULL) {
+            gateLeave(state);
+            break;
+        }
+        // the body goes to the page file and the scanner as it arrives
+        pagework_t work;
+        bool fetched = pageBegin(&work, state, current_page, self->num)
+            && webpage_fetchStream(current_page, pageSink, &work);
+        pageFinish(&work, fetched);
+        webpage_delete(current_page);
+        frontier_done(state->pagesToCrawl);
+        gateLeave(state);
+        checkpointMaybe(state);
+    }
+    return NULL;
+}
+
+/**************** crawlAsync() ****************/
+/* see the prototype above for description */
+static void crawlAsync(crawlstate_t* state, const crawlopts_t* opts)
+{
+    fetcher_t* fetcher = fetcher_new(opts->asyncFetches, opts->perHost,
+                                     opts->hostDelay, FETCH_TIMEOUT_MS,
+                                     asyncDone, state);
+    if (fetcher == NULL) {
+        fprintf(stderr, "Failed to start the fetcher\n");
+        exit(1);
+    }
+
+    while (true) {
+        // hand the fetcher only what it can have in flight; the rest
+        // stays in the frontier, in order and visible to checkpoints
+        webpage_t* page;
+        while (!state->pausing
+               && fetcher_outstanding(fetcher) < opts->asyncFetches
+               && (page = frontier_take(state->pagesToCrawl, 0, NULL)) != NULL) {
+            if (!fetcher_add(fetcher, webpage_getURL(page), page)) {
+                fprintf(stderr, "Failed to fetch the webpage: %s\n", webpage_getURL(page));
+                webpage_delete(page);
+                frontier_done(state->pagesToCrawl);
+            }
+        }
+        if (fetcher_outstanding(fetcher) == 0) {
+            if (!state->pausing) {
+                break;      // nothing queued and nothing in flight
+            }
+            // the fetches in flight have drained: take the checkpoint
+            if (!checkpointWrite(state)) {
+                fprintf(stderr, "Failed to write checkpoint in %s\n", state->pageDirectory);
+            }
+            state->pausing = false;
+            continue;
+        }
+        fetcher_poll(fetcher, POLL_MS);
+    }
+    fetcher_delete(fetcher, webpage_delete);
+}
+
+/**************** asyncDone() ****************/
+/* see the prototype above for description */
+static void asyncDone(void* arg, void* item, const int status,
+                      char* body, const size_t len)
+{
+    crawlstate_t* state = arg;
+    webpage_t* page = item;
+
+    // the whole body goes through the same path a streamed one does
+    pagework_t work;
+    bool fetched = pageBegin(&work, state, page, 0)
+        && status == 200 && pageSink(&work, body, len);
+    free(body);
+    pageFinish(&work, fetched);
+    webpage_delete(page);
+    frontier_done(state->pagesToCrawl);
+
+    // crawlAsync stops feeding the fetcher and checkpoints once it drains
+    if (checkpointDue(state)) {
+        state->pausing = true;
+    }
+}
+
+/**************** gateEnter() ****************/
+/* see the prototype above for description */
+static void gateEnter(crawlstate_t* state)
+{
+    pthread_mutex_lock(&state->gateLock);
+    while (state->pausing) {
+        pthread_cond_wait(&state->gateCond, &state->gateLock);
+    }
+    state->active++;
+    pthread_mutex_unlock(&state->gateLock);
+}
+
+/**************** gateLeave() ****************/
+/* see the prototype above for description */
+static void gateLeave(crawlstate_t* state)
+{
+    pthread_mutex_lock(&state->gateLock);
+    state->active--;
+    if (state->active == 0) {
+        pthread_cond_broadcast(&state->gateCond);
+    }
+    pthread_mutex_unlock(&state->gateLock);
+}
+
+/**************** checkpointMaybe() ****************/
+/* see the prototype above for description */
+static void checkpointMaybe(crawlstate_t* state)
+{
+    if (!checkpointDue(state)) {
+        return;
+    }
+
+    pthread_mutex_lock(&state->gateLock);
+    state->pausing = true;
+    while (state->active > 0) {
+        pthread_cond_wait(&state->gateCond, &state->gateLock);
+    }
+    // every worker is between pages: nothing is in flight
+    if (!checkpointWrite(state)) {
+        fprintf(stderr, "Failed to write checkpoint in %s\n", state->pageDirectory);
+    }
+    state->pausing = false;
+    pthread_cond_broadcast(&state->gateCond);
+    pthread_mutex_unlock(&state->gateLock);
+}
+
+/**************** checkpointDue() ****************/
+/* see the prototype above for description */
+static bool checkpointDue(crawlstate_t* state)
+{
+    if (state->checkpointEvery <= 0) {
+        return false;
+    }
+    int id = atomic_load(&state->id);
+    int last = atomic_load(&state->lastCheckpoint);
+    // only the caller that wins the exchange takes this checkpoint
+    return id - last >= state->checkpointEvery
+        && atomic_compare_exchange_strong(&state->lastCheckpoint, &last, id);
+}
+
+/**************** checkpointWrite() ****************/
+/* see the prototype above for description */
+static bool checkpointWrite(crawlstate_t* state)
+{
+    char* pathname = get_pathname(state->pageDirectory, ".checkpoint");
+    char* tmpname = get_pathname(state->pageDirectory, ".checkpoint.tmp");
+    FILE* fp = (tmpname == NULL) ? NULL : fopen(tmpname, "w");
+    bool ok = (pathname != NULL && fp != NULL);
+
+    if (ok) {
+        int count = 0;
+        frontier_iterate(state->pagesToCrawl, &count, countItem);
+        fprintf(fp, "nextID %d\n", atomic_load(&state->id) + 1);
+        fprintf(fp, "frontier %d\n", count);
+        frontier_iterate(state->pagesToCrawl, fp, writeItem);
+        ok = seenset_save(state->pagesSeen, fp);
+        if (state->fingerprints != NULL) {
+            // pages found to be duplicates since are recorded again
+            char* dupname = get_pathname(state->pageDirectory, ".duplicates");
+            struct stat st;
+            fprintf(fp, "duplicates %lld\n",
+                    stat(dupname, &st) == 0 ? (long long) st.st_size : 0LL);
+            free(dupname);
+        }
+        // the new checkpoint must be on disk before it replaces the old one
+        ok = (fflush(fp) == 0 && fsync(fileno(fp)) == 0) && ok;
+    }
+    if (fp != NULL) {
+        ok = (fclose(fp) == 0) && ok;
+    }
+    ok = ok && rename(tmpname, pathname) == 0;
+    free(pathname);
+    free(tmpname);
+    return ok;
+}
+
+/**************** checkpointLoad() ****************/
+/* see the prototype above for description */
+static bool checkpointLoad(crawlstate_t* state)
+{
+    char* pathname = get_pathname(state->pageDirectory, ".checkpoint");
+    FILE* fp = (pathname == NULL) ? NULL : fopen(pathname, "r");
+    free(pathname);
+    if (fp == NULL) {
+        return false;
+    }
+
+    int nextID, count;
+    if (fscanf(fp, "nextID %d\n", &nextID) != 1 || nextID < 1
+        || fscanf(fp, "frontier %d\n", &count) != 1 || count < 0) {
+        fclose(fp);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        int depth;
+        char* url = NULL;
+        if (fscanf(fp, "%d ", &depth) != 1 || (url = file_readLine(fp)) == NULL) {
+            fclose(fp);
+            return false;
+        }
+        webpage_t* page = webpage_new(url, depth, NULL);
+        if (page == NULL || !frontier_push(state->pagesToCrawl, 0, page, depth)) {
+            fprintf(stderr, "Dropping %s: depth %d is beyond maxDepth\n", url, depth);
+            if (page != NULL) {
+                webpage_delete(page);
+            } else {
+                free(url);
+            }
+        }
+    }
+    char* seenDirectory = get_pathname(state->pageDirectory, ".seen");
+    state->pagesSeen = seenset_load(fp, seenDirectory);
+    free(seenDirectory);
+    long long dupSize;
+    bool haveDups = (fscanf(fp, "duplicates %lld\n", &dupSize) == 1);
+    fclose(fp);
+    if (state->pagesSeen == NULL) {
+        return false;
+    }
+    if (haveDups) {
+        // duplicates recorded after the checkpoint are found again; with
+        // none recorded before it, there may be no file at all
+        char* dupname = get_pathname(state->pageDirectory, ".duplicates");
+        bool cut = (dupname != NULL && (truncate(dupname, dupSize) == 0
+                                        || (errno == ENOENT && dupSize == 0)));
+        if (!cut) {
+            fprintf(stderr, "Failed to restore %s\n", dupname != NULL ? dupname : ".duplicates");
+        }
+        free(dupname);
+        if (!cut) {
+            return false;
+        }
+    }
+
+    // pages saved after the checkpoint are fetched again under the same
+    // docIDs; remove them so a shorter rerun leaves no stale pages behind
+    for (int id = nextID; ; id++) {
+        char filename[16];
+        snprintf(filename, sizeof(filename), "%d", id);
+        char* stale = get_pathname(state->pageDirectory, filename);
+        bool removed = (stale != NULL && unlink(stale) == 0);
+        free(stale);
+        if (!removed) {
+            break;
+        }
+    }
+    atomic_store(&state->id, nextID - 1);
+    atomic_store(&state->lastCheckpoint, nextID - 1);
+    return fingerprintsLoad(state, nextID);
+}
+
+/**************** duplicatesCreate() ****************/
+/* see the prototype above for description */
+static bool duplicatesCreate(crawlstate_t* state)
+{
+    char* dupname = get_pathname(state->pageDirectory, ".duplicates");
+    FILE* fp = (dupname == NULL) ? NULL : fopen(dupname, "w");
+    bool ok = (fp != NULL && fclose(fp) == 0);
+    if (!ok) {
+        fprintf(stderr, "Failed to create %s\n", dupname != NULL ? dupname : ".duplicates");
+    }
+    free(dupname);
+    return ok;
+}
+
+/**************** fingerprintsLoad() ****************/
+/* see the prototype above for description */
+static bool fingerprintsLoad(crawlstate_t* state, const int nextID)
+{
+    if (state->fingerprints == NULL) {
+        return true;
+    }
+    // only originals were added during the crawl; the pages it found to
+    // be duplicates are listed, whatever they fingerprint as now
+    counters_t* duplicates;
+    if (!pagedir_duplicates(state->pageDirectory, &duplicates)) {
+        fprintf(stderr, "Failed to read the duplicates listed in %s\n", state->pageDirectory);
+        return false;
+    }
+    bool ok = true;
+    for (int id = 1; ok && id < nextID; id++) {
+        if (duplicates != NULL && counters_get(duplicates, id) != 0) {
+            continue;
+        }
+        char filename[16];
+        snprintf(filename, sizeof(filename), "%d", id);
+        char* pathname = get_pathname(state->pageDirectory, filename);
+        webpage_t* page = pagedir_load(pathname);
+        free(pathname);
+        ok = (page != NULL);
+        uint64_t fingerprint;
+        if (ok && simhash_page(page, &fingerprint)
+            && fpindex_find(state->fingerprints, fingerprint) == 0) {
+            fpindex_insert(state->fingerprints, fingerprint, id);
+        }
+        webpage_delete(page);
+    }
+    counters_delete(duplicates);
+    return ok;
+}
+
+/**************** countItem() ****************/
+/* frontier_iterate helper: count the queued pages */
+static void countItem(void* arg, void* item, const int depth)
+{
+    (*(int*) arg)++;
+}
+
+/**************** writeItem() ****************/
+/* frontier_iterate helper: write "depth url" for one queued page */
+static void writeItem(void* arg, void* item, const int depth)
+{
+    fprintf((FILE*) arg, "%d %s\n", depth, webpage_getURL((webpage_t*) item));
+}
+
+
+/**************** pageBegin() ****************/
+/* see the prototype above for description */
+static bool pageBegin(pagework_t* work, crawlstate_t* state, webpage_t* page,
+                      const int worker)
+{
+    const char* url = webpage_getURL(page);
+    bool wantLinks = webpage_getDepth(page) < state->maxDepth;
+    bool wantWords = state->fingerprints != NULL;
+
+    memset(work, 0, sizeof(pagework_t));
+    work->state = state;
+    work->page = page;
+    work->worker = worker;
+    work->writer = pagedir_begin(state->pageDirectory, url, webpage_getDepth(page),
+                                 state->compress);
+    if (wantLinks || wantWords) {
+        work->scanner = scanner_new(url, wantLinks ? pageLink : NULL,
+                                    wantWords ? pageWord : NULL, work);
+    }
+    if (wantWords) {
+        work->simhash = simhash_new();
+    }
+    return work->writer != NULL
+        && (work->scanner != NULL || !(wantLinks || wantWords))
+        && (work->simhash != NULL || !wantWords);
+}
+
+/**************** pageSink() ****************/
+/* see the prototype above for description */
+static bool pageSink(void* arg, const char* data, const size_t len)
+{
+    pagework_t* work = arg;
+    scanner_feed(work->scanner, data, len);
+    return pagedir_write(work->writer, data, len);
+}
+
+/**************** pageLink() ****************/
+/* see the prototype above for description */
+static void pageLink(void* arg, const char* url, const urlparts_t* parts)
+{
+    pagework_t* work = arg;
+    if (!parts->internal) {
+        return;
+    }
+
+    size_t len = strlen(url) + 1;
+    if (work->linksLen + len > work->linksSize) {
+        size_t size = (work->linksSize == 0) ? 4096 : 2 * work->linksSize;
+        while (size < work->linksLen + len) {
+            size *= 2;
+        }
+        char* links = realloc(work->links, size);
+        if (links == NULL) {
+            return;
+        }
+        work->links = links;
+        work->linksSize = size;
+    }
+    memcpy(work->links + work->linksLen, url, len);
+    work->linksLen += len;
+}
+
+/**************** pageWord() ****************/
+/* see the prototype above for description */
+static void pageWord(void* arg, char* word)
+{
+    pagework_t* work = arg;
+    simhash_add(work->simhash, word);
+    free(word);
+}
+
+/**************** pageFinish() ****************/
+/* see the prototype above for description */
+static void pageFinish(pagework_t* work, const bool fetched)
+{
+    if (!fetched) {
+        fprintf(stderr, "Failed to fetch the webpage: %s\n", webpage_getURL(work->page));
+        pagedir_abort(work->writer);
+    } else {
+        scanner_finish(work->scanner);
+        // a near-duplicate is saved and followed too: it may link to pages
+        // the original does not, and indexer --dedup leaves it out
+        pagedir_commit(work->writer, pageClaim(work));
+        linksPush(work);
+    }
+    scanner_delete(work->scanner);
+    simhash_delete(work->simhash);
+    free(work->links);
+}
+
+/**************** pageClaim() ****************/
+/* see the prototype above for description */
+static int pageClaim(pagework_t* work)
+{
+    crawlstate_t* state = work->state;
+    uint64_t fingerprint;
+    if (state->fingerprints == NULL || !simhash_value(work->simhash, &fingerprint)) {
+        return atomic_fetch_add(&state->id, 1) + 1;
+    }
+
+    // finding and adding must be one step, or two copies could both pass
+    pthread_mutex_lock(&state->dupLock);
+    int id = atomic_fetch_add(&state->id, 1) + 1;
+    int original = fpindex_find(state->fingerprints, fingerprint);
+    if (original == 0) {
+        fpindex_insert(state->fingerprints, fingerprint, id);
+    } else {
+        char* dupname = get_pathname(state->pageDirectory, ".duplicates");
+        FILE* fp = fopen(dupname, "a");
+        if (fp != NULL) {
+            fprintf(fp, "%d %d %s\n", id, original, webpage_getURL(work->page));
+            fclose(fp);
+        } else {
+            fprintf(stderr, "Failed to record duplicate in %s\n", dupname);
+        }
+        free(dupname);
+    }
+    pthread_mutex_unlock(&state->dupLock);
+    return id;
+}
+
+/**************** linksPush() ****************/
+/* see the prototype above for description */
+static void linksPush(pagework_t* work)
+{
+    int depth = webpage_getDepth(work->page) + 1;
+    size_t len;
+    for (char* url = work->links; url < work->links + work->linksLen; url += len + 1) {
+        len = strlen(url);
+        if (seenset_insert(work->state->pagesSeen, url)) {
+            // only a new URL needs a copy of its own, for the new page
+            char* copy = malloc(len + 1);
+            if (copy == NULL) {
+                continue;
+            }
+            memcpy(copy, url, len + 1);
+            webpage_t* newPage = webpage_new(copy, depth, NULL);
+            frontier_push(work->state->pagesToCrawl, work->worker, newPage, depth);
+        }
+    }
+    work->linksLen = 0;
+}
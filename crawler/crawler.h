@@ -0,0 +1,67 @@
+/*
+ * crawler.h - header file for CS50 Crawler module
+ *
+ * The crawler is responsible for starting at a given seed URL,
+ * crawling the web up to a specified depth, and saving web pages
+ * to a designated directory. It uses a frontier to store pages yet to
+ * be crawled and a seenset to track pages that have already been seen.
+ * Pages are fetched by one or more worker threads.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#ifndef __CRAWLER_H
+#define __CRAWLER_H
+
+#include <stdbool.h>
+
+/**************** global types ****************/
+/* optional crawler settings, from the flags after maxDepth */
+typedef struct crawlopts {
+    int numThreads;     // number of fetching threads (--threads=N)
+    bool bfs;           // crawl in breadth-first order (--bfs)
+    int seenBudgetMB;   // RAM for a bounded seen set, 0 for exact (--seen-budget=MB)
+    int checkpointEvery;  // pages saved between checkpoints, 0 for never (--checkpoint=N)
+    bool resume;        // continue from pageDirectory/.checkpoint (--resume)
+    int asyncFetches;   // fetches in flight on one thread, 0 for threads (--async=N)
+    int hostDelay;      // ms between async fetch starts on a host (--host-delay=MS)
+    int perHost;        // async connections busy on one host at once (--per-host=N)
+    bool compress;      // save pages lzblock-compressed (--compress)
+    bool dedup;         // record pages near-duplicate to one saved (--dedup)
+} crawlopts_t;
+
+/**************** functions ****************/
+
+/**************** crawl ****************/
+/* Start crawling from the seed URL, visiting pages and saving them to disk.
+ * 
+ * Caller provides:
+ *   a seed URL, a page directory where pages will be saved,
+ *   the maximum crawl depth (0 to 10), and the crawler options.
+ * We do:
+ *   initialize a frontier for pages yet to be crawled and a seenset to
+ *   track pages that have already been seen; with a seen budget, the
+ *   seenset is a Bloom filter of that size backed by bucket files in
+ *   pageDirectory/.seen, and otherwise, with checkpoints, an exact set
+ *   that logs its URLs there. Begin with the seed URL at
+ *   depth 0, then start opts->numThreads workers (see crawlWorker),
+ *   or with opts->asyncFetches run the crawl on this thread (see
+ *   crawlAsync). Return once the frontier has drained.
+ *   With opts->resume, the frontier, seenset and next docID come from
+ *   the checkpoint in pageDirectory instead of the seed URL; the crawl
+ *   exits with status 6 if there is no usable checkpoint.
+ *   Every opts->checkpointEvery pages, and once more at the end, the
+ *   crawl state is written to pageDirectory/.checkpoint.
+ *   With opts->dedup, a page whose text is a near-duplicate of a saved
+ *   page's (see simhash.h) is saved and scanned as usual, and also
+ *   recorded in pageDirectory/.duplicates (see pageClaim), which a
+ *   new crawl creates empty; indexer --dedup leaves the pages listed
+ *   there out of the index.
+ * We guarantee:
+ *   All pages up to the max depth are fetched and saved.
+ * Caller is responsible for:
+ *   ensuring the seed URL and directory are valid.
+ */
+void crawl(char* seedURL, char* pageDirectory, int maxDepth, const crawlopts_t* opts);
+
+#endif // __CRAWLER_H
@@ -79,6 +79,77 @@ echo "Total number of files found in ../data/wikipedia after crawling at depth 1
 
 echo""
 
+# Test 8: Run the crawler for the letters website with 4 threads, breadth-first
+echo "### Crawling the letters website at depth 3 with 4 threads ###"
+mkdir -p ../data/letters-threads
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-threads 3 --threads=4 --bfs --checkpoint=100
+num_threaded_files=$(ls ../data/letters-threads | wc -l)
+echo "Total number of files found in ../data/letters-threads: $num_threaded_files"
+
+echo""
+
+# Test 9: Invalid number of threads
+echo "### Testing with an invalid number of threads ###"
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters 2 --threads=0
+if [ $? -ne 0 ]; then
+    echo "Invalid number of threads was rejected"
+fi
+
+echo""
+
+# Test 10: Resume a finished crawl from its checkpoint
+echo "### Testing --resume on the threaded letters crawl ###"
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-threads 3 --resume
+num_resumed_files=$(ls ../data/letters-threads | wc -l)
+echo "Files in ../data/letters-threads after resuming: $num_resumed_files (was $num_threaded_files)"
+
+echo""
+
+# Test 11: Resume without a checkpoint
+echo "### Testing --resume with no checkpoint ###"
+mkdir -p ../data/letters-empty
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-empty 3 --resume
+if [ $? -ne 0 ]; then
+    echo "Resume without a checkpoint was rejected"
+fi
+
+echo""
+
+# Test 12: Event-driven fetcher
+echo "### Testing --async with 8 fetches in flight ###"
+mkdir -p ../data/letters-async
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-async 3 --async=8 --host-delay=100
+num_async_files=$(ls ../data/letters-async | wc -l)
+echo "Total number of files found in ../data/letters-async: $num_async_files"
+
+echo""
+
+# Test 13: Compressed page storage
+echo "### Testing --compress on the letters crawl ###"
+mkdir -p ../data/letters-compressed
+./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/index.html ../data/letters-compressed 3 --compress
+echo "Size of ../data/letters-compressed: $(du -sk ../data/letters-compressed | cut -f1)KB"
+
+echo""
+
+# Test 14: Near-duplicate detection
+echo "### Testing --dedup on the wikipedia crawl ###"
+mkdir -p ../data/wikipedia-dedup
+./crawler http://cs50tse.cs.dartmouth.edu/tse/wikipedia/Linked_list.html ../data/wikipedia-dedup 1 --dedup
+num_dedup_files=$(ls ../data/wikipedia-dedup | wc -l)
+echo "Pages saved: $num_dedup_files, near-duplicates recorded: $(wc -l < ../data/wikipedia-dedup/.duplicates)"
+
+echo""
+
+# Test 15: Bounded seen set
+echo "### Testing --seen-budget on the wikipedia crawl ###"
+mkdir -p ../data/wikipedia-bounded
+./crawler http://cs50tse.cs.dartmouth.edu/tse/wikipedia/Linked_list.html ../data/wikipedia-bounded 1 --seen-budget=1 --threads=4
+num_bounded_files=$(ls ../data/wikipedia-bounded | wc -l)
+echo "Pages saved with a 1MB seen budget: $num_bounded_files (exact set, in Test 14: $num_dedup_files)"
+
+echo""
+
 # Final directory check with summaries
 echo "### Final summary ###"
 echo "Total number of files in ../data/letters: $num_letters_files"
@@ -7,9 +7,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <limits.h>
 #include "../common/pagedir.h"
 #include "../common/word.h"
 #include "../common/index.h"
+#include "../common/simhash.h"
+#include "../common/docstats.h"
+#include "../common/positions.h"
+#include "../common/indexruns.h"
+#include "../common/indexshards.h"
 #include "../libcs50/hashtable.h"
 #include "../libcs50/counters.h"
 #include "../libcs50/webpage.h"
@@ -18,13 +26,46 @@
 
 
 // Function prototypes
-void index_build(char* pageDirectory, index_t* index);
-void indexPage(webpage_t* page, int docID, index_t* index);
+int index_build(char* pageDirectory, index_t* index, counters_t* duplicates,
+                fpindex_t* fingerprints, docstats_t* stats,
+                positions_t* positions, wordnorm_t* norm, indexruns_t* runs,
+                const int firstDoc, const int lastDoc);
+int indexPage(webpage_t* page, int docID, index_t* index, positions_t* positions,
+              wordnorm_t* norm);
+static bool indexRange(char* pageDirectory, char* indexFilename, counters_t* duplicates,
+                       fpindex_t* fingerprints, const bool keepPositions, wordnorm_t* norm, const size_t budget,
+                       const int firstDoc, const int lastDoc, int* skipped);
+static int countPages(char* pageDirectory);
 
 int main(const int argc, char* argv[]){
-    if (argc != 3){
+    bool dedup = false;
+    bool keepPositions = false;
+    int stages = 0;
+    size_t budget = 0;          // bytes of index in memory; 0 for no limit
+    int numShards = 0;          // docID ranges to index apart; 0 for one index
+    bool usage = (argc < 3 || argc > 8);
+    for (int i = 3; i < argc && !usage; i++) {
+        char* end;
+        if (strcmp(argv[i], "--dedup") == 0) {
+            dedup = true;
+        } else if (strcmp(argv[i], "--positions") == 0) {
+            keepPositions = true;
+        } else if (strcmp(argv[i], "--stem") == 0) {
+            stages |= WORD_STEM;
+        } else if (strncmp(argv[i], "--memory=", 9) == 0 && isdigit((unsigned char) argv[i][9])) {
+            budget = strtoull(argv[i] + 9, &end, 10);
+            usage = (*end != '\0' || budget == 0);
+        } else if (strncmp(argv[i], "--shards=", 9) == 0 && isdigit((unsigned char) argv[i][9])) {
+            long shards = strtol(argv[i] + 9, &end, 10);
+            usage = (*end != '\0' || shards < 1 || shards > INDEXSHARDS_MAX);
+            numShards = usage ? 0 : shards;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage){
         fprintf(stderr, "Invalid number of inputs\n");
-        fprintf(stderr, "Usage: ./indexer pageDirectory indexFilename\n");
+        fprintf(stderr, "Usage: ./indexer pageDirectory indexFilename [--dedup] [--positions] [--stem] [--memory=BYTES] [--shards=N]\n");
         exit(1);
     }
     char* pageDirectory = argv[1];
@@ -35,37 +76,182 @@ int main(const int argc, char* argv[]){
         exit(2);
     }
 
+    wordnorm_t* norm = wordnorm_new(stages);
+    if (norm == NULL) {
+        fprintf(stderr, "Failed to create the word normalizer\n");
+        exit(3);
+    }
+    // the near-duplicates crawler --dedup listed, if it did; otherwise
+    // one set of fingerprints, so near-duplicates are found across shards
+    counters_t* duplicates = NULL;
+    if (dedup && !pagedir_duplicates(pageDirectory, &duplicates)) {
+        fprintf(stderr, "Failed to read the duplicates listed in '%s'\n", pageDirectory);
+        wordnorm_delete(norm);
+        exit(3);
+    }
+    fpindex_t* fingerprints = (dedup && duplicates == NULL) ? fpindex_new() : NULL;
+    if (dedup && duplicates == NULL && fingerprints == NULL) {
+        fprintf(stderr, "Failed to create the page fingerprints\n");
+        wordnorm_delete(norm);
+        exit(3);
+    }
+    int skipped = 0;
+
+    // Index every page into one index file, or each docID range into a
+    // shard of its own, listing the shards last
+    bool ok = true;
+    if (numShards == 0) {
+        indexshards_remove(indexFilename);
+        ok = indexRange(pageDirectory, indexFilename, duplicates, fingerprints, keepPositions, norm, budget,
+                        1, INT_MAX, &skipped);
+    } else {
+        int numPages = countPages(pageDirectory);
+        int first[INDEXSHARDS_MAX];
+        int last[INDEXSHARDS_MAX];
+        for (int shard = 0; ok && shard < numShards; shard++) {
+            first[shard] = 1 + (int) ((long long) numPages * shard / numShards);
+            last[shard] = (int) ((long long) numPages * (shard + 1) / numShards);
+            char* shardFilename = indexshards_name(indexFilename, shard);
+            ok = shardFilename != NULL
+                 && indexRange(pageDirectory, shardFilename, duplicates, fingerprints,
+                               keepPositions, norm, budget, first[shard], last[shard],
+                               &skipped);
+            free(shardFilename);
+        }
+        if (ok && !indexshards_save(indexFilename, first, last, numShards)) {
+            fprintf(stderr, "Failed to save the list of shards for '%s'\n", indexFilename);
+            ok = false;
+        } else if (ok) {
+            fprintf(stderr, "Indexed %d pages into %d shards\n", numPages, numShards);
+        }
+    }
+    if (dedup) {
+        fprintf(stderr, "Skipped %d near-duplicate pages%s\n", skipped,
+                (duplicates != NULL) ? " listed by the crawler" : "");
+    }
+
+    // Clean up
+    wordnorm_delete(norm);
+    fpindex_delete(fingerprints);
+    counters_delete(duplicates);
+    return ok ? 0 : 3;
+}
+
+/**************** indexRange() ****************/
+/* Builds the index of the pages firstDoc through lastDoc (or the first
+ * missing page) and saves it to indexFilename, with the page lengths,
+ * positions (if keepPositions) and word normalization beside it. With
+ * a budget, the index is built in sorted runs (see indexruns.h).
+ * The pages in duplicates and near-duplicates of pages in fingerprints
+ * are skipped, and counted in *skipped. Returns false if the index could not be created, leaving
+ * any sorted runs on disk. */
+static bool indexRange(char* pageDirectory, char* indexFilename, counters_t* duplicates,
+                       fpindex_t* fingerprints, const bool keepPositions, wordnorm_t* norm, const size_t budget,
+                       const int firstDoc, const int lastDoc, int* skipped) {
     // Create a new index
     index_t* index = index_new(800);
-    if (index->ht == NULL){
+    if (index == NULL || index->ht == NULL){
         fprintf(stderr, "Failed to create index\n");
-        exit(3);
+        return false;
     }
 
-    // Build the index from the page directory
-    index_build(pageDirectory, index);
+    // Build the index from the page directory, noting page lengths
+    docstats_t* stats = docstats_new();
+    positions_t* positions = keepPositions ? positions_new(800) : NULL;
+    if (keepPositions && positions == NULL) {
+        fprintf(stderr, "Failed to create positions\n");
+        docstats_delete(stats);
+        index_delete(index);
+        return false;
+    }
+    indexruns_t* runs = (budget > 0) ? indexruns_new(indexFilename, budget) : NULL;
+    if (budget > 0 && runs == NULL) {
+        fprintf(stderr, "Failed to create the sorted runs\n");
+        positions_delete(positions);
+        docstats_delete(stats);
+        index_delete(index);
+        return false;
+    }
+    *skipped += index_build(pageDirectory, index, duplicates, fingerprints, stats, positions,
+                            norm, runs, firstDoc, lastDoc);
 
-    // Save the index to a file
-    index_save(indexFilename, index);
+    // Save the index to a file, merging any runs into it, and the page
+    // lengths beside it
+    bool ok = true;
+    if (runs == NULL) {
+        if (!index_save(indexFilename, index)) {
+            fprintf(stderr, "Failed to save the index to '%s'\n", indexFilename);
+            ok = false;
+        }
+    } else {
+        ok = indexruns_flush(runs, index);
+        if (!ok) {
+            fprintf(stderr, "Failed to write a sorted run for '%s'\n", indexFilename);
+        }
+        int num_runs = indexruns_count(runs);
+        if (ok && !indexruns_merge(runs, indexFilename)) {
+            fprintf(stderr, "Failed to merge the sorted runs into '%s'\n", indexFilename);
+            ok = false;
+        } else if (ok) {
+            fprintf(stderr, "Merged %d sorted runs\n", num_runs);
+        }
+        // the runs are all there is of the index if it could not be made
+        if (!ok) {
+            fprintf(stderr, "Sorted runs kept as '%s.run*'\n", indexFilename);
+        }
+        indexruns_delete(runs, !ok);
+    }
+    if (stats == NULL || !docstats_save(stats, indexFilename)) {
+        fprintf(stderr, "Failed to save document lengths for '%s'\n", indexFilename);
+    }
+    if (positions != NULL && !positions_save(positions, indexFilename)) {
+        fprintf(stderr, "Failed to save word positions for '%s'\n", indexFilename);
+    }
+    if (!wordnorm_save(norm, indexFilename)) {
+        fprintf(stderr, "Failed to save the word normalization for '%s'\n", indexFilename);
+    }
 
-    // Clean up
+    positions_delete(positions);
+    docstats_delete(stats);
     index_delete(index);
+    return ok;
+}
 
-    return 0;
+/**************** countPages() ****************/
+/* Counts the pages of a page directory: docIDs 1, 2, ... up to the
+ * first missing one, as index_build reads them. */
+static int countPages(char* pageDirectory) {
+    int numPages = 0;
+    char filename[16];
+    while (true) {
+        sprintf(filename, "%d", numPages + 1);
+        char* pathname = get_pathname(pageDirectory, filename);
+        FILE* fp = (pathname == NULL) ? NULL : fopen(pathname, "r");
+        free(pathname);
+        if (fp == NULL) {
+            return numPages;
+        }
+        fclose(fp);
+        numPages++;
+    }
 }
 
 /**************** index_build() ****************/
 /* see indexer.h for more information */
-void index_build(char* pageDirectory, index_t* index) {
-    int docID = 1;
+int index_build(char* pageDirectory, index_t* index, counters_t* duplicates,
+                fpindex_t* fingerprints, docstats_t* stats,
+                positions_t* positions, wordnorm_t* norm, indexruns_t* runs,
+                const int firstDoc, const int lastDoc) {
+    int docID = firstDoc;
     webpage_t* page;
     char filename[16];
     char* pathname;
     FILE* fp;
+    int skipped = 0;
 
     sprintf(filename, "%d", docID);
     pathname = get_pathname(pageDirectory, filename);
-    fp = fopen(pathname, "r");
+    fp = (docID <= lastDoc) ? fopen(pathname, "r") : NULL;
 
     while (fp != NULL) {
         fclose(fp);
@@ -76,12 +262,31 @@ void index_build(char* pageDirectory, index_t* index) {
             docID++;
             sprintf(filename, "%d", docID);
             pathname = get_pathname(pageDirectory, filename);
-            fp = fopen(pathname, "r");
+            fp = (docID <= lastDoc) ? fopen(pathname, "r") : NULL;
             continue;
         }
 
-        // Passes the webpage and docID to indexPage
-        indexPage(page, docID, index);
+        // Skip a page the crawler listed as a near-duplicate, or whose
+        // text nearly matches one already indexed
+        uint64_t fingerprint;
+        if (duplicates != NULL && counters_get(duplicates, docID) != 0) {
+            skipped++;
+        } else if (fingerprints != NULL && simhash_page(page, &fingerprint)) {
+            if (fpindex_find(fingerprints, fingerprint) != 0) {
+                skipped++;
+            } else {
+                fpindex_insert(fingerprints, fingerprint, docID);
+                docstats_set(stats, docID, indexPage(page, docID, index, positions, norm));
+            }
+        } else {
+            // Passes the webpage and docID to indexPage
+            docstats_set(stats, docID, indexPage(page, docID, index, positions, norm));
+        }
+
+        // Past the memory budget, write what is indexed as a sorted run
+        if (runs != NULL && !indexruns_check(runs, index)) {
+            fprintf(stderr, "Failed to write a sorted run; keeping the index in memory\n");
+        }
 
         // Clean up after processing the page
         webpage_delete(page);
@@ -91,19 +296,22 @@ void index_build(char* pageDirectory, index_t* index) {
         docID++;
         sprintf(filename, "%d", docID);
         pathname = get_pathname(pageDirectory, filename);
-        fp = fopen(pathname, "r");
+        fp = (docID <= lastDoc) ? fopen(pathname, "r") : NULL;
     }
     free(pathname);  // Free the last pathname allocated
+    return skipped;
 }
 
 /**************** indexPage() ****************/
 /* see indexer.h for more information */
-void indexPage(webpage_t* page, int docID, index_t* index) {
+int indexPage(webpage_t* page, int docID, index_t* index, positions_t* positions,
+              wordnorm_t* norm) {
     int pos = 0;
+    int length = 0;
     char* word;
     while ((word = webpage_getNextWord(page, &pos)) != NULL) {
         if (strlen(word) >= 3) {  
-            char* normalized_word = normalize(word);  
+            char* normalized_word = wordnorm_apply(norm, word);  
             if (normalized_word != NULL) {
                 counters_t* wordcounts = hashtable_find(index->ht, normalized_word);
                 if (wordcounts == NULL) {
@@ -121,9 +329,17 @@ void indexPage(webpage_t* page, int docID, index_t* index) {
                         free(word);
                         continue;
                     }
+                    index->num_words++;
                 } 
                 int current_count = counters_get(wordcounts, docID);
                 counters_set(wordcounts, docID, current_count + 1); 
+                if (current_count == 0) {
+                    index->num_postings++;
+                }
+                if (positions != NULL && !positions_add(positions, normalized_word, docID, length)) {
+                    fprintf(stderr, "Failed to record the position of '%s'\n", normalized_word);
+                }
+                length++;
             } 
             free(normalized_word);
             free(word);
@@ -132,4 +348,5 @@ void indexPage(webpage_t* page, int docID, index_t* index) {
             free(word);  // Free word if it's shorter than 3 characters
         }
     }
+    return length;
 }
@@ -12,9 +12,16 @@
 #define __INDEXER_H
 
 #include "../libcs50/hashtable.h"
+#include "../libcs50/counters.h"
 #include "../libcs50/webpage.h"
+#include "../common/docstats.h"
+#include "../common/positions.h"
+#include "../common/simhash.h"
+#include "../common/word.h"
+#include <stdbool.h>
 
 typedef hashtable_t index_t;
+typedef struct indexruns indexruns_t;  // see indexruns.h
 
 
 /**************** functions ****************/
@@ -24,31 +31,64 @@ typedef hashtable_t index_t;
  * 
  * Caller provides:
  *   the directory path where the pages are stored (pageDirectory),
- *   and an allocated hashtable to store the index.
+ *   an allocated hashtable to store the index, the near-duplicate pages
+ *   crawler --dedup listed, to skip (duplicates, as pagedir_duplicates
+ *   reads them; NULL if none), the fingerprints of the pages indexed so
+ *   far, to skip near-duplicates of them (fingerprints; NULL to index
+ *   every page not in duplicates), where to record each indexed
+ *   page's length (stats; NULL if not wanted), where to record the
+ *   position of every word indexed (positions; NULL if not wanted),
+ *   the pipeline to normalize words with (norm; see word.h), and the
+ *   sorted runs to write the index out to whenever it reaches their
+ *   memory budget (runs; NULL to hold the whole index in memory),
+ *   and the docIDs to index, firstDoc through lastDoc (INT_MAX for
+ *   every page from firstDoc on).
  * We do:
- *   iterate over each page in the directory, loading the page data,
- *   and adding each valid word (length >= 3) to the index.
+ *   iterate over each page in the range, loading the page data,
+ *   and adding each valid word (length >= 3) to the index, stopping
+ *   early at a missing page.
  *   The index is a hashtable where each word maps to a counters object.
  *   Each counters object holds document IDs and counts of word occurrences.
  * Caller is responsible for:
  *   providing a valid page directory and an allocated hashtable for indexing.
+ *   With fingerprints, each page's SimHash (see simhash.h) is compared
+ *   with those of the pages already indexed, here or into another shard,
+ *   and a page within SIMHASH_DISTANCE bits of one is left out of the
+ *   index entirely; the others' fingerprints are added.
+ * We return:
+ *   the number of near-duplicate pages skipped.
  * Notes:
  *   If an error occurs (e.g., page loading fails), a message is printed to stderr.
+ *   Crawls made with crawler --dedup still hold their near-duplicates,
+ *   listed in pageDirectory/.duplicates; the indexer passes that list
+ *   as duplicates, and no fingerprints, so the pages skipped are the
+ *   ones the crawler found.
  */
-void index_build(char* pageDirectory, index_t* index);
+int index_build(char* pageDirectory, index_t* index, counters_t* duplicates,
+                fpindex_t* fingerprints, docstats_t* stats,
+                positions_t* positions, wordnorm_t* norm, indexruns_t* runs,
+                const int firstDoc, const int lastDoc);
 
 /**************** indexPage ****************/
 /* Processes each page, adding words and their occurrences to the index.
  * 
  * Caller provides:
- *   a loaded webpage (page), document ID (docID), and an index (hashtable).
+ *   a loaded webpage (page), document ID (docID), an index (hashtable),
+ *   positions to record each word's place in the page in (NULL if
+ *   not wanted), and the pipeline to normalize words with (NULL to
+ *   only lowercase them).
  * We do:
- *   extract each word from the webpage, normalize it, and if its length
- *   is >= 3, add it to the hashtable. If the word already exists, increment
- *   the count in the corresponding document's counters.
+ *   extract each word from the webpage, and if its length is >= 3,
+ *   normalize it through the pipeline (lowercased, and stemmed if the
+ *   pipeline stems) and add it to the hashtable. If the word already exists, increment
+ *   the count in the corresponding document's counters. A word's position
+ *   is the number of words added before it.
+ * We return:
+ *   the number of words added (the page's length, for docstats).
  * Caller is responsible for:
  *   ensuring the page, docID, and index are valid.
  */
-void indexPage(webpage_t* page, int docID, index_t* index);
+int indexPage(webpage_t* page, int docID, index_t* index, positions_t* positions,
+              wordnorm_t* norm);
 
 #endif // __INDEXER_H
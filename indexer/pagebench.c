@@ -0,0 +1,232 @@
+/*
+ * pagebench.c - compare the indexer's read speed on raw and compressed pages
+ *
+ * usage: ./pagebench pageDirectory lzDirectory [passes]
+ *
+ * Copies every page in pageDirectory (a crawler directory) into
+ * lzDirectory with lzblock compression, reports the disk space each copy
+ * uses, and then times the indexer's read path on both: pagedir_load
+ * every page and split it into words as indexPage does. The first pass
+ * over each directory starts with the page files dropped from the page
+ * cache (posix_fadvise), to approximate a cold read from disk; the rest
+ * are warm, and the best of them is reported.
+ *
+ * Exit status: 0 on success, 1 on bad arguments, 2 if a directory is
+ * unusable, 3 if a compressed page does not load back identical.
+ *
+ * Manzi Fabrice Niyigaba, October 2024
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "../libcs50/webpage.h"
+#include "../common/pagedir.h"
+
+/**************** local functions ****************/
+static int compressPages(const char* rawDirectory, const char* lzDirectory);
+static long long diskUsage(const char* pageDirectory, const int numPages, long long* blocks);
+static double readPass(const char* pageDirectory, const int numPages, const bool cold,
+                       long long* htmlBytes);
+static char* pagePath(const char* pageDirectory, const int docID);
+static double now(void);
+
+static const int DEFAULT_PASSES = 5;
+
+/**************** main() ****************/
+int main(const int argc, char* argv[])
+{
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "usage: %s pageDirectory lzDirectory [passes]\n", argv[0]);
+        return 1;
+    }
+    int passes = (argc == 4) ? atoi(argv[3]) : DEFAULT_PASSES;
+    if (passes < 2) {
+        fprintf(stderr, "passes must be at least 2\n");
+        return 1;
+    }
+    const char* rawDirectory = argv[1];
+    const char* lzDirectory = argv[2];
+    if (pagedir_verify(rawDirectory) != 0) {
+        fprintf(stderr, "Not a crawler directory: %s\n", rawDirectory);
+        return 2;
+    }
+    if ((mkdir(lzDirectory, 0755) != 0 && errno != EEXIST) || !pagedir_init(lzDirectory)) {
+        fprintf(stderr, "Cannot use directory: %s\n", lzDirectory);
+        return 2;
+    }
+
+    int numPages = compressPages(rawDirectory, lzDirectory);
+    if (numPages < 0) {
+        return 3;
+    }
+    if (numPages == 0) {
+        fprintf(stderr, "No pages in %s\n", rawDirectory);
+        return 2;
+    }
+
+    const char* dirs[2] = { rawDirectory, lzDirectory };
+    const char* names[2] = { "raw", "lzblock" };
+    long long rawSize = 0;
+    printf("%d pages\n", numPages);
+    printf("%-8s %12s %12s %10s %10s %10s %10s\n",
+           "storage", "bytes", "on disk", "ratio", "cold MB/s", "warm MB/s", "pages/s");
+    for (int d = 0; d < 2; d++) {
+        long long blocks;
+        long long size = diskUsage(dirs[d], numPages, &blocks);
+        if (d == 0) {
+            rawSize = size;
+        }
+        long long htmlBytes = 0;
+        double cold = readPass(dirs[d], numPages, true, &htmlBytes);
+        double warm = readPass(dirs[d], numPages, false, &htmlBytes);
+        for (int p = 2; p < passes; p++) {
+            double t = readPass(dirs[d], numPages, false, &htmlBytes);
+            if (t < warm) {
+                warm = t;
+            }
+        }
+        double mb = htmlBytes / 1e6;
+        printf("%-8s %12lld %12lld %10.2f %10.1f %10.1f %10.0f\n",
+               names[d], size, blocks * 512, (double) rawSize / size,
+               mb / cold, mb / warm, numPages / warm);
+    }
+    printf("MB/s counts the HTML delivered to the indexer, not the bytes read from disk.\n");
+    return 0;
+}
+
+/**************** compressPages() ****************/
+/* Copy pages 1, 2, ... from rawDirectory into lzDirectory, compressed,
+ * and check each loads back the same; return the number of pages, or -1.
+ */
+static int compressPages(const char* rawDirectory, const char* lzDirectory)
+{
+    int docID = 1;
+    for (;; docID++) {
+        char* pathname = pagePath(rawDirectory, docID);
+        if (access(pathname, R_OK) != 0) {
+            free(pathname);
+            break;
+        }
+        webpage_t* page = pagedir_load(pathname);
+        free(pathname);
+        if (page == NULL) {
+            return -1;
+        }
+
+        // the loaded HTML ends in the newline pagedir_commit adds back
+        const char* html = webpage_getHTML(page);
+        size_t len = strlen(html);
+        if (len > 0 && html[len - 1] == '\n') {
+            len--;
+        }
+        pagewriter_t* writer = pagedir_begin(lzDirectory, webpage_getURL(page),
+                                             webpage_getDepth(page), true);
+        if (writer == NULL || !pagedir_write(writer, html, len)
+            || !pagedir_commit(writer, docID)) {
+            pagedir_abort(writer);
+            webpage_delete(page);
+            return -1;
+        }
+
+        pathname = pagePath(lzDirectory, docID);
+        webpage_t* copy = pagedir_load(pathname);
+        free(pathname);
+        bool same = copy != NULL && strcmp(webpage_getHTML(copy), html) == 0
+            && strcmp(webpage_getURL(copy), webpage_getURL(page)) == 0
+            && webpage_getDepth(copy) == webpage_getDepth(page);
+        webpage_delete(copy);
+        webpage_delete(page);
+        if (!same) {
+            fprintf(stderr, "Page %d does not load back identical\n", docID);
+            return -1;
+        }
+    }
+    return docID - 1;
+}
+
+/**************** diskUsage() ****************/
+/* Return the total size of pages 1..numPages; *blocks gets the number of
+ * 512-byte blocks they occupy.
+ */
+static long long diskUsage(const char* pageDirectory, const int numPages, long long* blocks)
+{
+    long long size = 0;
+    *blocks = 0;
+    for (int docID = 1; docID <= numPages; docID++) {
+        char* pathname = pagePath(pageDirectory, docID);
+        struct stat st;
+        if (stat(pathname, &st) == 0) {
+            size += st.st_size;
+            *blocks += st.st_blocks;
+        }
+        free(pathname);
+    }
+    return size;
+}
+
+/**************** readPass() ****************/
+/* Load and tokenize pages 1..numPages as the indexer does, first dropping
+ * them from the page cache if cold; return the seconds taken, and set
+ * *htmlBytes to the HTML delivered.
+ */
+static double readPass(const char* pageDirectory, const int numPages, const bool cold,
+                       long long* htmlBytes)
+{
+    if (cold) {
+        for (int docID = 1; docID <= numPages; docID++) {
+            char* pathname = pagePath(pageDirectory, docID);
+            int fd = open(pathname, O_RDONLY);
+            if (fd >= 0) {
+                fdatasync(fd);      // dirty pages would stay cached
+                posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                close(fd);
+            }
+            free(pathname);
+        }
+    }
+
+    *htmlBytes = 0;
+    double start = now();
+    for (int docID = 1; docID <= numPages; docID++) {
+        char* pathname = pagePath(pageDirectory, docID);
+        webpage_t* page = pagedir_load(pathname);
+        free(pathname);
+        if (page == NULL) {
+            continue;
+        }
+        *htmlBytes += strlen(webpage_getHTML(page));
+        int pos = 0;
+        char* word;
+        while ((word = webpage_getNextWord(page, &pos)) != NULL) {
+            free(word);
+        }
+        webpage_delete(page);
+    }
+    return now() - start;
+}
+
+/**************** pagePath() ****************/
+/* Return the malloc'd pathname of a page file */
+static char* pagePath(const char* pageDirectory, const int docID)
+{
+    char filename[16];
+    snprintf(filename, sizeof(filename), "%d", docID);
+    return get_pathname(pageDirectory, filename);
+}
+
+/**************** now() ****************/
+/* Return a monotonic time in seconds */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -105,6 +105,95 @@ else
 fi
 echo ""
 
+# Test 10: Near-duplicate pages left out of the index
+echo "Running --dedup indexing test on wikipedia directory..."
+./indexer ../data/wikipedia ../data/wikipedia.index
+./indexer ../data/wikipedia ../data/wikipedia-dedup.index --dedup
+echo "Index lines without --dedup: $(wc -l < ../data/wikipedia.index), with: $(wc -l < ../data/wikipedia-dedup.index)"
+echo ""
+
+# Test 11: Document lengths saved beside the index, one line per page
+echo "Checking the document lengths saved with the letters index..."
+if [ -f ../data/letters.index.docs ] \
+    && [ "$(wc -l < ../data/letters.index.docs)" -eq "$(ls ../data/letters | grep -c '^[0-9]*$')" ]; then
+    echo "Indexer saved one length per page in letters.index.docs"
+else
+    echo "Indexer did not save the document lengths"
+fi
+echo ""
+
+# Test 12: Word positions saved beside the index with --positions
+echo "Checking the word positions saved with --positions..."
+./indexer ../data/letters /tmp/letters_positions.index --positions >> testing.out 2>&1
+if head -1 /tmp/letters_positions.index.pos 2>/dev/null | grep -q "^positions 1$" \
+    && cmp -s /tmp/letters_positions.index ../data/letters.index; then
+    echo "Indexer saved positions, and the same index as without them"
+else
+    echo "Indexer did not save the word positions"
+fi
+rm -f /tmp/letters_positions.index /tmp/letters_positions.index.docs /tmp/letters_positions.index.pos /tmp/letters_positions.index.norm
+echo ""
+
+# Test 13: Stemmed words with --stem, and the pipeline saved beside the index
+echo "Checking the words indexed with --stem..."
+./indexer ../data/wikipedia /tmp/wikipedia_stem.index --stem >> testing.out 2>&1
+if [ "$(cat /tmp/wikipedia_stem.index.norm 2>/dev/null)" = "lower stem" ] \
+    && [ "$(cat ../data/letters.index.norm 2>/dev/null)" = "lower" ] \
+    && grep -q "^search " /tmp/wikipedia_stem.index && ! grep -q "^searching " /tmp/wikipedia_stem.index; then
+    echo "Indexer indexed 'searching' as 'search' and saved its pipeline"
+else
+    echo "Indexer did not stem the words"
+fi
+rm -f /tmp/wikipedia_stem.index /tmp/wikipedia_stem.index.docs /tmp/wikipedia_stem.index.norm
+echo ""
+
+# Test 14: A memory budget writes sorted runs and merges them into the same index
+echo "Checking the index built in sorted runs with --memory..."
+./indexer ../data/wikipedia /tmp/wikipedia_runs.index --memory=200000 >> testing.out 2>&1
+if [ "$(LC_ALL=C sort ../data/wikipedia.index | md5sum)" = "$(md5sum < /tmp/wikipedia_runs.index)" ] \
+    && [ -z "$(ls /tmp/wikipedia_runs.index.run* 2>/dev/null)" ]; then
+    echo "Indexer merged its runs into the sorted lines of the in-memory index"
+else
+    echo "Indexer built a different index in sorted runs"
+fi
+rm -f /tmp/wikipedia_runs.index /tmp/wikipedia_runs.index.docs /tmp/wikipedia_runs.index.norm
+echo ""
+
+# Test 15: --shards splits the pages into docID ranges, an index for each
+echo "Checking the index split into shards with --shards=3..."
+./indexer ../data/wikipedia /tmp/wikipedia_shards.index --shards=3 >> testing.out 2>&1
+if [ "$(wc -l < /tmp/wikipedia_shards.index.shards 2>/dev/null)" = "3" ] \
+    && [ ! -e /tmp/wikipedia_shards.index ] \
+    && [ "$(cat /tmp/wikipedia_shards.index.shard[012].docs 2>/dev/null | sort | md5sum)" \
+         = "$(sort ../data/wikipedia.index.docs | md5sum)" ]; then
+    echo "Indexer split the pages among three shards and listed them"
+else
+    echo "Indexer did not split the index into shards"
+fi
+rm -f /tmp/wikipedia_shards.index.shards /tmp/wikipedia_shards.index.shard*
+echo ""
+
+# Test 16: --dedup skips the near-duplicates a crawler --dedup listed
+echo "Checking that --dedup skips the pages listed in .duplicates..."
+rm -rf /tmp/letters_dedup && cp -r ../data/letters /tmp/letters_dedup
+echo "3 1 $(head -1 /tmp/letters_dedup/3)" > /tmp/letters_dedup/.duplicates
+./indexer /tmp/letters_dedup /tmp/letters_dedup.index --dedup 2> /tmp/letters_dedup.err
+if grep -q "^Skipped 1 near-duplicate pages listed by the crawler$" /tmp/letters_dedup.err \
+    && ! grep -q "^3 " /tmp/letters_dedup.index.docs \
+    && [ "$(wc -l < /tmp/letters_dedup.index.docs)" -eq "$(( $(wc -l < ../data/letters.index.docs) - 1 ))" ]; then
+    echo "Indexer left out the one page the crawler listed"
+else
+    echo "Indexer did not skip the pages the crawler listed"
+fi
+echo "3 http://example.com/" > /tmp/letters_dedup/.duplicates
+if ./indexer /tmp/letters_dedup /tmp/letters_dedup.index --dedup >> testing.out 2>&1; then
+    echo "Indexer accepted a malformed .duplicates"
+else
+    echo "Indexer refused a malformed .duplicates"
+fi
+rm -rf /tmp/letters_dedup /tmp/letters_dedup.index* /tmp/letters_dedup.err
+echo ""
+
 # Write only the contents of the index file to indexer.out
 cat ../data/letters.index > indexer.out
 
@@ -12,7 +12,7 @@
 /* students shouldn't take advantage of the gnu extensions, 
  * but parsing html without them is a pain.
  */
-#define _GNU_SOURCE       // strncasecmp, strdup
+#define _GNU_SOURCE       // strncasecmp, strdup, asprintf, MSG_NOSIGNAL
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -20,7 +20,10 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <errno.h>
 #include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
 #include "file.h"
 #include "webpage.h"
 #include "mem.h"
@@ -46,12 +49,54 @@ typedef struct webpage {
   int depth;                               // depth of crawl
 } webpage_t;
 
+/* hostaddr_t: a resolved server address, kept in the host cache */
+typedef struct hostaddr {
+  char* hostname;                          // host name as in the URL
+  int port;                                // port number
+  struct sockaddr_storage addr;            // its address
+  socklen_t addrlen;                       // length of addr
+  int family, socktype, protocol;          // for socket()
+  struct hostaddr* next;                   // next in the cache
+} hostaddr_t;
+
+/* conn_t: an open connection to a server, with a small read buffer */
+typedef struct conn {
+  int sock;                                // the socket
+  char* hostname;                          // server it is connected to
+  int port;                                // ... and on which port
+  char buf[8192];                          // bytes received, not yet read
+  size_t start, end;                       // unread bytes are buf[start..end)
+  struct conn* next;                       // next idle connection in pool
+} conn_t;
+
+/* bodybuf_t: a growing buffer for a page body */
+typedef struct bodybuf {
+  char* data;                              // the body so far, or NULL
+  size_t len;                              // bytes in data
+  size_t size;                             // bytes allocated
+} bodybuf_t;
+
 /* *********************************************************************** */
 /* Private function prototypes */
 
-static FILE* connectToHost(const char* hostname, const int port);
+static bool resolveHost(const char* hostname, const int port, hostaddr_t* addr);
+static conn_t* connAcquire(const char* hostname, const int port, bool* reused);
+static void connRelease(conn_t* conn);
+static void connClose(conn_t* conn);
+static bool sendAll(const int sock, const char* buf, size_t len);
+static bool connFill(conn_t* conn);
+static char* connReadLine(conn_t* conn);
+static bool connReadBody(conn_t* conn, size_t n, 
+                         bool (*sink)(void* arg, const char* data, const size_t len),
+                         void* arg, bool* delivered);
+static bool bodyAppend(void* arg, const char* data, const size_t len);
+static bool readResponse(conn_t* conn, int* status, 
+                         bool (*sink)(void* arg, const char* data, const size_t len),
+                         void* arg, bool* keepAlive, bool* failedEarly, 
+                         bool* delivered);
 static inline bool isBlankLine(const char* line);
-static char* removeDotSegments(char* input);
+static char* squeezeDotSegments(char* path, char* end);
+static bool hasKnownExt(const char* path, const char* end);
 static void removeWhitespace(char* str);
 static char* fixRelativeURL(char* base, char* rel, size_t len);
 static bool parseURL(const char* str, struct URL* url);
@@ -67,6 +112,13 @@ static void printURL(struct URL url);
 
 static const int MAX_TRY = 3;    // maximum attempts to fetch
 static const int HTTP_PORT = 80; // default web server port
+static const int MAX_IDLE = 64;  // most idle connections kept open
+
+/* the connection pool and host cache, shared by all threads */
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static conn_t* idleConns = NULL;       // idle keep-alive connections
+static int numIdle = 0;                // number of idle connections
+static hostaddr_t* hostCache = NULL;   // hosts already resolved
 
 static const char* EXTS[] = {  // valid extensions
   "html",
@@ -126,6 +178,32 @@ webpage_delete(void* data)
 
 
 /* ************* webpage_fetch ******************** */
+/* see webpage.h for usage documentation.
+ *
+ * Collects the body from webpage_fetchStream into one buffer.
+ */
+bool 
+webpage_fetch(webpage_t* page)
+{
+  // check webpage structure - must have URL and not yet have HTML
+  if (page == NULL || page->url == NULL || page->html != NULL) {
+    return false;
+  }
+
+  bodybuf_t buf = { NULL, 0, 0 };
+  if (!webpage_fetchStream(page, bodyAppend, &buf)) {
+    free(buf.data);
+    return false;
+  }
+  if (buf.data == NULL && (buf.data = calloc(1, sizeof(char))) == NULL) {
+    return false;                       // empty page, and out of memory
+  }
+  page->html = buf.data;
+  page->html_len = buf.len;
+  return true;
+}
+
+/* ************* webpage_fetchStream ******************** */
 /* see webpage.h for usage documentation.
  *
  * Limitations:
@@ -136,16 +214,20 @@ webpage_delete(void* data)
  * Pseudocode:
  *     1. check for valid page 
  *     2. parse url into hostname, port, and filename
- *     3. open a connection to the given host
+ *     3. take an idle connection to the host from the pool, or open one
  *     4. send http request
- *     5. fetch html response
- *     6. cleanup
+ *     5. read the response, passing the body to the sink as it arrives,
+ *        and using its Content-Length or chunks to find its end
+ *     6. return the connection to the pool if the server keeps it open
+ *     7. cleanup
  */
-bool 
-webpage_fetch(webpage_t* page)
+bool
+webpage_fetchStream(webpage_t* page, 
+                    bool (*sink)(void* arg, const char* data, const size_t len),
+                    void* arg)
 {
   // check webpage structure - must have URL and not yet have HTML
-  if (page == NULL || page->url == NULL || page->html != NULL) {
+  if (page == NULL || page->url == NULL || page->html != NULL || sink == NULL) {
     return false;
   }
 
@@ -158,70 +240,85 @@ webpage_fetch(webpage_t* page)
     return false;
   }
 
-  // attempt to connect to server 
-  FILE* http_fp = NULL; 
-  for (int try = 0;  http_fp == NULL && try < MAX_TRY; try++) {
-    // open connection - exit on error
-    http_fp = connectToHost(hostname, port);
+  // prepare the HTTP request
+  const char* httpFormat =
+    "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n\r\n";
+  char* request = NULL;
+  if (asprintf(&request, httpFormat, pathname, hostname) < 0) {
+    request = NULL;
+  }
+
+  // send it and read the response, retrying a few times on failure
+  int status = 0;
+  bool received = false;
+  bool delivered = false;      // has the sink seen any of the body?
+  for (int try = 0; request != NULL && !received && try < MAX_TRY; ) {
+    bool reused;
+    conn_t* conn = connAcquire(hostname, port, &reused);
+    bool keepAlive = false;
+    bool failedEarly = false;
+
+    if (conn != NULL) {
+      if (sendAll(conn->sock, request, strlen(request))) {
+        received = readResponse(conn, &status, sink, arg, 
+                                &keepAlive, &failedEarly, &delivered);
+      } else {
+        failedEarly = true;
+      }
+      if (received && keepAlive) {
+        connRelease(conn);
+      } else {
+        connClose(conn);
+      }
+    }
+
+    // the sink cannot take back what it has seen, so no retry after that
+    if (!received && delivered) {
+      break;
+    }
+    // a pooled connection the server has since closed is not a failed
+    // attempt; try again right away on a fresh connection
+    if (!received && reused && failedEarly) {
+      continue;
+    }
+    try++;
 
 #ifndef NOSLEEP // CS50 students: please don't turn off the sleep!
     sleep(1);   // sleep one second between fetches, to lighten load on server
 #endif
   }
 
-  // failed to connect?
-  if (http_fp == NULL) {
-    return false;
-  }
-
-  // prepare and send HTTP request; receive response
-  char* httpResponse = NULL;
-  const char* httpFormat =
-    "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n";
-  if (fprintf(http_fp, httpFormat, pathname, hostname) >= 0) {
-    // ensure stdio buffer is flushed to socket
-    fflush(http_fp);
-    // read the server's response
-    httpResponse = file_readLine(http_fp);
-  }
-
+  free(request);
   free(hostname);
   free(pathname);
 
-  // did we succeed? check the response
-  bool success = false;
-
-  if (httpResponse != NULL) {
-    // check response code to see whether we succeeded
-    int httpResponseCode = 0;
-    if (sscanf(httpResponse, "HTTP/1.1 %d", &httpResponseCode) == 1
-        && httpResponseCode == 200) {
-      // success! ignore the rest of the header, then grab the page
-      // read lines until we read a blank line or fail to read a line
-      char* line = file_readLine(http_fp);
-      while (line != NULL && !isBlankLine(line)) {
-        free(line);
-        line = file_readLine(http_fp);
-      }
-      // did we exit the loop because we read an empty line?
-      if (line != NULL) {
-        free(line); // the blank line
-
-        // then grab everything else - that should be the page content
-        char* html = file_readFile(http_fp);
-        if (html != NULL) {
-          page->html = html;
-          success = true;
-        } 
-      }
-    }
-    free(httpResponse);
-  }
-
-  // clean up
-  fclose(http_fp);
+  return received && status == 200;
+}
 
-  return success;
+/**************** webpage_closeConnections ****************/
+/* see webpage.h for documentation */
+void
+webpage_closeConnections(void)
+{
+  pthread_mutex_lock(&poolLock);
+  conn_t* conn = idleConns;
+  idleConns = NULL;
+  numIdle = 0;
+  hostaddr_t* addr = hostCache;
+  hostCache = NULL;
+  pthread_mutex_unlock(&poolLock);
+
+  while (conn != NULL) {
+    conn_t* next = conn->next;
+    connClose(conn);
+    conn = next;
+  }
+  while (addr != NULL) {
+    hostaddr_t* next = addr->next;
+    free(addr->hostname);
+    free(addr);
+    addr = next;
+  }
 }
 
 /**************** webpage_getNextWord ****************/
@@ -443,12 +540,9 @@ webpage_getNextURL(webpage_t* page, int* pos)
  *
  * Pseudocode:
  *     1. check arguments
- *     2. try to parse url
- *     3. check any file extensions
- *     4. clear the url
- *     5. remove dot segments and lowercase scheme and host
- *     6. allocate space for the new url string
- *     7. assemble the new url from pieces
+ *     2. allocate space for the new url string, which will be no
+ *        longer than url
+ *     3. let webpage_canonicalURL parse and normalize it there
  */
 char*
 normalizeURL(const char* url)
@@ -457,77 +551,14 @@ normalizeURL(const char* url)
     return NULL;
   }
 
-  // try to parse the url
-  struct URL tmp;               // pieces of the parsed url
-  if (!parseURL(url, &tmp)) {
-    freeURL(tmp);
-    return NULL;
-  }
-
-  // check file extension
-  if (tmp.path != NULL) {               // if we have a path
-    char* dot = strrchr(tmp.path, '.');   // where is last '.' within string
-    char* slash = strrchr(tmp.path, '/'); // where is last '/' within string
-
-    // We expect to see URL of form /path/to/file.ext
-    if (dot != NULL && slash != NULL && dot > slash) {
-      char* ext = dot+1;                  // extension begins after '.'
-
-      // check against list of known extensions
-      if (strlen(ext) > 0) {
-        bool isKnownExt = false;      // is the extension valid?
-        for (int i = 0; EXTS[i] != NULL; i++) {
-          if (strncasecmp(ext, EXTS[i], strlen(EXTS[i])) == 0) {
-            isKnownExt = true;
-            break;
-          }
-        }
-
-        // no recognized extension found
-        if (!isKnownExt) {
-          freeURL(tmp);
-          return NULL;
-        }
-      }
-    }
-  }
-
-  // Allocate space for resulting URL - which will be no longer than url.
-  char* result = malloc(strlen(url)+1);
+  size_t len = strlen(url);
+  char* result = malloc(len + 1);
   if (result == NULL) {
-    freeURL(tmp);
     return NULL;
-  } else {
-    // initialize it to empty string
-    *result = '\0';
-  }
-
-  // put normalized url back together
-  if (tmp.scheme) {                         // scheme
-    strcat(result, tmp.scheme);
-  }
-  if (tmp.user) {                           // user
-    strcat(result, tmp.user);
-  }
-  if (tmp.host) {                           // host
-    strcat(result, tmp.host);
-  }
-  if (tmp.path) {                           // path
-    // remove . and .. segments
-    char* path = removeDotSegments(tmp.path);
-    if (path == NULL) {
-      freeURL(tmp);
-      return NULL;
-    } else {
-      strcat(result, path);
-      free(path);
-    }
   }
-  if (tmp.query) {                          // query
-    strcat(result, tmp.query);
-  }
-  if (tmp.fragment) {                       // fragment
-    strcat(result, tmp.fragment);
+  if (webpage_canonicalURL(NULL, url, len, result, len + 1, NULL) == 0) {
+    free(result);
+    return NULL;
   }
 
 #ifdef REMOVE_SLASH
@@ -545,10 +576,163 @@ normalizeURL(const char* url)
   }
 #endif // REMOVE_SLASH
 
-  freeURL(tmp);
   return result;
 }
 
+/***********************************************************************
+ * webpage_linkURL - see webpage.h for interface description.
+ */
+char*
+webpage_linkURL(const char* baseURL, const char* href, const size_t len)
+{
+  if (baseURL == NULL || href == NULL) {
+    return NULL;
+  }
+
+  // is the url absolute, i.e, ':' must precede any '/', '?', or '#'
+  size_t i = 0;
+  while (i < len && strchr(":/?#", href[i]) == NULL) {
+    i++;
+  }
+  if (i == len || href[i] != ':') {
+    // relative: fix it up against the base url
+    return fixRelativeURL((char*) baseURL, (char*) href, len);
+  }
+  if (strncasecmp(href, "http", 4) != 0) {   // absolute, but not http(s)
+    return NULL;
+  }
+  char* result = calloc(len + 1, sizeof(char));
+  if (result != NULL) {
+    strncpy(result, href, len);
+  }
+  return result;
+}
+
+/***********************************************************************
+ * webpage_canonicalURL - see webpage.h for interface description.
+ *
+ * Pseudocode:
+ *     1. copy the raw absolute url into buf: href itself, or the
+ *        base's scheme and authority, then href if it begins with '/',
+ *        else the base's directory, '/', and href (as fixRelativeURL)
+ *     2. in place: lowercase the scheme and host, check any file
+ *        extension, remove dot segments from the path, and slide the
+ *        query and fragment down after it
+ */
+size_t
+webpage_canonicalURL(const char* baseURL, const char* href, const size_t len,
+                     char* buf, const size_t cap, urlparts_t* parts)
+{
+  if (href == NULL || buf == NULL) {
+    return 0;
+  }
+
+  // is href absolute, i.e, ':' must precede any '/', '?', or '#'
+  size_t i = 0;
+  while (i < len && strchr(":/?#", href[i]) == NULL) {
+    i++;
+  }
+  size_t n;                                // raw length in buf
+  if (i < len && href[i] == ':') {
+    if (baseURL != NULL && strncasecmp(href, "http", 4) != 0) {
+      return 0;                            // a link, but not http(s)
+    }
+    if (len + 1 > cap) {
+      return 0;
+    }
+    memcpy(buf, href, len);
+    n = len;
+  } else {
+    if (baseURL == NULL) {
+      return 0;
+    }
+    // the base's scheme and authority, then its path
+    const char* auth = strpbrk(baseURL, ":/?#");
+    if (auth == NULL || *auth != ':') {
+      return 0;
+    }
+    auth++;
+    if (strncmp(auth, "//", 2) == 0) {
+      auth += 2;
+    }
+    const char* path = auth + strcspn(auth, "/");
+    const char* pathEnd = path + strcspn(path, "?#");
+
+    // relative to the domain root, or to the base's directory
+    const char* dirEnd = path;             // where href goes
+    bool slash = false;                    // with a '/' before it?
+    if (len == 0 || href[0] != '/') {
+      const char* last = NULL;             // the base path's last '/'
+      for (const char* p = path; p < pathEnd; p++) {
+        if (*p == '/') {
+          last = p;
+        }
+      }
+      if (last != NULL) {
+        dirEnd = last + 1;
+      } else {
+        slash = true;
+      }
+    }
+    size_t prefix = dirEnd - baseURL;
+    n = prefix + slash + len;
+    if (n + 1 > cap) {
+      return 0;
+    }
+    memcpy(buf, baseURL, prefix);
+    if (slash) {
+      buf[prefix] = '/';
+    }
+    memcpy(buf + prefix + slash, href, len);
+  }
+  buf[n] = '\0';
+  char* const end = buf + n;
+
+  // scheme, lowercased, with any "//"
+  char* p = buf;
+  while (p < end && *p != ':' && *p != '/' && *p != '?' && *p != '#') {
+    *p = tolower(*p);
+    p++;
+  }
+  if (p == end || *p != ':') {
+    return 0;
+  }
+  p++;
+  if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+    p += 2;
+  }
+
+  // authority: any user info kept as is, the host lowercased
+  char* authEnd = p + strcspn(p, "/?#");
+  char* host = p;
+  char* at = memchr(p, '@', authEnd - p);
+  if (at != NULL) {
+    host = at + 1;
+  }
+  for (char* h = host; h < authEnd; h++) {
+    *h = tolower(*h);
+  }
+
+  // the path, which must begin with '/'
+  char* path = authEnd;
+  char* pathEnd = path + strcspn(path, "?#");
+  if (path == pathEnd || *path != '/' || !hasKnownExt(path, pathEnd)) {
+    return 0;
+  }
+  char* newEnd = squeezeDotSegments(path, pathEnd);
+  memmove(newEnd, pathEnd, end - pathEnd + 1);   // query, fragment, '\0'
+  size_t length = n - (pathEnd - newEnd);
+
+  if (parts != NULL) {
+    parts->host.start = host;
+    parts->host.len = authEnd - host;
+    parts->path.start = path;
+    parts->path.len = newEnd - path;
+    parts->internal = (strncmp(buf, INTERNAL_PREFIX, strlen(INTERNAL_PREFIX)) == 0);
+  }
+  return length;
+}
+
 /***********************************************************************
  * isInternalURL - see webpage.h for interface description.
  */
@@ -842,54 +1026,405 @@ burstURL(const char* url, char** hostname, int* port, char** pathname)
 }
 
 
-/* ********************* connectToHost ************************** */
-/* Connect to the given hostname and port, 
- * returning an open FILE* for the socket,
- * or NULL on failure.
+/* ********************* resolveHost ************************** */
+/* Fill *addr with the address of hostname:port, returning false on failure.
+ * Each host is looked up once; later calls are answered from a small
+ * cache, so a crawl of one server pays for DNS only on its first fetch.
+ * Uses getaddrinfo, not gethostbyname, so that several crawler
+ * threads may fetch pages at the same time.
  */
-static FILE* 
-connectToHost(const char* hostname, const int port)
+static bool
+resolveHost(const char* hostname, const int port, hostaddr_t* addr)
 {
+  pthread_mutex_lock(&poolLock);
+  for (hostaddr_t* a = hostCache; a != NULL; a = a->next) {
+    if (a->port == port && strcmp(a->hostname, hostname) == 0) {
+      *addr = *a;
+      pthread_mutex_unlock(&poolLock);
+      return true;
+    }
+  }
+  pthread_mutex_unlock(&poolLock);
+
   // Look up the hostname specified on command line
-  struct hostent *hostp = gethostbyname(hostname);
-  if (hostp == NULL) {
-    return NULL;
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  char service[16];
+  snprintf(service, sizeof(service), "%d", port);
+
+  struct addrinfo* server;    // address of the server
+  if (getaddrinfo(hostname, service, &hints, &server) != 0) {
+    return false;
+  }
+  memset(addr, 0, sizeof(*addr));
+  memcpy(&addr->addr, server->ai_addr, server->ai_addrlen);
+  addr->addrlen = server->ai_addrlen;
+  addr->family = server->ai_family;
+  addr->socktype = server->ai_socktype;
+  addr->protocol = server->ai_protocol;
+  addr->port = port;
+  freeaddrinfo(server);
+
+  // remember it; a racing thread may have added it too, which is harmless
+  hostaddr_t* entry = malloc(sizeof(hostaddr_t));
+  if (entry != NULL) {
+    *entry = *addr;
+    entry->hostname = strdup(hostname);
+    if (entry->hostname == NULL) {
+      free(entry);
+    } else {
+      pthread_mutex_lock(&poolLock);
+      entry->next = hostCache;
+      hostCache = entry;
+      pthread_mutex_unlock(&poolLock);
+    }
   }
+  addr->hostname = NULL;
+  addr->next = NULL;
+  return true;
+}
 
-  // Initialize fields of the server address
-  struct sockaddr_in server;  // address of the server
-  server.sin_family = AF_INET;
-  bcopy(hostp->h_addr_list[0], &server.sin_addr, hostp->h_length);
-  server.sin_port = htons(port);
+/* ********************* connAcquire ************************** */
+/* Return a connection to hostname:port, or NULL on failure.
+ * An idle connection from the pool is used if there is one (and
+ * *reused set true); otherwise a new socket is connected.
+ * The caller has the connection to itself until connRelease or connClose.
+ */
+static conn_t*
+connAcquire(const char* hostname, const int port, bool* reused)
+{
+  // look for an idle connection to this host
+  pthread_mutex_lock(&poolLock);
+  for (conn_t** prev = &idleConns; *prev != NULL; prev = &(*prev)->next) {
+    conn_t* conn = *prev;
+    if (conn->port == port && strcmp(conn->hostname, hostname) == 0) {
+      *prev = conn->next;
+      numIdle--;
+      pthread_mutex_unlock(&poolLock);
+      conn->next = NULL;
+      *reused = true;
+      return conn;
+    }
+  }
+  pthread_mutex_unlock(&poolLock);
+  *reused = false;
+
+  hostaddr_t addr;
+  if (!resolveHost(hostname, port, &addr)) {
+    return NULL;
+  }
 
   // Create socket (a file descriptor)
-  int comm_sock = socket(AF_INET, SOCK_STREAM, 0);
+  int comm_sock = socket(addr.family, addr.socktype, addr.protocol);
   if (comm_sock < 0) {
     return NULL;
   }
 
   // And connect that socket to that server   
-  if (connect(comm_sock, (struct sockaddr *) &server, sizeof(server)) < 0) {
+  if (connect(comm_sock, (struct sockaddr*) &addr.addr, addr.addrlen) < 0) {
+    close(comm_sock);
     return NULL;
   }
 
-  // to make it easier to work with, switch to stdio
-  FILE* http_fp = fdopen(comm_sock, "r+");
-  if (http_fp == NULL) {
+  conn_t* conn = malloc(sizeof(conn_t));
+  if (conn == NULL || (conn->hostname = strdup(hostname)) == NULL) {
+    free(conn);
+    close(comm_sock);
     return NULL;
   }
+  conn->sock = comm_sock;
+  conn->port = port;
+  conn->start = conn->end = 0;
+  conn->next = NULL;
+  return conn;
+}
+
+/* ********************* connRelease ************************** */
+/* Put a connection whose response was read in full back in the pool,
+ * or close it if the pool is already full.
+ */
+static void
+connRelease(conn_t* conn)
+{
+  pthread_mutex_lock(&poolLock);
+  if (numIdle < MAX_IDLE) {
+    conn->start = conn->end = 0;
+    conn->next = idleConns;
+    idleConns = conn;
+    numIdle++;
+    conn = NULL;
+  }
+  pthread_mutex_unlock(&poolLock);
+  if (conn != NULL) {
+    connClose(conn);
+  }
+}
+
+/* ********************* connClose ************************** */
+/* Close the socket and free the connection. */
+static void
+connClose(conn_t* conn)
+{
+  close(conn->sock);
+  free(conn->hostname);
+  free(conn);
+}
+
+/* ********************* sendAll ************************** */
+/* Write all len bytes of buf to the socket; false on error.
+ * MSG_NOSIGNAL keeps a server that closed an idle connection
+ * from killing us with SIGPIPE.
+ */
+static bool
+sendAll(const int sock, const char* buf, size_t len)
+{
+  while (len > 0) {
+    ssize_t n = send(sock, buf, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+/* ********************* connFill ************************** */
+/* Refill the connection's buffer once it has been used up;
+ * false on error or if the server closed the connection.
+ */
+static bool
+connFill(conn_t* conn)
+{
+  if (conn->start < conn->end) {
+    return true;
+  }
+  ssize_t n;
+  do {
+    n = recv(conn->sock, conn->buf, sizeof(conn->buf), 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    return false;
+  }
+  conn->start = 0;
+  conn->end = n;
+  return true;
+}
 
-  return http_fp;
+/* ********************* connReadLine ************************** */
+/* Read one line from the connection, without its CRLF (or LF).
+ * Returns a malloc'd string, or NULL if the connection ends first.
+ */
+static char*
+connReadLine(conn_t* conn)
+{
+  size_t len = 0, size = 128;
+  char* line = malloc(size);
+  while (line != NULL) {
+    if (!connFill(conn)) {
+      free(line);
+      return NULL;
+    }
+    char c = conn->buf[conn->start++];
+    if (c == '\n') {
+      if (len > 0 && line[len-1] == '\r') {
+        len--;
+      }
+      line[len] = '\0';
+      return line;
+    }
+    if (len + 1 >= size) {
+      char* bigger = realloc(line, size *= 2);
+      if (bigger == NULL) {
+        free(line);
+        return NULL;
+      }
+      line = bigger;
+    }
+    line[len++] = c;
+  }
+  return NULL;
+}
+
+/* ********************* connReadBody ************************** */
+/* Pass exactly n bytes from the connection to the sink (or drop them, 
+ * if sink is NULL), in pieces as they arrive; *delivered is set once the
+ * sink has been handed anything. False if the connection ends first or
+ * the sink refuses a piece.
+ */
+static bool
+connReadBody(conn_t* conn, size_t n, 
+             bool (*sink)(void* arg, const char* data, const size_t len),
+             void* arg, bool* delivered)
+{
+  while (n > 0) {
+    if (!connFill(conn)) {
+      return false;
+    }
+    size_t chunk = conn->end - conn->start;
+    if (chunk > n) {
+      chunk = n;
+    }
+    if (sink != NULL) {
+      *delivered = true;
+      if (!(*sink)(arg, conn->buf + conn->start, chunk)) {
+        return false;
+      }
+    }
+    conn->start += chunk;
+    n -= chunk;
+  }
+  return true;
 }
 
+/* ********************* bodyAppend ************************** */
+/* webpage_fetch's sink: append the data to a bodybuf_t, keeping it 
+ * null-terminated.
+ */
+static bool
+bodyAppend(void* arg, const char* data, const size_t len)
+{
+  bodybuf_t* buf = arg;
+  if (buf->len + len + 1 > buf->size) {
+    size_t size = (buf->size == 0) ? 4096 : buf->size;
+    while (size < buf->len + len + 1) {
+      size *= 2;
+    }
+    char* bigger = realloc(buf->data, size);
+    if (bigger == NULL) {
+      return false;
+    }
+    buf->data = bigger;
+    buf->size = size;
+  }
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+  buf->data[buf->len] = '\0';
+  return true;
+}
+
+/* ********************* readResponse ************************** */
+/* Read one whole HTTP response from the connection: the status code
+ * into *status, and the body, if the status is 200, to the sink as it
+ * arrives (other bodies are read and dropped). The body is delimited by
+ * Content-Length, by chunked transfer coding, or (for neither) by the
+ * server closing the connection. *keepAlive says whether the connection
+ * may be reused; *failedEarly whether it failed before any of the
+ * response arrived, as happens when the server has closed an idle
+ * connection; *delivered whether the sink has seen any of the body.
+ * Returns true if the whole response was read.
+ */
+static bool
+readResponse(conn_t* conn, int* status, 
+             bool (*sink)(void* arg, const char* data, const size_t len),
+             void* arg, bool* keepAlive, bool* failedEarly, bool* delivered)
+{
+  *keepAlive = false;
+  *failedEarly = false;
+
+  char* line = connReadLine(conn);
+  if (line == NULL) {
+    *failedEarly = true;
+    return false;
+  }
+  int minor = 0;
+  bool ok = (sscanf(line, "HTTP/1.%d %d", &minor, status) == 2);
+  free(line);
+  if (!ok) {
+    return false;
+  }
+  // HTTP/1.1 connections persist unless the server says otherwise
+  *keepAlive = (minor >= 1);
+  if (*status != 200) {
+    sink = NULL;
+  }
+
+  // headers, up to the blank line
+  long contentLength = -1;
+  bool chunked = false;
+  while ((line = connReadLine(conn)) != NULL && !isBlankLine(line)) {
+    char* value = strchr(line, ':');
+    if (value != NULL) {
+      *value++ = '\0';
+      value += strspn(value, " \t");
+      if (strcasecmp(line, "Content-Length") == 0) {
+        contentLength = atol(value);
+      } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+        chunked = (strcasestr(value, "chunked") != NULL);
+      } else if (strcasecmp(line, "Connection") == 0) {
+        if (strcasestr(value, "close") != NULL) {
+          *keepAlive = false;
+        } else if (strcasestr(value, "keep-alive") != NULL) {
+          *keepAlive = true;
+        }
+      }
+    }
+    free(line);
+  }
+  if (line == NULL) {
+    return false;
+  }
+  free(line);
+
+  if ((*status >= 100 && *status < 200) || *status == 204 || *status == 304) {
+    return true;                      // these never have a body
+  }
+  if (chunked) {
+    // each chunk is a hex size line, the data, and CRLF; size 0 ends it
+    while (true) {
+      line = connReadLine(conn);
+      if (line == NULL) {
+        return false;
+      }
+      size_t size = strtoul(line, NULL, 16);
+      free(line);
+      if (size == 0) {
+        break;
+      }
+      if (!connReadBody(conn, size, sink, arg, delivered) 
+          || (line = connReadLine(conn)) == NULL) {
+        return false;
+      }
+      free(line);
+    }
+    // skip any trailer headers
+    while ((line = connReadLine(conn)) != NULL && !isBlankLine(line)) {
+      free(line);
+    }
+    if (line == NULL) {
+      return false;
+    }
+    free(line);
+    return true;
+  }
+  if (contentLength >= 0) {
+    return connReadBody(conn, contentLength, sink, arg, delivered);
+  }
+  // no length given: the body runs until the server closes the connection
+  *keepAlive = false;
+  while (connFill(conn)) {
+    if (!connReadBody(conn, conn->end - conn->start, sink, arg, delivered)) {
+      return false;
+    }
+  }
+  return true;
+}
 
 /* ***************************************************************** */
 /*
- * removeDotSegments - removes . and .. segments from url paths
- * @input: the character buffer to cleanse
+ * squeezeDotSegments - removes . and .. segments from url paths, in place
+ * @path: first character of the (non-empty) path
+ * @end: just past its last character
  *
- * Returns a newly allocated character buffer with . and .. segments removed
- * according to the algorithm in RFC 3986 section 5.2.4 "Remove Dot Segments".
+ * Removes . and .. segments according to the algorithm in RFC 3986
+ * section 5.2.4 "Remove Dot Segments", and returns the new end of the
+ * path. The path never grows, so the output overwrites the input as it
+ * is read and nothing is allocated.
  * See: http://www.ietf.org/rfc/rfc1738.txt
  *
  * Should have no use outside of this file, thus declared static.
@@ -916,116 +1451,94 @@ connectToHost(const char* hostname, const int port)
  * be used in advertising or otherwise to promote the sale, use or other dealings
  * in this Software without prior written authorization of the copyright holder.
  */
-static char* 
-removeDotSegments(char* input)
+static char*
+squeezeDotSegments(char* path, char* end)
 {
-  size_t in_len;                           // input length
-  size_t copy_len;                         // copy length
-  char* copy;                              // copy of input that is modified
-  char* copyptr;                           // handle for free'ing copy'
-  char* out;                               // output buffer
-  char* outptr;                            // pointer to current write point
-
-  if (!input || strlen(input) < 1)
-    return NULL;
+  const char* in = path;                   // next character to read
+  char* out = path;                        // next character to write
 
-  // save lengths
-  in_len = copy_len = strlen(input);
+  // a prefix of the input, or all of it
+#define PREFIX(str) ((size_t) (end - in) >= strlen(str) \
+                     && strncmp(in, str, strlen(str)) == 0)
+#define EXACTLY(str) ((size_t) (end - in) == strlen(str) \
+                      && strncmp(in, str, strlen(str)) == 0)
 
-  // create output buffer
-  out = outptr = calloc(in_len + 1, sizeof(char));
-  if (!out)
-    return NULL; /* out of memory */
-
-  // copy the input buffer
-  copy = copyptr = strdup(input);
-  if (!copy) {
-    free(out);
-    return NULL;
-  }
-
-  // 2.  While the input buffer is not empty, loop as follows:
   do {
-    // A. If the input buffer begins with a prefix of "../" or "./",
-    //    then remove that prefix from the input buffer; otherwise,
-    if (!strncmp("./", copy, 2)) {
-      copy += 2;
-      copy_len -= 2;
-    }
-    else if (!strncmp("../", copy, 3)) {
-      copy += 3;
-      copy_len -= 3;
-    }
-
-    // B. if the input buffer begins with a prefix of "/./" or "/.",
-    //    where "." is a complete path segment, then replace that
-    //    prefix with "/" in the input buffer; otherwise,
-    else if (!strncmp("/./", copy, 3)) {
-      copy += 2;
-      copy_len -= 2;
-    }
-    else if (!strcmp("/.", copy)) {
-      copy[1] = '/';
-      copy++;
-      copy_len -= 1;
-    }
-
-    // C. if the input buffer begins with a prefix of "/../" or "/..",
-    //    where ".." is a complete path segment, then replace that
-    //    prefix with "/" in the input buffer and remove the last
-    //    segment and its preceding "/" (if any) from the output
-    //    buffer; otherwise,
-    else if (!strncmp("/../", copy, 4)) {
-      copy += 3;
-      copy_len -= 3;
-
-      // remove the last segment
-      while (outptr > out) {
-        outptr--;
-        if (*outptr == '/')
+    if (*in != '.' && (*in != '/' || end - in == 1 || in[1] != '.')) {
+      // the usual case, a segment not starting with '.': as E below
+      do {
+        *out++ = *in++;
+      } while (in < end && *in != '/');
+    } else if (PREFIX("./")) {             // A. drop "./" or "../"
+      in += 2;
+    } else if (PREFIX("../")) {
+      in += 3;
+    } else if (PREFIX("/./")) {            // B. "/./" or "/." becomes "/"
+      in += 2;
+    } else if (EXACTLY("/.")) {
+      *out++ = '/';
+      in = end;
+    } else if (PREFIX("/../") || EXACTLY("/..")) {
+      // C. "/../" or "/.." becomes "/", removing the last output segment
+      in += (end - in == 3) ? 2 : 3;
+      while (out > path) {
+        out--;
+        if (*out == '/') {
           break;
+        }
       }
-      *outptr = 0;
-    }
-    else if (!strcmp("/..", copy)) {
-      copy[2] = '/';
-      copy += 2;
-      copy_len -= 2;
-
-      // remove the last segment
-      while (outptr > out) {
-        outptr--;
-        if (*outptr == '/')
-          break;
+      if (in == end - 1) {
+        *out++ = '/';
+        in = end;
       }
-      *outptr = 0;
-    }
-
-    // D. if the input buffer consists only of "." or "..", then remove
-    //    that from the input buffer; otherwise, */
-    else if (!strcmp(".", copy) || !strcmp("..", copy)) {
-      *copy = 0;
-    }
-
-    // E. move the first path segment in the input buffer to the end of
-    //    the output buffer, including the initial "/" character (if
-    //    any) and any subsequent characters up to, but not including,
-    //    the next "/" character or the end of the input buffer. */
-    else {
+    } else if (EXACTLY(".") || EXACTLY("..")) {   // D. drop "." or ".."
+      in = end;
+    } else {                               // E. move the first segment
       do {
-        *outptr++ = *copy++;
-        copy_len--;
-      } while (*copy && (*copy != '/'));
-      *outptr = '\0';
+        *out++ = *in++;
+      } while (in < end && *in != '/');
     }
-  } while (*copy != '\0');    // keep going
-
-  // cleanup copy
-  free(copyptr);
+  } while (in < end);
 
+#undef PREFIX
+#undef EXACTLY
   return out;
 }
 
+/* ***************************************************************** */
+/*
+ * hasKnownExt - does the path name a file likely to hold html?
+ * @path: first character of the path
+ * @end: just past its last character
+ *
+ * True unless the path's last segment has an extension that is not
+ * one of EXTS; a path with no extension may be a directory, or html.
+ *
+ * Should have no use outside of this file, thus declared static.
+ */
+static bool
+hasKnownExt(const char* path, const char* end)
+{
+  const char* dot = NULL;                  // last '.' after the last '/'
+  for (const char* p = path; p < end; p++) {
+    if (*p == '/') {
+      dot = NULL;
+    } else if (*p == '.') {
+      dot = p;
+    }
+  }
+  if (dot == NULL || dot + 1 == end) {
+    return true;
+  }
+  size_t extlen = end - (dot + 1);
+  for (int i = 0; EXTS[i] != NULL; i++) {
+    if (extlen >= strlen(EXTS[i]) && strncasecmp(dot + 1, EXTS[i], strlen(EXTS[i])) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 /* ***************************************************************** */
 /*
  * fixRelativeURL - resolves a relative url to an absolute url
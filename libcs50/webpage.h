@@ -106,6 +106,44 @@ void webpage_delete(void* data);
  */
 bool webpage_fetch(webpage_t* page);
 
+/***************** webpage_fetchStream ******************************/
+/* retrieve HTML from page->url, handing it to sink piece by piece
+ *
+ * Caller provides
+ *   page, as for webpage_fetch (page->html is not touched), and
+ *   sink, a function called with each piece of the body as it arrives,
+ *     in order; it returns false to abandon the fetch.  
+ *   arg, passed to sink.
+ *
+ * We return:
+ *   true if the whole page arrived with HTTP status 200; otherwise false.
+ *
+ * Notes:
+ *   Nothing is buffered beyond a few kilobytes of socket data, so memory
+ *   use does not grow with the page. sink only sees the body of a 200
+ *   response. A fetch is retried, as in webpage_fetch, only until sink
+ *   has seen the first piece; a failure after that returns false, and
+ *   the caller should discard what sink received.
+ *   webpage_fetch is webpage_fetchStream with a sink that collects the body.
+ */
+bool webpage_fetchStream(webpage_t* page, 
+                         bool (*sink)(void* arg, const char* data, const size_t len),
+                         void* arg);
+
+/***************** webpage_closeConnections ******************************/
+/* close the connections webpage_fetch keeps open between fetches
+ *
+ * webpage_fetch asks servers to keep each connection open (HTTP/1.1
+ * keep-alive) and puts it in a pool after reading the whole response,
+ * so the next fetch from the same host:port skips the TCP handshake;
+ * host names are resolved once and cached. The pool is safe to use from
+ * several threads; each connection serves one thread at a time.
+ *
+ * Call this when done fetching, to close idle connections and forget
+ * cached host addresses; fetching again afterwards is fine.
+ */
+void webpage_closeConnections(void);
+
 
 /**************** webpage_getNextWord ***********************************/
 /* return the next word from page->html[pos]
@@ -173,6 +211,60 @@ char* webpage_getNextWord(webpage_t* page, int* pos);
 
 char* webpage_getNextURL(webpage_t* page, int* pos);
 
+/***********************************************************************
+ * webpage_linkURL - turn the value of an href into an absolute URL
+ *
+ * Caller provides:
+ *   baseURL, the URL of the page holding the link, and
+ *   href, the first len characters of which are the link target, with
+ *   any #fragment already removed.
+ *
+ * We return:
+ *   the absolute URL, as webpage_getNextURL would return it, in a new
+ *   malloc'd string; NULL for a link to another scheme, or on error.
+ *
+ * For scanners that find links without a whole page in hand.
+ */
+char* webpage_linkURL(const char* baseURL, const char* href, const size_t len);
+
+/***********************************************************************
+ * urlparts_t - where the pieces of a canonical URL lie in its buffer
+ */
+typedef struct urlspan {
+  const char* start;            // first character, within the buffer
+  size_t len;                   // number of characters
+} urlspan_t;
+
+typedef struct urlparts {
+  urlspan_t host;               // lowercased host name (and any :port)
+  urlspan_t path;               // from its first '/', dot segments removed
+  bool internal;                // does the URL begin with INTERNAL_PREFIX?
+} urlparts_t;
+
+/***********************************************************************
+ * webpage_canonicalURL - resolve and normalize a URL without allocating
+ *
+ * Caller provides:
+ *   baseURL, the URL of the page holding the link (may be NULL if href
+ *   is absolute);
+ *   href, the first len characters of which are the URL, absolute or
+ *   relative to baseURL;
+ *   buf, a buffer of cap characters; cap >= strlen(baseURL) + len + 2
+ *   always suffices;
+ *   parts, to receive the host, path, and internal check (may be NULL).
+ *
+ * We return:
+ *   the length of the canonical URL, written to buf as a string: the
+ *   same URL normalizeURL(webpage_linkURL(baseURL, href, len)) gives;
+ *   0 if it cannot be parsed, names a file unlikely to hold html, or
+ *   does not fit in buf.
+ *
+ * Everything happens in buf, in one pass over the URL, so a crawler can
+ * throw away external and already-seen links without calling malloc.
+ */
+size_t webpage_canonicalURL(const char* baseURL, const char* href, const size_t len,
+                            char* buf, const size_t cap, urlparts_t* parts);
+
 /***********************************************************************
  * normalizeURL - returns a normalized form of the url
  *
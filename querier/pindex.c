@@ -0,0 +1,1072 @@
+/*
+ * pindex.c - postings index for the 'querier' module
+ *
+ * Copies each word's postings, parsed from the index file already in
+ * docID order (see indexfile.h), into an array of its own once, when
+ * the index is loaded, so no counters list is ever built. BM25 weights
+ * use the IDF ln(1 + (N - df + 0.5) / (df + 0.5)), which stays positive
+ * for words in most documents; a document missing from the lengths file
+ * is taken to be of average length. Best scores per list and per block
+ * are found in a last pass, once the normalizers are known.
+ *
+ * pindex_share gives a sharded index the statistics of the whole: the
+ * normalizers are made again from the lengths kept at load, against
+ * every shard's mean length, and each word's weight from its document
+ * frequency summed over the shards (one lookup per shard), after which
+ * its best scores and impact list are found again.
+ *
+ * The sorted words are front-coded in blocks of LEX_BLOCK: each word is
+ * stored as the number of leading letters it shares with the word before
+ * it, then the rest of its letters and a 0 byte; the first word of each
+ * block shares none, so it can be compared in place, and a prefix search
+ * is a binary search over the blocks' first words and a scan forward.
+ *
+ * For fuzzy lookups the words are also listed under every string made
+ * by deleting up to max_edits letters from their first FUZZY_PREFIX
+ * letters, each such deletion as a hash and a word number, sorted. Two
+ * words a few edits apart share a deletion (the word itself counts as
+ * one), so the words near a query word are found among those listed
+ * under the query word's own deletions, then checked letter by letter.
+ * Only the first letters are used, which keeps the list to at most 29
+ * entries a word however long the words are.
+ *
+ * pindex_layout sizes one block for the hot dictionary and every array,
+ * each rounded up to a cache line, and copies the lists in, the hot
+ * words' first and then the lexicon's, passing over any already copied
+ * (its address is then inside the block). The hot dictionary is an
+ * open-addressed table, a power of two at least twice the words, probed
+ * one slot after another from the word's hash; an empty slot ends a
+ * probe. Its slots copy their words' postings_t, so a hot word's lookup
+ * reads one cache line before it reaches the list.
+ * See pindex.h for declarations.
+ *
+ * Manzi Fabrice Niyigaba, CS50, November 2024
+ */
+
+# define _GNU_SOURCE
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <stdint.h>
+# include <math.h>
+# include <sys/mman.h>
+# include "pindex.h"
+# include "../libcs50/hashtable.h"
+
+// letters of a word its fuzzy deletions are made from, and how many
+// deletions of up to two letters that makes, the word itself included
+#define FUZZY_PREFIX 7
+#define MAX_DELETIONS (1 + FUZZY_PREFIX + FUZZY_PREFIX * (FUZZY_PREFIX - 1) / 2)
+
+#define CACHE_LINE 64   // bytes each laid out array, and hot word, starts on
+
+struct pindex {
+    hashtable_t* ht;         // word -> postings_t
+    int max_doc;             // largest docID seen
+    double* norms;           // BM25 normalizers by docID, or NULL
+    int* lengths;            // document lengths by docID, -1 if unknown, for norms
+    int num_docs;            // documents with lengths, for IDF; every shard's once shared
+    double average;          // their mean length
+    positions_t* positions;  // word positions, or NULL
+    wordnorm_t* norm;        // how the index's words were normalized, or NULL
+    char* lex;               // the words, sorted and front-coded
+    size_t* lex_blocks;      // where each block of LEX_BLOCK words starts in lex
+    const postings_t** lex_postings;   // each word's postings, in sorted order
+    int num_words;           // words in the lexicon
+    size_t longest;          // letters in the longest word
+    struct deletion* deletions;   // the words' deletions, for fuzzy lookups
+    int num_deletions;
+    int max_edits;           // edits pindex_near allows, 0 if not prepared
+    bool stopwords;          // frequent words are stopwords
+    char* arena;             // the block pindex_layout put every list in, or NULL
+    size_t arena_mapped;     // its bytes, if it was mapped rather than allocated
+    struct hotword* hot;     // the hot dictionary, at the front of the block, or NULL
+    unsigned int hot_mask;   // its slots, less one
+};
+
+/*************** hotword ***************
+ * One slot of the hot dictionary, a cache line: a word's postings, as
+ * pindex_find returns them, and the word; an empty slot has no word.
+ */
+struct hotword {
+    postings_t postings;
+    char word[CACHE_LINE - sizeof(postings_t)];
+};
+
+/*************** deletion ***************
+ * A string made by deleting letters from a word, and the word's number
+ * in the lexicon.
+ */
+struct deletion {
+    unsigned int hash;
+    int word;
+};
+
+/*************** build_args ***************
+ * State for converting the index, one word at a time.
+ */
+struct build_args {
+    pindex_t* pindex;
+    bool failed;             // an allocation failed
+    struct lexword* words;   // the words, for sorting
+    int frequent;            // documents that make a word frequent
+};
+
+/*************** share_args ***************
+ * State for weighting one shard's words by every shard's postings.
+ */
+struct share_args {
+    pindex_t* pindex;        // the shard whose words are weighted
+    pindex_t** shards;
+    int num;
+};
+
+/*************** lexword ***************
+ * A word and its postings, while the lexicon is built.
+ */
+struct lexword {
+    const char* word;
+    const postings_t* postings;
+};
+
+// Local helpers
+static void build_word(void* arg, const char* word, const indexposting_t* postings,
+                       const int num);
+static void bound_word(void* arg, const char* key, void* item);
+static void make_impact(postings_t* postings, const double* norms);
+static void share_word(void* arg, const char* key, void* item);
+static void set_norms(pindex_t* pindex);
+static bool build_lexicon(pindex_t* pindex, struct lexword* words);
+static int compare_words(const void* a, const void* b);
+static int make_deletions(const char* word, int max_edits, char (*out)[FUZZY_PREFIX + 1]);
+static unsigned int hash_text(const char* text);
+static void lexicon_word(pindex_t* pindex, int i, char* word);
+static int edit_distance(const char* a, const char* b, int max_edits, int* rows);
+static int compare_deletions(const void* a, const void* b);
+static int compare_ints(const void* a, const void* b);
+static int compare_impacts(const void* a, const void* b);
+static void postings_delete(void* item);
+static const postings_t* find_hot(pindex_t* pindex, const char* word);
+static bool add_hot(pindex_t* pindex, const char* word, const postings_t* postings);
+static size_t line_bytes(size_t bytes);
+static size_t list_bytes(const postings_t* postings);
+static char* move_list(postings_t* postings, const char* arena, char* at, bool owned);
+static char* move_array(void** array, size_t bytes, char* at, bool owned);
+static char* arena_new(size_t bytes, bool huge_pages, size_t* mapped);
+static void arena_delete(char* arena, size_t mapped);
+static void forget_lists(void* arg, const char* key, void* item);
+
+static const double BM25_K1 = 1.2;    // how soon repeated words stop counting
+static const double BM25_B = 0.75;    // how much length normalizes
+static const int LEX_BLOCK = 16;      // words per front-coded block
+static const int MAX_EDITS = 2;       // most edits pindex_fuzzy prepares for
+static const size_t HUGE_PAGE = 2 << 20;   // bytes of a huge page, which a mapping rounds up to
+
+/*************** pindex_build ***************/
+// see pindex.h for more information
+pindex_t* pindex_build(indexfile_t* file, docstats_t* stats, positions_t* positions,
+                       wordnorm_t* norm) {
+    pindex_t* pindex = (file == NULL) ? NULL : calloc(1, sizeof(pindex_t));
+    if (pindex == NULL) {
+        positions_delete(positions);
+        wordnorm_delete(norm);
+        return NULL;
+    }
+    pindex->positions = positions;
+    pindex->norm = norm;
+    pindex->num_docs = docstats_count(stats);
+    struct build_args args = {pindex, false, NULL, 0};
+    size_t num_words = indexfile_count(file);
+    pindex->ht = hashtable_new(num_words > 0 ? num_words : 1);
+    if (pindex->ht == NULL) {
+        pindex_delete(pindex);
+        return NULL;
+    }
+    indexfile_iterate(file, &args, build_word);
+    if (args.failed) {
+        pindex_delete(pindex);
+        return NULL;
+    }
+
+    // length normalizers for BM25
+    if (stats != NULL) {
+        pindex->norms = malloc((pindex->max_doc + 1) * sizeof(double));
+        pindex->lengths = malloc((pindex->max_doc + 1) * sizeof(int));
+        if (pindex->norms == NULL || pindex->lengths == NULL) {
+            pindex_delete(pindex);
+            return NULL;
+        }
+        for (int doc = 0; doc <= pindex->max_doc; doc++) {
+            pindex->lengths[doc] = docstats_length(stats, doc);
+        }
+        pindex->average = docstats_average(stats);
+        set_norms(pindex);
+    }
+
+    // best scores, impact lists, and the words in sorted order
+    int num_docs = (pindex->num_docs > 0) ? pindex->num_docs : pindex->max_doc;
+    args.frequent = (num_docs + PINDEX_FREQUENT - 1) / PINDEX_FREQUENT;
+    if (args.frequent < 2) {
+        args.frequent = 2;
+    }
+    args.words = malloc((num_words + 1) * sizeof(struct lexword));
+    args.failed = (args.words == NULL);
+    hashtable_iterate(pindex->ht, &args, bound_word);
+    if (args.failed || !build_lexicon(pindex, args.words)) {
+        free(args.words);
+        pindex_delete(pindex);
+        return NULL;
+    }
+    free(args.words);
+    return pindex;
+}
+
+/*************** pindex_share ***************/
+// see pindex.h for more information
+void pindex_share(pindex_t** shards, int num) {
+    if (shards == NULL || num < 2 || shards[0]->norms == NULL) {
+        return;
+    }
+    int num_docs = 0;
+    double length = 0;
+    for (int s = 0; s < num; s++) {
+        num_docs += shards[s]->num_docs;
+        length += shards[s]->average * shards[s]->num_docs;
+    }
+    for (int s = 0; s < num; s++) {
+        shards[s]->num_docs = num_docs;
+        shards[s]->average = (num_docs > 0) ? length / num_docs : 0;
+        set_norms(shards[s]);
+    }
+    struct share_args args = {NULL, shards, num};
+    for (int s = 0; s < num; s++) {
+        args.pindex = shards[s];
+        hashtable_iterate(shards[s]->ht, &args, share_word);
+    }
+}
+
+/*************** pindex_find ***************/
+// see pindex.h for more information
+const postings_t* pindex_find(pindex_t* pindex, const char* word) {
+    if (pindex == NULL) {
+        return NULL;
+    }
+    const postings_t* postings = (pindex->hot != NULL) ? find_hot(pindex, word) : NULL;
+    return (postings != NULL) ? postings : hashtable_find(pindex->ht, word);
+}
+
+/*************** pindex_prefix ***************/
+// see pindex.h for more information
+bool pindex_prefix(pindex_t* pindex, const char* prefix, void* arg,
+                   bool (*itemfunc)(void* arg, const char* word, const postings_t* postings)) {
+    if (pindex == NULL || prefix == NULL || pindex->num_words == 0) {
+        return true;
+    }
+    // the last block whose first word is before the prefix
+    int num_blocks = (pindex->num_words + LEX_BLOCK - 1) / LEX_BLOCK;
+    int lo = 0;
+    int hi = num_blocks;
+    while (lo + 1 < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(pindex->lex + pindex->lex_blocks[mid] + 1, prefix) < 0) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    char* word = malloc(pindex->longest + 1);
+    if (word == NULL) {
+        return false;
+    }
+    size_t len = strlen(prefix);
+    const char* p = pindex->lex + pindex->lex_blocks[lo];
+    for (int i = lo * LEX_BLOCK; i < pindex->num_words; i++) {
+        size_t shared = (unsigned char) *p++;
+        strcpy(word + shared, p);
+        p += strlen(p) + 1;
+        int order = strncmp(word, prefix, len);
+        if (order > 0 || (order == 0 && !itemfunc(arg, word, pindex->lex_postings[i]))) {
+            break;
+        }
+    }
+    free(word);
+    return true;
+}
+
+/*************** pindex_fuzzy ***************/
+// see pindex.h for more information
+bool pindex_fuzzy(pindex_t* pindex, int max_edits) {
+    if (pindex == NULL) {
+        return false;
+    }
+    free(pindex->deletions);
+    pindex->deletions = NULL;
+    pindex->num_deletions = 0;
+    pindex->max_edits = 0;
+    if (max_edits <= 0 || max_edits > MAX_EDITS) {
+        return max_edits == 0;
+    }
+
+    size_t bytes = ((size_t) pindex->num_words * MAX_DELETIONS + 1) * sizeof(struct deletion);
+    struct deletion* deletions = malloc(bytes);
+    char* word = malloc(pindex->longest + 1);
+    if (deletions == NULL || word == NULL) {
+        free(deletions);
+        free(word);
+        return false;
+    }
+    char made[MAX_DELETIONS][FUZZY_PREFIX + 1];
+    int num = 0;
+    for (int i = 0; i < pindex->num_words; i++) {
+        lexicon_word(pindex, i, word);
+        int n = make_deletions(word, max_edits, made);
+        for (int k = 0; k < n; k++) {
+            deletions[num].hash = hash_text(made[k]);
+            deletions[num].word = i;
+            num++;
+        }
+    }
+    free(word);
+
+    // sort, and drop the repeats a doubled letter makes
+    qsort(deletions, num, sizeof(struct deletion), compare_deletions);
+    int kept = 0;
+    for (int i = 0; i < num; i++) {
+        if (kept == 0 || compare_deletions(&deletions[kept - 1], &deletions[i]) != 0) {
+            deletions[kept++] = deletions[i];
+        }
+    }
+    struct deletion* smaller = realloc(deletions, (kept + 1) * sizeof(struct deletion));
+    pindex->deletions = (smaller != NULL) ? smaller : deletions;
+    pindex->num_deletions = kept;
+    pindex->max_edits = max_edits;
+    return true;
+}
+
+/*************** pindex_near ***************/
+// see pindex.h for more information
+bool pindex_near(pindex_t* pindex, const char* word, void* arg,
+                 bool (*itemfunc)(void* arg, const char* word, int edits,
+                                  const postings_t* postings)) {
+    if (pindex == NULL || word == NULL || pindex->max_edits == 0) {
+        return true;
+    }
+    char made[MAX_DELETIONS][FUZZY_PREFIX + 1];
+    int n = make_deletions(word, pindex->max_edits, made);
+
+    // the words listed under any of the word's deletions
+    int num = 0;
+    int size = 64;
+    int* found = malloc(size * sizeof(int));
+    for (int k = 0; k < n && found != NULL; k++) {
+        unsigned int hash = hash_text(made[k]);
+        int lo = 0;
+        int hi = pindex->num_deletions;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (pindex->deletions[mid].hash < hash) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (int i = lo; i < pindex->num_deletions && pindex->deletions[i].hash == hash; i++) {
+            if (num == size) {
+                int* bigger = realloc(found, 2 * size * sizeof(int));
+                if (bigger == NULL) {
+                    free(found);
+                    return false;
+                }
+                found = bigger;
+                size *= 2;
+            }
+            found[num++] = pindex->deletions[i].word;
+        }
+    }
+    size_t len = strlen(word);
+    char* other = malloc(pindex->longest + 1);
+    int* rows = malloc(3 * (len + 1) * sizeof(int));
+    if (found == NULL || other == NULL || rows == NULL) {
+        free(found);
+        free(other);
+        free(rows);
+        return false;
+    }
+
+    // each word once, checked in full
+    qsort(found, num, sizeof(int), compare_ints);
+    for (int i = 0; i < num; i++) {
+        if (i > 0 && found[i] == found[i - 1]) {
+            continue;
+        }
+        lexicon_word(pindex, found[i], other);
+        int edits = edit_distance(word, other, pindex->max_edits, rows);
+        if (edits <= pindex->max_edits
+            && !itemfunc(arg, other, edits, pindex->lex_postings[found[i]])) {
+            break;
+        }
+    }
+    free(found);
+    free(other);
+    free(rows);
+    return true;
+}
+
+/*************** pindex_layout ***************/
+// see pindex.h for more information
+bool pindex_layout(pindex_t* pindex, char** hot, int num_hot, bool huge_pages) {
+    if (pindex == NULL || num_hot < 0 || (hot == NULL && num_hot > 0)) {
+        return false;
+    }
+    // the hot words the pindex holds, normalized as its words were
+    char** words = calloc(num_hot + 1, sizeof(char*));
+    postings_t** lists = calloc(num_hot + 1, sizeof(postings_t*));
+    bool ok = (words != NULL && lists != NULL);
+    int num_found = 0;
+    for (int i = 0; ok && i < num_hot; i++) {
+        char* word = wordnorm_apply(pindex->norm, hot[i]);
+        postings_t* postings = (word == NULL) ? NULL : hashtable_find(pindex->ht, word);
+        ok = (word != NULL);
+        if (postings != NULL) {
+            words[num_found] = word;
+            lists[num_found++] = postings;
+        } else {
+            free(word);
+        }
+    }
+
+    // the dictionary's slots, then every list
+    int num_dictionary = (num_found < PINDEX_HOT_MAX) ? num_found : PINDEX_HOT_MAX;
+    size_t num_slots = 0;
+    if (num_dictionary > 0) {
+        num_slots = 1;
+        while (num_slots < 2 * (size_t) num_dictionary) {
+            num_slots *= 2;
+        }
+    }
+    size_t bytes = num_slots * sizeof(struct hotword);
+    for (int i = 0; i < pindex->num_words; i++) {
+        bytes += list_bytes(pindex->lex_postings[i]);
+    }
+    size_t mapped = 0;
+    char* arena = ok ? arena_new(bytes, huge_pages, &mapped) : NULL;
+    if (arena != NULL) {
+        memset(arena, 0, num_slots * sizeof(struct hotword));
+        char* at = arena + num_slots * sizeof(struct hotword);
+        bool owned = (pindex->arena == NULL);   // not in an earlier block
+        for (int i = 0; i < num_found; i++) {
+            at = move_list(lists[i], arena, at, owned);
+        }
+        for (int i = 0; i < pindex->num_words; i++) {
+            at = move_list((postings_t*) pindex->lex_postings[i], arena, at, owned);
+        }
+        arena_delete(pindex->arena, pindex->arena_mapped);
+        pindex->arena = arena;
+        pindex->arena_mapped = mapped;
+
+        // copied once the lists have moved
+        pindex->hot = (num_slots > 0) ? (struct hotword*) arena : NULL;
+        pindex->hot_mask = num_slots - 1;
+        int added = 0;
+        for (int i = 0; i < num_found && added < num_dictionary; i++) {
+            if (add_hot(pindex, words[i], lists[i])) {
+                added++;
+            }
+        }
+    }
+
+    for (int i = 0; words != NULL && i < num_found; i++) {
+        free(words[i]);
+    }
+    free(words);
+    free(lists);
+    return arena != NULL;
+}
+
+/*************** pindex_stopwords ***************/
+// see pindex.h for more information
+void pindex_stopwords(pindex_t* pindex, bool drop) {
+    if (pindex != NULL) {
+        pindex->stopwords = drop;
+    }
+}
+
+/*************** pindex_is_stopword ***************/
+// see pindex.h for more information
+bool pindex_is_stopword(pindex_t* pindex, const postings_t* postings) {
+    return pindex != NULL && pindex->stopwords && postings != NULL && postings->impact != NULL;
+}
+
+/*************** pindex_max_doc ***************/
+// see pindex.h for more information
+int pindex_max_doc(pindex_t* pindex) {
+    return (pindex == NULL) ? 0 : pindex->max_doc;
+}
+
+/*************** pindex_norms ***************/
+// see pindex.h for more information
+const double* pindex_norms(pindex_t* pindex) {
+    return (pindex == NULL) ? NULL : pindex->norms;
+}
+
+/*************** pindex_positions ***************/
+// see pindex.h for more information
+positions_t* pindex_positions(pindex_t* pindex) {
+    return (pindex == NULL) ? NULL : pindex->positions;
+}
+
+/*************** pindex_normalizer ***************/
+// see pindex.h for more information
+wordnorm_t* pindex_normalizer(pindex_t* pindex) {
+    return (pindex == NULL) ? NULL : pindex->norm;
+}
+
+/*************** pindex_weight ***************/
+// see pindex.h for more information
+double pindex_weight(pindex_t* pindex, int df) {
+    if (pindex == NULL || pindex->num_docs == 0 || df <= 0) {
+        return 0;
+    }
+    // more documents may hold the word than have lengths, if the
+    // lengths file is stale; the IDF then bottoms out near zero
+    double n = (pindex->num_docs > df) ? pindex->num_docs : df;
+    double idf = log(1 + (n - df + 0.5) / (df + 0.5));
+    return idf * (BM25_K1 + 1) * PINDEX_BM25_SCALE;
+}
+
+/*************** pindex_bound ***************/
+// see pindex.h for more information
+void pindex_bound(postings_t* list, const double* norms) {
+    list->max_score = 0;
+    for (int i = 0; i < list->num; i++) {
+        int score = pindex_score(list, norms, i);
+        int* best = &list->block_max[i / PINDEX_BLOCK];
+        if (i % PINDEX_BLOCK == 0 || score > *best) {
+            *best = score;
+        }
+        if (score > list->max_score) {
+            list->max_score = score;
+        }
+    }
+}
+
+/*************** pindex_score ***************/
+// see pindex.h for more information
+int pindex_score(const postings_t* list, const double* norms, int pos) {
+    int count = list->list[pos].score;
+    if (norms == NULL) {
+        return count;
+    }
+    double score = list->weight * count / (count + norms[list->list[pos].docID]);
+    return (score < 1) ? 1 : (int) (score + 0.5);
+}
+
+/*************** pindex_delete ***************/
+// see pindex.h for more information
+void pindex_delete(pindex_t* pindex) {
+    if (pindex != NULL) {
+        if (pindex->arena != NULL) {
+            hashtable_iterate(pindex->ht, NULL, forget_lists);
+            arena_delete(pindex->arena, pindex->arena_mapped);
+        }
+        free(pindex->norms);
+        free(pindex->lengths);
+        free(pindex->lex);
+        free(pindex->lex_blocks);
+        free(pindex->lex_postings);
+        free(pindex->deletions);
+        positions_delete(pindex->positions);
+        wordnorm_delete(pindex->norm);
+        hashtable_delete(pindex->ht, postings_delete);
+        free(pindex);
+    }
+}
+
+/*************** build_word ***************
+ * Copies one word's postings, already by increasing docID, into its
+ * postings array.
+ */
+static void build_word(void* arg, const char* word, const indexposting_t* list,
+                       const int num) {
+    struct build_args* args = arg;
+    if (args->failed || num == 0) {
+        return;                         // a word with no documents
+    }
+    postings_t* postings = calloc(1, sizeof(postings_t));
+    if (postings == NULL) {
+        args->failed = true;
+        return;
+    }
+    postings->list = malloc(num * sizeof(doc_score_t));
+    if (postings->list == NULL) {
+        free(postings);
+        args->failed = true;
+        return;
+    }
+    for (int i = 0; i < num; i++) {
+        postings->list[i].docID = list[i].docID;
+        postings->list[i].score = list[i].count;
+    }
+    postings->num = num;
+
+    if (!hashtable_insert(args->pindex->ht, word, postings)) {
+        postings_delete(postings);      // a word on an earlier line too
+        return;
+    }
+    postings->weight = pindex_weight(args->pindex, postings->num);
+    int last = postings->list[postings->num - 1].docID;
+    if (last > args->pindex->max_doc) {
+        args->pindex->max_doc = last;
+    }
+}
+
+/*************** bound_word ***************
+ * Finds one word's best score, overall and in each block, gives a
+ * frequent word its impact list, and lists the word for the lexicon.
+ */
+static void bound_word(void* arg, const char* key, void* item) {
+    struct build_args* args = arg;
+    postings_t* postings = item;
+    if (args->failed) {
+        return;
+    }
+    args->words[args->pindex->num_words].word = key;
+    args->words[args->pindex->num_words].postings = postings;
+    args->pindex->num_words++;
+    int num_blocks = (postings->num + PINDEX_BLOCK - 1) / PINDEX_BLOCK;
+    postings->block_max = malloc(num_blocks * sizeof(int));
+    if (postings->block_max == NULL) {
+        args->failed = true;
+        return;
+    }
+    pindex_bound(postings, args->pindex->norms);
+    if (postings->num < args->frequent) {
+        return;
+    }
+    postings->impact = malloc(postings->num * sizeof(doc_score_t));
+    if (postings->impact == NULL) {
+        args->failed = true;
+        return;
+    }
+    make_impact(postings, args->pindex->norms);
+}
+
+/*************** make_impact ***************
+ * Fills a frequent word's impact list with its postings' scores, and
+ * sorts it.
+ */
+static void make_impact(postings_t* postings, const double* norms) {
+    for (int i = 0; i < postings->num; i++) {
+        postings->impact[i].docID = postings->list[i].docID;
+        postings->impact[i].score = (norms != NULL)
+            ? pindex_score(postings, norms, i) : postings->list[i].score;
+    }
+    qsort(postings->impact, postings->num, sizeof(doc_score_t), compare_impacts);
+}
+
+/*************** share_word ***************
+ * Weights one word of a shard by its document frequency in every shard,
+ * and finds its best scores and impact list again.
+ */
+static void share_word(void* arg, const char* key, void* item) {
+    struct share_args* args = arg;
+    postings_t* postings = item;
+    int df = 0;
+    for (int s = 0; s < args->num; s++) {
+        const postings_t* other = (args->shards[s] == args->pindex)
+            ? postings : hashtable_find(args->shards[s]->ht, key);
+        df += (other == NULL) ? 0 : other->num;
+    }
+    postings->weight = pindex_weight(args->pindex, df);
+    pindex_bound(postings, args->pindex->norms);
+    if (postings->impact != NULL) {
+        make_impact(postings, args->pindex->norms);
+    }
+}
+
+/*************** set_norms ***************
+ * Computes the BM25 length normalizers from the document lengths and
+ * their mean length; a document without a length is taken to be of
+ * mean length.
+ */
+static void set_norms(pindex_t* pindex) {
+    for (int doc = 0; doc <= pindex->max_doc; doc++) {
+        int length = pindex->lengths[doc];
+        double ratio = (length < 0 || pindex->average <= 0) ? 1 : length / pindex->average;
+        pindex->norms[doc] = BM25_K1 * (1 - BM25_B + BM25_B * ratio);
+    }
+}
+
+/*************** build_lexicon ***************
+ * Sorts the words and front-codes them into the pindex's lexicon.
+ * Inputs:
+ * pindex - with num_words set.
+ * words - its words and their postings, in any order; sorted here.
+ * Returns:
+ * false if memory ran out.
+ */
+static bool build_lexicon(pindex_t* pindex, struct lexword* words) {
+    int n = pindex->num_words;
+    qsort(words, n, sizeof(struct lexword), compare_words);
+    size_t bytes = 0;
+    for (int i = 0; i < n; i++) {
+        size_t len = strlen(words[i].word);
+        bytes += len + 2;
+        if (len > pindex->longest) {
+            pindex->longest = len;
+        }
+    }
+    pindex->lex = malloc(bytes + 1);
+    pindex->lex_blocks = malloc(((n + LEX_BLOCK - 1) / LEX_BLOCK + 1) * sizeof(size_t));
+    pindex->lex_postings = malloc((n + 1) * sizeof(postings_t*));
+    if (pindex->lex == NULL || pindex->lex_blocks == NULL || pindex->lex_postings == NULL) {
+        return false;
+    }
+
+    char* p = pindex->lex;
+    for (int i = 0; i < n; i++) {
+        const char* word = words[i].word;
+        size_t shared = 0;
+        if (i % LEX_BLOCK == 0) {
+            pindex->lex_blocks[i / LEX_BLOCK] = p - pindex->lex;
+        } else {
+            const char* prev = words[i - 1].word;
+            while (shared < 255 && word[shared] != '\0' && word[shared] == prev[shared]) {
+                shared++;
+            }
+        }
+        *p++ = (char) shared;
+        strcpy(p, word + shared);
+        p += strlen(word + shared) + 1;
+        pindex->lex_postings[i] = words[i].postings;
+    }
+    return true;
+}
+
+/*************** compare_words ***************
+ * Orders lexicon words alphabetically, for qsort.
+ */
+static int compare_words(const void* a, const void* b) {
+    return strcmp(((const struct lexword*) a)->word, ((const struct lexword*) b)->word);
+}
+
+/*************** make_deletions ***************
+ * Makes the strings found by deleting up to max_edits letters from the
+ * first FUZZY_PREFIX letters of a word, starting with those letters as
+ * they are. A doubled letter makes some strings twice.
+ * Inputs:
+ * word - the word.
+ * max_edits - 1 or 2.
+ * out - room for MAX_DELETIONS strings.
+ * Returns:
+ * the number of strings made.
+ */
+static int make_deletions(const char* word, int max_edits, char (*out)[FUZZY_PREFIX + 1]) {
+    int len = strlen(word);
+    if (len > FUZZY_PREFIX) {
+        len = FUZZY_PREFIX;
+    }
+    // skip letters i < j, -1 for none; deleting one letter leaves i at -1
+    int n = 0;
+    for (int i = -1; i < ((max_edits > 1) ? len : 0); i++) {
+        for (int j = (i < 0) ? -1 : i + 1; j < len; j++) {
+            char* p = out[n++];
+            for (int k = 0; k < len; k++) {
+                if (k != i && k != j) {
+                    *p++ = word[k];
+                }
+            }
+            *p = '\0';
+        }
+    }
+    return n;
+}
+
+/*************** hash_text ***************
+ * Hashes a string (FNV-1a), for the fuzzy deletions.
+ */
+static unsigned int hash_text(const char* text) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*) text; *p != '\0'; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+/*************** lexicon_word ***************
+ * Decodes word i of the lexicon, from the start of its block, into
+ * word, which has room for the longest.
+ */
+static void lexicon_word(pindex_t* pindex, int i, char* word) {
+    const char* p = pindex->lex + pindex->lex_blocks[i / LEX_BLOCK];
+    for (int k = i - i % LEX_BLOCK; k <= i; k++) {
+        size_t shared = (unsigned char) *p++;
+        strcpy(word + shared, p);
+        p += strlen(p) + 1;
+    }
+}
+
+/*************** edit_distance ***************
+ * Counts the edits between two words: letters inserted, deleted or
+ * replaced, and neighboring letters swapped (each once), by the usual
+ * table, a row at a time, giving up once every entry of two rows in a
+ * row is over max_edits.
+ * Inputs:
+ * a, b - the words.
+ * max_edits - the most edits of interest.
+ * rows - room for three rows of strlen(a) + 1 entries.
+ * Returns:
+ * the edits, or max_edits + 1 if there are more.
+ */
+static int edit_distance(const char* a, const char* b, int max_edits, int* rows) {
+    int m = strlen(a);
+    int n = strlen(b);
+    if (m - n > max_edits || n - m > max_edits) {
+        return max_edits + 1;
+    }
+    int* before = rows;              // row j - 2
+    int* last = rows + (m + 1);      // row j - 1
+    int* row = rows + 2 * (m + 1);   // row j
+    for (int i = 0; i <= m; i++) {
+        last[i] = i;
+    }
+    int least_last = 0;              // least entry of row j - 1
+    for (int j = 1; j <= n; j++) {
+        row[0] = j;
+        int least = j;
+        for (int i = 1; i <= m; i++) {
+            int cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+            int best = last[i - 1] + cost;
+            if (last[i] + 1 < best) {
+                best = last[i] + 1;
+            }
+            if (row[i - 1] + 1 < best) {
+                best = row[i - 1] + 1;
+            }
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]
+                && before[i - 2] + 1 < best) {
+                best = before[i - 2] + 1;
+            }
+            row[i] = best;
+            if (best < least) {
+                least = best;
+            }
+        }
+        if (least > max_edits && least_last > max_edits) {
+            return max_edits + 1;    // a swap reaches back only one row
+        }
+        least_last = least;
+        int* spare = before;
+        before = last;
+        last = row;
+        row = spare;
+    }
+    return (last[m] > max_edits) ? max_edits + 1 : last[m];
+}
+
+/*************** compare_deletions ***************
+ * Orders deletions by hash, then word, for qsort.
+ */
+static int compare_deletions(const void* a, const void* b) {
+    const struct deletion* x = a;
+    const struct deletion* y = b;
+    if (x->hash != y->hash) {
+        return (x->hash > y->hash) ? 1 : -1;
+    }
+    return (x->word > y->word) - (x->word < y->word);
+}
+
+/*************** compare_ints ***************
+ * Orders ints increasingly, for qsort.
+ */
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*) a;
+    int y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+/*************** compare_impacts ***************
+ * Orders postings by decreasing score, then increasing docID, for qsort.
+ */
+static int compare_impacts(const void* a, const void* b) {
+    const doc_score_t* x = a;
+    const doc_score_t* y = b;
+    if (x->score != y->score) {
+        return (x->score < y->score) ? 1 : -1;
+    }
+    return (x->docID > y->docID) - (x->docID < y->docID);
+}
+
+/*************** postings_delete ***************
+ * Frees one word's postings.
+ */
+static void postings_delete(void* item) {
+    postings_t* postings = item;
+    if (postings != NULL) {
+        free(postings->list);
+        free(postings->block_max);
+        free(postings->impact);
+        free(postings);
+    }
+}
+
+/*************** find_hot ***************
+ * Looks a word up in the hot dictionary.
+ * Returns:
+ * its postings, or NULL if it is not a hot word.
+ */
+static const postings_t* find_hot(pindex_t* pindex, const char* word) {
+    if (strlen(word) >= sizeof(pindex->hot->word)) {
+        return NULL;
+    }
+    for (unsigned int i = hash_text(word) & pindex->hot_mask; pindex->hot[i].word[0] != '\0';
+         i = (i + 1) & pindex->hot_mask) {
+        if (strcmp(pindex->hot[i].word, word) == 0) {
+            return &pindex->hot[i].postings;
+        }
+    }
+    return NULL;
+}
+
+/*************** add_hot ***************
+ * Adds a word and a copy of its postings to the hot dictionary, which
+ * has room for it.
+ * Returns:
+ * false if the word is too long for a slot, or already there.
+ */
+static bool add_hot(pindex_t* pindex, const char* word, const postings_t* postings) {
+    if (strlen(word) >= sizeof(pindex->hot->word)) {
+        return false;
+    }
+    unsigned int i = hash_text(word) & pindex->hot_mask;
+    while (pindex->hot[i].word[0] != '\0') {
+        if (strcmp(pindex->hot[i].word, word) == 0) {
+            return false;
+        }
+        i = (i + 1) & pindex->hot_mask;
+    }
+    pindex->hot[i].postings = *postings;
+    strcpy(pindex->hot[i].word, word);
+    return true;
+}
+
+/*************** line_bytes ***************
+ * Rounds a number of bytes up to whole cache lines.
+ */
+static size_t line_bytes(size_t bytes) {
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+/*************** list_bytes ***************
+ * Returns the bytes a word's arrays take laid out.
+ */
+static size_t list_bytes(const postings_t* postings) {
+    size_t num_blocks = (postings->num + PINDEX_BLOCK - 1) / PINDEX_BLOCK;
+    size_t bytes = line_bytes(postings->num * sizeof(doc_score_t))
+        + line_bytes(num_blocks * sizeof(int));
+    if (postings->impact != NULL) {
+        bytes += line_bytes(postings->num * sizeof(doc_score_t));
+    }
+    return bytes;
+}
+
+/*************** move_list ***************
+ * Copies a word's arrays into the block at at, unless they are there
+ * already, and points its postings at the copies.
+ * Inputs:
+ * arena - the start of the block; the arrays between it and at have
+ *   been copied.
+ * owned - the arrays were allocated one by one, and are freed.
+ * Returns:
+ * where the next arrays go.
+ */
+static char* move_list(postings_t* postings, const char* arena, char* at, bool owned) {
+    uintptr_t list = (uintptr_t) postings->list;
+    if (list >= (uintptr_t) arena && list < (uintptr_t) at) {
+        return at;
+    }
+    size_t num_blocks = (postings->num + PINDEX_BLOCK - 1) / PINDEX_BLOCK;
+    at = move_array((void**) &postings->list, postings->num * sizeof(doc_score_t), at, owned);
+    at = move_array((void**) &postings->block_max, num_blocks * sizeof(int), at, owned);
+    if (postings->impact != NULL) {
+        at = move_array((void**) &postings->impact, postings->num * sizeof(doc_score_t), at, owned);
+    }
+    return at;
+}
+
+/*************** move_array ***************
+ * Copies one array to at, freeing it if owned, and points it at the copy.
+ * Returns:
+ * the next cache line after the copy.
+ */
+static char* move_array(void** array, size_t bytes, char* at, bool owned) {
+    memcpy(at, *array, bytes);
+    if (owned) {
+        free(*array);
+    }
+    *array = at;
+    return at + line_bytes(bytes);
+}
+
+/*************** arena_new ***************
+ * Allocates a block of at least bytes, starting on a cache line. With
+ * huge_pages it is mapped instead: from the reserved huge pages if
+ * there are enough, or else as ordinary memory the kernel is asked to
+ * back with transparent huge pages (a hint it may ignore).
+ * Inputs:
+ * mapped - set to the bytes mapped, or 0 if the block was allocated.
+ * Returns:
+ * the block, or NULL if memory ran out.
+ */
+static char* arena_new(size_t bytes, bool huge_pages, size_t* mapped) {
+    *mapped = 0;
+    if (huge_pages) {
+        size_t size = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        if (size == 0) {
+            size = HUGE_PAGE;
+        }
+        void* block = MAP_FAILED;
+# ifdef MAP_HUGETLB
+        block = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+# endif
+        if (block == MAP_FAILED) {
+            block = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+# ifdef MADV_HUGEPAGE
+            if (block != MAP_FAILED) {
+                madvise(block, size, MADV_HUGEPAGE);
+            }
+# endif
+        }
+        if (block == MAP_FAILED) {
+            return NULL;
+        }
+        *mapped = size;
+        return block;
+    }
+    return aligned_alloc(CACHE_LINE, (bytes > 0) ? line_bytes(bytes) : CACHE_LINE);
+}
+
+/*************** arena_delete ***************
+ * Frees a block arena_new made, given what it set mapped to; NULL is
+ * ignored.
+ */
+static void arena_delete(char* arena, size_t mapped) {
+    if (arena != NULL && mapped > 0) {
+        munmap(arena, mapped);
+    } else {
+        free(arena);
+    }
+}
+
+/*************** forget_lists ***************
+ * Drops a word's pointers into the block, which is freed whole, so
+ * postings_delete does not free them one by one.
+ */
+static void forget_lists(void* arg, const char* key, void* item) {
+    postings_t* postings = item;
+    postings->list = NULL;
+    postings->block_max = NULL;
+    postings->impact = NULL;
+}
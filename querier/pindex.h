@@ -0,0 +1,250 @@
+// pindex.h - header file for the querier's postings index
+//
+// A pindex holds, for every word of an index file, its postings as an array
+// of (docID, count) pairs sorted by docID, with the number of pairs (the
+// word's document frequency). Arrays can be intersected by merging or
+// galloping instead of by list lookups, and are never changed once built,
+// so any number of threads may read one pindex at once. Postings use
+// doc_score_t, with `score` holding the word's count in the document.
+//
+// Built with document lengths (see docstats.h), a pindex also ranks by
+// BM25: each word gets a weight from its IDF, and each document a
+// length normalizer, both computed once at load, so a document's score
+// for a word is weight * count / (count + norm[docID]). BM25 scores are
+// kept as integers in units of 1/PINDEX_BM25_SCALE, so they add up the
+// same in any order.
+//
+// For top-k evaluation every list also keeps its best score, and the
+// best score of each PINDEX_BLOCK postings, so whole runs of documents
+// that cannot make the top k can be skipped. A frequent word, one in
+// at least 1/PINDEX_FREQUENT of the documents (and in two or more), also
+// has its postings in decreasing order of score, an impact list, whose
+// first k entries are its top k and give a top-k OR a head start. The
+// querier may instead drop frequent words as stopwords (see
+// pindex_stopwords).
+//
+// A pindex may also hold the index's word positions (see positions.h),
+// which only phrase queries read, and it holds the pipeline the index's
+// words were normalized with (see word.h), so that query words are
+// normalized the same way and a reloaded index brings its own.
+//
+// Besides the hashtable for looking words up, a pindex keeps its words
+// in sorted order, front-coded, so every word with a given prefix can
+// be found by a binary search and a short scan (see pindex_prefix).
+// Prepared with pindex_fuzzy, it also finds the words a few edits away
+// from a misspelled one (see pindex_near).
+//
+// Each postings list starts out in memory of its own. pindex_layout
+// instead packs them all into one block, cache-line aligned, with the
+// lists queries ask for most first, and gives those words a compact
+// dictionary of their own, so the lists and words that queries keep
+// reading share as few cache lines and pages as they can.
+
+#ifndef PINDEX_H
+#define PINDEX_H
+
+#include "querier.h"
+#include "../common/indexfile.h"
+#include "../common/docstats.h"
+#include "../common/positions.h"
+#include "../common/word.h"
+
+#define PINDEX_BM25_SCALE 1000   // BM25 score units per point
+#define PINDEX_BLOCK 64          // postings per block of block_max
+#define PINDEX_FREQUENT 8        // frequent: in 1/PINDEX_FREQUENT of documents
+#define PINDEX_HOT_MAX 16384     // most words in the hot dictionary
+
+typedef struct pindex pindex_t;  // opaque to users of the module
+
+/*************** postings_t ***************
+ * One word's postings.
+ * - `num`: number of documents containing the word.
+ * - `list`: those documents and counts, by increasing docID.
+ * - `weight`: the word's BM25 weight, IDF * (k1 + 1) * PINDEX_BM25_SCALE
+ *   (0 without document lengths).
+ * - `max_score`: the best score (see pindex_score) of any posting.
+ * - `block_max`: the best score in each run of PINDEX_BLOCK postings,
+ *   postings 0 .. PINDEX_BLOCK - 1 first.
+ * - `impact`: for a frequent word, its postings with the scores
+ *   pindex_score gives them, by decreasing score, then increasing docID;
+ *   NULL for other words.
+ */
+typedef struct postings {
+    int num;
+    doc_score_t* list;
+    double weight;
+    int max_score;
+    int* block_max;
+    doc_score_t* impact;
+} postings_t;
+
+/*************** pindex_build ***************
+ * Builds postings arrays for every word in an index file.
+ * Input:
+ * file - the parsed index file (see indexfile.h); it is not changed,
+ *   and may be deleted after. Of a word on several lines, the first
+ *   line is kept.
+ * stats - the index's document lengths, for BM25; NULL to rank by counts.
+ *   Also not kept.
+ * positions - the index's word positions, or NULL; kept by the pindex,
+ *   which deletes them with itself (or at once, on error).
+ * norm - the pipeline the index's words were normalized with, or NULL
+ *   for lowercase only; kept and deleted likewise.
+ * Output:
+ * The new pindex, or NULL on error. Caller is responsible for pindex_delete.
+ */
+pindex_t* pindex_build(indexfile_t* file, docstats_t* stats, positions_t* positions,
+                       wordnorm_t* norm);
+
+/*************** pindex_share ***************
+ * Makes the shards of a split index (see qshard.h) rank by BM25 as the
+ * index unsplit would: every shard's normalizers use the mean length
+ * of all their documents, and every word's weight its document
+ * frequency summed over the shards, with N their documents together.
+ * Which words are frequent stays each shard's own. Nothing is done
+ * unless there are two or more shards ranking by BM25.
+ * Inputs:
+ * shards - the shards' postings, none laid out yet (see pindex_layout).
+ * num - number of shards.
+ */
+void pindex_share(pindex_t** shards, int num);
+
+/*************** pindex_find ***************
+ * Returns the word's postings, or NULL if no document contains it.
+ */
+const postings_t* pindex_find(pindex_t* pindex, const char* word);
+
+/*************** pindex_prefix ***************
+ * Visits every word beginning with prefix, in sorted order.
+ * Inputs:
+ * pindex - the postings.
+ * prefix - the prefix; "" visits every word.
+ * arg - passed to itemfunc.
+ * itemfunc - called with each word and its postings; the word is only
+ *   good during the call. Returning false stops the visit.
+ * Output:
+ * false if memory ran out before the visit could start.
+ */
+bool pindex_prefix(pindex_t* pindex, const char* prefix, void* arg,
+                   bool (*itemfunc)(void* arg, const char* word, const postings_t* postings));
+
+/*************** pindex_fuzzy ***************
+ * Prepares the pindex for pindex_near: lists every string made by
+ * deleting up to max_edits letters from the start of each word, by a
+ * hash of the string, so a lookup is a few binary searches.
+ * Inputs:
+ * pindex - the postings.
+ * max_edits - 1 or 2; 0 undoes the preparation.
+ * Output:
+ * false if memory ran out; pindex_near then finds nothing.
+ */
+bool pindex_fuzzy(pindex_t* pindex, int max_edits);
+
+/*************** pindex_near ***************
+ * Visits every word within the prepared number of edits of word, in
+ * sorted order. An edit inserts, deletes or replaces a letter, or swaps
+ * two neighboring letters.
+ * Inputs:
+ * pindex - the postings, prepared by pindex_fuzzy; if not, no word is
+ *   visited.
+ * word - the word, usually one the pindex does not hold.
+ * arg - passed to itemfunc.
+ * itemfunc - called with each word, its number of edits from word, and
+ *   its postings; the word is only good during the call. Returning
+ *   false stops the visit.
+ * Output:
+ * false if memory ran out before the visit could start.
+ */
+bool pindex_near(pindex_t* pindex, const char* word, void* arg,
+                 bool (*itemfunc)(void* arg, const char* word, int edits,
+                                  const postings_t* postings));
+
+/*************** pindex_layout ***************
+ * Lays the postings out for the words queries ask for most. Every list,
+ * with its block maxima and impact list, is moved into one block of
+ * memory, each array starting on a cache line: the hot words' lists
+ * first, in the order given, then the rest in sorted order, the order
+ * wildcards read them in. The first PINDEX_HOT_MAX hot words (of fewer
+ * than 16 letters) also get a dictionary at the front of the block,
+ * one cache line per word holding the word and its postings_t, which
+ * pindex_find looks in before the hashtable.
+ * Inputs:
+ * pindex - the postings; no other thread may be reading them.
+ * hot - words, most often asked for first (see qlog.h), as queries give
+ *   them: each is normalized as the pindex's words were, and those the
+ *   pindex does not hold are passed over.
+ * num_hot - number of hot words; with 0 the lists are only packed.
+ * huge_pages - back the block with huge pages: reserved ones if the
+ *   system has any, or else transparent ones, where it allows them.
+ * Output:
+ * false if memory ran out; the pindex is then as it was. Laying the
+ * postings out again replaces the earlier layout.
+ */
+bool pindex_layout(pindex_t* pindex, char** hot, int num_hot, bool huge_pages);
+
+/*************** pindex_stopwords ***************
+ * Sets whether frequent words are stopwords, which pindex_is_stopword
+ * reports; they are not by default.
+ */
+void pindex_stopwords(pindex_t* pindex, bool drop);
+
+/*************** pindex_is_stopword ***************
+ * Returns true if stopwords are set and the postings are a frequent
+ * word's (those with an impact list).
+ */
+bool pindex_is_stopword(pindex_t* pindex, const postings_t* postings);
+
+/*************** pindex_max_doc ***************
+ * Returns the largest docID in any postings list (0 if none).
+ */
+int pindex_max_doc(pindex_t* pindex);
+
+/*************** pindex_norms ***************
+ * Returns the BM25 length normalizers, k1 * (1 - b + b * length / average),
+ * indexed by docID from 0 to pindex_max_doc; NULL when ranking by counts.
+ */
+const double* pindex_norms(pindex_t* pindex);
+
+/*************** pindex_positions ***************
+ * Returns the word positions the pindex was built with, or NULL.
+ */
+positions_t* pindex_positions(pindex_t* pindex);
+
+/*************** pindex_normalizer ***************
+ * Returns the word pipeline the pindex was built with, or NULL.
+ */
+wordnorm_t* pindex_normalizer(pindex_t* pindex);
+
+/*************** pindex_weight ***************
+ * Returns the BM25 weight of a term held by df documents, as in
+ * postings_t (0 when ranking by counts), for postings made at query
+ * time, such as a phrase's.
+ */
+double pindex_weight(pindex_t* pindex, int df);
+
+/*************** pindex_bound ***************
+ * Sets a list's max_score and fills its block_max, which must have room
+ * for one score per PINDEX_BLOCK postings, rounding up.
+ * Inputs:
+ * list - the postings, with list, num and weight set.
+ * norms - the pindex's BM25 normalizers, or NULL to score by counts.
+ */
+void pindex_bound(postings_t* list, const double* norms);
+
+/*************** pindex_score ***************
+ * Scores one posting for its word: the count or, given BM25 norms
+ * (see pindex_norms), the BM25 score in units of 1/PINDEX_BM25_SCALE,
+ * at least 1 so every matching document keeps a positive score.
+ * Inputs:
+ * list - the word's postings.
+ * norms - the pindex's BM25 normalizers, or NULL to score by counts.
+ * pos - which posting.
+ */
+int pindex_score(const postings_t* list, const double* norms, int pos);
+
+/*************** pindex_delete ***************
+ * Frees the pindex and all its postings.
+ */
+void pindex_delete(pindex_t* pindex);
+
+#endif // PINDEX_H
@@ -0,0 +1,299 @@
+/*
+ * qbatch.c - batch mode for the 'querier' module
+ *
+ * The main thread reads a chunk of lines, starts the workers, and waits
+ * for them; workers claim a few lines at a time until the chunk is
+ * used up, leaving each line's formatted result in its slot, and the
+ * main thread then writes the slots in order. Results from the shared
+ * cache are formatted while its lock is held, since qcache_find's array
+ * is only good until the next insert.
+ * See qbatch.h for declarations.
+ *
+ * Manzi Fabrice Niyigaba, CS50, November 2024
+ */
+
+# define _GNU_SOURCE
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <pthread.h>
+# include "qbatch.h"
+# include "qshard.h"
+# include "querier.h"
+# include "validate.h"
+
+/*************** batch ***************
+ * One chunk of queries, shared by the workers.
+ * - `lines`, `results`: each query line, and its formatted result.
+ * - `next`: first line no worker has claimed; guarded by `claim_lock`.
+ * - `cache`: query results shared by all; guarded by `cache_lock`.
+ * - `top`: documents to keep per query, 0 for all.
+ */
+struct batch {
+    char** lines;
+    char** results;
+    int num_lines;
+    int next;
+    pthread_mutex_t claim_lock;
+    qshard_t* index;
+    qcache_t* cache;
+    pthread_mutex_t cache_lock;
+    bool failed;             // a result could not be formatted; claim_lock
+    int top;
+};
+
+/*************** bworker ***************
+ * One evaluation thread, with the buffers it keeps between chunks.
+ */
+struct bworker {
+    pthread_t thread;
+    struct batch* batch;
+    qgather_t* gather;       // every shard's buffers and AND prefixes
+    char* text;              // the result being formatted
+    size_t text_len;
+    size_t text_size;
+    bool text_failed;        // the buffer could not grow
+};
+
+// Local helpers
+static int read_chunk(FILE* in, char** lines, int max_lines);
+static void* batch_worker(void* arg);
+static char* answer(struct bworker* worker, const char* line);
+static void text_add(struct bworker* worker, const char* s, size_t len);
+static void text_results(struct bworker* worker, const doc_score_t* scores, int num_docs);
+
+static const int CHUNK_LINES = 4096;   // queries read and written at a time
+static const int CLAIM_LINES = 16;     // queries a worker takes at a time
+
+/*************** qbatch_run ***************/
+// see qbatch.h for more information
+bool qbatch_run(FILE* in, FILE* out, qshard_t* index, qcache_t* cache,
+                size_t pair_cache_bytes, int num_threads, int top, bool stats) {
+    struct batch batch = {.claim_lock = PTHREAD_MUTEX_INITIALIZER, .index = index,
+                          .cache = cache, .cache_lock = PTHREAD_MUTEX_INITIALIZER, .top = top};
+    batch.lines = calloc(CHUNK_LINES, sizeof(char*));
+    batch.results = calloc(CHUNK_LINES, sizeof(char*));
+    struct bworker* workers = calloc(num_threads, sizeof(struct bworker));
+    bool ok = (batch.lines != NULL && batch.results != NULL && workers != NULL);
+    for (int t = 0; ok && t < num_threads; t++) {
+        workers[t].batch = &batch;
+        // the workers already run at once, so each searches the shards in turn
+        workers[t].gather = qgather_new(pair_cache_bytes / num_threads, false);
+        ok = workers[t].gather != NULL;
+    }
+
+    while (ok && (batch.num_lines = read_chunk(in, batch.lines, CHUNK_LINES)) > 0) {
+        batch.next = 0;
+        int started = 0;
+        while (started < num_threads
+               && pthread_create(&workers[started].thread, NULL, batch_worker,
+                                 &workers[started]) == 0) {
+            started++;
+        }
+        if (started == 0) {
+            ok = false;     // no threads at all; one would do
+        }
+        for (int t = 0; t < started; t++) {
+            pthread_join(workers[t].thread, NULL);
+        }
+
+        for (int i = 0; i < batch.num_lines; i++) {
+            if (ok && batch.results[i] != NULL) {
+                fputs(batch.results[i], out);
+            }
+            free(batch.lines[i]);
+            free(batch.results[i]);
+            batch.lines[i] = batch.results[i] = NULL;
+        }
+        ok = ok && !batch.failed;
+    }
+    fflush(out);
+
+    if (stats && pair_cache_bytes > 0 && workers != NULL) {
+        long hits = 0, misses = 0;
+        size_t bytes = 0;
+        for (int t = 0; t < num_threads; t++) {
+            long h, m;
+            size_t b;
+            qgather_stats(workers[t].gather, &h, &m, &b);
+            hits += h;
+            misses += m;
+            bytes += b;
+        }
+        fprintf(stderr, "AND cache: %ld hits, %ld misses, %zu bytes held\n",
+                hits, misses, bytes);
+    }
+
+    for (int t = 0; workers != NULL && t < num_threads; t++) {
+        qgather_delete(workers[t].gather);
+        free(workers[t].text);
+    }
+    free(workers);
+    free(batch.lines);
+    free(batch.results);
+    pthread_mutex_destroy(&batch.claim_lock);
+    pthread_mutex_destroy(&batch.cache_lock);
+    return ok;
+}
+
+/*************** read_chunk ***************
+ * Reads up to max_lines lines, without their newlines.
+ * Returns:
+ * the number read; 0 at end of file.
+ */
+static int read_chunk(FILE* in, char** lines, int max_lines) {
+    int n = 0;
+    size_t size = 0;
+    while (n < max_lines) {
+        lines[n] = NULL;
+        size = 0;
+        ssize_t nread = getline(&lines[n], &size, in);
+        if (nread == -1) {
+            free(lines[n]);
+            lines[n] = NULL;
+            break;
+        }
+        if (nread > 0 && lines[n][nread - 1] == '\n') {
+            lines[n][nread - 1] = '\0';
+        }
+        n++;
+    }
+    return n;
+}
+
+/*************** batch_worker ***************
+ * Thread body: answers unclaimed lines of the chunk until none are left.
+ */
+static void* batch_worker(void* arg) {
+    struct bworker* worker = arg;
+    struct batch* batch = worker->batch;
+    while (1) {
+        pthread_mutex_lock(&batch->claim_lock);
+        int first = batch->next;
+        batch->next += CLAIM_LINES;
+        pthread_mutex_unlock(&batch->claim_lock);
+        if (first >= batch->num_lines) {
+            break;
+        }
+        int end = (first + CLAIM_LINES < batch->num_lines) ? first + CLAIM_LINES : batch->num_lines;
+        for (int i = first; i < end; i++) {
+            batch->results[i] = answer(worker, batch->lines[i]);
+            if (batch->results[i] == NULL) {
+                pthread_mutex_lock(&batch->claim_lock);
+                batch->failed = true;
+                pthread_mutex_unlock(&batch->claim_lock);
+            }
+        }
+    }
+    return NULL;
+}
+
+/*************** answer ***************
+ * Evaluates one query line and formats its output line.
+ * Returns:
+ * a malloc'd output line for the caller to free, or NULL on error.
+ */
+static char* answer(struct bworker* worker, const char* line) {
+    struct batch* batch = worker->batch;
+    worker->text_len = 0;
+    worker->text_failed = false;
+    char* cleaned_query = query_clean(line);
+    if (cleaned_query == NULL) {
+        return NULL;
+    }
+    for (char* p = cleaned_query; *p != '\0'; p++) {
+        if (*p == '\t') {
+            *p = ' ';
+        }
+    }
+    text_add(worker, cleaned_query, strlen(cleaned_query));
+    text_add(worker, "\t", 1);
+
+    // phrases need positions, as in interactive mode
+    int word_count = 0;
+    char** words = validate(cleaned_query, &word_count);
+    if (words == NULL || word_count == 0 || !operator_validate(words, word_count)
+        || !query_normalize(words, word_count, qshard_normalizer(batch->index))
+        || (query_phrase(words, word_count) && !qshard_positions(batch->index))) {
+        text_add(worker, "-1\t\n", 4);
+    } else {
+        char* key = query_key(words, word_count);
+        const doc_score_t* scores;
+        int num_docs;
+        pthread_mutex_lock(&batch->cache_lock);
+        bool hit = key != NULL && qcache_find(batch->cache, key, &scores, &num_docs);
+        if (hit) {
+            text_results(worker, scores, num_docs);
+        }
+        pthread_mutex_unlock(&batch->cache_lock);
+
+        // a query that could not be evaluated fails the batch; it is
+        // not cached as matching nothing
+        if (!hit && !qgather_run(worker->gather, batch->index, words, word_count,
+                                 batch->top, &scores, &num_docs)) {
+            worker->text_failed = true;
+        } else if (!hit) {
+            text_results(worker, scores, num_docs);
+            pthread_mutex_lock(&batch->cache_lock);
+            qcache_insert(batch->cache, key, scores, num_docs);
+            pthread_mutex_unlock(&batch->cache_lock);
+        }
+        free(key);
+    }
+    if (words != NULL) {
+        free_memory(words, &word_count);
+    }
+    free(cleaned_query);
+
+    if (worker->text_failed) {
+        return NULL;
+    }
+    return strndup(worker->text, worker->text_len);
+}
+
+/*************** text_add ***************
+ * Appends to the result being formatted, growing its buffer as needed;
+ * once it cannot grow, later appends to the result do nothing.
+ */
+static void text_add(struct bworker* worker, const char* s, size_t len) {
+    if (worker->text_failed) {
+        return;
+    }
+    if (worker->text_len + len + 1 > worker->text_size) {
+        size_t size = (worker->text_size > 0) ? worker->text_size : 256;
+        while (size < worker->text_len + len + 1) {
+            size *= 2;
+        }
+        char* bigger = realloc(worker->text, size);
+        if (bigger == NULL) {
+            worker->text_failed = true;
+            return;
+        }
+        worker->text = bigger;
+        worker->text_size = size;
+    }
+    memcpy(worker->text + worker->text_len, s, len);
+    worker->text_len += len;
+}
+
+/*************** text_results ***************
+ * Appends the count and the ranked documents, ending the line; BM25
+ * scores are written to three decimals.
+ */
+static void text_results(struct bworker* worker, const doc_score_t* scores, int num_docs) {
+    bool bm25 = qshard_bm25(worker->batch->index);
+    char field[48];
+    int len = snprintf(field, sizeof(field), "%d\t", num_docs);
+    text_add(worker, field, len);
+    for (int i = 0; i < num_docs; i++) {
+        if (bm25) {
+            len = snprintf(field, sizeof(field), "%s%d:%.3f", (i > 0) ? " " : "",
+                           scores[i].docID, (double) scores[i].score / PINDEX_BM25_SCALE);
+        } else {
+            len = snprintf(field, sizeof(field), "%s%d:%d", (i > 0) ? " " : "",
+                           scores[i].docID, scores[i].score);
+        }
+        text_add(worker, field, len);
+    }
+    text_add(worker, "\n", 1);
+}
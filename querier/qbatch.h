@@ -0,0 +1,50 @@
+// qbatch.h - header file for the querier's batch mode
+//
+// Batch mode answers a file of queries, one per line (such as fuzzquery
+// writes), without prompts. Queries are evaluated on a pool of threads
+// against one shared, read-only index, each thread with its own qgather
+// workspace and AND prefix caches; the query result cache is shared
+// under a lock. Input is taken a chunk of lines at a time, and each
+// chunk's results are written in input order once it is done.
+//
+// Every input line produces exactly one output line of three
+// tab-separated fields:
+//
+//     query <TAB> count <TAB> docID:score docID:score ...
+//
+// `query` is the line lowercased (tabs become spaces), `count` is the
+// number of documents matched (or kept, if only the top ones are
+// wanted), and the documents follow ranked as the interactive querier
+// ranks them. A line that is blank or not a valid query, or that holds
+// a phrase when the index has no positions, has count -1 and no
+// documents.
+
+#ifndef QBATCH_H
+#define QBATCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "qshard.h"
+#include "qcache.h"
+
+/*************** qbatch_run ***************
+ * Answers every query in a file.
+ * Inputs:
+ * in - the queries, one per line.
+ * out - where the results go, one line per query (see above).
+ * index - the index to evaluate against, of one shard or several.
+ * cache - query result cache shared by the threads; may hold nothing.
+ * pair_cache_bytes - AND prefix cache capacity, split among the threads;
+ *   0 for none.
+ * num_threads - threads to evaluate queries on, at least 1.
+ * top - how many documents to give per query; 0 for all that match.
+ * stats - print the AND cache's hits and misses to stderr at the end.
+ * Output:
+ * false if memory or a thread could not be had; results already
+ * written stay written.
+ */
+bool qbatch_run(FILE* in, FILE* out, qshard_t* index, qcache_t* cache,
+                size_t pair_cache_bytes, int num_threads, int top, bool stats);
+
+#endif // QBATCH_H
@@ -0,0 +1,241 @@
+/*
+ * qbench.c - time the querier's evaluation on postings laid out three ways
+ *
+ * usage: ./qbench indexFilename queryFile [logFile] [passes]
+ *
+ * Loads the index once, parses and normalizes every valid query of
+ * queryFile (such as fuzzquery writes) once, and then times evaluating
+ * them all, every match and only the top 10, on the postings as they
+ * are loaded, laid out by the words logFile asks for most (queryFile
+ * itself if no log is given; see pindex_layout), and laid out so on
+ * huge pages. Queries are ranked by BM25 if the index has its page
+ * lengths beside it, and by count otherwise. The AND and result caches
+ * are left out, so every query reads its postings. Each way is timed
+ * over passes passes (5 by default), and the best is reported, with
+ * the time pindex_layout took. Prefetching is built in; build qbench
+ * with -DNOPREFETCH in CFLAGS to time the evaluation without it.
+ *
+ * Exit status: 0 on success, 1 on bad arguments, 2 if the index, the
+ * queries, or the log cannot be loaded, 3 if a layout changes a result.
+ *
+ * Manzi Fabrice Niyigaba, CS50, November 2024
+ */
+
+# define _GNU_SOURCE
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <stdbool.h>
+# include <time.h>
+# include "pindex.h"
+# include "qplan.h"
+# include "qlog.h"
+# include "querier.h"
+# include "validate.h"
+# include "../common/indexfile.h"
+# include "../common/docstats.h"
+# include "../common/positions.h"
+# include "../common/word.h"
+
+/*************** query ***************
+ * One parsed query: its validated, normalized words.
+ */
+typedef struct query {
+    char** words;
+    int word_count;
+} query_t;
+
+// Local helpers
+static query_t* load_queries(const char* filename, wordnorm_t* norm, int* num_queries);
+static bool run_pass(qwork_t* work, pindex_t* pindex, query_t* queries, int num_queries,
+                     int top, double* seconds, unsigned long* checksum);
+static double now(void);
+
+static const int DEFAULT_PASSES = 5;
+static const int TOP = 10;   // documents kept in the top-k runs
+
+int main(const int argc, char* argv[]) {
+    if (argc < 3 || argc > 5) {
+        fprintf(stderr, "usage: %s indexFilename queryFile [logFile] [passes]\n", argv[0]);
+        return 1;
+    }
+    const char* index_file = argv[1];
+    const char* log_file = (argc >= 4) ? argv[3] : argv[2];
+    int passes = (argc == 5) ? atoi(argv[4]) : DEFAULT_PASSES;
+    if (passes < 1) {
+        fprintf(stderr, "passes must be at least 1\n");
+        return 1;
+    }
+
+    indexfile_t* file = indexfile_load(index_file);
+    wordnorm_t* norm = wordnorm_load(index_file);
+    docstats_t* stats = docstats_load(index_file);   // NULL ranks by count
+    int num_hot = 0;
+    char** hot = qlog_load(log_file, &num_hot);
+    int num_queries = 0;
+    validate_quiet(true);
+    query_t* queries = (norm == NULL) ? NULL : load_queries(argv[2], norm, &num_queries);
+    qwork_t* work = qwork_new();
+    if (file == NULL || norm == NULL || hot == NULL || queries == NULL || work == NULL) {
+        fprintf(stderr, "Cannot load %s, %s, or %s\n", index_file, argv[2], log_file);
+        return 2;
+    }
+    printf("%d queries, %d words in the log, ranked by %s\n",
+           num_queries, num_hot, (stats != NULL) ? "BM25" : "count");
+    printf("%-12s %12s %14s %14s\n", "layout", "layout ms", "all us/query", "top-10 us/query");
+
+    const char* names[3] = {"as loaded", "by log", "huge pages"};
+    unsigned long expected[2] = {0, 0};
+    int status = 0;
+    for (int way = 0; way < 3 && status == 0; way++) {
+        // each way starts from freshly built postings
+        pindex_t* pindex = pindex_build(file, stats, positions_load(index_file),
+                                        wordnorm_load(index_file));
+        if (pindex == NULL) {
+            status = 2;
+            break;
+        }
+        double start = now();
+        if (way > 0 && !pindex_layout(pindex, hot, num_hot, way == 2)) {
+            fprintf(stderr, "Cannot lay out the postings\n");
+            pindex_delete(pindex);
+            status = 2;
+            break;
+        }
+        double layout = now() - start;
+
+        double best[2];
+        for (int t = 0; t < 2 && status == 0; t++) {
+            for (int p = 0; p < passes; p++) {
+                double seconds;
+                unsigned long checksum;
+                if (!run_pass(work, pindex, queries, num_queries, (t == 0) ? 0 : TOP,
+                              &seconds, &checksum)) {
+                    status = 2;
+                    break;
+                }
+                if (p == 0 || seconds < best[t]) {
+                    best[t] = seconds;
+                }
+                if (way == 0 && p == 0) {
+                    expected[t] = checksum;
+                } else if (checksum != expected[t]) {
+                    fprintf(stderr, "Results differ laid out %s\n", names[way]);
+                    status = 3;
+                    break;
+                }
+            }
+        }
+        if (status == 0) {
+            printf("%-12s %12.1f %14.2f %14.2f\n", names[way], layout * 1e3,
+                   best[0] * 1e6 / num_queries, best[1] * 1e6 / num_queries);
+        }
+        pindex_delete(pindex);
+    }
+
+    for (int i = 0; i < num_queries; i++) {
+        free_memory(queries[i].words, &queries[i].word_count);
+    }
+    free(queries);
+    qwork_delete(work);
+    qlog_delete(hot, num_hot);
+    docstats_delete(stats);
+    wordnorm_delete(norm);
+    indexfile_delete(file);
+    return status;
+}
+
+/*************** load_queries ***************
+ * Reads the valid queries of a file, one per line, validated and
+ * normalized as the querier does.
+ * Returns:
+ * the queries, or NULL if the file cannot be read, memory runs out,
+ * or no query is valid.
+ */
+static query_t* load_queries(const char* filename, wordnorm_t* norm, int* num_queries) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return NULL;
+    }
+    query_t* queries = NULL;
+    int num = 0;
+    int size = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    bool ok = true;
+    while (ok && getline(&line, &line_size, fp) != -1) {
+        line[strcspn(line, "\n")] = '\0';
+        char* cleaned_query = query_clean(line);
+        int word_count = 0;
+        char** words = (cleaned_query == NULL) ? NULL : validate(cleaned_query, &word_count);
+        free(cleaned_query);
+        if (words == NULL) {
+            continue;
+        }
+        if (word_count == 0 || !operator_validate(words, word_count)
+            || !query_normalize(words, word_count, norm)) {
+            free_memory(words, &word_count);
+            continue;
+        }
+        if (num == size) {
+            size = (size > 0) ? size * 2 : 1024;
+            query_t* bigger = realloc(queries, size * sizeof(query_t));
+            if (bigger == NULL) {
+                free_memory(words, &word_count);
+                ok = false;
+                break;
+            }
+            queries = bigger;
+        }
+        queries[num].words = words;
+        queries[num].word_count = word_count;
+        num++;
+    }
+    free(line);
+    fclose(fp);
+    if (!ok || num == 0) {
+        for (int i = 0; i < num; i++) {
+            free_memory(queries[i].words, &queries[i].word_count);
+        }
+        free(queries);
+        return NULL;
+    }
+    *num_queries = num;
+    return queries;
+}
+
+/*************** run_pass ***************
+ * Evaluates every query once.
+ * Inputs:
+ * top - documents to keep, 0 for all that match.
+ * seconds - set to the time taken.
+ * checksum - set to a sum over every result, to compare layouts by.
+ * Returns:
+ * false if the workspace could not grow.
+ */
+static bool run_pass(qwork_t* work, pindex_t* pindex, query_t* queries, int num_queries,
+                     int top, double* seconds, unsigned long* checksum) {
+    *checksum = 0;
+    double start = now();
+    for (int q = 0; q < num_queries; q++) {
+        if (!qplan_compile(work, queries[q].words, queries[q].word_count, pindex)) {
+            return false;
+        }
+        int num_docs = 0;
+        const doc_score_t* scores = qplan_execute(work, NULL, top, &num_docs);
+        for (int i = 0; i < num_docs; i++) {
+            *checksum = *checksum * 31 + (unsigned long) scores[i].docID * 7919 + scores[i].score;
+        }
+    }
+    *seconds = now() - start;
+    return true;
+}
+
+/*************** now ***************
+ * Returns a monotonic time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,283 @@
+/*
+ * qcache.c - query result cache for the 'querier' module
+ *
+ * An LRU cache: entries hang off a hash table by key, and also sit on a
+ * doubly-linked list from most to least recently used, so a lookup, an
+ * insert, and dropping the oldest entry each take constant time.
+ * Popularity is a table of saturating byte counters indexed by the key's
+ * hash; after as many lookups as the table has counters, every counter
+ * is halved.
+ * See qcache.h for declarations.
+ *
+ * Manzi Fabrice Niyigaba, CS50, November 2024
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <stdbool.h>
+# include "qcache.h"
+
+/*************** qentry ***************
+ * One query's results.
+ * - `key`, `scores`, `num_docs`: the query and its ranked documents.
+ * - `bytes`: memory the entry accounts for.
+ * - `next`: next entry in the same hash bucket.
+ * - `newer`, `older`: neighbours in the LRU list.
+ */
+typedef struct qentry {
+    char* key;
+    doc_score_t* scores;
+    int num_docs;
+    size_t bytes;
+    struct qentry* next;
+    struct qentry* newer;
+    struct qentry* older;
+} qentry_t;
+
+struct qcache {
+    qentry_t** buckets;      // hash table of entries
+    size_t num_buckets;      // a power of two
+    qentry_t* newest;        // head of the LRU list
+    qentry_t* oldest;        // tail of the LRU list
+    size_t capacity;         // most bytes to hold
+    size_t bytes;            // bytes held now
+    long hits;
+    long misses;
+    unsigned char* popular;  // lookup counts by hash
+    size_t num_popular;      // a power of two
+    size_t lookups;          // lookups since the counts were last halved
+};
+
+// Local helpers
+static size_t key_hash(const char* key);
+static qentry_t** bucket_slot(qcache_t* cache, const char* key);
+static void lru_unlink(qcache_t* cache, qentry_t* entry);
+static void lru_push(qcache_t* cache, qentry_t* entry);
+static void entry_drop(qcache_t* cache, qentry_t* entry);
+static void popularity_count(qcache_t* cache, const char* key);
+
+static const size_t BYTES_PER_BUCKET = 256;   // a typical small entry
+static const size_t MIN_BUCKETS = 64;
+static const size_t MAX_BUCKETS = 1 << 16;
+static const size_t POPULAR_PER_BUCKET = 4;   // counters per hash bucket
+
+/*************** qcache_new ***************/
+// see qcache.h for more information
+qcache_t* qcache_new(size_t capacity) {
+    qcache_t* cache = calloc(1, sizeof(qcache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->num_buckets = MIN_BUCKETS;
+    while (cache->num_buckets < MAX_BUCKETS
+           && cache->num_buckets * BYTES_PER_BUCKET < capacity) {
+        cache->num_buckets *= 2;
+    }
+    cache->buckets = calloc(cache->num_buckets, sizeof(qentry_t*));
+    cache->num_popular = cache->num_buckets * POPULAR_PER_BUCKET;
+    cache->popular = calloc(cache->num_popular, 1);
+    if (cache->buckets == NULL || cache->popular == NULL) {
+        free(cache->buckets);
+        free(cache->popular);
+        free(cache);
+        return NULL;
+    }
+    cache->capacity = capacity;
+    return cache;
+}
+
+/*************** qcache_find ***************/
+// see qcache.h for more information
+bool qcache_find(qcache_t* cache, const char* key,
+                 const doc_score_t** scores, int* num_docs) {
+    if (cache == NULL || key == NULL) {
+        return false;
+    }
+    popularity_count(cache, key);
+    qentry_t* entry = *bucket_slot(cache, key);
+    if (entry == NULL) {
+        cache->misses++;
+        return false;
+    }
+    cache->hits++;
+    lru_unlink(cache, entry);
+    lru_push(cache, entry);
+    *scores = entry->scores;
+    *num_docs = entry->num_docs;
+    return true;
+}
+
+/*************** qcache_insert ***************/
+// see qcache.h for more information
+void qcache_insert(qcache_t* cache, const char* key,
+                   const doc_score_t* scores, int num_docs) {
+    if (cache == NULL || key == NULL || num_docs < 0) {
+        return;
+    }
+    size_t bytes = sizeof(qentry_t) + strlen(key) + 1 + num_docs * sizeof(doc_score_t);
+    if (bytes > cache->capacity) {
+        return;
+    }
+
+    // replace any old results for the key
+    qentry_t* old = *bucket_slot(cache, key);
+    if (old != NULL) {
+        entry_drop(cache, old);
+    }
+    while (cache->bytes + bytes > cache->capacity) {
+        entry_drop(cache, cache->oldest);
+    }
+
+    qentry_t* entry = calloc(1, sizeof(qentry_t));
+    if (entry == NULL) {
+        return;
+    }
+    entry->key = malloc(strlen(key) + 1);
+    if (num_docs > 0) {
+        entry->scores = malloc(num_docs * sizeof(doc_score_t));
+    }
+    if (entry->key == NULL || (num_docs > 0 && entry->scores == NULL)) {
+        free(entry->key);
+        free(entry->scores);
+        free(entry);
+        return;
+    }
+    strcpy(entry->key, key);
+    if (num_docs > 0) {
+        memcpy(entry->scores, scores, num_docs * sizeof(doc_score_t));
+    }
+    entry->num_docs = num_docs;
+    entry->bytes = bytes;
+
+    qentry_t** slot = bucket_slot(cache, key);
+    entry->next = *slot;
+    *slot = entry;
+    lru_push(cache, entry);
+    cache->bytes += bytes;
+}
+
+/*************** qcache_popularity ***************/
+// see qcache.h for more information
+int qcache_popularity(qcache_t* cache, const char* key) {
+    if (cache == NULL || key == NULL) {
+        return 0;
+    }
+    return cache->popular[key_hash(key) & (cache->num_popular - 1)];
+}
+
+/*************** qcache_flush ***************/
+// see qcache.h for more information
+void qcache_flush(qcache_t* cache) {
+    if (cache == NULL) {
+        return;
+    }
+    while (cache->oldest != NULL) {
+        entry_drop(cache, cache->oldest);
+    }
+}
+
+/*************** qcache_stats ***************/
+// see qcache.h for more information
+void qcache_stats(qcache_t* cache, long* hits, long* misses, size_t* bytes) {
+    *hits = (cache == NULL) ? 0 : cache->hits;
+    *misses = (cache == NULL) ? 0 : cache->misses;
+    *bytes = (cache == NULL) ? 0 : cache->bytes;
+}
+
+/*************** qcache_delete ***************/
+// see qcache.h for more information
+void qcache_delete(qcache_t* cache) {
+    if (cache == NULL) {
+        return;
+    }
+    qcache_flush(cache);
+    free(cache->buckets);
+    free(cache->popular);
+    free(cache);
+}
+
+/*************** key_hash ***************
+ * 64-bit FNV-1a hash of a key.
+ */
+static size_t key_hash(const char* key) {
+    unsigned long long h = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*) key; *p != '\0'; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return (size_t) h;
+}
+
+/*************** bucket_slot ***************
+ * Returns the link that points at the key's entry, or at the NULL
+ * ending its bucket if the key is not cached.
+ */
+static qentry_t** bucket_slot(qcache_t* cache, const char* key) {
+    qentry_t** slot = &cache->buckets[key_hash(key) & (cache->num_buckets - 1)];
+    while (*slot != NULL && strcmp((*slot)->key, key) != 0) {
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+/*************** lru_unlink ***************
+ * Takes an entry off the LRU list.
+ */
+static void lru_unlink(qcache_t* cache, qentry_t* entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+    entry->newer = entry->older = NULL;
+}
+
+/*************** lru_push ***************
+ * Puts an entry at the most recently used end of the LRU list.
+ */
+static void lru_push(qcache_t* cache, qentry_t* entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+/*************** entry_drop ***************
+ * Removes an entry from the table and the LRU list, and frees it.
+ */
+static void entry_drop(qcache_t* cache, qentry_t* entry) {
+    qentry_t** slot = bucket_slot(cache, entry->key);
+    *slot = entry->next;
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->bytes;
+    free(entry->key);
+    free(entry->scores);
+    free(entry);
+}
+
+/*************** popularity_count ***************
+ * Counts one lookup of the key, halving every count once enough
+ * lookups have gone by.
+ */
+static void popularity_count(qcache_t* cache, const char* key) {
+    unsigned char* count = &cache->popular[key_hash(key) & (cache->num_popular - 1)];
+    if (*count < 255) {
+        (*count)++;
+    }
+    if (++cache->lookups >= cache->num_popular) {
+        for (size_t i = 0; i < cache->num_popular; i++) {
+            cache->popular[i] /= 2;
+        }
+        cache->lookups = 0;
+    }
+}
@@ -0,0 +1,81 @@
+// qcache.h - header file for the querier's query result cache
+//
+// A qcache remembers the ranked results of recent queries, keyed by the
+// query as the querier evaluates it: the validated words, lowercased
+// and joined by single spaces, so "Home  AND back" and "home and back"
+// share an entry. When the cache holds more than its capacity in bytes,
+// the least recently used results are dropped first.
+//
+// The cache also keeps a rough count of how often each key has been
+// looked up lately (a small table of counters, halved now and then so
+// old popularity fades), so callers can cache only what keeps coming
+// back.
+//
+// The cache knows nothing about the index; the querier must call
+// qcache_flush whenever the index it answers from changes.
+
+#ifndef QCACHE_H
+#define QCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "querier.h"
+
+typedef struct qcache qcache_t;  // opaque to users of the module
+
+/*************** qcache_new ***************
+ * Creates an empty cache.
+ * Input:
+ * capacity - the most bytes of results (with their keys and bookkeeping)
+ *            to hold; 0 makes a cache that never holds anything.
+ * Output:
+ * The new cache, or NULL on error. Caller is responsible for qcache_delete.
+ */
+qcache_t* qcache_new(size_t capacity);
+
+/*************** qcache_find ***************
+ * Looks up a query's results, counting a hit or a miss.
+ * Inputs:
+ * cache - the cache.
+ * key - the query's key (see above).
+ * scores, num_docs - set to the ranked results on a hit; the array
+ *   belongs to the cache and is good until the next qcache_insert,
+ *   qcache_flush, or qcache_delete (NULL if no documents matched).
+ * Output:
+ * true on a hit, which also makes the entry the most recently used.
+ * Either way the lookup counts toward the key's popularity.
+ */
+bool qcache_find(qcache_t* cache, const char* key,
+                 const doc_score_t** scores, int* num_docs);
+
+/*************** qcache_insert ***************
+ * Adds a query's ranked results, copying the key and the array, and
+ * drops least recently used entries until the cache fits its capacity.
+ * Results too big for the whole cache are not kept.
+ */
+void qcache_insert(qcache_t* cache, const char* key,
+                   const doc_score_t* scores, int num_docs);
+
+/*************** qcache_popularity ***************
+ * Estimates how many times the key has been looked up lately. Keys that
+ * share a counter are counted together, so the estimate may be high,
+ * never low (until the counts are halved).
+ */
+int qcache_popularity(qcache_t* cache, const char* key);
+
+/*************** qcache_flush ***************
+ * Drops every entry; the hit and miss counts are kept.
+ */
+void qcache_flush(qcache_t* cache);
+
+/*************** qcache_stats ***************
+ * Reports the hits and misses so far, and the bytes now in use.
+ */
+void qcache_stats(qcache_t* cache, long* hits, long* misses, size_t* bytes);
+
+/*************** qcache_delete ***************
+ * Frees the cache and everything in it.
+ */
+void qcache_delete(qcache_t* cache);
+
+#endif // QCACHE_H
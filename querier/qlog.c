@@ -0,0 +1,156 @@
+/*
+ * qlog.c - query logs for the 'querier' module
+ *
+ * Every counted word of the log is kept, then sorted, so that equal
+ * words sit together and each run's length is its count; the distinct
+ * words are then sorted by count. A log holds far fewer words than an
+ * index, so this is done once at startup and costs little.
+ * See qlog.h for declarations.
+ *
+ * Manzi Fabrice Niyigaba, CS50, November 2024
+ */
+
+# define _GNU_SOURCE
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <ctype.h>
+# include <stdbool.h>
+# include "qlog.h"
+
+/*************** ranked ***************
+ * A distinct word of the log, and how many times it was asked for.
+ */
+struct ranked {
+    char* word;
+    int count;
+};
+
+// Local helpers
+static bool add_word(char*** words, int* num, int* size, const char* start, size_t len);
+static int compare_words(const void* a, const void* b);
+static int compare_ranked(const void* a, const void* b);
+
+/*************** qlog_load ***************/
+// see qlog.h for more information
+char** qlog_load(const char* filename, int* num_words) {
+    *num_words = 0;
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return NULL;
+    }
+    char** words = NULL;
+    int num = 0;
+    int size = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    bool ok = true;
+    while (ok && getline(&line, &line_size, fp) != -1) {
+        char* p = line;
+        while (ok && *p != '\0') {
+            if (!isalpha((unsigned char) *p)) {
+                p++;
+                continue;
+            }
+            char* start = p;
+            while (isalpha((unsigned char) *p)) {
+                p++;
+            }
+            bool wildcard = (*p == '*' || (start > line && start[-1] == '*'));
+            if (!wildcard) {
+                ok = add_word(&words, &num, &size, start, p - start);
+            }
+        }
+    }
+    free(line);
+    fclose(fp);
+
+    // equal words together, then one entry a word, by count
+    struct ranked* ranked = ok ? malloc((num + 1) * sizeof(struct ranked)) : NULL;
+    int num_ranked = 0;
+    if (ranked != NULL) {
+        qsort(words, num, sizeof(char*), compare_words);
+        for (int i = 0; i < num; i++) {
+            if (num_ranked > 0 && strcmp(ranked[num_ranked - 1].word, words[i]) == 0) {
+                ranked[num_ranked - 1].count++;
+                free(words[i]);
+            } else {
+                ranked[num_ranked].word = words[i];
+                ranked[num_ranked].count = 1;
+                num_ranked++;
+            }
+        }
+        qsort(ranked, num_ranked, sizeof(struct ranked), compare_ranked);
+        for (int i = 0; i < num_ranked; i++) {
+            words[i] = ranked[i].word;
+        }
+        free(ranked);
+        *num_words = num_ranked;
+        if (words == NULL) {
+            words = malloc(sizeof(char*));   // an empty log
+        }
+        return words;
+    }
+    qlog_delete(words, num);
+    return NULL;
+}
+
+/*************** qlog_delete ***************/
+// see qlog.h for more information
+void qlog_delete(char** words, int num_words) {
+    for (int i = 0; words != NULL && i < num_words; i++) {
+        free(words[i]);
+    }
+    free(words);
+}
+
+/*************** add_word ***************
+ * Adds a lowercased copy of a word to the list, growing it as needed.
+ * Returns:
+ * false if memory ran out.
+ */
+static bool add_word(char*** words, int* num, int* size, const char* start, size_t len) {
+    // the operators are not words anyone asks for
+    if ((len == 3 && strncasecmp(start, "and", 3) == 0)
+        || (len == 2 && strncasecmp(start, "or", 2) == 0)) {
+        return true;
+    }
+    if (*num == *size) {
+        int bigger_size = (*size > 0) ? *size * 2 : 1024;
+        char** bigger = realloc(*words, bigger_size * sizeof(char*));
+        if (bigger == NULL) {
+            return false;
+        }
+        *words = bigger;
+        *size = bigger_size;
+    }
+    char* word = malloc(len + 1);
+    if (word == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        word[i] = tolower((unsigned char) start[i]);
+    }
+    word[len] = '\0';
+    (*words)[(*num)++] = word;
+    return true;
+}
+
+/*************** compare_words ***************
+ * Orders words alphabetically, for qsort.
+ */
+static int compare_words(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/*************** compare_ranked ***************
+ * Orders words by decreasing count, then alphabetically, for qsort.
+ */
+static int compare_ranked(const void* a, const void* b) {
+    const struct ranked* x = a;
+    const struct ranked* y = b;
+    if (x->count != y->count) {
+        return (x->count < y->count) ? 1 : -1;
+    }
+    return strcmp(x->word, y->word);
+}
@@ -0,0 +1,30 @@
+// qlog.h - header file for the querier's query logs
+//
+// A query log is a file of past queries, one per line, such as batch
+// mode reads and fuzzquery writes. qlog_load ranks the words of a log by
+// how often they were asked for, so the pindex can lay out the postings
+// of the words asked for most together (see pindex_layout). A word is a
+// run of letters, lowercased; the operators `and` and `or`, and words
+// with a wildcard, are not counted. The words of a phrase count as words.
+
+#ifndef QLOG_H
+#define QLOG_H
+
+/*************** qlog_load ***************
+ * Reads a query log and ranks its words.
+ * Inputs:
+ * filename - the log.
+ * num_words - set to the number of distinct words.
+ * Output:
+ * The words, each once, most often asked for first (ties in
+ * alphabetical order); NULL if the log cannot be read or memory runs
+ * out. Caller is responsible for qlog_delete.
+ */
+char** qlog_load(const char* filename, int* num_words);
+
+/*************** qlog_delete ***************
+ * Frees the words qlog_load returned.
+ */
+void qlog_delete(char** words, int num_words);
+
+#endif // QLOG_H
@@ -0,0 +1,1452 @@
+/*
+ * qplan.c - query evaluation plans for the 'querier' module
+ *
+ * Each AND group is intersected in place in the candidate buffer: it
+ * starts as a copy of the rarest list (or of a cached prefix), and each
+ * further list keeps only the candidates it also holds, found by
+ * galloping forward from the last match, so the cost follows the
+ * shorter list. OR groups are added into a dense array of scores by
+ * docID; the docIDs touched are listed so the array can be cleared
+ * without sweeping it.
+ *
+ * Asked for the top k of an OR, the plan instead walks one cursor per
+ * group in docID order (block-max WAND): a one-term group walks its
+ * postings, and a longer group is intersected first and walks that.
+ * Cursors are kept sorted by their current docID; the pivot is the
+ * first cursor at which the groups' best scores add up to more than
+ * the k-th best score so far, and no document before it can enter the
+ * top k. If the blocks around the pivot's document cannot either, all
+ * those cursors skip past the nearest block end; otherwise, once every
+ * cursor up to the pivot is on its document, the document is scored.
+ * Since documents come in docID order, one that only ties the k-th
+ * best would rank after it, so ties are skipped too. Frequent words'
+ * impact lists give the walk a head start: the documents at the head
+ * of each are scored in full first, by binary search in every cursor,
+ * and a document must score at least the k-th best of those to be
+ * worth scoring during the walk. A query of one frequent word needs no
+ * walk at all; its top k head its impact list.
+ *
+ * The loops that jump through memory ask for their next reads ahead:
+ * a gallop prefetches its next probe while it compares the current
+ * one, and both halves' next probes while it searches binarily, and OR
+ * groups prefetch the score a few documents ahead, since the docIDs
+ * scatter over the dense array. Built with -DNOPREFETCH, they do not.
+ *
+ * If the pindex treats frequent words as stopwords, they are dropped
+ * from each AND group that has other words when the plan is compiled.
+ *
+ * A quoted phrase is evaluated when the plan is compiled, into postings
+ * of its own that the plan then treats as a term's: the documents
+ * holding all its words are found by the same docID intersection as an
+ * AND group, and only in those are word positions decoded, starting
+ * from the word with the fewest there, so queries without phrases never
+ * touch positions.
+ *
+ * A word with wildcards is expanded when the plan is compiled too: the
+ * words starting with the letters before its first '*' are one range of
+ * the pindex's sorted lexicon, and those matching the whole pattern are
+ * kept, at most QPLAN_MAX_EXPAND of them, the most frequent first. Their
+ * postings are merged by docID through a heap into postings of its own,
+ * a document's count the sum of the words' counts, so the plan treats
+ * the expansion as one term. Either kind is weighted by its own count
+ * of documents, unless qplan_weigh gives it another before execution.
+ *
+ * A word the pindex does not hold is, if the pindex was prepared for
+ * fuzzy lookups, replaced the same way by the words nearest it: those
+ * pindex_near finds with the fewest edits.
+ * See qplan.h for declarations.
+ *
+ * Manzi Fabrice Niyigaba, CS50, November 2024
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <limits.h>
+# include "qplan.h"
+
+// asks for the cache line holding addr before it is read (or written)
+# ifdef NOPREFETCH
+# define PREFETCH(addr, write) ((void) 0)
+# else
+# define PREFETCH(addr, write) __builtin_prefetch((addr), (write))
+# endif
+
+/*************** cursor_t ***************
+ * A top-k OR's place in one group's documents.
+ * - `list`, `num`: the documents, by increasing docID.
+ * - `term`: the group's one term, whose scores are computed as the
+ *   cursor goes; NULL if the scores in `list` are final.
+ * - `block_max`, `max`: best score in each PINDEX_BLOCK documents, and
+ *   overall.
+ * - `pos`: the current document.
+ * - `block`: the block of the last document bounded; only moves forward.
+ * - `offset`, `block_offset`: where an intersected group's documents and
+ *   block maxima start in the workspace, until those buffers stop growing.
+ */
+typedef struct cursor {
+    const doc_score_t* list;
+    int num;
+    const postings_t* term;
+    const int* block_max;
+    int max;
+    int pos;
+    int block;
+    size_t offset;
+    size_t block_offset;
+} cursor_t;
+
+/*************** qmade_t ***************
+ * Postings made for one phrase or wildcard word of a plan, with the
+ * sizes of their buffers, which are kept for the next plan.
+ */
+typedef struct qmade {
+    postings_t postings;
+    size_t list_size;
+    size_t blocks_size;
+} qmade_t;
+
+/*************** expansion_t ***************
+ * One word a wildcard matches: its postings, and its place among the
+ * words matched, which are found in alphabetical order.
+ */
+typedef struct expansion {
+    const postings_t* postings;
+    int order;
+} expansion_t;
+
+/*************** expand_args ***************
+ * State for collecting the words a wildcard, or misspelled word, stands for.
+ */
+struct expand_args {
+    qwork_t* work;
+    const char* pattern;     // the wildcard pattern
+    int edits;               // fewest edits to a word found so far
+    int num;                 // words collected so far, in work->expand
+    bool failed;             // the buffer could not be grown
+};
+
+/*************** pterm_t ***************
+ * One word of the phrase, or wildcard expansion, being evaluated.
+ * - `list`, `pos`: its postings and positions (phrases only).
+ * - `at`: where the last document looked up is in both.
+ */
+typedef struct pterm {
+    const postings_t* list;
+    const posword_t* pos;
+    int at;
+} pterm_t;
+
+struct qwork {
+    char** words;                // the plan's terms, in query order
+    const postings_t** lists;    // each term's postings, NULL if none
+    int* order;                  // per group, its term numbers rarest first
+    size_t terms_size;
+    int num_terms;
+    int* group_end;              // one past each group's last term
+    size_t groups_size;
+    int num_groups;
+    int max_doc;                 // largest docID in the postings
+    const double* norms;         // BM25 length normalizers, or NULL
+
+    doc_score_t* cand;           // the current AND group's documents
+    size_t cand_size;
+    int* acc;                    // OR scores by docID, zero when unused
+    int* touched;                // docIDs with a nonzero score in acc
+    size_t acc_size;
+    doc_score_t* results;        // ranked documents of an OR; heap of the top k
+    size_t results_size;
+
+    cursor_t* cursors;           // top-k OR: a cursor per group with documents
+    cursor_t** active;           // those not at their end, by current docID
+    size_t cursors_size;
+    doc_score_t* mat;            // intersected groups' documents, for cursors
+    size_t mat_size;
+    int* mat_blocks;             // their block maxima
+    size_t mat_blocks_size;
+    doc_score_t* seeds;          // documents heading the impact lists, scored
+    size_t seeds_size;
+
+    qmade_t* made;               // postings of the plan's phrases and wildcards
+    size_t made_size;
+    pterm_t* pterms;             // the words of the phrase or expansion being evaluated
+    size_t pterms_size;
+    char* text;                  // that phrase split into words, or a wildcard's prefix
+    size_t text_size;
+    int* starts;                 // where the phrase may start in a document
+    size_t starts_size;
+    int* spots;                  // one word's positions in a document
+    size_t spots_size;
+    expansion_t* expand;         // the words a wildcard matches
+    size_t expand_size;
+
+    char** sorted;               // scratch for building cache keys
+    char* key;
+    size_t key_size;
+};
+
+// Local helpers
+static bool grow(void** buffer, size_t* size, size_t need, size_t item);
+static int run_group(qwork_t* work, int first, int end, qcache_t* pairs);
+static bool run_phrase(qwork_t* work, const char* phrase, qmade_t* result, pindex_t* pindex);
+static int phrase_count(qwork_t* work, int num_pterms, int docID);
+static bool run_wildcard(qwork_t* work, const char* pattern, qmade_t* result, pindex_t* pindex);
+static bool run_fuzzy(qwork_t* work, const char* word, qmade_t* result, pindex_t* pindex);
+static bool merge_expansion(qwork_t* work, int num, qmade_t* result, pindex_t* pindex);
+static bool expand_word(void* arg, const char* word, const postings_t* postings);
+static bool near_word(void* arg, const char* word, int edits, const postings_t* postings);
+static bool add_expansion(struct expand_args* args, const postings_t* postings);
+static bool glob_match(const char* pattern, const char* word);
+static void sift_down(pterm_t* heap, int num, int i);
+static bool finish_made(qwork_t* work, qmade_t* result, pindex_t* pindex);
+static int intersect(qwork_t* work, int num_cand, bool started, const postings_t* list);
+static int gallop(const doc_score_t* list, int num, int lo, int docID);
+static const doc_score_t* execute_top(qwork_t* work, qcache_t* pairs, int top, int* num_docs);
+static bool open_cursors(qwork_t* work, qcache_t* pairs, int* num_cursors);
+static int seed_threshold(qwork_t* work, int num_cursors, int top);
+static void drop_stopwords(qwork_t* work, pindex_t* pindex);
+static int sort_cursors(cursor_t** active, int num_active);
+static int cursor_block(cursor_t* cursor, int docID);
+static int block_maxima(const doc_score_t* list, int num, int* block_max);
+static void offer(doc_score_t* heap, int* num_best, int top, int docID, int score);
+static const char* prefix_key(qwork_t* work, int first, int k);
+static int compare_terms(const void* a, const void* b);
+static int compare_ranks(const void* a, const void* b);
+static int compare_df(const void* a, const void* b);
+static int compare_docs(const void* a, const void* b);
+
+static const int PAIR_ADMIT = 3;     // lookups before an AND prefix is cached
+static const int PREFETCH_AHEAD = 8; // documents ahead an OR prefetches the score of
+
+/*************** qwork_new ***************/
+// see qplan.h for more information
+qwork_t* qwork_new(void) {
+    return calloc(1, sizeof(qwork_t));
+}
+
+/*************** qplan_compile ***************/
+// see qplan.h for more information
+bool qplan_compile(qwork_t* work, char** words, int word_count, pindex_t* pindex) {
+    if (work == NULL || words == NULL) {
+        return false;
+    }
+    // the term buffers grow alike, so one size stands for all four
+    size_t sizes[4] = {work->terms_size, work->terms_size, work->terms_size, work->terms_size};
+    if (!grow((void**) &work->words, &sizes[0], word_count, sizeof(char*))
+        || !grow((void**) &work->lists, &sizes[1], word_count, sizeof(postings_t*))
+        || !grow((void**) &work->order, &sizes[2], word_count, sizeof(int))
+        || !grow((void**) &work->sorted, &sizes[3], word_count, sizeof(char*))
+        || !grow((void**) &work->group_end, &work->groups_size, word_count + 1, sizeof(int))) {
+        return false;
+    }
+    work->terms_size = sizes[0];
+    size_t old = work->made_size;
+    if (!grow((void**) &work->made, &work->made_size, word_count, sizeof(qmade_t))) {
+        return false;
+    }
+    memset(work->made + old, 0, (work->made_size - old) * sizeof(qmade_t));
+    work->max_doc = pindex_max_doc(pindex);
+    work->norms = pindex_norms(pindex);
+
+    // split at each OR, dropping ANDs; evaluate phrases and wildcards now
+    work->num_terms = 0;
+    work->num_groups = 0;
+    int num_made = 0;
+    for (int i = 0; i <= word_count; i++) {
+        if (i == word_count || strcmp(words[i], "or") == 0) {
+            work->group_end[work->num_groups++] = work->num_terms;
+        } else if (strchr(words[i], ' ') != NULL || strchr(words[i], '*') != NULL) {
+            qmade_t* made = &work->made[num_made++];
+            bool phrase = (strchr(words[i], ' ') != NULL);
+            if (phrase ? !run_phrase(work, words[i], made, pindex)
+                       : !run_wildcard(work, words[i], made, pindex)) {
+                return false;
+            }
+            work->words[work->num_terms] = words[i];
+            work->lists[work->num_terms] = (made->postings.num > 0) ? &made->postings : NULL;
+            work->num_terms++;
+        } else if (strcmp(words[i], "and") != 0) {
+            work->words[work->num_terms] = words[i];
+            work->lists[work->num_terms] = pindex_find(pindex, words[i]);
+            if (work->lists[work->num_terms] == NULL) {
+                qmade_t* made = &work->made[num_made++];
+                if (!run_fuzzy(work, words[i], made, pindex)) {
+                    return false;
+                }
+                work->lists[work->num_terms] = (made->postings.num > 0) ? &made->postings : NULL;
+            }
+            work->num_terms++;
+        }
+    }
+
+    drop_stopwords(work, pindex);
+
+    // order each group's terms by document frequency, by insertion
+    int first = 0;
+    for (int g = 0; g < work->num_groups; first = work->group_end[g++]) {
+        for (int i = first; i < work->group_end[g]; i++) {
+            const postings_t* list = work->lists[i];
+            int df = (list == NULL) ? 0 : list->num;
+            int j = i;
+            while (j > first) {
+                const postings_t* prev = work->lists[work->order[j - 1]];
+                if ((prev == NULL ? 0 : prev->num) <= df) {
+                    break;
+                }
+                work->order[j] = work->order[j - 1];
+                j--;
+            }
+            work->order[j] = i;
+        }
+    }
+    return true;
+}
+
+/*************** qplan_df ***************/
+// see qplan.h for more information
+int qplan_df(qwork_t* work, const char* word) {
+    for (int i = 0; work != NULL && i < work->num_terms; i++) {
+        if (work->words[i] == word && work->lists[i] != NULL) {
+            return work->lists[i]->num;
+        }
+    }
+    return 0;
+}
+
+/*************** qplan_weigh ***************/
+// see qplan.h for more information
+void qplan_weigh(qwork_t* work, pindex_t* pindex, const char* word, int df) {
+    for (int i = 0; work != NULL && i < work->num_terms; i++) {
+        if (work->words[i] != word || work->lists[i] == NULL) {
+            continue;
+        }
+        for (size_t m = 0; m < work->made_size; m++) {
+            postings_t* postings = &work->made[m].postings;
+            if (postings == work->lists[i]) {
+                postings->weight = pindex_weight(pindex, df);
+                pindex_bound(postings, work->norms);
+            }
+        }
+    }
+}
+
+/*************** qplan_execute ***************/
+// see qplan.h for more information
+const doc_score_t* qplan_execute(qwork_t* work, qcache_t* pairs, int top, int* num_docs) {
+    *num_docs = 0;
+    if (work == NULL || work->num_groups == 0) {
+        return NULL;
+    }
+    if (top > 0) {
+        return execute_top(work, pairs, top, num_docs);
+    }
+
+    // a single group is ranked where it was intersected
+    if (work->num_groups == 1) {
+        int num_cand = run_group(work, 0, work->group_end[0], pairs);
+        if (num_cand <= 0) {
+            return NULL;
+        }
+        qsort(work->cand, num_cand, sizeof(doc_score_t), compare_ranks);
+        *num_docs = num_cand;
+        return work->cand;
+    }
+
+    size_t need = work->max_doc + 1;
+    if (need > work->acc_size) {
+        size_t old = work->acc_size;
+        size_t size = old;
+        if (!grow((void**) &work->acc, &size, need, sizeof(int))
+            || !grow((void**) &work->touched, &work->acc_size, need, sizeof(int))) {
+            return NULL;
+        }
+        memset(work->acc + old, 0, (work->acc_size - old) * sizeof(int));
+    }
+
+    int num_touched = 0;
+    bool failed = false;
+    int first = 0;
+    for (int g = 0; g < work->num_groups; first = work->group_end[g++]) {
+        int num_cand = run_group(work, first, work->group_end[g], pairs);
+        if (num_cand < 0) {
+            failed = true;
+            break;
+        }
+        for (int i = 0; i < num_cand; i++) {
+            if (i + PREFETCH_AHEAD < num_cand) {
+                PREFETCH(&work->acc[work->cand[i + PREFETCH_AHEAD].docID], 1);
+            }
+            int doc = work->cand[i].docID;
+            if (work->acc[doc] == 0) {
+                work->touched[num_touched++] = doc;
+            }
+            work->acc[doc] += work->cand[i].score;
+        }
+    }
+
+    if (failed
+        || !grow((void**) &work->results, &work->results_size, num_touched, sizeof(doc_score_t))) {
+        for (int i = 0; i < num_touched; i++) {
+            work->acc[work->touched[i]] = 0;
+        }
+        return NULL;
+    }
+    for (int i = 0; i < num_touched; i++) {
+        if (i + PREFETCH_AHEAD < num_touched) {
+            PREFETCH(&work->acc[work->touched[i + PREFETCH_AHEAD]], 1);
+        }
+        int doc = work->touched[i];
+        work->results[i].docID = doc;
+        work->results[i].score = work->acc[doc];
+        work->acc[doc] = 0;
+    }
+    if (num_touched == 0) {
+        return NULL;
+    }
+    qsort(work->results, num_touched, sizeof(doc_score_t), compare_ranks);
+    *num_docs = num_touched;
+    return work->results;
+}
+
+/*************** qwork_delete ***************/
+// see qplan.h for more information
+void qwork_delete(qwork_t* work) {
+    if (work != NULL) {
+        free(work->words);
+        free(work->lists);
+        free(work->order);
+        free(work->group_end);
+        free(work->cand);
+        free(work->acc);
+        free(work->touched);
+        free(work->results);
+        for (size_t i = 0; i < work->made_size; i++) {
+            free(work->made[i].postings.list);
+            free(work->made[i].postings.block_max);
+        }
+        free(work->made);
+        free(work->pterms);
+        free(work->text);
+        free(work->starts);
+        free(work->spots);
+        free(work->expand);
+        free(work->cursors);
+        free(work->active);
+        free(work->mat);
+        free(work->mat_blocks);
+        free(work->seeds);
+        free(work->sorted);
+        free(work->key);
+        free(work);
+    }
+}
+
+/*************** grow ***************
+ * Makes a buffer hold at least need items, doubling it as needed.
+ * Inputs:
+ * buffer, size - the buffer and how many items it holds; both updated.
+ * need - items wanted.
+ * item - bytes per item.
+ * Returns:
+ * false if it could not be grown (the buffer is unchanged).
+ */
+static bool grow(void** buffer, size_t* size, size_t need, size_t item) {
+    if (need <= *size && *buffer != NULL) {
+        return true;
+    }
+    size_t size_new = (*size > 0) ? *size : 16;
+    while (size_new < need) {
+        size_new *= 2;
+    }
+    void* bigger = realloc(*buffer, size_new * item);
+    if (bigger == NULL) {
+        return false;
+    }
+    *buffer = bigger;
+    *size = size_new;
+    return true;
+}
+
+/*************** run_group ***************
+ * Intersects the postings of one AND group into the candidate buffer,
+ * as the minimum count of each document over the group's terms.
+ * The longest prefix of the group (two or more terms, in query order)
+ * found in the pairs cache is the starting point; if a longer prefix
+ * has been looked up PAIR_ADMIT times, it is completed next and cached.
+ * Remaining terms are intersected rarest first.
+ * Inputs:
+ * work - the workspace.
+ * first, end - the group's terms are first .. end - 1.
+ * pairs - cache of AND prefixes, or NULL.
+ * Returns:
+ * number of candidates, or -1 on error.
+ */
+static int run_group(qwork_t* work, int first, int end, qcache_t* pairs) {
+    int n = end - first;
+    for (int i = first; i < end; i++) {
+        if (work->lists[i] == NULL) {
+            return 0;      // a word no document holds
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    int done = 0;          // terms of the group already intersected
+    int admit = 0;         // the longest popular prefix
+    int num_cand = 0;
+    for (int k = n; k >= 2 && pairs != NULL; k--) {
+        const char* key = prefix_key(work, first, k);
+        const doc_score_t* postings;
+        int num_postings;
+        if (key == NULL) {
+            break;
+        }
+        if (qcache_find(pairs, key, &postings, &num_postings)) {
+            if (!grow((void**) &work->cand, &work->cand_size, num_postings, sizeof(doc_score_t))) {
+                return -1;
+            }
+            if (num_postings > 0) {
+                memcpy(work->cand, postings, num_postings * sizeof(doc_score_t));
+            }
+            num_cand = num_postings;
+            done = k;
+            break;
+        }
+        if (admit == 0 && qcache_popularity(pairs, key) >= PAIR_ADMIT) {
+            admit = k;
+        }
+    }
+
+    // the rest of the popular prefix, then the rest
+    bool started = (done > 0);
+    if (admit > done) {
+        for (int j = first; j < end; j++) {
+            int i = work->order[j];
+            if (i >= first + done && i < first + admit) {
+                num_cand = intersect(work, num_cand, started, work->lists[i]);
+                started = true;
+            }
+        }
+        if (num_cand < 0) {
+            return -1;
+        }
+        qcache_insert(pairs, prefix_key(work, first, admit), work->cand, num_cand);
+        done = admit;
+    }
+    for (int j = first; j < end; j++) {
+        int i = work->order[j];
+        if (i >= first + done) {
+            num_cand = intersect(work, num_cand, started, work->lists[i]);
+            started = true;
+        }
+    }
+    return num_cand;
+}
+
+/*************** run_phrase ***************
+ * Finds the documents in which a phrase's words occur one right after
+ * another, with the number of times they do as the count, and gives
+ * the postings a BM25 weight and best scores as for a word.
+ * Inputs:
+ * work - the workspace; its candidate buffer is used.
+ * phrase - the phrase's words, joined by single spaces.
+ * result - where the phrase's postings go; their buffers are reused.
+ * pindex - the postings and positions to evaluate against.
+ * Returns:
+ * false on error. The postings are empty if the pindex has no
+ * positions, or no document holds the phrase.
+ */
+static bool run_phrase(qwork_t* work, const char* phrase, qmade_t* result, pindex_t* pindex) {
+    postings_t* postings = &result->postings;
+    postings->num = 0;
+    size_t len = strlen(phrase) + 1;
+    if (!grow((void**) &work->text, &work->text_size, len, 1)
+        || !grow((void**) &work->pterms, &work->pterms_size, len / 2 + 1, sizeof(pterm_t))) {
+        return false;
+    }
+    memcpy(work->text, phrase, len);
+
+    // each word's postings and positions, which must list the same documents
+    int num_pterms = 0;
+    for (char* word = work->text; word != NULL; ) {
+        char* space = strchr(word, ' ');
+        if (space != NULL) {
+            *space = '\0';
+        }
+        pterm_t* term = &work->pterms[num_pterms++];
+        term->list = pindex_find(pindex, word);
+        term->pos = positions_find(pindex_positions(pindex), word);
+        term->at = 0;
+        if (term->list == NULL || term->pos == NULL || term->pos->num_docs != term->list->num) {
+            return true;
+        }
+        word = (space == NULL) ? NULL : space + 1;
+    }
+
+    // the documents holding every word, rarest word first
+    int num_cand = 0;
+    bool started = false;
+    for (int done = 0; done < num_pterms; done++) {
+        int rarest = -1;
+        for (int j = 0; j < num_pterms; j++) {
+            int df = work->pterms[j].list->num;
+            if (work->pterms[j].at == 0 && (rarest < 0 || df < work->pterms[rarest].list->num)) {
+                rarest = j;
+            }
+        }
+        work->pterms[rarest].at = -1;       // intersected
+        num_cand = intersect(work, num_cand, started, work->pterms[rarest].list);
+        started = true;
+    }
+    if (num_cand < 0) {
+        return false;
+    }
+    for (int j = 0; j < num_pterms; j++) {
+        work->pterms[j].at = 0;
+    }
+
+    // the candidates whose positions line up
+    for (int i = 0; i < num_cand; i++) {
+        int count = phrase_count(work, num_pterms, work->cand[i].docID);
+        if (count < 0) {
+            return false;
+        }
+        if (count > 0) {
+            if (!grow((void**) &postings->list, &result->list_size, postings->num + 1,
+                      sizeof(doc_score_t))) {
+                return false;
+            }
+            postings->list[postings->num].docID = work->cand[i].docID;
+            postings->list[postings->num].score = count;
+            postings->num++;
+        }
+    }
+    return finish_made(work, result, pindex);
+}
+
+/*************** phrase_count ***************
+ * Counts the places in a document where the phrase's words occur one
+ * right after another. The positions of the word with the fewest bytes
+ * of them there give the possible starts, and each other word keeps the
+ * starts it holds the right position for.
+ * Inputs:
+ * work - the workspace, with the phrase's words in pterms; each word's
+ *   `at` moves forward to the document, so documents must come in
+ *   increasing docID order.
+ * num_pterms - number of words.
+ * docID - the document, which holds every word.
+ * Returns:
+ * the count, or -1 on error.
+ */
+static int phrase_count(qwork_t* work, int num_pterms, int docID) {
+    int fewest = 0;
+    size_t least = 0;
+    size_t most = 0;
+    for (int j = 0; j < num_pterms; j++) {
+        pterm_t* term = &work->pterms[j];
+        term->at = gallop(term->list->list, term->list->num, term->at, docID);
+        if (term->at >= term->pos->num_docs || term->pos->docs[term->at] != docID) {
+            return 0;     // positions out of step with the index
+        }
+        const size_t* ends = term->pos->ends;
+        size_t bytes = ends[term->at] - ((term->at == 0) ? 0 : ends[term->at - 1]);
+        if (j == 0 || bytes < least) {
+            fewest = j;
+            least = bytes;
+        }
+        if (bytes > most) {
+            most = bytes;
+        }
+    }
+    if (!grow((void**) &work->starts, &work->starts_size, most, sizeof(int))
+        || !grow((void**) &work->spots, &work->spots_size, most, sizeof(int))) {
+        return -1;
+    }
+
+    int num_starts = 0;
+    int n = positions_decode(work->pterms[fewest].pos, work->pterms[fewest].at, work->spots);
+    for (int k = 0; k < n; k++) {
+        if (work->spots[k] >= fewest) {
+            work->starts[num_starts++] = work->spots[k] - fewest;
+        }
+    }
+    for (int j = 0; j < num_pterms && num_starts > 0; j++) {
+        if (j == fewest) {
+            continue;
+        }
+        n = positions_decode(work->pterms[j].pos, work->pterms[j].at, work->spots);
+        int kept = 0;
+        int k = 0;
+        for (int s = 0; s < num_starts; s++) {
+            int want = work->starts[s] + j;
+            while (k < n && work->spots[k] < want) {
+                k++;
+            }
+            if (k < n && work->spots[k] == want) {
+                work->starts[kept++] = work->starts[s];
+            }
+        }
+        num_starts = kept;
+    }
+    return num_starts;
+}
+
+/*************** run_wildcard ***************
+ * Finds the documents holding any word that matches a wildcard pattern,
+ * with the sum of the words' counts as the count, and gives the
+ * postings a BM25 weight and best scores as for a word. Of the words
+ * matched, only the QPLAN_MAX_EXPAND with the most documents are used,
+ * ties going to the first alphabetically.
+ * Inputs:
+ * work - the workspace.
+ * pattern - letters and '*'s, starting with letters.
+ * result - where the postings go; their buffers are reused.
+ * pindex - the postings to evaluate against.
+ * Returns:
+ * false on error. The postings are empty if no word matches.
+ */
+static bool run_wildcard(qwork_t* work, const char* pattern, qmade_t* result, pindex_t* pindex) {
+    postings_t* postings = &result->postings;
+    postings->num = 0;
+    size_t prefix = strcspn(pattern, "*");
+    if (!grow((void**) &work->text, &work->text_size, prefix + 1, 1)) {
+        return false;
+    }
+    memcpy(work->text, pattern, prefix);
+    work->text[prefix] = '\0';
+    struct expand_args args = {work, pattern, 0, 0, false};
+    if (!pindex_prefix(pindex, work->text, &args, expand_word) || args.failed) {
+        return false;
+    }
+    return merge_expansion(work, args.num, result, pindex);
+}
+
+/*************** run_fuzzy ***************
+ * Finds the documents holding any of the words nearest a word the
+ * pindex does not hold, as run_wildcard does for the words a pattern
+ * matches. The nearest are those with the fewest edits from it, if
+ * within the edits pindex_fuzzy prepared for.
+ * Inputs:
+ * work - the workspace.
+ * word - the word.
+ * result - where the postings go; their buffers are reused.
+ * pindex - the postings to evaluate against.
+ * Returns:
+ * false on error. The postings are empty if the pindex was not
+ * prepared, or no word is near enough.
+ */
+static bool run_fuzzy(qwork_t* work, const char* word, qmade_t* result, pindex_t* pindex) {
+    result->postings.num = 0;
+    struct expand_args args = {work, NULL, INT_MAX, 0, false};
+    if (!pindex_near(pindex, word, &args, near_word) || args.failed) {
+        return false;
+    }
+    return merge_expansion(work, args.num, result, pindex);
+}
+
+/*************** merge_expansion ***************
+ * Merges the postings of the words collected in work->expand into
+ * result, summing each document's counts. Only the QPLAN_MAX_EXPAND
+ * words with the most documents are used, ties going to the first found.
+ * Inputs:
+ * work - the workspace.
+ * num - number of words collected.
+ * result - where the postings go; their buffers are reused.
+ * pindex - the postings, for the BM25 weight.
+ * Returns:
+ * false on error.
+ */
+static bool merge_expansion(qwork_t* work, int num, qmade_t* result, pindex_t* pindex) {
+    postings_t* postings = &result->postings;
+    postings->num = 0;
+    if (num > QPLAN_MAX_EXPAND) {
+        qsort(work->expand, num, sizeof(expansion_t), compare_df);
+        num = QPLAN_MAX_EXPAND;
+    }
+    if (num == 0) {
+        return true;
+    }
+
+    // merge the words' postings by docID, smallest current docID at the root
+    size_t total = 0;
+    for (int j = 0; j < num; j++) {
+        total += work->expand[j].postings->num;
+    }
+    if (!grow((void**) &work->pterms, &work->pterms_size, num, sizeof(pterm_t))
+        || !grow((void**) &postings->list, &result->list_size, total, sizeof(doc_score_t))) {
+        return false;
+    }
+    pterm_t* heap = work->pterms;
+    for (int j = 0; j < num; j++) {
+        heap[j].list = work->expand[j].postings;
+        heap[j].pos = NULL;
+        heap[j].at = 0;
+    }
+    for (int j = num / 2 - 1; j >= 0; j--) {
+        sift_down(heap, num, j);
+    }
+    while (num > 0) {
+        const doc_score_t* next = &heap[0].list->list[heap[0].at];
+        if (postings->num == 0 || postings->list[postings->num - 1].docID != next->docID) {
+            postings->list[postings->num].docID = next->docID;
+            postings->list[postings->num].score = 0;
+            postings->num++;
+        }
+        postings->list[postings->num - 1].score += next->score;
+        if (++heap[0].at == heap[0].list->num) {
+            heap[0] = heap[--num];
+        }
+        sift_down(heap, num, 0);
+    }
+    return finish_made(work, result, pindex);
+}
+
+/*************** expand_word ***************
+ * Adds a word to the wildcard's expansion if it matches the whole
+ * pattern, for pindex_prefix.
+ * Returns:
+ * false to stop, if the expansion could not be grown.
+ */
+static bool expand_word(void* arg, const char* word, const postings_t* postings) {
+    struct expand_args* args = arg;
+    return !glob_match(args->pattern, word) || add_expansion(args, postings);
+}
+
+/*************** near_word ***************
+ * Adds a word to a misspelled word's expansion if no word found so far
+ * takes fewer edits, dropping those that take more, for pindex_near.
+ * Returns:
+ * false to stop, if the expansion could not be grown.
+ */
+static bool near_word(void* arg, const char* word, int edits, const postings_t* postings) {
+    struct expand_args* args = arg;
+    if (edits > args->edits) {
+        return true;
+    }
+    if (edits < args->edits) {
+        args->edits = edits;
+        args->num = 0;
+    }
+    return add_expansion(args, postings);
+}
+
+/*************** add_expansion ***************
+ * Adds a word's postings to the expansion being collected.
+ * Returns:
+ * false, with args->failed set, if the expansion could not be grown.
+ */
+static bool add_expansion(struct expand_args* args, const postings_t* postings) {
+    if (!grow((void**) &args->work->expand, &args->work->expand_size, args->num + 1,
+              sizeof(expansion_t))) {
+        args->failed = true;
+        return false;
+    }
+    args->work->expand[args->num].postings = postings;
+    args->work->expand[args->num].order = args->num;
+    args->num++;
+    return true;
+}
+
+/*************** glob_match ***************
+ * Matches a word against a pattern in which each '*' stands for any
+ * letters, or none. On a mismatch the last '*' takes one more letter,
+ * so the work is at most the product of the two lengths.
+ * Returns:
+ * true if the whole word matches.
+ */
+static bool glob_match(const char* pattern, const char* word) {
+    const char* star = NULL;     // the last '*' seen
+    const char* resume = NULL;   // where the word picks up after it
+    while (*word != '\0') {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = word;
+        } else if (*pattern == *word) {
+            pattern++;
+            word++;
+        } else if (star != NULL) {
+            pattern = star + 1;
+            word = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+/*************** sift_down ***************
+ * Moves the entry at position i of a wildcard's merge heap down to
+ * its place; the heap is ordered by the docID each word is at.
+ * Inputs:
+ * heap, num - the heap and its size.
+ * i - the position whose entry may be out of place.
+ */
+static void sift_down(pterm_t* heap, int num, int i) {
+    if (i >= num) {
+        return;
+    }
+    pterm_t entry = heap[i];
+    int doc = entry.list->list[entry.at].docID;
+    while (2 * i + 1 < num) {
+        int child = 2 * i + 1;
+        if (child + 1 < num && heap[child + 1].list->list[heap[child + 1].at].docID
+                               < heap[child].list->list[heap[child].at].docID) {
+            child++;
+        }
+        if (heap[child].list->list[heap[child].at].docID >= doc) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = entry;
+}
+
+/*************** finish_made ***************
+ * Gives postings made for a phrase or wildcard their BM25 weight and
+ * their best scores, overall and by block.
+ * Returns:
+ * false on error.
+ */
+static bool finish_made(qwork_t* work, qmade_t* result, pindex_t* pindex) {
+    postings_t* postings = &result->postings;
+    if (postings->num == 0) {
+        return true;
+    }
+    size_t num_blocks = (postings->num + PINDEX_BLOCK - 1) / PINDEX_BLOCK;
+    if (!grow((void**) &postings->block_max, &result->blocks_size, num_blocks, sizeof(int))) {
+        return false;
+    }
+    postings->weight = pindex_weight(pindex, postings->num);
+    pindex_bound(postings, work->norms);
+    return true;
+}
+
+/*************** intersect ***************
+ * Keeps the candidates that are also in the list, each with the lower
+ * of the two counts (or, for BM25, with the list's score added); the
+ * first list of a group is copied in instead.
+ * Inputs:
+ * work - the workspace.
+ * num_cand - number of candidates, or -1 after an error.
+ * started - false for the group's first list.
+ * list - the postings to intersect with.
+ * Returns:
+ * the number of candidates left, or -1 on error.
+ */
+static int intersect(qwork_t* work, int num_cand, bool started, const postings_t* list) {
+    if (!started) {
+        if (!grow((void**) &work->cand, &work->cand_size, list->num, sizeof(doc_score_t))) {
+            return -1;
+        }
+        memcpy(work->cand, list->list, list->num * sizeof(doc_score_t));
+        for (int i = 0; work->norms != NULL && i < list->num; i++) {
+            work->cand[i].score = pindex_score(list, work->norms, i);
+        }
+        return list->num;
+    }
+    if (num_cand <= 0) {
+        return num_cand;
+    }
+    int kept = 0;
+    int pos = 0;
+    for (int i = 0; i < num_cand && pos < list->num; i++) {
+        pos = gallop(list->list, list->num, pos, work->cand[i].docID);
+        if (pos < list->num && list->list[pos].docID == work->cand[i].docID) {
+            int count = list->list[pos].score;
+            work->cand[kept].docID = work->cand[i].docID;
+            if (work->norms != NULL) {
+                work->cand[kept].score = work->cand[i].score + pindex_score(list, work->norms, pos);
+            } else {
+                work->cand[kept].score = (count < work->cand[i].score) ? count : work->cand[i].score;
+            }
+            kept++;
+        }
+    }
+    return kept;
+}
+
+/*************** gallop ***************
+ * Finds the first document at or after lo whose docID is at least docID,
+ * probing 1, 2, 4, ... ahead and then searching the last step binarily.
+ * Inputs:
+ * list, num - documents by increasing docID, and how many.
+ * Returns:
+ * its position, or num if there is none.
+ */
+static int gallop(const doc_score_t* list, int num, int lo, int docID) {
+    const doc_score_t* p = list;
+    if (lo >= num || p[lo].docID >= docID) {
+        return lo;
+    }
+    // p[lo] < docID; find hi with p[hi] >= docID, or the end
+    int step = 1;
+    int hi = lo + 1;
+    while (hi < num && p[hi].docID < docID) {
+        lo = hi;
+        step *= 2;
+        hi = lo + step;
+        if (hi + 2 * step < num) {
+            PREFETCH(&p[hi + 2 * step], 0);
+        }
+    }
+    if (hi > num) {
+        hi = num;
+    }
+    while (lo + 1 < hi) {
+        int mid = lo + (hi - lo) / 2;
+        PREFETCH(&p[lo + (mid - lo) / 2], 0);
+        PREFETCH(&p[mid + (hi - mid) / 2], 0);
+        if (p[mid].docID < docID) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+/*************** execute_top ***************
+ * Finds the top documents of the plan by block-max WAND, ranked.
+ * Inputs:
+ * work - the workspace, with a plan compiled.
+ * pairs - cache of AND prefixes, or NULL.
+ * top - how many documents to keep, at least 1.
+ * num_docs - set to the number kept.
+ * Returns:
+ * the documents, in the workspace's results buffer; NULL if none.
+ */
+static const doc_score_t* execute_top(qwork_t* work, qcache_t* pairs, int top, int* num_docs) {
+    // one frequent word: its impact list is already ranked
+    const postings_t* only = (work->num_terms == 1) ? work->lists[0] : NULL;
+    if (work->num_groups == 1 && only != NULL && only->impact != NULL) {
+        int n = (only->num < top) ? only->num : top;
+        if (!grow((void**) &work->results, &work->results_size, n, sizeof(doc_score_t))) {
+            return NULL;
+        }
+        memcpy(work->results, only->impact, n * sizeof(doc_score_t));
+        *num_docs = n;
+        return work->results;
+    }
+
+    int num_active = 0;
+    if (!open_cursors(work, pairs, &num_active)
+        || !grow((void**) &work->results, &work->results_size, top, sizeof(doc_score_t))) {
+        return NULL;
+    }
+    cursor_t** active = work->active;
+    num_active = sort_cursors(active, num_active);
+
+    int num_best = 0;
+    int threshold = seed_threshold(work, num_active, top);   // a document must score more to enter
+    while (num_active > 0) {
+        // the pivot: no document before its one can beat the threshold
+        long bound = 0;
+        int pivot = 0;
+        while (pivot < num_active && (bound += active[pivot]->max) <= threshold) {
+            pivot++;
+        }
+        if (pivot == num_active) {
+            break;
+        }
+        int doc = active[pivot]->list[active[pivot]->pos].docID;
+        while (pivot + 1 < num_active && active[pivot + 1]->list[active[pivot + 1]->pos].docID == doc) {
+            pivot++;
+        }
+
+        // the best the pivot's document, or any before the next block end, can do
+        long block_bound = 0;
+        int next = (pivot + 1 < num_active) ? active[pivot + 1]->list[active[pivot + 1]->pos].docID
+                                            : INT_MAX;
+        for (int i = 0; i <= pivot; i++) {
+            int block = cursor_block(active[i], doc);
+            if (block >= 0) {
+                cursor_t* cursor = active[i];
+                int last = (block + 1) * PINDEX_BLOCK - 1;
+                last = cursor->list[(last < cursor->num) ? last : cursor->num - 1].docID;
+                block_bound += cursor->block_max[block];
+                if (last < next) {
+                    next = last + 1;
+                }
+            }
+        }
+
+        if (block_bound <= threshold) {
+            for (int i = 0; i <= pivot; i++) {
+                cursor_t* cursor = active[i];
+                cursor->pos = gallop(cursor->list, cursor->num, cursor->pos, next);
+            }
+        } else if (active[0]->list[active[0]->pos].docID == doc) {
+            int score = 0;
+            for (int i = 0; i <= pivot; i++) {
+                cursor_t* cursor = active[i];
+                score += (cursor->term != NULL) ? pindex_score(cursor->term, work->norms, cursor->pos)
+                                                : cursor->list[cursor->pos].score;
+                cursor->pos++;
+            }
+            offer(work->results, &num_best, top, doc, score);
+            if (num_best == top) {
+                threshold = work->results[0].score;
+            }
+        } else {
+            for (int i = 0; active[i]->list[active[i]->pos].docID < doc; i++) {
+                cursor_t* cursor = active[i];
+                cursor->pos = gallop(cursor->list, cursor->num, cursor->pos, doc);
+            }
+        }
+        num_active = sort_cursors(active, num_active);
+    }
+
+    if (num_best == 0) {
+        return NULL;
+    }
+    qsort(work->results, num_best, sizeof(doc_score_t), compare_ranks);
+    *num_docs = num_best;
+    return work->results;
+}
+
+/*************** open_cursors ***************
+ * Starts a cursor on each group of the plan that has documents, in
+ * the workspace's cursors, and lists them all in its active array.
+ * A group of two or more terms is intersected (see run_group) and its
+ * documents kept in the workspace, with their block maxima.
+ * Inputs:
+ * work - the workspace, with a plan compiled.
+ * pairs - cache of AND prefixes, or NULL.
+ * num_cursors - set to the number of cursors.
+ * Returns:
+ * false on error.
+ */
+static bool open_cursors(qwork_t* work, qcache_t* pairs, int* num_cursors) {
+    size_t size = work->cursors_size;
+    if (!grow((void**) &work->cursors, &size, work->num_groups, sizeof(cursor_t))
+        || !grow((void**) &work->active, &work->cursors_size, work->num_groups, sizeof(cursor_t*))) {
+        return false;
+    }
+    size_t mat_used = 0;
+    size_t blocks_used = 0;
+    int num = 0;
+    int first = 0;
+    for (int g = 0; g < work->num_groups; first = work->group_end[g++]) {
+        int end = work->group_end[g];
+        cursor_t* cursor = &work->cursors[num];
+        memset(cursor, 0, sizeof(cursor_t));
+        if (end - first == 1) {
+            const postings_t* list = work->lists[first];
+            if (list == NULL) {
+                continue;
+            }
+            cursor->list = list->list;
+            cursor->num = list->num;
+            cursor->term = list;
+            cursor->block_max = list->block_max;
+            cursor->max = list->max_score;
+        } else {
+            int num_cand = run_group(work, first, end, pairs);
+            if (num_cand < 0) {
+                return false;
+            }
+            if (num_cand == 0) {
+                continue;
+            }
+            size_t num_blocks = (num_cand + PINDEX_BLOCK - 1) / PINDEX_BLOCK;
+            if (!grow((void**) &work->mat, &work->mat_size, mat_used + num_cand, sizeof(doc_score_t))
+                || !grow((void**) &work->mat_blocks, &work->mat_blocks_size,
+                         blocks_used + num_blocks, sizeof(int))) {
+                return false;
+            }
+            memcpy(work->mat + mat_used, work->cand, num_cand * sizeof(doc_score_t));
+            cursor->num = num_cand;
+            cursor->max = block_maxima(work->cand, num_cand, work->mat_blocks + blocks_used);
+            cursor->offset = mat_used;
+            cursor->block_offset = blocks_used;
+            mat_used += num_cand;
+            blocks_used += num_blocks;
+        }
+        work->active[num] = cursor;
+        num++;
+    }
+
+    // the intersected groups' buffers are done growing
+    for (int i = 0; i < num; i++) {
+        cursor_t* cursor = &work->cursors[i];
+        if (cursor->list == NULL) {
+            cursor->list = work->mat + cursor->offset;
+            cursor->block_max = work->mat_blocks + cursor->block_offset;
+        }
+    }
+    *num_cursors = num;
+    return true;
+}
+
+/*************** seed_threshold ***************
+ * Scores in full the documents heading the impact lists of one-term
+ * groups, the top of each list, to find a score the top documents
+ * must reach.
+ * Inputs:
+ * work - the workspace, with cursors open and at their starts.
+ * num_cursors - number of cursors.
+ * top - how many documents are wanted.
+ * Returns:
+ * one less than the top-th best score of those documents, or 0 if
+ * there are fewer than top of them (or memory ran out).
+ */
+static int seed_threshold(qwork_t* work, int num_cursors, int top) {
+    int num_seeds = 0;
+    for (int c = 0; c < num_cursors; c++) {
+        const postings_t* term = work->cursors[c].term;
+        if (term == NULL || term->impact == NULL) {
+            continue;
+        }
+        int n = (term->num < top) ? term->num : top;
+        if (!grow((void**) &work->seeds, &work->seeds_size, num_seeds + n, sizeof(doc_score_t))) {
+            return 0;
+        }
+        memcpy(work->seeds + num_seeds, term->impact, n * sizeof(doc_score_t));
+        num_seeds += n;
+    }
+    if (num_seeds < top) {
+        return 0;
+    }
+
+    // each document once, with its score over every group
+    qsort(work->seeds, num_seeds, sizeof(doc_score_t), compare_docs);
+    int kept = 0;
+    for (int i = 0; i < num_seeds; i++) {
+        int doc = work->seeds[i].docID;
+        if (kept > 0 && work->seeds[kept - 1].docID == doc) {
+            continue;
+        }
+        int score = 0;
+        for (int c = 0; c < num_cursors; c++) {
+            cursor_t* cursor = &work->cursors[c];
+            int pos = gallop(cursor->list, cursor->num, 0, doc);
+            if (pos < cursor->num && cursor->list[pos].docID == doc) {
+                score += (cursor->term != NULL) ? pindex_score(cursor->term, work->norms, pos)
+                                                : cursor->list[pos].score;
+            }
+        }
+        work->seeds[kept].docID = doc;
+        work->seeds[kept].score = score;
+        kept++;
+    }
+    if (kept < top) {
+        return 0;
+    }
+    qsort(work->seeds, kept, sizeof(doc_score_t), compare_ranks);
+    return work->seeds[top - 1].score - 1;
+}
+
+/*************** drop_stopwords ***************
+ * Drops the stopwords (see pindex_is_stopword) from every group of the
+ * plan that has other words, moving the terms left behind together.
+ * A group of stopwords alone is kept whole.
+ */
+static void drop_stopwords(qwork_t* work, pindex_t* pindex) {
+    int kept = 0;
+    int first = 0;
+    for (int g = 0; g < work->num_groups; g++) {
+        int end = work->group_end[g];
+        bool others = false;
+        for (int i = first; i < end; i++) {
+            others = others || !pindex_is_stopword(pindex, work->lists[i]);
+        }
+        for (int i = first; i < end; i++) {
+            if (!others || !pindex_is_stopword(pindex, work->lists[i])) {
+                work->words[kept] = work->words[i];
+                work->lists[kept] = work->lists[i];
+                kept++;
+            }
+        }
+        work->group_end[g] = kept;
+        first = end;
+    }
+    work->num_terms = kept;
+}
+
+/*************** sort_cursors ***************
+ * Drops the cursors that are past their last document and sorts the
+ * rest by their current docID, by insertion, since few move at a time.
+ * Returns:
+ * the number of cursors left.
+ */
+static int sort_cursors(cursor_t** active, int num_active) {
+    int kept = 0;
+    for (int i = 0; i < num_active; i++) {
+        if (active[i]->pos < active[i]->num) {
+            active[kept++] = active[i];
+        }
+    }
+    for (int i = 1; i < kept; i++) {
+        cursor_t* cursor = active[i];
+        int doc = cursor->list[cursor->pos].docID;
+        int j = i;
+        while (j > 0 && active[j - 1]->list[active[j - 1]->pos].docID > doc) {
+            active[j] = active[j - 1];
+            j--;
+        }
+        active[j] = cursor;
+    }
+    return kept;
+}
+
+/*************** cursor_block ***************
+ * Finds the block of the cursor's first document at or after docID,
+ * moving the cursor's block forward to it. Pivot documents only
+ * increase, so a cursor never needs an earlier block.
+ * Returns:
+ * the block, or -1 if the cursor has no such document.
+ */
+static int cursor_block(cursor_t* cursor, int docID) {
+    int num_blocks = (cursor->num + PINDEX_BLOCK - 1) / PINDEX_BLOCK;
+    while (cursor->block < num_blocks) {
+        int last = (cursor->block + 1) * PINDEX_BLOCK - 1;
+        if (cursor->list[(last < cursor->num) ? last : cursor->num - 1].docID >= docID) {
+            return cursor->block;
+        }
+        cursor->block++;
+    }
+    return -1;
+}
+
+/*************** block_maxima ***************
+ * Finds the best score in each PINDEX_BLOCK documents of a list.
+ * Returns:
+ * the best score in the list.
+ */
+static int block_maxima(const doc_score_t* list, int num, int* block_max) {
+    int best = 0;
+    for (int i = 0; i < num; i++) {
+        if (i % PINDEX_BLOCK == 0) {
+            block_max[i / PINDEX_BLOCK] = 0;
+        }
+        if (list[i].score > block_max[i / PINDEX_BLOCK]) {
+            block_max[i / PINDEX_BLOCK] = list[i].score;
+        }
+        if (list[i].score > best) {
+            best = list[i].score;
+        }
+    }
+    return best;
+}
+
+/*************** offer ***************
+ * Offers a document to a heap of the best top documents so far, worst
+ * at the root. Documents are offered by increasing docID, so one that
+ * only ties the worst is not better than it.
+ * Inputs:
+ * heap, num_best - the heap and its size, which is updated.
+ * top - the most documents it keeps.
+ * docID, score - the document.
+ */
+static void offer(doc_score_t* heap, int* num_best, int top, int docID, int score) {
+    int i;
+    if (*num_best < top) {
+        // sift up from the new leaf
+        i = (*num_best)++;
+        while (i > 0 && compare_ranks(&heap[(i - 1) / 2], &(doc_score_t) {docID, score}) < 0) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+    } else if (score > heap[0].score) {
+        // sift down from the root
+        i = 0;
+        while (2 * i + 1 < top) {
+            int child = 2 * i + 1;
+            if (child + 1 < top && compare_ranks(&heap[child + 1], &heap[child]) > 0) {
+                child++;
+            }
+            if (compare_ranks(&heap[child], &(doc_score_t) {docID, score}) <= 0) {
+                break;
+            }
+            heap[i] = heap[child];
+            i = child;
+        }
+    } else {
+        return;
+    }
+    heap[i].docID = docID;
+    heap[i].score = score;
+}
+
+/*************** prefix_key ***************
+ * Builds the pairs cache key for the first k terms of a group: the
+ * terms sorted and joined by single spaces, since the intersection
+ * does not depend on their order, with phrases in double quotes.
+ * Returns:
+ * the key, in the workspace's key buffer, or NULL on error.
+ */
+static const char* prefix_key(qwork_t* work, int first, int k) {
+    size_t len = 1;
+    for (int i = 0; i < k; i++) {
+        work->sorted[i] = work->words[first + i];
+        len += strlen(work->sorted[i]) + 3;
+    }
+    if (!grow((void**) &work->key, &work->key_size, len, 1)) {
+        return NULL;
+    }
+    qsort(work->sorted, k, sizeof(char*), compare_terms);
+    char* p = work->key;
+    for (int i = 0; i < k; i++) {
+        if (i > 0) {
+            *p++ = ' ';
+        }
+        bool phrase = (strchr(work->sorted[i], ' ') != NULL);
+        size_t n = strlen(work->sorted[i]);
+        if (phrase) {
+            *p++ = '"';
+        }
+        memcpy(p, work->sorted[i], n);
+        p += n;
+        if (phrase) {
+            *p++ = '"';
+        }
+    }
+    *p = '\0';
+    return work->key;
+}
+
+/*************** compare_terms ***************
+ * Orders two words alphabetically, for qsort.
+ */
+static int compare_terms(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/*************** compare_ranks ***************
+ * Orders documents by decreasing score, then increasing docID, for qsort.
+ */
+static int compare_ranks(const void* a, const void* b) {
+    const doc_score_t* x = a;
+    const doc_score_t* y = b;
+    if (x->score != y->score) {
+        return (x->score < y->score) ? 1 : -1;
+    }
+    return (x->docID > y->docID) - (x->docID < y->docID);
+}
+
+/*************** compare_docs ***************
+ * Orders documents by increasing docID, for qsort.
+ */
+static int compare_docs(const void* a, const void* b) {
+    int x = ((const doc_score_t*) a)->docID;
+    int y = ((const doc_score_t*) b)->docID;
+    return (x > y) - (x < y);
+}
+
+/*************** compare_df ***************
+ * Orders a wildcard's words by decreasing number of documents, then
+ * alphabetically, for qsort.
+ */
+static int compare_df(const void* a, const void* b) {
+    const expansion_t* x = a;
+    const expansion_t* y = b;
+    if (x->postings->num != y->postings->num) {
+        return (x->postings->num < y->postings->num) ? 1 : -1;
+    }
+    return (x->order > y->order) - (x->order < y->order);
+}
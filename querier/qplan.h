@@ -0,0 +1,91 @@
+// qplan.h - header file for the querier's query evaluation plans
+//
+// A validated query is compiled into a plan: an OR of AND groups, each
+// group a list of postings (see pindex.h) with its terms ordered by
+// document frequency, rarest first. Executing the plan intersects each
+// group's postings, adds the groups' scores together, and ranks the
+// documents by score (ties by docID). A group scores a document by the
+// least count of its words there or, if the pindex ranks by BM25, by
+// the sum of its words' BM25 scores, computed in the same single pass.
+// Asked for only the top k documents, execution skips the documents
+// that cannot make the top k, using each postings list's best scores
+// (see pindex.h), instead of scoring every match.
+//
+// A plan lives in a qwork_t, a workspace holding every buffer the
+// evaluation needs: term lists, candidate documents, a dense score array
+// indexed by docID, and the ranked results. Buffers only ever grow, so
+// once a workspace has seen queries of a given size, evaluating another
+// allocates nothing. A workspace is not shared; each thread that
+// evaluates queries needs its own.
+
+#ifndef QPLAN_H
+#define QPLAN_H
+
+#include <stdbool.h>
+#include "querier.h"
+#include "pindex.h"
+#include "qcache.h"
+
+// the most words one wildcard, or misspelled, word of a query expands to
+#define QPLAN_MAX_EXPAND 64
+
+typedef struct qwork qwork_t;  // opaque to users of the module
+
+/*************** qwork_new ***************
+ * Creates an empty workspace.
+ * Output:
+ * The new workspace, or NULL on error. Caller is responsible for
+ * qwork_delete.
+ */
+qwork_t* qwork_new(void);
+
+/*************** qplan_compile ***************
+ * Compiles a query into the workspace's plan, replacing any earlier one.
+ * Inputs:
+ * work - the workspace.
+ * words - the query's validated words and operators, as operator_validate
+ *   accepts them; kept (not copied) until the plan is executed.
+ * word_count - number of words.
+ * pindex - the postings to evaluate against; must outlive the execution.
+ * Output:
+ * false if a buffer could not be grown.
+ */
+bool qplan_compile(qwork_t* work, char** words, int word_count, pindex_t* pindex);
+
+/*************** qplan_df ***************
+ * Returns the number of documents in the postings the compiled plan
+ * made for a phrase or wildcard word: words[i] as given to
+ * qplan_compile (the same pointer). 0 if it matched none, or if the
+ * word is not in the plan.
+ */
+int qplan_df(qwork_t* work, const char* word);
+
+/*************** qplan_weigh ***************
+ * Gives the postings the compiled plan made for a phrase or wildcard
+ * word the BM25 weight of a term held by df documents, rather than by
+ * as many as it holds, and bounds their scores again; a sharded index
+ * passes the shards' counts summed (see qshard.h).
+ */
+void qplan_weigh(qwork_t* work, pindex_t* pindex, const char* word, int df);
+
+/*************** qplan_execute ***************
+ * Executes the compiled plan.
+ * Inputs:
+ * work - the workspace, with a plan compiled.
+ * pairs - cache of popular AND prefixes, or NULL for none. Each group
+ *   starts from its longest cached prefix (two or more terms, in query
+ *   order); a prefix looked up PAIR_ADMIT times is cached when computed.
+ * top - how many of the best documents to find; 0 for all that match.
+ * num_docs - set to the number of documents matched (at most top).
+ * Output:
+ * The ranked documents, which belong to the workspace and are good until
+ * its next qplan_compile; NULL if none matched or on error.
+ */
+const doc_score_t* qplan_execute(qwork_t* work, qcache_t* pairs, int top, int* num_docs);
+
+/*************** qwork_delete ***************
+ * Frees the workspace and its buffers.
+ */
+void qwork_delete(qwork_t* work);
+
+#endif // QPLAN_H
@@ -0,0 +1,438 @@
+/*
+ * qshard.c - sharded indexes for the 'querier' module
+ *
+ * A query is compiled and executed on each shard with the shard's own
+ * qwork_t and AND cache, made the first time the shard is searched.
+ * Between the two steps, a BM25 query's phrases and wildcards are
+ * weighted by their documents in every shard (see qplan_weigh). Each
+ * shard's documents come back ranked, so gathering them is a merge of
+ * sorted lists, which stops once it has the top k.
+ *
+ * A parallel workspace keeps a helper thread for each of shards 1 on,
+ * started the first time it is needed and kept until the workspace is
+ * deleted. For each step the calling thread bumps a round number and
+ * wakes the helpers, does shard 0 (and any shard without a helper)
+ * itself, and waits until the last helper is done; a helper whose
+ * shard the index does not have just reports back.
+ * See qshard.h for declarations.
+ *
+ * Manzi Fabrice Niyigaba, CS50, November 2024
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <pthread.h>
+# include "qshard.h"
+# include "qplan.h"
+# include "qcache.h"
+# include "../common/indexshards.h"
+
+/*************** qshard ***************
+ * The shards' postings, in docID order.
+ */
+struct qshard {
+    pindex_t** shards;
+    int num;
+};
+
+/*************** gshard ***************
+ * One shard's part of a query: what to search, and what it found.
+ */
+struct gshard {
+    pthread_t thread;        // the shard's helper, if it has one
+    qgather_t* gather;       // the workspace the shard belongs to
+    long round;              // the last round the helper took part in
+    qwork_t* work;           // plan and evaluation buffers
+    qcache_t* pairs;         // this shard's AND prefixes, or NULL
+    pindex_t* pindex;
+    char** words;
+    int word_count;
+    int top;
+    const doc_score_t* scores;   // the shard's ranked documents
+    int num_docs;
+    bool ok;
+};
+
+/*************** qgather ***************
+ * A workspace for every shard, and the merged results.
+ * - `hits`, `misses`: counts of AND caches flushed away.
+ * - `lock` guards the helpers' round: `round`, `num`, `step`,
+ *   `busy` and `closing`.
+ */
+struct qgather {
+    struct gshard shards[INDEXSHARDS_MAX];
+    size_t pair_cache_bytes;
+    bool parallel;
+    doc_score_t* merged;
+    size_t merged_size;
+    long hits;
+    long misses;
+    int num_helpers;         // shards 1 .. num_helpers have a helper
+    pthread_mutex_t lock;
+    pthread_cond_t wake;     // a round has started, or the helpers are to quit
+    pthread_cond_t done;     // the last helper of the round is done
+    long round;              // rounds started so far
+    int num;                 // shards in this round
+    void (*step)(struct gshard* shard);
+    int busy;                // helpers not yet done with this round
+    bool closing;
+};
+
+// Local helpers
+static void run_step(qgather_t* gather, int num, void (*step)(struct gshard* shard));
+static void* helper(void* arg);
+static void compile_shard(struct gshard* shard);
+static void execute_shard(struct gshard* shard);
+static void weigh_made(qgather_t* gather, qshard_t* index, char** words, int word_count);
+static bool merge(qgather_t* gather, int num, int top, int* num_docs);
+
+/*************** qshard_new ***************/
+// see qshard.h for more information
+qshard_t* qshard_new(pindex_t** shards, int num) {
+    if (shards == NULL || num < 1 || num > INDEXSHARDS_MAX) {
+        return NULL;
+    }
+    qshard_t* index = malloc(sizeof(qshard_t));
+    if (index == NULL) {
+        return NULL;
+    }
+    index->shards = malloc(num * sizeof(pindex_t*));
+    if (index->shards == NULL) {
+        free(index);
+        return NULL;
+    }
+    memcpy(index->shards, shards, num * sizeof(pindex_t*));
+    index->num = num;
+    return index;
+}
+
+/*************** qshard_count ***************/
+// see qshard.h for more information
+int qshard_count(qshard_t* index) {
+    return (index == NULL) ? 0 : index->num;
+}
+
+/*************** qshard_pindex ***************/
+// see qshard.h for more information
+pindex_t* qshard_pindex(qshard_t* index, int i) {
+    if (index == NULL || i < 0 || i >= index->num) {
+        return NULL;
+    }
+    return index->shards[i];
+}
+
+/*************** qshard_normalizer ***************/
+// see qshard.h for more information
+wordnorm_t* qshard_normalizer(qshard_t* index) {
+    return pindex_normalizer(qshard_pindex(index, 0));
+}
+
+/*************** qshard_positions ***************/
+// see qshard.h for more information
+bool qshard_positions(qshard_t* index) {
+    for (int i = 0; i < qshard_count(index); i++) {
+        if (pindex_positions(index->shards[i]) == NULL) {
+            return false;
+        }
+    }
+    return index != NULL;
+}
+
+/*************** qshard_bm25 ***************/
+// see qshard.h for more information
+bool qshard_bm25(qshard_t* index) {
+    return pindex_norms(qshard_pindex(index, 0)) != NULL;
+}
+
+/*************** qshard_delete ***************/
+// see qshard.h for more information
+void qshard_delete(qshard_t* index) {
+    if (index == NULL) {
+        return;
+    }
+    for (int i = 0; i < index->num; i++) {
+        pindex_delete(index->shards[i]);
+    }
+    free(index->shards);
+    free(index);
+}
+
+/*************** qgather_new ***************/
+// see qshard.h for more information
+qgather_t* qgather_new(size_t pair_cache_bytes, bool parallel) {
+    qgather_t* gather = calloc(1, sizeof(qgather_t));
+    if (gather == NULL) {
+        return NULL;
+    }
+    gather->pair_cache_bytes = pair_cache_bytes;
+    gather->parallel = parallel;
+    for (int s = 0; s < INDEXSHARDS_MAX; s++) {
+        gather->shards[s].gather = gather;
+    }
+    pthread_mutex_init(&gather->lock, NULL);
+    pthread_cond_init(&gather->wake, NULL);
+    pthread_cond_init(&gather->done, NULL);
+    return gather;
+}
+
+/*************** qgather_run ***************/
+// see qshard.h for more information
+bool qgather_run(qgather_t* gather, qshard_t* index, char** words, int word_count,
+                 int top, const doc_score_t** scores, int* num_docs) {
+    *scores = NULL;
+    *num_docs = 0;
+    if (gather == NULL || index == NULL) {
+        return false;
+    }
+    int num = index->num;
+    for (int s = 0; s < num; s++) {
+        struct gshard* shard = &gather->shards[s];
+        if (shard->work == NULL && (shard->work = qwork_new()) == NULL) {
+            return false;
+        }
+        if (gather->pair_cache_bytes > 0 && shard->pairs == NULL
+            && (shard->pairs = qcache_new(gather->pair_cache_bytes / num)) == NULL) {
+            return false;
+        }
+        shard->pindex = index->shards[s];
+        shard->words = words;
+        shard->word_count = word_count;
+        shard->top = top;
+    }
+
+    run_step(gather, num, compile_shard);
+    bool ok = true;
+    for (int s = 0; s < num; s++) {
+        ok = ok && gather->shards[s].ok;
+    }
+    if (!ok) {
+        return false;
+    }
+    if (num > 1 && qshard_bm25(index)) {
+        weigh_made(gather, index, words, word_count);
+    }
+    run_step(gather, num, execute_shard);
+
+    if (num == 1) {
+        *scores = gather->shards[0].scores;
+        *num_docs = gather->shards[0].num_docs;
+        return true;
+    }
+    if (!merge(gather, num, top, num_docs)) {
+        return false;
+    }
+    *scores = (*num_docs > 0) ? gather->merged : NULL;
+    return true;
+}
+
+/*************** run_step ***************
+ * Takes one step on shards 0 .. num - 1: on the helpers, starting any
+ * not yet running, and on the calling thread for the rest.
+ */
+static void run_step(qgather_t* gather, int num, void (*step)(struct gshard* shard)) {
+    while (gather->parallel && gather->num_helpers + 1 < num) {
+        struct gshard* shard = &gather->shards[gather->num_helpers + 1];
+        shard->round = gather->round;
+        if (pthread_create(&shard->thread, NULL, helper, shard) != 0) {
+            break;          // the calling thread does the rest
+        }
+        gather->num_helpers++;
+    }
+    if (gather->num_helpers > 0) {
+        pthread_mutex_lock(&gather->lock);
+        gather->num = num;
+        gather->step = step;
+        gather->busy = gather->num_helpers;
+        gather->round++;
+        pthread_cond_broadcast(&gather->wake);
+        pthread_mutex_unlock(&gather->lock);
+    }
+    step(&gather->shards[0]);
+    for (int s = gather->num_helpers + 1; s < num; s++) {
+        step(&gather->shards[s]);
+    }
+    if (gather->num_helpers > 0) {
+        pthread_mutex_lock(&gather->lock);
+        while (gather->busy > 0) {
+            pthread_cond_wait(&gather->done, &gather->lock);
+        }
+        pthread_mutex_unlock(&gather->lock);
+    }
+}
+
+/*************** helper ***************
+ * Thread body: takes each round's step on its shard, until the
+ * workspace is deleted.
+ */
+static void* helper(void* arg) {
+    struct gshard* shard = arg;
+    qgather_t* gather = shard->gather;
+    int s = shard - gather->shards;
+    pthread_mutex_lock(&gather->lock);
+    while (1) {
+        while (!gather->closing && shard->round == gather->round) {
+            pthread_cond_wait(&gather->wake, &gather->lock);
+        }
+        if (gather->closing) {
+            break;
+        }
+        shard->round = gather->round;
+        if (s < gather->num) {
+            void (*step)(struct gshard* shard) = gather->step;
+            pthread_mutex_unlock(&gather->lock);
+            step(shard);
+            pthread_mutex_lock(&gather->lock);
+        }
+        if (--gather->busy == 0) {
+            pthread_cond_signal(&gather->done);
+        }
+    }
+    pthread_mutex_unlock(&gather->lock);
+    return NULL;
+}
+
+/*************** compile_shard ***************
+ * Compiles the query on one shard.
+ */
+static void compile_shard(struct gshard* shard) {
+    shard->scores = NULL;
+    shard->num_docs = 0;
+    shard->ok = qplan_compile(shard->work, shard->words, shard->word_count, shard->pindex);
+}
+
+/*************** execute_shard ***************
+ * Executes the compiled query on one shard.
+ */
+static void execute_shard(struct gshard* shard) {
+    shard->scores = qplan_execute(shard->work, shard->pairs, shard->top, &shard->num_docs);
+}
+
+/*************** weigh_made ***************
+ * Weights every phrase and wildcard word of a compiled BM25 query by
+ * the documents it matched in all the shards, as the words themselves
+ * are (see pindex_share). A misspelled word's replacements are found
+ * shard by shard, and keep their own weights.
+ */
+static void weigh_made(qgather_t* gather, qshard_t* index, char** words, int word_count) {
+    for (int i = 0; i < word_count; i++) {
+        if (strchr(words[i], ' ') == NULL && strchr(words[i], '*') == NULL) {
+            continue;
+        }
+        int df = 0;
+        for (int s = 0; s < index->num; s++) {
+            df += qplan_df(gather->shards[s].work, words[i]);
+        }
+        for (int s = 0; s < index->num; s++) {
+            qplan_weigh(gather->shards[s].work, index->shards[s], words[i], df);
+        }
+    }
+}
+
+/*************** merge ***************
+ * Merges the shards' ranked documents, by decreasing score and then
+ * increasing docID as each shard ranks them, into the workspace's
+ * merged array, keeping the best top (all, if top is 0).
+ * Returns:
+ * false if the array could not grow.
+ */
+static bool merge(qgather_t* gather, int num, int top, int* num_docs) {
+    struct gshard* shards = gather->shards;
+    size_t total = 0;
+    for (int s = 0; s < num; s++) {
+        total += shards[s].num_docs;
+    }
+    if (top > 0 && total > (size_t) top) {
+        total = top;
+    }
+    if (total > gather->merged_size) {
+        doc_score_t* bigger = realloc(gather->merged, total * sizeof(doc_score_t));
+        if (bigger == NULL) {
+            return false;
+        }
+        gather->merged = bigger;
+        gather->merged_size = total;
+    }
+
+    int next[INDEXSHARDS_MAX] = {0};
+    for (size_t n = 0; n < total; n++) {
+        const doc_score_t* best = NULL;
+        int from = 0;
+        for (int s = 0; s < num; s++) {
+            if (next[s] < shards[s].num_docs) {
+                const doc_score_t* head = &shards[s].scores[next[s]];
+                if (best == NULL || head->score > best->score
+                    || (head->score == best->score && head->docID < best->docID)) {
+                    best = head;
+                    from = s;
+                }
+            }
+        }
+        gather->merged[n] = *best;
+        next[from]++;
+    }
+    *num_docs = total;
+    return true;
+}
+
+/*************** qgather_flush ***************/
+// see qshard.h for more information
+void qgather_flush(qgather_t* gather) {
+    if (gather == NULL) {
+        return;
+    }
+    // the caches are made again, split among however many shards there are then
+    for (int s = 0; s < INDEXSHARDS_MAX; s++) {
+        if (gather->shards[s].pairs != NULL) {
+            long hits, misses;
+            size_t bytes;
+            qcache_stats(gather->shards[s].pairs, &hits, &misses, &bytes);
+            gather->hits += hits;
+            gather->misses += misses;
+            qcache_delete(gather->shards[s].pairs);
+            gather->shards[s].pairs = NULL;
+        }
+    }
+}
+
+/*************** qgather_stats ***************/
+// see qshard.h for more information
+void qgather_stats(qgather_t* gather, long* hits, long* misses, size_t* bytes) {
+    *hits = (gather == NULL) ? 0 : gather->hits;
+    *misses = (gather == NULL) ? 0 : gather->misses;
+    *bytes = 0;
+    for (int s = 0; gather != NULL && s < INDEXSHARDS_MAX; s++) {
+        if (gather->shards[s].pairs != NULL) {
+            long h, m;
+            size_t b;
+            qcache_stats(gather->shards[s].pairs, &h, &m, &b);
+            *hits += h;
+            *misses += m;
+            *bytes += b;
+        }
+    }
+}
+
+/*************** qgather_delete ***************/
+// see qshard.h for more information
+void qgather_delete(qgather_t* gather) {
+    if (gather == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&gather->lock);
+    gather->closing = true;
+    pthread_cond_broadcast(&gather->wake);
+    pthread_mutex_unlock(&gather->lock);
+    for (int s = 1; s <= gather->num_helpers; s++) {
+        pthread_join(gather->shards[s].thread, NULL);
+    }
+    for (int s = 0; s < INDEXSHARDS_MAX; s++) {
+        qwork_delete(gather->shards[s].work);
+        qcache_delete(gather->shards[s].pairs);
+    }
+    pthread_mutex_destroy(&gather->lock);
+    pthread_cond_destroy(&gather->wake);
+    pthread_cond_destroy(&gather->done);
+    free(gather->merged);
+    free(gather);
+}
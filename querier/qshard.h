@@ -0,0 +1,130 @@
+// qshard.h - header file for the querier's sharded indexes
+//
+// An index the indexer split with --shards=N (see indexshards.h) is
+// loaded as N pindexes, one per shard, held together in a qshard_t; an
+// index of one file is a qshard_t of one. Every shard holds a range of
+// docIDs of its own, so a query is answered by evaluating it on each
+// shard (scatter) and merging the shards' ranked documents into one
+// ranking (gather). Asked for the top k, each shard finds its own top
+// k, and the best k of those are the top k of the whole index.
+//
+// The shards rank with the whole index's statistics: a BM25 score uses
+// the document count and mean page length of all the shards, and a
+// word's document frequency summed over them (see pindex_share), as
+// does a phrase or wildcard, whose documents are counted in every shard
+// before the query is executed. BM25 scores are therefore those of the
+// index unsplit, as scores by count are, but for a misspelled word's
+// replacements (see --fuzzy), which each shard finds and weights on its
+// own. Stopwords, too, are decided per shard.
+//
+// The evaluation buffers and AND prefix caches of every shard live in
+// a qgather_t, a workspace like qwork_t (see qplan.h), which is not
+// shared; each thread that evaluates queries needs its own.
+
+#ifndef QSHARD_H
+#define QSHARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "querier.h"
+#include "pindex.h"
+#include "../common/word.h"
+
+typedef struct qshard qshard_t;    // opaque to users of the module
+typedef struct qgather qgather_t;  // opaque to users of the module
+
+/*************** qshard_new ***************
+ * Creates a sharded index from its shards' postings.
+ * Inputs:
+ * shards - num pindexes, in docID order; the qshard_t takes them over,
+ *   and the array itself is copied.
+ * num - number of shards, 1 to INDEXSHARDS_MAX.
+ * Output:
+ * The new index, or NULL on error (the shards are then still the
+ * caller's). Caller is responsible for qshard_delete.
+ */
+qshard_t* qshard_new(pindex_t** shards, int num);
+
+/*************** qshard_count ***************
+ * Returns the number of shards.
+ */
+int qshard_count(qshard_t* index);
+
+/*************** qshard_pindex ***************
+ * Returns shard i's postings.
+ */
+pindex_t* qshard_pindex(qshard_t* index, int i);
+
+/*************** qshard_normalizer ***************
+ * Returns how the index's words were normalized; every shard's words
+ * are normalized alike, so this is the first shard's.
+ */
+wordnorm_t* qshard_normalizer(qshard_t* index);
+
+/*************** qshard_positions ***************
+ * Returns true if every shard has word positions, for phrases.
+ */
+bool qshard_positions(qshard_t* index);
+
+/*************** qshard_bm25 ***************
+ * Returns true if the shards rank by BM25 (see pindex_norms).
+ */
+bool qshard_bm25(qshard_t* index);
+
+/*************** qshard_delete ***************
+ * Frees the index and every shard's postings.
+ */
+void qshard_delete(qshard_t* index);
+
+/*************** qgather_new ***************
+ * Creates an empty workspace.
+ * Inputs:
+ * pair_cache_bytes - AND prefix cache capacity, split among the shards;
+ *   0 for none.
+ * parallel - evaluate a query on every shard at once, each on a thread
+ *   of its own that the workspace keeps from query to query; otherwise
+ *   the shards are evaluated one after another (as in batch mode, whose
+ *   threads are already busy with other queries).
+ * Output:
+ * The new workspace, or NULL on error. Caller is responsible for
+ * qgather_delete.
+ */
+qgather_t* qgather_new(size_t pair_cache_bytes, bool parallel);
+
+/*************** qgather_run ***************
+ * Evaluates a query on every shard and merges the results.
+ * Inputs:
+ * gather - the workspace.
+ * index - the sharded index; the same one on every call until
+ *   qgather_flush.
+ * words, word_count - the query's validated words and operators, as
+ *   qplan_compile takes them.
+ * top - how many of the best documents to find; 0 for all that match.
+ * scores - set to the ranked documents, which belong to the workspace
+ *   and are good until its next qgather_run (NULL if none matched).
+ * num_docs - set to the number of documents matched (at most top).
+ * Output:
+ * false if a buffer or thread could not be had.
+ */
+bool qgather_run(qgather_t* gather, qshard_t* index, char** words, int word_count,
+                 int top, const doc_score_t** scores, int* num_docs);
+
+/*************** qgather_flush ***************
+ * Drops the cached AND prefixes, as when the index changes; the hit
+ * and miss counts are kept.
+ */
+void qgather_flush(qgather_t* gather);
+
+/*************** qgather_stats ***************
+ * Reports the AND prefix caches' hits and misses so far, and the bytes
+ * now in use, summed over the shards.
+ */
+void qgather_stats(qgather_t* gather, long* hits, long* misses, size_t* bytes);
+
+/*************** qgather_delete ***************
+ * Stops the workspace's threads, and frees it, its buffers, and its
+ * caches.
+ */
+void qgather_delete(qgather_t* gather);
+
+#endif // QSHARD_H
@@ -11,84 +11,144 @@
 
 # define _GNU_SOURCE
 # include "validate.h"
+# include "querier.h"
+# include "qcache.h"
+# include "pindex.h"
+# include "qplan.h"
+# include "qbatch.h"
+# include "qshard.h"
+# include "qlog.h"
 # include<stdio.h>
 # include<stdlib.h>
 # include <string.h>
 # include <ctype.h>
 # include <stdbool.h>
+# include <unistd.h>
+# include <sys/stat.h>
 # include "../common/word.h"
-# include "../libcs50/counters.h"
 # include "../common/pagedir.h"
-# include "../common/index.h"
+# include "../common/indexfile.h"
+# include "../common/docstats.h"
+# include "../common/positions.h"
+# include "../common/indexshards.h"
 # include "../libcs50/file.h"
-#include "../common/index.h"
 
 
-/*************** qeryctrs ***************
- * Used to store intermediate and final counters
- * during query execution.
- * - `final`: cumulative counters for the final query result.
- * - `temp`: temporary counters used for intermediate query logic.
+/*************** qopts_t ***************
+ * Command-line options.
+ * - `cache_bytes`, `pair_cache_bytes`: query and AND cache capacities.
+ * - `batch_file`: queries to answer in batch mode, or NULL.
+ * - `num_threads`: threads for batch mode.
+ * - `bm25`: rank by BM25 rather than by counts.
+ * - `top`: documents to show per query, 0 for all that match.
+ * - `fuzzy`: edits a missing word may be from the words it stands for.
+ * - `stopwords`: drop frequent words from AND groups with other words.
+ * - `layout_file`: query log to lay the postings out by, or NULL;
+ *   `hot_words`, `num_hot`: its words, most asked for first.
+ * - `huge_pages`: lay the postings out on huge pages.
+ * - `stats`: print the caches' hits and misses on exit.
  */
-struct qeryctrs {
-    counters_t* final;       // cumulative counters for entire query
-    counters_t* temp;        // intermediate counters for logic steps
-};
-
-/*************** doc_score_t ***************
- * Represents a document's score for ranking purposes.
- * - `docID`: unique identifier for the document.
- * - `score`: relevance score calculated for the document.
- */
-typedef struct doc_score_t {
-    int docID;               // document identifier
-    int score;               // relevance score for ranking
-} doc_score_t;
-
-/*************** and_helper_args ***************
- * Arguments struct used in AND operations during query execution.
- * - `temp`: stores intersection results for AND logic.
- * - `curr`: current counters being intersected with `temp`.
- */
-struct and_helper_args {
-    counters_t* temp;        // intersection results
-    counters_t* curr;        // current counters in intersection
-};
-
-/*************** score_helper_args ***************
- * Helper structure for populating the document scores array.
- * - `scores`: array of doc_score_t to populate with results.
- * - `index`: current position in the scores array for insertion.
- */
-struct score_helper_args {
-    doc_score_t* scores;     // array to hold document scores
-    int index;               // current index in scores array
-};
-
+typedef struct qopts {
+    size_t cache_bytes;
+    size_t pair_cache_bytes;
+    const char* batch_file;
+    int num_threads;
+    bool bm25;
+    int top;
+    int fuzzy;
+    bool stopwords;
+    const char* layout_file;
+    char** hot_words;
+    int num_hot;
+    bool huge_pages;
+    bool stats;
+} qopts_t;
 
 // Function Prototypes
-index_t* validate_and_load_index(int argc, char* argv[]);
-void process_queries(index_t* index, const char* page_directory);
-counters_t* execute_query(char** word, int word_count, index_t* index);
-doc_score_t* rank_documents(counters_t* final, int* num_docs);
-void display_output(doc_score_t* scores, int num_docs, const char* pagedir);
+qshard_t* validate_and_load_index(int argc, char* argv[], qopts_t* opts);
+qshard_t* load_index(const char* index_file, const qopts_t* opts);
+pindex_t* load_postings(const char* index_file, const qopts_t* opts);
+bool prepare_postings(pindex_t* pindex, const char* index_file, const qopts_t* opts);
+void process_queries(qshard_t** index, const char* page_directory,
+                     const char* index_file, const qopts_t* opts,
+                     qcache_t* cache, qgather_t* gather);
+bool parse_bytes(const char* arg, const char* option, size_t* bytes);
+bool index_changed(const char* index_file, struct stat* stamp);
+void display_output(const doc_score_t* scores, int num_docs, const char* pagedir,
+                    bool bm25, int top);
+
+static const size_t DEFAULT_CACHE_BYTES = 4 << 20;   // 4MB of results
+static const size_t DEFAULT_PAIR_CACHE_BYTES = 4 << 20;   // 4MB of postings
+static const int MAX_THREADS = 64;   // most batch threads we allow
+static const int MAX_TOP = 1 << 20;  // most documents --top may ask for
+static const int MAX_FUZZY = 2;      // most edits --fuzzy may allow
 
 
 int main(int argc, char* argv[])
 {
-    index_t* index = validate_and_load_index(argc, argv);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    qopts_t opts = {.cache_bytes = DEFAULT_CACHE_BYTES,
+                    .pair_cache_bytes = DEFAULT_PAIR_CACHE_BYTES,
+                    .num_threads = (cpus < 1) ? 1 : (cpus > MAX_THREADS) ? MAX_THREADS : cpus};
+    qshard_t* index = validate_and_load_index(argc, argv, &opts);
     if (index == NULL) {
         fprintf(stderr, "Error: Failed to validate inputs and load index.\n");
         exit(1);
     }
     char* page_directory = argv[1];
+    qcache_t* cache = qcache_new(opts.cache_bytes);
+    // batch mode gives each thread its own workspace and AND caches
+    qgather_t* gather = (opts.batch_file == NULL) ? qgather_new(opts.pair_cache_bytes, true) : NULL;
+    if (cache == NULL || (gather == NULL && opts.batch_file == NULL)) {
+        fprintf(stderr, "Error: Failed to create the query caches.\n");
+        qcache_delete(cache);
+        qgather_delete(gather);
+        qshard_delete(index);
+        exit(4);
+    }
 
-    // Start processing user queries
-    process_queries(index, page_directory);
+    int status = 0;
+    if (opts.batch_file != NULL) {
+        // Answer a file of queries, no prompts
+        FILE* in = (strcmp(opts.batch_file, "-") == 0) ? stdin : fopen(opts.batch_file, "r");
+        if (in == NULL) {
+            fprintf(stderr, "Cannot read queries from %s\n", opts.batch_file);
+            status = 5;
+        } else {
+            validate_quiet(true);
+            if (!qbatch_run(in, stdout, index, cache, opts.pair_cache_bytes,
+                            opts.num_threads, opts.top, opts.stats)) {
+                fprintf(stderr, "Error: batch mode ran out of memory or threads.\n");
+                status = 4;
+            }
+            if (in != stdin) {
+                fclose(in);
+            }
+        }
+    } else {
+        // Start processing user queries
+        process_queries(&index, page_directory, argv[2], &opts, cache, gather);
+    }
+
+    long hits, misses;
+    size_t bytes;
+    if (opts.stats && opts.cache_bytes > 0) {
+        qcache_stats(cache, &hits, &misses, &bytes);
+        fprintf(stderr, "Query cache: %ld hits, %ld misses, %zu bytes held\n",
+                hits, misses, bytes);
+    }
+    if (opts.stats && gather != NULL && opts.pair_cache_bytes > 0) {
+        qgather_stats(gather, &hits, &misses, &bytes);
+        fprintf(stderr, "AND cache: %ld hits, %ld misses, %zu bytes held\n",
+                hits, misses, bytes);
+    }
 
     // Clean up and exit
-    index_delete(index); 
-    return 0;
+    qcache_delete(cache);
+    qgather_delete(gather);
+    qshard_delete(index);
+    qlog_delete(opts.hot_words, opts.num_hot);
+    return status;
 }
 
 
@@ -99,16 +159,67 @@ int main(int argc, char* argv[])
  * Parameters:
  *   argc - number of arguments
  *   argv - array of argument strings
+ *   opts - defaults on entry; set from any --cache=BYTES,
+ *          --pair-cache=BYTES, --batch=FILE, --threads=N,
+ *          --rank=count|bm25, --top=K, --fuzzy=N, --stopwords,
+ *          --layout=LOG, --huge-pages, or --stats given; a cache
+ *          size given also turns on stats
  *
  * Returns:
- *   Loaded index if inputs are valid; exits on error.
+ *   The loaded index, of one shard or several, if inputs are valid;
+ *   exits on error.
  */
 
-index_t* validate_and_load_index(int argc, char* argv[]){
-    if (argc!=3){
+qshard_t* validate_and_load_index(int argc, char* argv[], qopts_t* opts){
+    if (argc<3 || argc>14){
         fprintf(stderr, "invalid number of inputs");
         exit(1);
     }
+    for (int i = 3; i < argc; i++) {
+        size_t threads;
+        size_t top;
+        size_t fuzzy;
+        if (strncmp(argv[i], "--batch=", 8) == 0 && argv[i][8] != '\0') {
+            opts->batch_file = argv[i] + 8;
+        } else if (strcmp(argv[i], "--stopwords") == 0) {
+            opts->stopwords = true;
+        } else if (strncmp(argv[i], "--layout=", 9) == 0 && argv[i][9] != '\0') {
+            opts->layout_file = argv[i] + 9;
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            opts->huge_pages = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            opts->stats = true;
+        } else if (strcmp(argv[i], "--rank=bm25") == 0 || strcmp(argv[i], "--rank=count") == 0) {
+            opts->bm25 = (strcmp(argv[i], "--rank=bm25") == 0);
+        } else if (parse_bytes(argv[i], "--threads=", &threads)) {
+            if (threads < 1 || threads > MAX_THREADS) {
+                fprintf(stderr, "invalid number of threads: %s\n", argv[i] + 10);
+                exit(1);
+            }
+            opts->num_threads = threads;
+        } else if (parse_bytes(argv[i], "--top=", &top)) {
+            if (top > MAX_TOP) {
+                fprintf(stderr, "invalid number of documents: %s\n", argv[i] + 6);
+                exit(1);
+            }
+            opts->top = top;
+        } else if (parse_bytes(argv[i], "--fuzzy=", &fuzzy)) {
+            if (fuzzy < 1 || fuzzy > MAX_FUZZY) {
+                fprintf(stderr, "invalid number of edits: %s\n", argv[i] + 8);
+                exit(1);
+            }
+            opts->fuzzy = fuzzy;
+        } else if (parse_bytes(argv[i], "--cache=", &opts->cache_bytes)
+                   || parse_bytes(argv[i], "--pair-cache=", &opts->pair_cache_bytes)) {
+            opts->stats = true;
+        } else {
+            fprintf(stderr, "usage: %s pageDirectory indexFilename [--cache=BYTES] "
+                    "[--pair-cache=BYTES] [--batch=FILE] [--threads=N] "
+                    "[--rank=count|bm25] [--top=K] [--fuzzy=1|2] [--stopwords] "
+                    "[--layout=LOG] [--huge-pages] [--stats]\n", argv[0]);
+            exit(1);
+        }
+    }
 
     char* pageDirectory = argv[1];
     char* indexerfile = argv[2];
@@ -117,7 +228,12 @@ index_t* validate_and_load_index(int argc, char* argv[]){
         fprintf(stderr, "Invalid directory provided\n");
         exit(2);
     }
-    index_t* index = index_load(indexerfile);
+    if (opts->layout_file != NULL
+        && (opts->hot_words = qlog_load(opts->layout_file, &opts->num_hot)) == NULL) {
+        fprintf(stderr, "Failed to read the query log: %s\n", opts->layout_file);
+        exit(3);
+    }
+    qshard_t* index = load_index(indexerfile, opts);
     if (index == NULL) {
         fprintf(stderr, "Failed to load the index from file: %s\n", indexerfile);
         exit(3);
@@ -126,19 +242,175 @@ index_t* validate_and_load_index(int argc, char* argv[]){
 }
 
 
+/**************** load_index ****************/
+/* Loads an index: the index file itself or, if the indexer split it
+ * into shards (see indexshards.h), every shard's file, each with the
+ * files saved beside it. Shards ranking by BM25 are given the whole
+ * index's statistics (see pindex_share) before they are prepared for
+ * queries.
+ *
+ * Returns:
+ *   the index, or NULL if its list of shards is malformed or any file
+ *   cannot be loaded.
+ */
+qshard_t* load_index(const char* index_file, const qopts_t* opts) {
+    int num = indexshards_load(index_file);
+    if (num < 0) {
+        fprintf(stderr, "Malformed list of shards for %s\n", index_file);
+        return NULL;
+    }
+    if (num == 0) {
+        pindex_t* pindex = load_postings(index_file, opts);
+        if (pindex != NULL && !prepare_postings(pindex, index_file, opts)) {
+            pindex_delete(pindex);
+            pindex = NULL;
+        }
+        qshard_t* index = (pindex == NULL) ? NULL : qshard_new(&pindex, 1);
+        if (index == NULL) {
+            pindex_delete(pindex);
+        }
+        return index;
+    }
+
+    pindex_t* shards[INDEXSHARDS_MAX];
+    int loaded = 0;
+    while (loaded < num) {
+        char* shard_file = indexshards_name(index_file, loaded);
+        shards[loaded] = (shard_file == NULL) ? NULL : load_postings(shard_file, opts);
+        free(shard_file);
+        if (shards[loaded] == NULL) {
+            break;
+        }
+        loaded++;
+    }
+    bool ok = (loaded == num);
+    if (ok) {
+        pindex_share(shards, num);
+    }
+    for (int i = 0; ok && i < num; i++) {
+        char* shard_file = indexshards_name(index_file, i);
+        ok = shard_file != NULL && prepare_postings(shards[i], shard_file, opts);
+        free(shard_file);
+    }
+    qshard_t* index = ok ? qshard_new(shards, num) : NULL;
+    if (index == NULL) {
+        for (int i = 0; i < loaded; i++) {
+            pindex_delete(shards[i]);
+        }
+    }
+    return index;
+}
+
+
+/**************** load_postings ****************/
+/* Loads an index file and converts it to postings arrays; the parsed
+ * file is freed, since queries only read the postings. For BM25 the
+ * document lengths saved beside the index are loaded too, and the word
+ * positions, for phrases, if the indexer saved them, and the way the
+ * indexer normalized words (stemming them or not).
+ *
+ * Returns:
+ *   the postings, or NULL if either file cannot be loaded.
+ */
+pindex_t* load_postings(const char* index_file, const qopts_t* opts) {
+    docstats_t* stats = NULL;
+    if (opts->bm25 && (stats = docstats_load(index_file)) == NULL) {
+        fprintf(stderr, "No document lengths for %s; re-run the indexer\n", index_file);
+        return NULL;
+    }
+    indexfile_t* file = indexfile_load(index_file);
+    if (file == NULL) {
+        fprintf(stderr, "Failed to read the index file %s\n", index_file);
+        docstats_delete(stats);
+        return NULL;
+    }
+    if (indexfile_skipped(file) > 0) {
+        fprintf(stderr, "Skipped %d malformed lines in %s\n", indexfile_skipped(file), index_file);
+    }
+    wordnorm_t* norm = wordnorm_load(index_file);
+    if (norm == NULL) {
+        fprintf(stderr, "Unknown word normalization for %s\n", index_file);
+        indexfile_delete(file);
+        docstats_delete(stats);
+        return NULL;
+    }
+    pindex_t* pindex = pindex_build(file, stats, positions_load(index_file), norm);
+    indexfile_delete(file);
+    docstats_delete(stats);
+    return pindex;
+}
+
+
+/**************** prepare_postings ****************/
+/* Prepares loaded postings for queries. With --fuzzy, they are made
+ * ready to find the words a few edits from a missing one (see
+ * pindex_fuzzy), and with --stopwords they treat frequent words as
+ * stopwords. With --layout or --huge-pages they are laid out for the
+ * words the log asks for most (see pindex_layout).
+ *
+ * Returns:
+ *   false if memory ran out; the caller still owns the postings.
+ */
+bool prepare_postings(pindex_t* pindex, const char* index_file, const qopts_t* opts) {
+    if ((opts->layout_file != NULL || opts->huge_pages)
+        && !pindex_layout(pindex, opts->hot_words, opts->num_hot, opts->huge_pages)) {
+        fprintf(stderr, "Failed to lay out the postings of %s\n", index_file);
+        return false;
+    }
+    if (opts->fuzzy > 0 && !pindex_fuzzy(pindex, opts->fuzzy)) {
+        return false;
+    }
+    pindex_stopwords(pindex, opts->stopwords);
+    return true;
+}
+
+
+/**************** parse_bytes ****************/
+/* Parses an option of the form OPTIONnumber, such as --cache=1048576
+ * (or --threads=4, --top=10).
+ *
+ * Returns:
+ *   true, with *bytes set, if arg is option followed by a number.
+ */
+bool parse_bytes(const char* arg, const char* option, size_t* bytes) {
+    size_t len = strlen(option);
+    if (strncmp(arg, option, len) != 0 || !isdigit((unsigned char) arg[len])) {
+        return false;
+    }
+    char* end;
+    unsigned long long value = strtoull(arg + len, &end, 10);
+    if (*end != '\0') {
+        return false;
+    }
+    *bytes = value;
+    return true;
+}
+
+
 /**************** process_queries ****************/
 /* Processes user queries and displays matching documents.
  *
  * Parameters:
- *   index - loaded index for query processing
+ *   index - the loaded index; replaced if the index file (or its list
+ *           of shards) changes
  *   page_directory - directory of crawled pages for document paths
+ *   index_file - the file the index was loaded from
+ *   opts - the command-line options: ranking, top k, and how to
+ *          reload the index
+ *   cache - results of earlier queries, flushed if the index file changes
+ *   gather - workspace for searching the shards, whose AND prefixes
+ *            are flushed likewise
  *
  * Returns:
  *   None; exits on EOF or error.
  */
-void process_queries(index_t* index, const char* page_directory) {
+void process_queries(qshard_t** index, const char* page_directory,
+                     const char* index_file, const qopts_t* opts,
+                     qcache_t* cache, qgather_t* gather) {
     char* input = NULL;
     size_t len = 0;
+    struct stat stamp;
+    index_changed(index_file, &stamp);
 
     while (1) {
         printf("Query? ");
@@ -187,22 +459,59 @@ void process_queries(index_t* index, const char* page_directory) {
 
         printf("Query: %s\n", cleaned_query);
 
-        counters_t* result = execute_query(words, word_count, index);
-        if (result == NULL) {
-            printf("No documents match.\n");
+        // results of an older index must not be served
+        if (index_changed(index_file, &stamp)) {
+            qcache_flush(cache);
+            qgather_flush(gather);
+            qshard_t* fresh = load_index(index_file, opts);
+            if (fresh != NULL) {
+                qshard_delete(*index);
+                *index = fresh;
+            } else {
+                fprintf(stderr, "Error: Failed to reload the index from %s\n", index_file);
+            }
+        }
+
+        // query words must be normalized as the index's words were
+        if (!query_normalize(words, word_count, qshard_normalizer(*index))) {
+            free_memory(words, &word_count);
+            free(cleaned_query);
+            continue;
+        }
+
+        // phrases need the positions the indexer saves with --positions
+        if (query_phrase(words, word_count) && !qshard_positions(*index)) {
+            print_error("no word positions for phrases; re-run the indexer with --positions", NULL);
             printf("-----------------------------------------------\n");
-        } else {
-            // Rank and display the results
-            int num_docs = 0;
-            doc_score_t* scores = rank_documents(result, &num_docs);
-            display_output(scores, num_docs, page_directory);
+            free_memory(words, &word_count);
+            free(cleaned_query);
+            continue;
+        }
 
-            // Clean up ranking resources
-            free(scores);
+        char* key = query_key(words, word_count);
+        const doc_score_t* cached;
+        int num_cached;
+        if (key != NULL && qcache_find(cache, key, &cached, &num_cached)) {
+            display_output(cached, num_cached, page_directory, opts->bm25, opts->top);
             printf("-----------------------------------------------\n");
+            free(key);
+            free_memory(words, &word_count);
+            free(cleaned_query);
+            continue;
         }
 
-        counters_delete(result);
+        const doc_score_t* scores;
+        int num_docs;
+        if (!qgather_run(gather, *index, words, word_count, opts->top, &scores, &num_docs)) {
+            printf("No documents match.\n");
+        } else {
+            // Rank and display the results
+            display_output(scores, num_docs, page_directory, opts->bm25, opts->top);
+            qcache_insert(cache, key, scores, num_docs);
+        }
+        printf("-----------------------------------------------\n");
+
+        free(key);
         free_memory(words, &word_count);
         free(cleaned_query);
     }
@@ -212,237 +521,75 @@ void process_queries(index_t* index, const char* page_directory) {
 
 
 
-/************** counters_copy_helper ***************
- * Copies each (key, count) pair from one counters structure to another.
- *
- * Inputs:
- *   arg - destination counters structure (as void pointer)
- *   key - unique document ID
- *   count - count associated with the document ID
- */
-void counters_copy_helper(void* arg, int key, int count)
-{
-    counters_t* temp = arg;
-    counters_set(temp, key, count);
-}
-
-/************** counters_and_helper ***************
- * Helper function for AND operations on counters.
- * Updates the target counters structure with the minimum count for matching keys.
- *
- * Inputs:
- *   arg - structure containing temporary and current counters
- *   key - unique document ID
- *   count - count in the temporary counters structure
- */
-void counters_and_helper(void* arg, const int key, const int count) {
-    struct and_helper_args* args = arg;
-    int curr_count = counters_get(args->curr, key);
-
-    if (curr_count > 0) {
-        counters_set(args->temp, key, (count < curr_count) ? count : curr_count);
-        
-    } else {
-        counters_set(args->temp, key, 0);
-    }
-}
-
-/************** counters_set_to_zero ***************
- * Sets all counts in a given counters structure to zero.
- *
- * Inputs:
- *   arg - counters structure to update
- *   key - unique document ID
- *   count - current count (unused)
- */
-void counters_set_to_zero(void*arg, const int key, const int count){
-    counters_set((counters_t*)arg, key,0);
-}
-
-/************** and_intersect_counters ***************
- * Performs an AND intersection on two counters structures.
- * Stores the minimum counts in the first counters structure.
- *
- * Inputs:
- *   temp - counters structure to store intersected counts
- *   curr - counters structure to intersect with `temp`
- */
-void and_intersect_counters(counters_t* temp, counters_t* curr){
-    if (curr==NULL){
-        counters_iterate(temp, temp, counters_set_to_zero);
-        return;
-    }
-    struct and_helper_args args = {temp, curr};
-    counters_iterate(temp, &args, counters_and_helper);
-}
-
-
-
-/************** counters_or_helper ***************
- * Helper for OR operation; adds counts for matching keys across two counters.
- *
- * Inputs:
- *   arg - destination counters structure (as void pointer)
- *   key - unique document ID
- *   count - count from the source counters structure
- */
-void counters_or_helper(void* arg, int key, int count) {
-    counters_t* final = arg;  // Final counters as argument
-    int final_count = counters_get(final, key);
-    counters_set(final, key, final_count + count);
-}
-
-/************** or_merge_counters ***************
- * Merges two counters structures with an OR operation,
- * adding counts from the source to the destination structure.
- *
- * Inputs:
- *   final - counters structure to accumulate counts
- *   temp - source counters structure
- */
-void or_merge_counters(counters_t* final, counters_t* temp) {
-
-    if (temp != NULL) {
-        counters_iterate(temp, final, counters_or_helper);
-    }
-}
-
-/************** execute_query ***************
- * Executes a search query on the index using OR/AND logic.
- * Combines results in `final` counters for all valid words.
- *
- * Inputs:
- *   word - array of words from the query
- *   word_count - number of words in the query
- *   index - index structure for document search
+/**************** index_changed ****************/
+/* Checks whether the index file has changed since it was last seen. A
+ * sharded index is watched through its list of shards, which the
+ * indexer writes after the shards themselves.
  *
- * Returns:
- *   counters_t* - final counters with combined results for the query
- */
-counters_t* execute_query(char** word, int word_count, index_t* index){
-    struct qeryctrs ctrs;
-    ctrs.final = counters_new();
-    ctrs.temp = NULL;
-
-    for (int i = 0; i < word_count; i++){
-        if (strcmp(word[i], "or") == 0) {
-            // Merge ctrs.temp into ctrs.final for OR
-            or_merge_counters(ctrs.final, ctrs.temp);
-            counters_delete(ctrs.temp);
-            ctrs.temp = NULL;
-        } 
-        else if (strcmp(word[i], "and") != 0) {
-            counters_t* curr = hashtable_find(index->ht, word[i]);
-
-            if (ctrs.temp == NULL) {
-                // Start new temp counters for the word
-                ctrs.temp = counters_new();
-                if (curr != NULL) {
-                    counters_iterate(curr, ctrs.temp, counters_copy_helper);
-                }
-            } else {
-                // Perform AND with current counters
-                and_intersect_counters(ctrs.temp, curr);
-            }
-        }
-    }
-
-    // Final OR merge if temp has remaining values
-    if (ctrs.temp != NULL) {
-        or_merge_counters(ctrs.final, ctrs.temp);
-        counters_delete(ctrs.temp);
-    }
-
-    return ctrs.final;
-}
-
-
-/************** compare_scores ***************
- * Compares two document scores, used for ranking results.
- *
- * Inputs:
- *   a - first document score
- *   b - second document score
+ * Parameters:
+ *   index_file - the index file
+ *   stamp - what stat said last time; updated to what it says now
  *
  * Returns:
- *   difference in scores for sorting in descending order
+ *   true if the file's device, inode, size, or modification time
+ *   differs from stamp (a new file renamed into place changes the inode,
+ *   as does an index becoming sharded, or no longer sharded).
  */
-int compare_scores(const void* a, const void* b) {
-    const doc_score_t* score_a = (const doc_score_t*)a;
-    const doc_score_t* score_b = (const doc_score_t*)b;
-    return score_b->score - score_a->score;
-}
-
-/************** add_to_doc_score_array ***************
- * Helper to populate an array with document scores.
- *
- * Inputs:
- *   arg - struct holding score array and current index
- *   doc_id - document ID
- *   score - score for the document
- */
-void add_to_doc_score_array(void* arg, const int doc_id, const int score) {
-    struct score_helper_args* args = arg;
-    args->scores[args->index].docID = doc_id;
-    args->scores[args->index].score = score;
-    args->index++;
-}
-
-/************** count_docs ***************
- * Counts documents with positive scores.
- *
- * Inputs:
- *   arg - pointer to document count
- *   key - document ID
- *   count - score for the document
- */
-void count_docs(void* arg, const int key, const int count) {
-    int* num_docs = arg;
-    if (count > 0) {
-        (*num_docs)++;
+bool index_changed(const char* index_file, struct stat* stamp) {
+    struct stat now;
+    char* list = indexshards_list(index_file);
+    bool found = (list != NULL && stat(list, &now) == 0) || stat(index_file, &now) == 0;
+    free(list);
+    if (!found) {
+        return false;      // keep answering from the index we have
     }
+    bool changed = now.st_dev != stamp->st_dev || now.st_ino != stamp->st_ino
+        || now.st_size != stamp->st_size
+        || now.st_mtim.tv_sec != stamp->st_mtim.tv_sec
+        || now.st_mtim.tv_nsec != stamp->st_mtim.tv_nsec;
+    *stamp = now;
+    return changed;
 }
 
-
-/************** rank_documents ***************
- * Creates a ranked array of documents based on their scores.
+/**************** query_key ****************/
+/* Builds the query cache key: the validated words joined by single spaces,
+ * with each phrase (a word holding spaces) in double quotes.
  *
- * Inputs:
- *   final - counters structure with document scores
- *   num_docs - pointer to hold the number of ranked documents
+ * Parameters:
+ *   words - the words and operators of the query, lowercased
+ *   word_count - number of words
  *
  * Returns:
- *   doc_score_t* - array of documents sorted by score, or NULL if empty
+ *   a malloc'd key for the caller to free, or NULL on error.
  */
-doc_score_t* rank_documents(counters_t* final, int* num_docs) {
-    *num_docs = 0;
-    counters_iterate(final, num_docs, count_docs);
-
-    if (*num_docs == 0) {
-        return NULL; // no document found
+char* query_key(char** words, int word_count) {
+    size_t len = 0;
+    for (int i = 0; i < word_count; i++) {
+        len += strlen(words[i]) + 3;
     }
-
-    doc_score_t* scores = malloc(*num_docs * sizeof(doc_score_t));
-
-    if (scores == NULL) {
-        fprintf(stderr, "Error: Unable to allocate memory for document scores.\n");
+    char* key = malloc(len + 1);
+    if (key == NULL) {
         return NULL;
     }
-
-    // Reset an index for adding scores
-    struct score_helper_args {
-        doc_score_t* scores;
-        int index;
-    } args = {scores, 0};
-
-    counters_iterate(final, &args, add_to_doc_score_array);
-
-    qsort(scores, *num_docs, sizeof(doc_score_t), compare_scores);
-
-    return scores;
+    char* p = key;
+    for (int i = 0; i < word_count; i++) {
+        if (i > 0) {
+            *p++ = ' ';
+        }
+        bool phrase = (strchr(words[i], ' ') != NULL);
+        if (phrase) {
+            *p++ = '"';
+        }
+        strcpy(p, words[i]);
+        p += strlen(words[i]);
+        if (phrase) {
+            *p++ = '"';
+        }
+    }
+    *p = '\0';
+    return key;
 }
 
-
 /************** display_output ***************
  * Displays ranked query results with document scores and URLs.
  *
@@ -450,12 +597,19 @@ doc_score_t* rank_documents(counters_t* final, int* num_docs) {
  *   scores - array of document scores
  *   num_docs - number of documents to display
  *   pagedir - directory path for document retrieval
+ *   bm25 - scores are BM25 units, shown to three decimals
+ *   top - the most documents asked for, 0 for all that match
  *
  * Returns:
  *   None; prints results to stdout
  */
-void display_output(doc_score_t* scores, int num_docs, const char* pagedir) {
-    printf("Matches %d documents (ranked):\n", num_docs);
+void display_output(const doc_score_t* scores, int num_docs, const char* pagedir,
+                    bool bm25, int top) {
+    if (top > 0) {
+        printf("Top %d documents (ranked):\n", num_docs);
+    } else {
+        printf("Matches %d documents (ranked):\n", num_docs);
+    }
 
     for (int i = 0; i < num_docs; i++) {
         int doc_id = scores[i].docID;
@@ -469,7 +623,12 @@ void display_output(doc_score_t* scores, int num_docs, const char* pagedir) {
             char url[1024];  
             if (fgets(url, sizeof(url), file) != NULL) {  
                 url[strcspn(url, "\n")] = '\0';
-                printf("score\t%d doc\t%d: %s\n", score, doc_id, url);
+                if (bm25) {
+                    printf("score\t%.3f doc\t%d: %s\n",
+                           (double) score / PINDEX_BM25_SCALE, doc_id, url);
+                } else {
+                    printf("score\t%d doc\t%d: %s\n", score, doc_id, url);
+                }
             } else {
                 fprintf(stderr, "Error: Unable to read URL from file %s\n", pathname);
             }
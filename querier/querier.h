@@ -0,0 +1,22 @@
+// querier.h - types and helpers shared by the querier and its modules
+
+#ifndef QUERIER_H
+#define QUERIER_H
+
+/*************** doc_score_t ***************
+ * Represents a document's score for ranking purposes.
+ * - `docID`: unique identifier for the document.
+ * - `score`: relevance score calculated for the document.
+ */
+typedef struct doc_score_t {
+    int docID;               // document identifier
+    int score;               // relevance score for ranking
+} doc_score_t;
+
+/*************** query_key ***************
+ * Builds the query cache key: the validated words joined by single
+ * spaces (see querier.c). Returns a malloc'd key, or NULL on error.
+ */
+char* query_key(char** words, int word_count);
+
+#endif // QUERIER_H
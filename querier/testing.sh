@@ -70,6 +70,213 @@ else
     log "Test 4 Failed: Query 'home AND back' encountered an error"
 fi
 
+# Test 5: Repeated queries are answered from the query cache
+log "Test 5: Query 'home AND back' twice, differently spaced and cased"
+printf "home AND back\nHome  and  BACK\n" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" >> "$OUTPUT_FILE" 2>&1
+if printf "home AND back\nHome  and  BACK\n" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --stats 2>&1 >/dev/null | grep -q "1 hits, 1 misses"; then
+    log "Test 5 Passed: second query was a cache hit"
+else
+    log "Test 5 Failed: second query was not a cache hit"
+fi
+
+# Test 6: A changed index file empties the cache
+log "Test 6: Replace the index file between two identical queries"
+LIVE_INDEX="$(mktemp)"
+cp "$INDEX_FILENAME" "$LIVE_INDEX"
+(echo "home"; sleep 1; cp "$INDEX_FILENAME" "$LIVE_INDEX.new"; mv "$LIVE_INDEX.new" "$LIVE_INDEX"; echo "home") \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$LIVE_INDEX" --stats 2>&1 >/dev/null | grep -q "0 hits, 2 misses"
+if [ $? -eq 0 ]; then
+    log "Test 6 Passed: query after the index changed was evaluated again"
+else
+    log "Test 6 Failed: query after the index changed was served from the cache"
+fi
+rm -f "$LIVE_INDEX"
+
+# Test 7: A popular AND prefix is cached and reused by other queries
+# (every word is in the index; a group with a missing word is empty
+# without consulting the cache)
+log "Test 7: Four queries starting 'home AND page'"
+PAIR_QUERIES="home page first\nhome page search\npage and home the\nhome page this\n"
+if printf "$PAIR_QUERIES" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --stats 2>&1 >/dev/null | grep -q "AND cache: 1 hits"; then
+    log "Test 7 Passed: fourth query reused the cached 'home AND page' postings"
+else
+    log "Test 7 Failed: fourth query did not reuse the cached prefix"
+fi
+
+# Test 8: Batch mode answers every line, in input order
+log "Test 8: Batch mode on four lines, one blank and one invalid"
+BATCH_OUT=$(printf "home\nhome and page\n\nhome and\n" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- --threads=2 2>/dev/null)
+BATCH_HOME=$(echo "home" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" 2>/dev/null \
+    | sed -n 's/.*Matches \([0-9]*\) documents.*/\1/p')
+if [ "$(echo "$BATCH_OUT" | wc -l)" -eq 4 ] \
+    && [ "$(echo "$BATCH_OUT" | sed -n 1p | cut -f2)" = "$BATCH_HOME" ] \
+    && [ "$(echo "$BATCH_OUT" | sed -n 4p | cut -f2)" = "-1" ]; then
+    log "Test 8 Passed: one result line per query line, matching interactive mode"
+else
+    log "Test 8 Failed: batch output did not line up with its input"
+fi
+
+# Test 9: BM25 ranking needs the document lengths the indexer saves
+log "Test 9: --rank=bm25 with and without document lengths"
+BM25_INDEX="$OUTPUT_FILE.bm25.index"
+cp "$INDEX_FILENAME" "$BM25_INDEX"
+rm -f "$BM25_INDEX.docs"
+echo "home" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$BM25_INDEX" --rank=bm25 > /dev/null 2>&1
+NO_DOCS=$?
+../indexer/indexer "$PAGE_DIRECTORY" "$BM25_INDEX" > /dev/null 2>&1
+BM25_TOP=$(echo "home" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$BM25_INDEX" --rank=bm25 2>/dev/null \
+    | grep -m 1 "^score" | cut -f2)
+if [ $NO_DOCS -ne 0 ] && echo "$BM25_TOP" | grep -q "^[0-9]*\.[0-9][0-9][0-9] doc"; then
+    log "Test 9 Passed: BM25 refused an index without lengths and ranked one with them"
+else
+    log "Test 9 Failed: BM25 ranking did not behave as expected"
+fi
+rm -f "$BM25_INDEX" "$BM25_INDEX.docs" "$BM25_INDEX.norm"
+
+# Test 10: --top=K shows the first K documents of the full ranking
+log "Test 10: 'home or page or first' with --top=2"
+TOP_QUERY="home or page or first"
+FULL_TOP=$(echo "$TOP_QUERY" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" 2>/dev/null \
+    | grep "^score" | head -2)
+TOP_ONLY=$(echo "$TOP_QUERY" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --top=2 2>/dev/null \
+    | grep "^score")
+if [ -n "$TOP_ONLY" ] && [ "$TOP_ONLY" = "$FULL_TOP" ]; then
+    log "Test 10 Passed: the top two documents match the full ranking"
+else
+    log "Test 10 Failed: --top=2 did not give the first two ranked documents"
+fi
+
+# Test 11: Phrases match words in order, given the indexer's positions
+log "Test 11: '\"home page\"' and '\"page home\"' on an index with positions"
+PHRASE_INDEX="$OUTPUT_FILE.phrase.index"
+../indexer/indexer "$PAGE_DIRECTORY" "$PHRASE_INDEX" --positions > /dev/null 2>&1
+PHRASE_OUT=$(printf '"home page"\n"page home"\n' \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$PHRASE_INDEX" --batch=- 2>/dev/null | cut -f2)
+# without positions a phrase is refused, as in interactive mode
+NO_POSITIONS_OUT=$(printf '"home page"\n' \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- 2>/dev/null | cut -f2)
+if [ "$(echo $PHRASE_OUT)" = "1 0" ] && [ "$NO_POSITIONS_OUT" = "-1" ]; then
+    log "Test 11 Passed: the phrase matched only in order, and needed positions"
+else
+    log "Test 11 Failed: phrase counts were '$(echo $PHRASE_OUT)', not '1 0', and '$NO_POSITIONS_OUT' without positions"
+fi
+rm -f "$PHRASE_INDEX" "$PHRASE_INDEX.docs" "$PHRASE_INDEX.pos" "$PHRASE_INDEX.norm"
+
+# Test 12: A wildcard word matches every word it stands for
+log "Test 12: 'hom*' matches at least the documents 'home' does"
+WILD_OUT=$(printf "home\nhom*\n*ome\n" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- 2>/dev/null | cut -f2)
+set -- $WILD_OUT
+if [ "$#" -eq 3 ] && [ "$1" -gt 0 ] && [ "$2" -ge "$1" ] && [ "$3" = "-1" ]; then
+    log "Test 12 Passed: 'hom*' matched $2 documents, 'home' $1, and '*ome' was refused"
+else
+    log "Test 12 Failed: wildcard counts were '$WILD_OUT'"
+fi
+
+# Test 13: With --fuzzy, a misspelled word finds the word it misspells
+log "Test 13: 'hoem' with and without --fuzzy=1"
+FUZZY_OUT=$(printf "home\nhoem\n" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- --fuzzy=1 2>/dev/null | cut -f2,3)
+EXACT_OUT=$(echo "hoem" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- 2>/dev/null | cut -f2)
+if [ "$(echo "$FUZZY_OUT" | sed -n 1p)" = "$(echo "$FUZZY_OUT" | sed -n 2p)" ] && [ "$EXACT_OUT" = "0" ]; then
+    log "Test 13 Passed: 'hoem' matched as 'home' only with --fuzzy=1"
+else
+    log "Test 13 Failed: fuzzy results were '$FUZZY_OUT', exact '$EXACT_OUT'"
+fi
+
+# Test 14: --stopwords drops frequent words from groups with other words
+# ('home' is in every page; BM25 shows whether it was scored)
+log "Test 14: 'home page' and 'home' with and without --stopwords"
+STOP_INDEX="$OUTPUT_FILE.stop.index"
+../indexer/indexer "$PAGE_DIRECTORY" "$STOP_INDEX" > /dev/null 2>&1
+STOP_ON=$(printf "home page\npage\nhome\n" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$STOP_INDEX" --batch=- --rank=bm25 --stopwords 2>/dev/null | cut -f2,3)
+STOP_OFF=$(echo "home page" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$STOP_INDEX" --batch=- --rank=bm25 2>/dev/null | cut -f2,3)
+if [ "$(echo "$STOP_ON" | sed -n 1p)" = "$(echo "$STOP_ON" | sed -n 2p)" ] \
+    && [ "$STOP_OFF" != "$(echo "$STOP_ON" | sed -n 1p)" ] \
+    && [ "$(echo "$STOP_ON" | sed -n 3p | cut -f1)" = "3" ]; then
+    log "Test 14 Passed: 'home' was dropped beside 'page' but still answered alone"
+else
+    log "Test 14 Failed: stopword results were '$STOP_ON' and '$STOP_OFF'"
+fi
+rm -f "$STOP_INDEX" "$STOP_INDEX.docs" "$STOP_INDEX.norm"
+
+# Test 15: An index built with --stem stems query words the same way
+log "Test 15: 'searching' on a stemmed index and on the given one"
+STEM_INDEX="$OUTPUT_FILE.stem.index"
+../indexer/indexer "$PAGE_DIRECTORY" "$STEM_INDEX" --stem > /dev/null 2>&1
+STEM_OUT=$(printf "search\nsearching\n" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$STEM_INDEX" --batch=- 2>/dev/null | cut -f2,3)
+PLAIN_OUT=$(echo "searching" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- 2>/dev/null | cut -f2)
+if [ "$(echo "$STEM_OUT" | sed -n 1p)" = "$(echo "$STEM_OUT" | sed -n 2p)" ] \
+    && [ "$(echo "$STEM_OUT" | sed -n 1p | cut -f1)" -gt 0 ] && [ "$PLAIN_OUT" = "0" ]; then
+    log "Test 15 Passed: 'searching' matched as 'search' only on the stemmed index"
+else
+    log "Test 15 Failed: stemmed results were '$STEM_OUT', unstemmed '$PLAIN_OUT'"
+fi
+rm -f "$STEM_INDEX" "$STEM_INDEX.docs" "$STEM_INDEX.norm"
+
+# Test 16: Every line of the index file is loaded, the first one too
+FIRST_WORD=$(head -1 "$INDEX_FILENAME" | cut -d' ' -f1)
+log "Test 16: '$FIRST_WORD', the first word of the index file"
+FIRST_OUT=$(echo "$FIRST_WORD" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- 2>/dev/null | cut -f2)
+if [ -n "$FIRST_OUT" ] && [ "$FIRST_OUT" -gt 0 ]; then
+    log "Test 16 Passed: '$FIRST_WORD' matched $FIRST_OUT documents"
+else
+    log "Test 16 Failed: '$FIRST_WORD' matched '$FIRST_OUT' documents"
+fi
+
+# Test 17: An index split into shards answers as the index unsplit,
+# ranked by BM25 too, in batch mode and interactively
+log "Test 17: the same queries on an index of three shards and on one file"
+SHARD_INDEX="$OUTPUT_FILE.shard.index"
+WHOLE_INDEX="$OUTPUT_FILE.whole.index"
+../indexer/indexer "$PAGE_DIRECTORY" "$SHARD_INDEX" --shards=3 > /dev/null 2>&1
+../indexer/indexer "$PAGE_DIRECTORY" "$WHOLE_INDEX" > /dev/null 2>&1
+SHARD_QUERIES="home\nhome page\nsearch or page\nplayground and home or first\nplay* or tse\n"
+for RANK in count bm25; do
+    for TOP in 0 2; do
+        SHARD_OUT=$(printf "$SHARD_QUERIES" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$SHARD_INDEX" \
+            --batch=- --top=$TOP --rank=$RANK 2>/dev/null)
+        WHOLE_OUT=$(printf "$SHARD_QUERIES" | $QUERIER_EXEC "$PAGE_DIRECTORY" "$WHOLE_INDEX" \
+            --batch=- --top=$TOP --rank=$RANK 2>/dev/null)
+        if [ -n "$SHARD_OUT" ] && [ "$SHARD_OUT" = "$WHOLE_OUT" ]; then
+            log "Test 17 Passed: three shards gave the index's results with --top=$TOP --rank=$RANK"
+        else
+            log "Test 17 Failed: shards gave '$SHARD_OUT', the index '$WHOLE_OUT' with --top=$TOP --rank=$RANK"
+        fi
+    done
+done
+SHARD_OUT=$(printf "$SHARD_QUERIES" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$SHARD_INDEX" --rank=bm25 2>/dev/null | grep "^score")
+WHOLE_OUT=$(printf "$SHARD_QUERIES" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$WHOLE_INDEX" --rank=bm25 2>/dev/null | grep "^score")
+if [ -n "$SHARD_OUT" ] && [ "$SHARD_OUT" = "$WHOLE_OUT" ]; then
+    log "Test 17 Passed: the shards' threads ranked as the index does interactively"
+else
+    log "Test 17 Failed: interactively the shards ranked differently from the index"
+fi
+rm -f "$SHARD_INDEX.shards" "$SHARD_INDEX".shard* "$WHOLE_INDEX" "$WHOLE_INDEX.docs" "$WHOLE_INDEX.norm"
+
+# Test 18: Laying the postings out by a query log changes no result
+log "Test 18: the same queries with --layout and --huge-pages and without"
+LAYOUT_LOG="$OUTPUT_FILE.layout.log"
+LAYOUT_QUERIES="home\nhome page\nsearch or page\nplayground and home or first\n"
+printf "page\npage\nhome\nplayground and search\n" > "$LAYOUT_LOG"
+LAID_OUT=$(printf "$LAYOUT_QUERIES" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- --top=2 \
+        --layout="$LAYOUT_LOG" --huge-pages 2>/dev/null)
+AS_LOADED=$(printf "$LAYOUT_QUERIES" \
+    | $QUERIER_EXEC "$PAGE_DIRECTORY" "$INDEX_FILENAME" --batch=- --top=2 2>/dev/null)
+if [ -n "$LAID_OUT" ] && [ "$LAID_OUT" = "$AS_LOADED" ]; then
+    log "Test 18 Passed: the laid out postings gave the same results"
+else
+    log "Test 18 Failed: laid out gave '$LAID_OUT', as loaded '$AS_LOADED'"
+fi
+rm -f "$LAYOUT_LOG"
+
 # Additional tests can be continued here in the same manner...
 
 log "=========================================================="
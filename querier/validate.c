@@ -16,10 +16,25 @@
 # include "validate.h"
 # include "word.h"
 
+static bool quiet = false;     // see validate_quiet
+
+static char* read_phrase(const char* query, int* i);
+static bool check_word(const char* word);
+
+static const int MIN_PREFIX = 2;   // letters a wildcard word must start with
+
+/*************** validate_quiet ***************/
+// see validate.h for more information
+void validate_quiet(bool silent) {
+    quiet = silent;
+}
 
 /*************** print_error ***************/
 // see validate.h for more information
 void print_error(const char* message, const char* detail) {
+    if (quiet) {
+        return;
+    }
     if (detail != NULL) {
         printf("Error: %s %s\n", message, detail);
     } else {
@@ -46,7 +61,6 @@ void free_memory(char** result, int* count) {
 // see validate.h for more information
 char** validate(char* query, int* count)
 {
-    const char* operant_1 = "or";
     char** result = malloc(strlen(query) * sizeof(char*));
     if (result == NULL) {
         print_error("failed to allocate memory", NULL);
@@ -56,8 +70,21 @@ char** validate(char* query, int* count)
     *count = 0;
     int i = 0, start = 0;
     while (query[i] != '\0') {
-        if (!isalpha(query[i]) && !isspace(query[i])) {
-            printf("Error: bad character '%c' in query.\n", query[i]);
+        if (query[i] == '"' && start == i) {
+            char* phrase = read_phrase(query, &i);
+            if (phrase == NULL) {
+                free_memory(result, count);
+                return NULL;
+            }
+            result[*count] = phrase;
+            (*count)++;
+            start = i;
+            continue;
+        }
+        if (!isalpha(query[i]) && !isspace(query[i]) && query[i] != '*') {
+            char message[100];
+            snprintf(message, sizeof(message), "bad character '%c' in query.", query[i]);
+            print_error(message, NULL);
             free_memory(result, count);
             return NULL;
         }
@@ -74,10 +101,7 @@ char** validate(char* query, int* count)
                 strncpy(word, query + start, length);
                 word[length] = '\0';
 
-                if (length < 3 && strcmp(word, operant_1) != 0) {
-                    char message[100];
-                    snprintf(message, sizeof(message), "'%s' is an invalid word", word);
-                    print_error(message, NULL);
+                if (!check_word(word)) {
                     free(word);
                     free_memory(result, count);
                     return NULL;
@@ -101,10 +125,7 @@ char** validate(char* query, int* count)
         strncpy(word, query + start, length);
         word[length] = '\0';
 
-        if (length < 3 && strcmp(word, operant_1) != 0) {
-            char message[100];
-            snprintf(message, sizeof(message), "'%s' is an invalid word", word);
-            print_error(message, NULL);
+        if (!check_word(word)) {
             free(word);
             free_memory(result, count);
             return NULL;
@@ -123,6 +144,143 @@ char** validate(char* query, int* count)
 }
 
 
+/*************** check_word ***************
+ * Checks one word of a query: "or", or three or more letters and
+ * wildcards, of which the first MIN_PREFIX are letters.
+ * Returns:
+ * true if it is valid; false after printing an error if not.
+ */
+static bool check_word(const char* word) {
+    char message[100];
+    size_t prefix = strcspn(word, "*");
+    if (strlen(word) < 3 && strcmp(word, "or") != 0) {
+        snprintf(message, sizeof(message), "'%s' is an invalid word", word);
+        print_error(message, NULL);
+        return false;
+    }
+    if (word[prefix] == '*' && (int) prefix < MIN_PREFIX) {
+        snprintf(message, sizeof(message), "'%s' needs %d letters before its first '*'",
+                 word, MIN_PREFIX);
+        print_error(message, NULL);
+        return false;
+    }
+    return true;
+}
+
+/*************** read_phrase ***************
+ * Reads the quoted phrase starting at query[*i] and moves *i past its
+ * closing quote.
+ * Returns:
+ * its words joined by single spaces (a phrase of one word is just the
+ * word), or NULL after printing an error if it is unclosed, empty, or
+ * holds anything but words of three or more letters.
+ */
+static char* read_phrase(const char* query, int* i) {
+    const char* open = query + *i + 1;
+    const char* close = strchr(open, '"');
+    if (close == NULL) {
+        print_error("unclosed quote in query.", NULL);
+        return NULL;
+    }
+    char* phrase = malloc(close - open + 1);
+    if (phrase == NULL) {
+        print_error("failed to allocate memory", NULL);
+        return NULL;
+    }
+    char* p = phrase;
+    for (const char* s = open; s < close; ) {
+        if (*s == ' ') {
+            s++;
+            continue;
+        }
+        const char* end = s;
+        while (end < close && *end != ' ') {
+            if (!isalpha(*end)) {
+                char message[100];
+                snprintf(message, sizeof(message), "bad character '%c' in query.", *end);
+                print_error(message, NULL);
+                free(phrase);
+                return NULL;
+            }
+            end++;
+        }
+        if (end - s < 3) {
+            char message[100];
+            snprintf(message, sizeof(message), "'%.*s' is an invalid word", (int) (end - s), s);
+            print_error(message, NULL);
+            free(phrase);
+            return NULL;
+        }
+        if (p > phrase) {
+            *p++ = ' ';
+        }
+        memcpy(p, s, end - s);
+        p += end - s;
+        s = end;
+    }
+    *p = '\0';
+    if (p == phrase) {
+        print_error("empty phrase in query.", NULL);
+        free(phrase);
+        return NULL;
+    }
+    *i = close - query + 1;
+    return phrase;
+}
+
+/*************** query_phrase ***************/
+// see validate.h for more information
+bool query_phrase(char** words, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strchr(words[i], ' ') != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*************** query_normalize ***************/
+// see validate.h for more information
+bool query_normalize(char** words, int count, wordnorm_t* norm) {
+    if (wordnorm_stages(norm) == 0) {
+        return true;       // validate has already lowercased them
+    }
+    for (int i = 0; i < count; i++) {
+        if (strcmp(words[i], "and") == 0 || strcmp(words[i], "or") == 0
+            || strchr(words[i], '*') != NULL) {
+            continue;
+        }
+        // a normalized word is never longer, so the words are rewritten
+        // in place, a phrase's one at a time behind the one being read
+        char* out = words[i];
+        char* s = words[i];
+        while (*s != '\0') {
+            size_t length = strcspn(s, " ");
+            char separator = s[length];
+            s[length] = '\0';
+            char* normalized = wordnorm_apply(norm, s);
+            s[length] = separator;
+            if (normalized == NULL) {
+                print_error("failed to allocate memory", NULL);
+                return false;
+            }
+            if (out > words[i]) {
+                *out++ = ' ';
+            }
+            size_t n = strlen(normalized);
+            memcpy(out, normalized, n);
+            out += n;
+            free(normalized);
+            s += length;
+            if (*s == ' ') {
+                s++;
+            }
+        }
+        *out = '\0';
+    }
+    return true;
+}
+
 /*************** operator_validate ***************/
 // see validate.h for more information
 bool operator_validate(char** string_array, int count) {
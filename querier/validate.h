@@ -4,6 +4,7 @@
 #define VALIDATE_H
 
 #include <stdbool.h>
+#include "../common/word.h"
 
 /*************** query_clean ***************
  * Cleans and normalizes the input query string.
@@ -22,8 +23,18 @@ char* query_clean(const char* query);
  */
 void print_error(const char* message, const char* detail);
 
+/*************** validate_quiet ***************
+ * Turns print_error's messages off (true) or back on (false), for
+ * callers that report invalid queries themselves. Set it before any
+ * threads start validating.
+ */
+void validate_quiet(bool silent);
+
 /*************** validate ***************
  * Tokenizes, validates, and builds an array of valid words from the input query.
+ * A phrase in double quotes is one word of the array, its words joined
+ * by single spaces. A word may hold '*' wildcards, each standing for
+ * any letters, once it starts with two letters.
  * Inputs:
  * query - the input query string.
  * count - pointer to hold the count of valid words in the query.
@@ -32,6 +43,32 @@ void print_error(const char* message, const char* detail);
  */
 char** validate(char* query, int* count);
 
+/*************** query_normalize ***************
+ * Normalizes validated query words the way the index's words were,
+ * each word of a phrase on its own; "and", "or" and wildcard words are
+ * left as they are, since a wildcard's letters are matched against
+ * the index's words as they stand.
+ * Inputs:
+ * words - the array from validate; changed in place.
+ * count - number of words in the array.
+ * norm - the index's pipeline (see pindex_normalizer); NULL leaves the
+ *   words as validate made them.
+ * Output:
+ * Returns false, after printing an error, if memory runs out.
+ */
+bool query_normalize(char** words, int count, wordnorm_t* norm);
+
+/*************** query_phrase ***************
+ * Tells whether validated query words hold a phrase (a word holding
+ * spaces), which only an index with positions can answer.
+ * Inputs:
+ * words - the array from validate.
+ * count - number of words in the array.
+ * Output:
+ * Returns true if any word is a phrase.
+ */
+bool query_phrase(char** words, int count);
+
 /*************** operator_validate ***************
  * Ensures operators in the query are used correctly.
  * Inputs: